@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Fontをアトラス画像に変換(app.baked_fonts用)
+
+../tools/fontbake -a ../assets -o ../assets ui_*.json
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# 古い.meshが残っていたらビルドを止める(ビルドの前処理で実行)
+
+../tools/meshc -a ../assets -c
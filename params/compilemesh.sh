@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# Modelをバイナリ形式に変換(.objより先に読み込む)
+
+../tools/meshc -a ../assets -o ../assets
@@ -0,0 +1,18 @@
+#!/bin/sh
+
+# stageをバイナリ形式に変換(COMPILED_STAGES用)
+
+../tools/stagec stage01.json ../assets/stage01.stage
+../tools/stagec stage02.json ../assets/stage02.stage
+../tools/stagec stage03.json ../assets/stage03.stage
+../tools/stagec stage04.json ../assets/stage04.stage
+../tools/stagec stage05.json ../assets/stage05.stage
+../tools/stagec stage06.json ../assets/stage06.stage
+../tools/stagec stage07.json ../assets/stage07.stage
+../tools/stagec stage08.json ../assets/stage08.stage
+../tools/stagec stage09.json ../assets/stage09.stage
+../tools/stagec stage10.json ../assets/stage10.stage
+../tools/stagec stage11.json ../assets/stage11.stage
+
+../tools/stagec startline.json ../assets/startline.stage
+../tools/stagec finishline.json ../assets/finishline.stage
@@ -28,7 +28,7 @@ class AllStageClearController : public ControllerBase {
   float deactive_delay_;
   float sns_delay_;
 
-  std::string jingle_se_;
+  SoundHandle jingle_se_;
   
   std::string sns_text_;
   std::string sns_url_;
@@ -57,7 +57,7 @@ public:
     titleback_delay_(params["titleback_delay"].getValue<float>()),
     deactive_delay_(params["deactive_delay"].getValue<float>()),
     sns_delay_(params["sns_delay"].getValue<float>()),
-    jingle_se_(params["jingle-se"].getValue<std::string>()),
+    jingle_se_(getSoundHandle(params["jingle-se"].getValue<std::string>())),
     sns_url_(Localize::get(params["sns_url"].getValue<std::string>())),
     view_(std::move(view)),
     active_(true),
@@ -76,7 +76,8 @@ public:
         // stage崩壊
         event_timeline_->add([this]() noexcept {
             event_.signal("collapse-stage", EventParam());
-            requestSound(event_, "all-stage-collapse");
+            static const SoundHandle all_stage_collapse_se = getSoundHandle("all-stage-collapse");
+            requestSound(event_, all_stage_collapse_se);
             
 
             // text表示
@@ -149,24 +150,24 @@ private:
     // SNS投稿で使うのでここで定義
     int item_rate = 0;
     {
-      auto item_num = boost::any_cast<int>(result.at("play_item_num"));
-      auto item_total_num = boost::any_cast<int>(result.at("play_item_total_num"));
+      auto item_num = result.get<int>("play_item_num");
+      auto item_total_num = result.get<int>("play_item_total_num");
 
       if (item_total_num > 0) {
         item_rate = item_num * 100 / item_total_num;
         view_->getWidget("item-result").setText(toFormatedString(item_rate, 3) + "%");
       }
-      if (boost::any_cast<bool>(result.at("highest_item_num"))) {
+      if (result.get<bool>("highest_item_num")) {
         view_->startWidgetTween("tween-complete-item");
       }
     }
     
-    auto game_score = boost::any_cast<int>(result.at("total_score"));
+    auto game_score = result.get<int>("total_score");
     view_->getWidget("score-result").setText(toFormatedString(game_score, 5));
-    auto total_items = boost::any_cast<int>(result.at("total_items"));
+    auto total_items = result.get<int>("total_items");
     GameCenter::submitScore(game_score, total_items);
 
-    if (boost::any_cast<bool>(result.at("highest_total_score"))) {
+    if (result.get<bool>("highest_total_score")) {
       view_->startWidgetTween("tween-hi-score");
     }
     
@@ -188,7 +189,7 @@ private:
       replaceString(sns_text_, "%1", std::to_string(game_score));
       replaceString(sns_text_, "%3", std::to_string(item_rate));
 
-      auto stage_num = boost::any_cast<int>(result.at("current_stage"));
+      auto stage_num = result.get<int>("current_stage");
       replaceString(sns_text_, "%4", std::to_string(stage_num));
       replaceString(sns_text_, "%5", sns_url_);
     }
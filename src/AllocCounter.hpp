@@ -0,0 +1,78 @@
+﻿#pragma once
+
+//
+// ヒープ確保の回数を数える(DEBUG時のみ)
+//   グローバルなoperator newを置き換える
+//   TIPS:unity buildなので一度だけincludeされる
+//
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+
+namespace ngs { namespace AllocCounter {
+
+#ifdef DEBUG
+
+std::atomic<u_int> alloc_num(0);
+
+u_int count() noexcept {
+  return alloc_num;
+}
+
+void* allocate(const size_t size) noexcept {
+  alloc_num += 1;
+  return std::malloc(size ? size : 1);
+}
+
+#else
+
+u_int count() noexcept {
+  return 0;
+}
+
+#endif
+
+} }
+
+
+#ifdef DEBUG
+
+void* operator new(size_t size) {
+  void* p = ngs::AllocCounter::allocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  void* p = ngs::AllocCounter::allocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return ngs::AllocCounter::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return ngs::AllocCounter::allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+#endif
@@ -7,8 +7,20 @@
 
 namespace ngs { namespace Asset {
 
+#if defined (HEADLESS)
+
+// Headless実行時のassetの場所
+std::string& rootPath() {
+  static std::string root_path("../assets/");
+  return root_path;
+}
+
+#endif
+
 std::string fullPath(const std::string& path) {
-#if defined (DEBUG) && defined (CINDER_MAC)
+#if defined (HEADLESS)
+  return rootPath() + path;
+#elif defined (DEBUG) && defined (CINDER_MAC)
   // DEBUG時、OSXはプロジェクトの場所からfileを読み込む
   std::string full_path(std::string(PREPRO_TO_STR(SRCROOT)) + "../assets/" + path);
   return full_path;
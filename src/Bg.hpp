@@ -2,50 +2,133 @@
 
 //
 // イケてる背景(主観)
+//   Cubeは要素ごとに配列を分けて保持し、SIMDで4個ずつ移動させる
+//   BBoxからはみ出したCubeは添え字のリストで入れ替え演出を管理する
 //
 
+#include <vector>
 #include <boost/noncopyable.hpp>
-#include "TweenUtil.hpp"
+#include <cinder/Rand.h>
+#include "TweenPool.hpp"
+#include "Profiler.hpp"
+
+#if defined (USE_SSE)
+#include <xmmintrin.h>
+#elif defined (USE_NEON)
+#include <arm_neon.h>
+#endif
 
 
 namespace ngs {
 
 class Bg : private boost::noncopyable {
 public:
-  struct Cube {
-    ci::Vec3f position;
-    ci::Anim<ci::Vec3f> size;
-    ci::Color color;
-
-    ci::Vec3f speed;
-    ci::Vec3f revised_pos;
-    bool is_tween;
-
-    Cube(const ci::Vec3f& position_,
-         const ci::Anim<ci::Vec3f>& size_,
-         const ci::Color& color_,
-         const ci::Vec3f& speed_,
-         const ci::Vec3f& revised_pos_,
-         const bool is_tween_) noexcept :
-      position(position_),
-      size(size_),
-      color(color_),
-      speed(speed_),
-      revised_pos(revised_pos_),
-      is_tween(is_tween_)
+  // TIPS:SIMDで4個ずつ処理するので、配列の長さは4の倍数
+  //      余りの分は止めておき、表示もしない
+  struct Cubes {
+    enum {
+      LANE_NUM = 4,
+    };
+    
+    size_t num;
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    // 直前の更新開始時の位置(描画時の補間用)
+    std::vector<float> prev_x;
+    std::vector<float> prev_y;
+    std::vector<float> prev_z;
+    std::vector<float> speed_x;
+    std::vector<float> speed_y;
+    std::vector<float> speed_z;
+    // 1:移動中 0:停止(入れ替え演出中)
+    std::vector<float> moving;
+
+    std::vector<ci::Vec3f> size;
+    std::vector<ci::Color> color;
+
+
+    Cubes() noexcept :
+      num(0)
     {}
+
+    ci::Vec3f position(const size_t i) const noexcept {
+      return ci::Vec3f(x[i], y[i], z[i]);
+    }
+
+    ci::Vec3f prevPosition(const size_t i) const noexcept {
+      return ci::Vec3f(prev_x[i], prev_y[i], prev_z[i]);
+    }
+
+    void keepPrevPositions() noexcept {
+      prev_x = x;
+      prev_y = y;
+      prev_z = z;
+    }
+
+    void push(const ci::Vec3f& position, const ci::Color& color_, const ci::Vec3f& speed) noexcept {
+      x.push_back(position.x);
+      y.push_back(position.y);
+      z.push_back(position.z);
+      prev_x.push_back(position.x);
+      prev_y.push_back(position.y);
+      prev_z.push_back(position.z);
+      speed_x.push_back(speed.x);
+      speed_y.push_back(speed.y);
+      speed_z.push_back(speed.z);
+      moving.push_back(1.0f);
+      size.push_back(ci::Vec3f::one());
+      color.push_back(color_);
+
+      num += 1;
+    }
+
+    // 4の倍数まで止まったCubeで埋める
+    void pad() noexcept {
+      while (x.size() % LANE_NUM) {
+        push(ci::Vec3f::zero(), ci::Color::black(), ci::Vec3f::zero());
+        moving.back() = 0.0f;
+        num -= 1;
+      }
+    }
   };
 
 
 private:
   const ci::JsonTree& params_;
   Event<EventParam>& event_;
-
-  ci::TimelineRef animation_timeline_;
+  ci::Rand& rand_;
 
   float revise_duration_;
-  
-  std::vector<Cube> cubes_;
+
+  Cubes cubes_;
+
+  // 入れ替え演出中のCube
+  struct Revise {
+    u_int index;
+    float time;
+    bool in_box;
+    ci::Vec3f revised_pos;
+  };
+  std::vector<Revise> revising_;
+  // BBoxからはみ出したCube(毎フレーム使い回す)
+  std::vector<u_int> out_of_bbox_;
+
+  // 入れ替え演出
+  struct TweenStep {
+    u_int ease;
+    float duration;
+    float delay;
+    bool has_start;
+    ci::Vec3f start;
+    bool has_end;
+    ci::Vec3f end;
+  };
+  TweenPool<ci::Vec3f> tween_pool_;
+  std::vector<TweenHandle> tween_;
+  std::vector<TweenStep> out_box_tween_;
+  std::vector<TweenStep> in_box_tween_;
 
   ci::Vec3f bbox_min_orig_;
   ci::Vec3f bbox_max_orig_;
@@ -56,21 +139,20 @@ private:
   
 public:
   Bg(ci::JsonTree& params,
-     ci::TimelineRef timeline,
-     Event<EventParam>& event) noexcept :
+     Event<EventParam>& event,
+     ci::Rand& rand) noexcept :
     params_(params),
     event_(event),
-    animation_timeline_(ci::Timeline::create()),
+    rand_(rand),
     revise_duration_(params["game.bg.revise_duration"].getValue<float>()),
     bbox_min_orig_(Json::getVec3<float>(params["game.bg.bbox_min"])),
     bbox_max_orig_(Json::getVec3<float>(params["game.bg.bbox_max"])),
     bbox_min_(bbox_min_orig_),
     bbox_max_(bbox_max_orig_)
   {
-    auto current_time = timeline->getCurrentTime();
-    animation_timeline_->setStartTime(current_time);
-    timeline->apply(animation_timeline_);
-
+    out_box_tween_ = readTweenSteps(params["game.bg.tween.out_box"]);
+    in_box_tween_  = readTweenSteps(params["game.bg.tween.in_box"]);
+    
     auto cube_speed = Json::getVec2<float>(params["game.bg.cube_speed"]);
     auto cube_density = params["app.low_efficiency_device"].getValue<bool>() ? params["game.bg.cube_density_low"].getValue<float>()
                                                                              : params["game.bg.cube_density"].getValue<float>();
@@ -80,53 +162,51 @@ public:
 
     int max_y = bbox_max_.y;
     for (int iy = bbox_min_.y; iy < max_y; ++iy) {
-      if (ci::randInt(100) < 50) {
+      if (rand_.nextInt(100) < 50) {
         // X方向
         int max_x = bbox_max_.x;
         for (int ix = bbox_min_.x; ix < max_x; ++ix) {
-          if (ci::randFloat() > cube_density) continue;
-
-          float speed = ci::randFloat(cube_speed.x, cube_speed.y);
-          // 確率1/2で向きを逆に
-          if (ci::randInt(100) < 50) speed = -speed;
-          float v = ci::randFloat(color_range.x, color_range.y);
-
-          cubes_.emplace_back(ci::Vec3f(ix, iy, ci::randInt(bbox_min_.z, bbox_max_.z)),
-                              ci::Vec3f::one(),
-                              ci::Color(v, v, v),
-                              ci::Vec3f(0, 0, speed),
-                              ci::Vec3f::zero(),
-                              false);
+          int num = cubeNumInCell(cube_density);
+          for (int i = 0; i < num; ++i) {
+            float speed = rand_.nextFloat(cube_speed.x, cube_speed.y);
+            // 確率1/2で向きを逆に
+            if (rand_.nextInt(100) < 50) speed = -speed;
+            float v = rand_.nextFloat(color_range.x, color_range.y);
+
+            cubes_.push(ci::Vec3f(ix, iy, rand_.nextInt(bbox_min_.z, bbox_max_.z)),
+                        ci::Color(v, v, v),
+                        ci::Vec3f(0, 0, speed));
+          }
         }
       }
       else {
         // Z方向
         int max_z = bbox_max_.z;
         for (int iz = bbox_min_.z; iz < max_z; ++iz) {
-          if (ci::randFloat() > cube_density) continue;
-
-          float speed = ci::randFloat(cube_speed.x, cube_speed.y);
-          if (ci::randInt(100) < 50) speed = -speed;
-          float v = ci::randFloat(color_range.x, color_range.y);
-
-          cubes_.emplace_back(ci::Vec3f(ci::randInt(bbox_min_.x, bbox_max_.x), iy, iz),
-                              ci::Vec3f::one(),
-                              ci::Color(v, v, v),
-                              ci::Vec3f(speed, 0, 0),
-                              ci::Vec3f::zero(),
-                              false);
+          int num = cubeNumInCell(cube_density);
+          for (int i = 0; i < num; ++i) {
+            float speed = rand_.nextFloat(cube_speed.x, cube_speed.y);
+            if (rand_.nextInt(100) < 50) speed = -speed;
+            float v = rand_.nextFloat(color_range.x, color_range.y);
+
+            cubes_.push(ci::Vec3f(rand_.nextInt(bbox_min_.x, bbox_max_.x), iy, iz),
+                        ci::Color(v, v, v),
+                        ci::Vec3f(speed, 0, 0));
+          }
         }
       }
     }
+    cubes_.pad();
 
-    DOUT << "bg num:" << cubes_.size() << std::endl;
-  }
+    // 演出中に確保が起きないよう、Cubeの数だけ用意しておく
+    tween_.resize(cubes_.x.size());
+    tween_pool_.reserve(cubes_.num * std::max(out_box_tween_.size(), in_box_tween_.size()));
+    revising_.reserve(cubes_.num);
+    out_of_bbox_.reserve(cubes_.x.size());
 
-  ~Bg() {
-    // 再生途中のものもあるので、手動で取り除く
-    animation_timeline_->removeSelf();
+    DOUT << "bg num:" << cubes_.num << std::endl;
   }
-  
+
 
   void setCenterPosition(const ci::Vec3i& pos) noexcept {
     
@@ -135,61 +215,246 @@ public:
   }
 
   void update(const double progressing_seconds) noexcept {
-    for (auto& cube : cubes_) {
-      if (cube.is_tween) continue;
-
-      cube.position += cube.speed * progressing_seconds;
-      bool revised = !checkInBbox(cube.position, bbox_min_, bbox_max_);
-      if (revised) {
-        cube.revised_pos.x = repeatValue(cube.position.x, bbox_min_.x, bbox_max_.x);
-        cube.revised_pos.y = repeatValue(cube.position.y, bbox_min_.y, bbox_max_.y);
-        cube.revised_pos.z = repeatValue(cube.position.z, bbox_min_.z, bbox_max_.z);
+    PROFILE_ZONE("Bg::update");
+
+    tween_pool_.update(progressing_seconds);
+    updateRevising(progressing_seconds);
+
+    out_of_bbox_.clear();
+    moveCubes(cubes_, progressing_seconds, bbox_min_, bbox_max_, out_of_bbox_);
+
+    for (auto index : out_of_bbox_) {
+      Revise revise = {
+        index, 0.0f, false,
+        ci::Vec3f(repeatValue(cubes_.x[index], bbox_min_.x, bbox_max_.x),
+                  repeatValue(cubes_.y[index], bbox_min_.y, bbox_max_.y),
+                  repeatValue(cubes_.z[index], bbox_min_.z, bbox_max_.z))
+      };
+      revising_.push_back(revise);
         
-        startTween("out_box", cube);
-        cube.is_tween = true;
-
-        animation_timeline_->add([this, &cube]() mutable {
-            cube.position = cube.revised_pos;
-            startTween("in_box", cube);
-          },
-          animation_timeline_->getCurrentTime() + revise_duration_);
-
-        animation_timeline_->add([&cube]() mutable {
-            cube.is_tween = false;
-          },
-          animation_timeline_->getCurrentTime() + revise_duration_ * 2);
-      }
+      startTween(out_box_tween_, index);
+      cubes_.moving[index] = 0.0f;
     }
   }
 
 
-  const std::vector<Cube>& cubes() const noexcept { return cubes_; }
+  const Cubes& cubes() const noexcept { return cubes_; }
+
+  void keepPrevPositions() noexcept { cubes_.keepPrevPositions(); }
 
   std::pair<ci::Vec3f, ci::Vec3f> getBbox() const noexcept {
     return std::make_pair(bbox_min_, bbox_max_);
   }
-  
+
+
+  // 移動させて、BBoxからはみ出した添え字を返す
+  static void moveCubes(Cubes& cubes, const float dt,
+                        const ci::Vec3f& bbox_min, const ci::Vec3f& bbox_max,
+                        std::vector<u_int>& out_of_bbox) noexcept {
+#if defined (USE_SSE)
+    moveCubesSSE(cubes, dt, bbox_min, bbox_max, out_of_bbox);
+#elif defined (USE_NEON)
+    moveCubesNEON(cubes, dt, bbox_min, bbox_max, out_of_bbox);
+#else
+    moveCubesScalar(cubes, dt, bbox_min, bbox_max, out_of_bbox);
+#endif
+  }
+
+  static void moveCubesScalar(Cubes& cubes, const float dt,
+                              const ci::Vec3f& bbox_min, const ci::Vec3f& bbox_max,
+                              std::vector<u_int>& out_of_bbox) noexcept {
+    size_t num = cubes.x.size();
+    for (size_t i = 0; i < num; ++i) {
+      if (cubes.moving[i] == 0.0f) continue;
+
+      cubes.x[i] += cubes.speed_x[i] * dt;
+      cubes.y[i] += cubes.speed_y[i] * dt;
+      cubes.z[i] += cubes.speed_z[i] * dt;
+
+      if (!checkInBbox(cubes.position(i), bbox_min, bbox_max)) {
+        out_of_bbox.push_back(u_int(i));
+      }
+    }
+  }
+
 
 private:
-  void startTween(const std::string& name, Cube& cube) noexcept {
-    auto tween_params = params_["game.bg.tween." + name];
-
-    std::set<std::string> applyed_targets;
-    for (const auto& params : tween_params) {
-      std::map<std::string,
-               std::function<void (Cube&, const ci::JsonTree&, const bool)> > tween_setup = {
-        { "scale",
-          [this](Cube& cube, const ci::JsonTree& params, const bool is_first) {
-            setVec3Tween(*animation_timeline_, cube.size, params, ci::Vec3f::zero(), is_first);
-          }
-        },
-      };
+#if defined (USE_SSE)
+  static void moveCubesSSE(Cubes& cubes, const float dt,
+                           const ci::Vec3f& bbox_min, const ci::Vec3f& bbox_max,
+                           std::vector<u_int>& out_of_bbox) noexcept {
+    const __m128 zero  = _mm_setzero_ps();
+    const __m128 t     = _mm_set1_ps(dt);
+    const __m128 min_x = _mm_set1_ps(bbox_min.x);
+    const __m128 min_y = _mm_set1_ps(bbox_min.y);
+    const __m128 min_z = _mm_set1_ps(bbox_min.z);
+    const __m128 max_x = _mm_set1_ps(bbox_max.x);
+    const __m128 max_y = _mm_set1_ps(bbox_max.y);
+    const __m128 max_z = _mm_set1_ps(bbox_max.z);
+
+    float* x = cubes.x.data();
+    float* y = cubes.y.data();
+    float* z = cubes.z.data();
+    const float* speed_x = cubes.speed_x.data();
+    const float* speed_y = cubes.speed_y.data();
+    const float* speed_z = cubes.speed_z.data();
+    const float* moving  = cubes.moving.data();
+
+    size_t num = cubes.x.size();
+    for (size_t i = 0; i < num; i += Cubes::LANE_NUM) {
+      // 停止中は移動量が0になる
+      __m128 m    = _mm_loadu_ps(moving + i);
+      __m128 step = _mm_mul_ps(t, m);
+
+      __m128 px = _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(speed_x + i), step));
+      __m128 py = _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(speed_y + i), step));
+      __m128 pz = _mm_add_ps(_mm_loadu_ps(z + i), _mm_mul_ps(_mm_loadu_ps(speed_z + i), step));
+      _mm_storeu_ps(x + i, px);
+      _mm_storeu_ps(y + i, py);
+      _mm_storeu_ps(z + i, pz);
+
+      __m128 out = _mm_or_ps(_mm_cmplt_ps(px, min_x), _mm_cmpgt_ps(px, max_x));
+      out = _mm_or_ps(out, _mm_or_ps(_mm_cmplt_ps(py, min_y), _mm_cmpgt_ps(py, max_y)));
+      out = _mm_or_ps(out, _mm_or_ps(_mm_cmplt_ps(pz, min_z), _mm_cmpgt_ps(pz, max_z)));
+      out = _mm_and_ps(out, _mm_cmpgt_ps(m, zero));
+
+      int mask = _mm_movemask_ps(out);
+      if (!mask) continue;
+      for (int j = 0; j < Cubes::LANE_NUM; ++j) {
+        if (mask & (1 << j)) out_of_bbox.push_back(u_int(i + j));
+      }
+    }
+  }
+#endif
+
+#if defined (USE_NEON)
+  static void moveCubesNEON(Cubes& cubes, const float dt,
+                            const ci::Vec3f& bbox_min, const ci::Vec3f& bbox_max,
+                            std::vector<u_int>& out_of_bbox) noexcept {
+    const float32x4_t zero  = vdupq_n_f32(0.0f);
+    const float32x4_t t     = vdupq_n_f32(dt);
+    const float32x4_t min_x = vdupq_n_f32(bbox_min.x);
+    const float32x4_t min_y = vdupq_n_f32(bbox_min.y);
+    const float32x4_t min_z = vdupq_n_f32(bbox_min.z);
+    const float32x4_t max_x = vdupq_n_f32(bbox_max.x);
+    const float32x4_t max_y = vdupq_n_f32(bbox_max.y);
+    const float32x4_t max_z = vdupq_n_f32(bbox_max.z);
+
+    float* x = cubes.x.data();
+    float* y = cubes.y.data();
+    float* z = cubes.z.data();
+    const float* speed_x = cubes.speed_x.data();
+    const float* speed_y = cubes.speed_y.data();
+    const float* speed_z = cubes.speed_z.data();
+    const float* moving  = cubes.moving.data();
+
+    size_t num = cubes.x.size();
+    for (size_t i = 0; i < num; i += Cubes::LANE_NUM) {
+      // 停止中は移動量が0になる
+      float32x4_t m    = vld1q_f32(moving + i);
+      float32x4_t step = vmulq_f32(t, m);
+
+      float32x4_t px = vmlaq_f32(vld1q_f32(x + i), vld1q_f32(speed_x + i), step);
+      float32x4_t py = vmlaq_f32(vld1q_f32(y + i), vld1q_f32(speed_y + i), step);
+      float32x4_t pz = vmlaq_f32(vld1q_f32(z + i), vld1q_f32(speed_z + i), step);
+      vst1q_f32(x + i, px);
+      vst1q_f32(y + i, py);
+      vst1q_f32(z + i, pz);
+
+      uint32x4_t out = vorrq_u32(vcltq_f32(px, min_x), vcgtq_f32(px, max_x));
+      out = vorrq_u32(out, vorrq_u32(vcltq_f32(py, min_y), vcgtq_f32(py, max_y)));
+      out = vorrq_u32(out, vorrq_u32(vcltq_f32(pz, min_z), vcgtq_f32(pz, max_z)));
+      out = vandq_u32(out, vcgtq_f32(m, zero));
+
+      uint32x2_t any = vorr_u32(vget_low_u32(out), vget_high_u32(out));
+      if (!vget_lane_u32(vpmax_u32(any, any), 0)) continue;
+
+      uint32_t lanes[Cubes::LANE_NUM];
+      vst1q_u32(lanes, out);
+      for (int j = 0; j < Cubes::LANE_NUM; ++j) {
+        if (lanes[j]) out_of_bbox.push_back(u_int(i + j));
+      }
+    }
+  }
+#endif
+
+  // 入れ替え演出を進める
+  //   revise_duration_でBBoxの反対側へ移し、その倍の時間で移動を再開
+  void updateRevising(const double progressing_seconds) noexcept {
+    for (size_t i = 0; i < revising_.size(); ) {
+      auto& revise = revising_[i];
+      revise.time += progressing_seconds;
+
+      if (!revise.in_box && (revise.time >= revise_duration_)) {
+        cubes_.x[revise.index] = revise.revised_pos.x;
+        cubes_.y[revise.index] = revise.revised_pos.y;
+        cubes_.z[revise.index] = revise.revised_pos.z;
+        // 反対側へ移したので補間しない
+        cubes_.prev_x[revise.index] = revise.revised_pos.x;
+        cubes_.prev_y[revise.index] = revise.revised_pos.y;
+        cubes_.prev_z[revise.index] = revise.revised_pos.z;
+        startTween(in_box_tween_, revise.index);
+        revise.in_box = true;
+      }
+
+      if (revise.time >= (revise_duration_ * 2)) {
+        cubes_.moving[revise.index] = 1.0f;
 
-      const auto& target = params["target"].getValue<std::string>();
-      tween_setup[target](cube, params, isFirstApply(target, applyed_targets));
+        revise = revising_.back();
+        revising_.pop_back();
+        continue;
+      }
+
+      ++i;
     }
   }
 
+  void startTween(const std::vector<TweenStep>& steps, const u_int index) noexcept {
+    auto* target = &cubes_.size[index];
+    
+    bool is_first = true;
+    for (const auto& step : steps) {
+      auto start = step.has_start ? step.start : *target;
+      auto end   = step.has_end   ? step.end   : *target;
+      
+      if (is_first) {
+        tween_pool_.stop(tween_[index]);
+        tween_[index] = tween_pool_.apply(target, start, end, step.duration, step.ease, step.delay);
+        is_first = false;
+      }
+      else {
+        tween_[index] = tween_pool_.appendTo(tween_[index], target, end, step.duration, step.ease, step.delay);
+      }
+    }
+  }
+
+  std::vector<TweenStep> readTweenSteps(const ci::JsonTree& params) noexcept {
+    std::vector<TweenStep> steps;
+    for (const auto& p : params) {
+      assert((p["target"].getValue<std::string>() == "scale") && "bg tween supports scale only.");
+
+      TweenStep step = {
+        tween_pool_.ease(p["type"].getValue<std::string>()),
+        p["duration"].getValue<float>(),
+        p.hasChild("delay") ? p["delay"].getValue<float>() : 0.0f,
+        p.hasChild("start"),
+        p.hasChild("start") ? Json::getVec3<float>(p["start"]) : ci::Vec3f::zero(),
+        p.hasChild("end"),
+        p.hasChild("end") ? Json::getVec3<float>(p["end"]) : ci::Vec3f::zero(),
+      };
+      steps.push_back(step);
+    }
+    return steps;
+  }
+
+  // 1マスに置くCubeの数
+  // TIPS:1を超える密度では複数置く
+  int cubeNumInCell(const float density) noexcept {
+    int num = int(density);
+    if (rand_.nextFloat() < (density - num)) num += 1;
+    return num;
+  }
+
   static bool checkInBbox(const ci::Vec3f& pos,
                           const ci::Vec3f& bbox_min, const ci::Vec3f& bbox_max) noexcept {
     return pos.x >= bbox_min.x
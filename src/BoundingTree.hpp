@@ -0,0 +1,314 @@
+﻿#pragma once
+
+//
+// Rayで当たり判定するためのBVH(Bounding Volume Hierarchy)
+//   idごとにAABBを登録し、動いたものだけ親のAABBを更新(refit)する
+//   登録数が変わった時と、refitを繰り返して木の形が崩れた時だけ作り直す
+//   TIPS:beginUpdate〜endUpdateの間にupdateされなかったidは削除される
+//
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <cinder/Ray.h>
+#include <cinder/AxisAlignedBox.h>
+
+
+namespace ngs {
+
+class BoundingTree : private boost::noncopyable {
+  enum {
+    // 葉の数のこの倍refitしたら作り直す
+    REBUILD_RATE = 4,
+  };
+
+  struct Bounds {
+    ci::Vec3f min;
+    ci::Vec3f max;
+
+    bool operator==(const Bounds& rhs) const noexcept {
+      return (min == rhs.min) && (max == rhs.max);
+    }
+  };
+
+  struct Leaf {
+    u_int  id;
+    Bounds bounds;
+    u_int  frame;
+    int    node;
+  };
+
+  struct Node {
+    Bounds bounds;
+    int    parent;
+    // 葉の場合はleftが負になり、~leftが葉の添え字
+    int    left;
+    int    right;
+  };
+
+  std::vector<Leaf> leaves_;
+  std::vector<Node> nodes_;
+  std::unordered_map<u_int, int> index_;
+
+  u_int frame_;
+  bool  dirty_;
+  size_t refit_num_;
+
+  // 作り直し用の作業領域
+  std::vector<int> order_;
+
+  
+public:
+  BoundingTree() noexcept :
+    frame_(0),
+    dirty_(false),
+    refit_num_(0)
+  {
+    leaves_.reserve(64);
+    nodes_.reserve(128);
+    index_.reserve(64);
+  }
+
+
+  void beginUpdate() noexcept {
+    frame_ += 1;
+  }
+
+  // 登録 or 位置の更新
+  void update(const u_int id, const ci::Vec3f& min, const ci::Vec3f& max) noexcept {
+    Bounds bounds = { min, max };
+    
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+      index_.emplace(id, int(leaves_.size()));
+      leaves_.push_back({ id, bounds, frame_, -1 });
+      dirty_ = true;
+      return;
+    }
+
+    auto& leaf = leaves_[it->second];
+    leaf.frame = frame_;
+    if (leaf.bounds == bounds) return;
+
+    leaf.bounds = bounds;
+    if (!dirty_) refit(leaf.node);
+  }
+
+  // 更新されなかったidを削除して、必要なら木を作り直す
+  void endUpdate() noexcept {
+    for (size_t i = 0; i < leaves_.size(); ) {
+      if (leaves_[i].frame == frame_) {
+        ++i;
+        continue;
+      }
+
+      // 末尾と入れ替えて削除
+      index_.erase(leaves_[i].id);
+      if (i != leaves_.size() - 1) {
+        leaves_[i] = leaves_.back();
+        index_[leaves_[i].id] = int(i);
+      }
+      leaves_.pop_back();
+      dirty_ = true;
+    }
+
+    if (dirty_ || (refit_num_ > leaves_.size() * REBUILD_RATE)) {
+      build();
+    }
+  }
+
+  void clear() noexcept {
+    leaves_.clear();
+    nodes_.clear();
+    index_.clear();
+    dirty_ = false;
+    refit_num_ = 0;
+  }
+  
+
+  bool contains(const u_int id) const noexcept {
+    return index_.find(id) != index_.end();
+  }
+
+  size_t size() const noexcept { return leaves_.size(); }
+
+  
+  // Rayと交差する一番手前のidを返す
+  // skip(id)がtrueのidは無視する
+  template <typename F>
+  boost::optional<u_int> rayCast(const ci::Ray& ray, F skip) const noexcept {
+    if (nodes_.empty()) return boost::optional<u_int>();
+
+    const auto& origin = ray.getOrigin();
+    const auto& direction = ray.getDirection();
+    ci::Vec3f inv_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    float near_t = std::numeric_limits<float>::max();
+    int   picked = -1;
+
+    // 再帰せず、自前のスタックで辿る
+    int stack[64];
+    int stack_num = 0;
+    stack[stack_num++] = 0;
+    while (stack_num > 0) {
+      const auto& node = nodes_[stack[--stack_num]];
+
+      float t;
+      if (!intersect(node.bounds, origin, inv_direction, t) || (t > near_t)) continue;
+
+      if (node.left < 0) {
+        const auto& leaf = leaves_[~node.left];
+        if (skip(leaf.id)) continue;
+
+        near_t = t;
+        picked = ~node.left;
+        continue;
+      }
+
+      // 手前の子から先に調べるよう、奥の子を先に積む
+      float left_t;
+      float right_t;
+      bool left_hit  = intersect(nodes_[node.left].bounds, origin, inv_direction, left_t);
+      bool right_hit = intersect(nodes_[node.right].bounds, origin, inv_direction, right_t);
+      if (left_hit && right_hit) {
+        if (left_t < right_t) {
+          stack[stack_num++] = node.right;
+          stack[stack_num++] = node.left;
+        }
+        else {
+          stack[stack_num++] = node.left;
+          stack[stack_num++] = node.right;
+        }
+      }
+      else if (left_hit) {
+        stack[stack_num++] = node.left;
+      }
+      else if (right_hit) {
+        stack[stack_num++] = node.right;
+      }
+    }
+
+    if (picked < 0) return boost::optional<u_int>();
+    return boost::optional<u_int>(leaves_[picked].id);
+  }
+
+
+private:
+  // slab法でRayとAABBの交差を調べる
+  // tには入る位置(始点がAABBの中なら0)を返す
+  static bool intersect(const Bounds& bounds,
+                        const ci::Vec3f& origin, const ci::Vec3f& inv_direction,
+                        float& t) noexcept {
+    float t_min = 0.0f;
+    float t_max = std::numeric_limits<float>::max();
+    for (int i = 0; i < 3; ++i) {
+      float t0 = (bounds.min[i] - origin[i]) * inv_direction[i];
+      float t1 = (bounds.max[i] - origin[i]) * inv_direction[i];
+      if (t0 > t1) std::swap(t0, t1);
+
+      // TIPS:Rayが軸と平行で境界上にあるとNaNになるので、比較が偽なら採用しない
+      t_min = (t0 > t_min) ? t0 : t_min;
+      t_max = (t1 < t_max) ? t1 : t_max;
+      if (t_min > t_max) return false;
+    }
+
+    t = t_min;
+    return true;
+  }
+
+  static Bounds merge(const Bounds& a, const Bounds& b) noexcept {
+    Bounds bounds = {
+      ci::Vec3f(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z)),
+      ci::Vec3f(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z))
+    };
+    return bounds;
+  }
+
+
+  // 葉から根に向かってAABBを更新
+  void refit(int index) noexcept {
+    refit_num_ += 1;
+
+    auto& leaf_node = nodes_[index];
+    leaf_node.bounds = leaves_[~leaf_node.left].bounds;
+
+    index = leaf_node.parent;
+    while (index >= 0) {
+      auto& node = nodes_[index];
+      auto bounds = merge(nodes_[node.left].bounds, nodes_[node.right].bounds);
+      // 変化が無ければ、それより上も変わらない
+      if (node.bounds == bounds) break;
+
+      node.bounds = bounds;
+      index = node.parent;
+    }
+  }
+  
+  // 中心が一番広がっている軸の中央値で、上から二分割して作る
+  void build() noexcept {
+    nodes_.clear();
+    dirty_ = false;
+    refit_num_ = 0;
+    if (leaves_.empty()) return;
+
+    order_.resize(leaves_.size());
+    for (size_t i = 0; i < order_.size(); ++i) {
+      order_[i] = int(i);
+    }
+    
+    buildNode(0, int(order_.size()), -1);
+  }
+
+  int buildNode(const int begin, const int end, const int parent) noexcept {
+    int index = int(nodes_.size());
+    nodes_.push_back(Node());
+    nodes_[index].parent = parent;
+
+    if ((end - begin) == 1) {
+      auto& leaf = leaves_[order_[begin]];
+      leaf.node = index;
+
+      nodes_[index].bounds = leaf.bounds;
+      nodes_[index].left   = ~order_[begin];
+      nodes_[index].right  = -1;
+      return index;
+    }
+
+    // 中心の範囲から分割する軸を決める
+    auto center = [this](const int i) {
+      return (leaves_[i].bounds.min + leaves_[i].bounds.max) * 0.5f;
+    };
+    
+    ci::Vec3f c_min = center(order_[begin]);
+    ci::Vec3f c_max = c_min;
+    for (int i = begin + 1; i < end; ++i) {
+      auto c = center(order_[i]);
+      c_min.set(std::min(c.x, c_min.x), std::min(c.y, c_min.y), std::min(c.z, c_min.z));
+      c_max.set(std::max(c.x, c_max.x), std::max(c.y, c_max.y), std::max(c.z, c_max.z));
+    }
+    auto extent = c_max - c_min;
+    int axis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2)
+                                     : ((extent.y > extent.z) ? 1 : 2);
+
+    int mid = (begin + end) / 2;
+    std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+                     [this, axis](const int a, const int b) {
+                       return (leaves_[a].bounds.min[axis] + leaves_[a].bounds.max[axis])
+                            < (leaves_[b].bounds.min[axis] + leaves_[b].bounds.max[axis]);
+                     });
+
+    // push_backで再確保されるので、参照を持たずに添え字で書き込む
+    int left  = buildNode(begin, mid, index);
+    int right = buildNode(mid, end, index);
+    nodes_[index].left   = left;
+    nodes_[index].right  = right;
+    nodes_[index].bounds = merge(nodes_[left].bounds, nodes_[right].bounds);
+    return index;
+  }
+  
+};
+
+}
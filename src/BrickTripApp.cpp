@@ -3,13 +3,15 @@
 // 
 
 #include "Defines.hpp"
+#include <chrono>
+#include <set>
+#include <memory>
 #include <boost/noncopyable.hpp>
 #include <cinder/app/AppNative.h>
 #include <cinder/Json.h>
 #include <cinder/gl/gl.h>
 #include <cinder/Camera.h>
 #include <cinder/System.h>
-#include "DrawVboMesh.hpp"
 #include "AntiAliasingType.hpp"
 #include "Autolayout.hpp"
 #include "JsonUtil.hpp"
@@ -23,6 +25,7 @@
 #include "GameCenter.h"
 #include "AppSupport.hpp"
 #include "StageData.hpp"
+#include "JobGraph.hpp"
 
 
 namespace ngs {
@@ -48,6 +51,9 @@ class BrickTripApp : public ci::app::AppNative,
   // FIXME:setupが呼ばれるまではCinderの機能を使ってはならない
   std::unique_ptr<FontHolder> fonts_;
   std::unique_ptr<ModelHolder> models_;
+
+  // TIPS:controller_より先に破棄されないように、ここで宣言
+  std::unique_ptr<JobGraph> jobs_;
   
   ci::Vec2f mouse_pos_;
   ci::Vec2f mouse_prev_pos_;
@@ -85,8 +91,6 @@ class BrickTripApp : public ci::app::AppNative,
     
     fast_speed_ = params_["app.fast_speed"].getValue<double>();
     slow_speed_ = params_["app.slow_speed"].getValue<double>();
-
-    setEasingParams(params_);
   }
   
 
@@ -95,6 +99,10 @@ class BrickTripApp : public ci::app::AppNative,
     // OpenGLのコンテキストも使える
     AudioSession::begin();
 
+    // Fieldを作る前にEase関数と効果音の番号の表を作っておく
+    setupEaseFunc(params_);
+    setupSoundHandle(params_["sounds"]);
+
     ci::Rand::randomize();
 
 #if !defined(CINDER_COCOA_TOUCH)
@@ -132,10 +140,20 @@ class BrickTripApp : public ci::app::AppNative,
     forward_speed_change_ = false;
     pause_ = false;
 
-    setupFonts();
-    setupModels();
+    // 起動時の読み込みはJobGraphで並列に処理
+    // 最初の描画に必要なFontとModelだけ待ち、効果音はIntroの間も読み込み続ける
+    auto start_time = std::chrono::high_resolution_clock::now();
+    jobs_ = std::unique_ptr<JobGraph>(new JobGraph(Json::getValue(params_, "app.loader_threads", 0u)));
+
+    auto setup_jobs = setupFonts();
+    setup_jobs.push_back(setupModels());
     
-    controller_ = std::unique_ptr<ControllerBase>(new RootController(params_, timeline_, touch_event_));
+    controller_ = std::unique_ptr<ControllerBase>(new RootController(params_, timeline_, touch_event_, *jobs_));
+
+    jobs_->wait(setup_jobs);
+    using ms = std::chrono::duration<double, std::milli>;
+    DOUT << "setup:" << ms(std::chrono::high_resolution_clock::now() - start_time).count() << "ms"
+         << std::endl;
 
     // 以下OpenGL設定
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -249,7 +267,7 @@ class BrickTripApp : public ci::app::AppNative,
       
       params_ = readParams();
 
-      controller_ = std::unique_ptr<ControllerBase>(new RootController(params_, timeline_, touch_event_));
+      controller_ = std::unique_ptr<ControllerBase>(new RootController(params_, timeline_, touch_event_, *jobs_));
       // すぐさまresizeを呼んでCameraの調整
       resize();
 
@@ -334,6 +352,9 @@ class BrickTripApp : public ci::app::AppNative,
     }
 #endif
     
+    // 読み込みの終わったものを反映
+    jobs_->update();
+
     timeline_->step(progressing_seconds);
     controller_->update(progressing_seconds);
     
@@ -358,67 +379,176 @@ class BrickTripApp : public ci::app::AppNative,
   }
 
 
-  void prerenderFont(TextureFont& font, const ci::JsonTree& params) noexcept {
-    if (!Json::getValue(params, "pre_render", false)) return;
-      
-    auto text = params["pre_render_text"].getValue<std::string>();
-    auto text_length = strlen(text);
-    
-    for (size_t it = 0; it < text_length; ++it) {
-      font.getTextureFromString(substr(text, it, 1));
+  // Font一つ分の準備
+  //   read() は別スレッドで、add() はメインスレッドで実行する
+  struct FontLoader {
+    ci::JsonTree params;
+    bool use_baked;
+    bool mipmap;
+
+    TextureFont::Baked baked;
+    bool has_baked;
+
+    // アプリ起動時に事前にレンダリングしておく文字
+    // iOS:処理の引っ掛かりを減らす
+    std::vector<std::string> keys;
+    std::vector<ci::Surface8u> glyphs;
+
+    FontLoader(const ci::JsonTree& params_, const bool use_baked_, const bool mipmap_) noexcept :
+      params(params_),
+      use_baked(use_baked_),
+      mipmap(mipmap_),
+      has_baked(false)
+    {}
+
+    void read() noexcept {
+      int size          = params["size"].getValue<int>();
+      int atlas_size    = Json::getValue(params, "atlas_size", 1024);
+      int atlas_padding = Json::getValue(params, "atlas_padding", 2);
+
+      // 事前に作ったアトラスがあれば、FreeTypeでのレンダリングを省く
+      auto baked_path = Json::getValue(params, "baked", std::string());
+      if (use_baked && !baked_path.empty()) {
+        has_baked = TextureFont::readBaked(baked_path, size, atlas_size, atlas_padding, baked);
+      }
+
+      if (!Json::getValue(params, "pre_render", false)) return;
+
+      std::set<std::string> registered(std::begin(baked.keys), std::end(baked.keys));
+      auto text = params["pre_render_text"].getValue<std::string>();
+      auto text_length = strlen(text);
+      for (size_t it = 0; it < text_length; ++it) {
+        auto key = substr(text, it, 1);
+        if (registered.insert(key).second) keys.push_back(key);
+      }
+      if (keys.empty()) return;
+
+      // TIPS:FreeTypeはスレッドごとに用意する
+      FontCreator creator;
+      Font font(params["path"].getValue<std::string>(), creator);
+      font.setSize(size);
+      for (const auto& key : keys) {
+        glyphs.push_back(TextureFont::renderGlyph(font, size, key));
+      }
     }
-  }
-  
-  void setupFonts() noexcept {
-    fonts_ = std::unique_ptr<FontHolder>(new FontHolder);
 
-    const auto& fonts_params = params_["app.fonts"];
+    void add(FontHolder& fonts) noexcept {
+      const auto& name = params["name"].getValue<std::string>();
+      const auto& path = params["path"].getValue<std::string>();
+      int size          = params["size"].getValue<int>();
+      ci::Vec3f scale   = Json::getVec3<float>(params["scale"]);
+      ci::Vec3f offset  = Json::getVec3<float>(params["offset"]);
+      bool font_mipmap  = params["mipmap"].getValue<bool>() && mipmap;
+      int atlas_size    = Json::getValue(params, "atlas_size", 1024);
+      int atlas_padding = Json::getValue(params, "atlas_padding", 2);
+
+      auto& font = fonts.addFont(name, path, size, scale, offset, font_mipmap,
+                                 atlas_size, atlas_padding);
+      // 読み込めなければ、すべての文字をFreeTypeで描く
+      if (has_baked) font.loadBaked(baked);
+
+      for (size_t i = 0; i < keys.size(); ++i) {
+        font.insertGlyph(keys[i], glyphs[i]);
+      }
 
-    bool do_mipmap = true;
+      if (Json::getValue(params, "default", false)) {
+        fonts.setDefaultFont(name);
+      }
+    }
+  };
+
+  bool fontMipmap() const noexcept {
     if (params_["app.low_efficiency_device"].getValue<bool>()) {
       // 低性能の実行環境ではFontのmipmapを強制OFF
-      do_mipmap = false;
-
       DOUT << "Font:no mipmap." << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // FreeTypeと画像の読み込みは別スレッドで、アトラスへの転送はメインスレッドで
+  std::vector<u_int> setupFonts() noexcept {
+    bool use_baked = Json::getValue(params_, "app.baked_fonts", false);
+    bool mipmap    = fontMipmap();
+
+    fonts_ = std::unique_ptr<FontHolder>(new FontHolder);
+
+    std::vector<u_int> jobs;
+    for (const auto& p : params_["app.fonts"]) {
+      auto loader = std::make_shared<FontLoader>(p, use_baked, mipmap);
+      jobs.push_back(jobs_->add("font:" + p["name"].getValue<std::string>(),
+                                [loader]() {
+                                  loader->read();
+                                },
+                                [this, loader]() {
+                                  loader->add(*fonts_);
+                                }));
     }
-    
-    for(const auto& p : fonts_params) {
-      const auto& name = p["name"].getValue<std::string>();
-      const auto& path = p["path"].getValue<std::string>();
-      int size         = p["size"].getValue<int>();
-      ci::Vec3f scale  = Json::getVec3<float>(p["scale"]);
-      ci::Vec3f offset = Json::getVec3<float>(p["offset"]);
-      bool mipmap      = p["mipmap"].getValue<bool>() && do_mipmap;
-      
-      auto& font = fonts_->addFont(name, path, size, scale, offset, mipmap);
 
-      if (Json::getValue(p, "default", false)) {
-        fonts_->setDefaultFont(name);
+#ifdef DEBUG
+    if (Json::getValue(params_, "app.font_setup_bench", false)) {
+      // 比較のため、それぞれの方法で一つのスレッドで準備する
+      for (auto baked : { true, false }) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        createFonts(baked);
+        using ms = std::chrono::duration<double, std::milli>;
+        DOUT << "setupFonts(bench):" << ms(std::chrono::high_resolution_clock::now() - start_time).count() << "ms"
+             << " baked:" << baked
+             << std::endl;
       }
+    }
+#endif
 
-      // アプリ起動時に事前に文字をレンダリングしてキャッシュに入れておく
-      // iOS:処理の引っ掛かりを減らす
-      prerenderFont(font, p);
+    return jobs;
+  }
+
+#ifdef DEBUG
+  std::unique_ptr<FontHolder> createFonts(const bool use_baked) noexcept {
+    std::unique_ptr<FontHolder> fonts(new FontHolder);
+    bool mipmap = fontMipmap();
+
+    for (const auto& p : params_["app.fonts"]) {
+      FontLoader loader(p, use_baked, mipmap);
+      loader.read();
+      loader.add(*fonts);
     }
+
+    return fonts;
   }
+#endif
 
-  void setupModels() noexcept {
+  // .objの解析は別スレッドで、VBOへの転送はすべて揃ってからメインスレッドで
+  u_int setupModels() noexcept {
     models_ = std::unique_ptr<ModelHolder>(new ModelHolder);
 
     // 低性能環境はポリゴン数の少ないモデルを使う
     auto model_path = params_["app.low_efficiency_device"].getValue<bool>() ? "path_low"
                                                                             : "path";
 
+    std::vector<u_int> jobs;
     for(const auto& p : params_["app.models"]) {
-      const auto& name = p["name"].getValue<std::string>();
-      const auto& path = p.hasChild(model_path) ? p[model_path].getValue<std::string>()
-                                                : p["path"].getValue<std::string>();
+      auto name = p["name"].getValue<std::string>();
+      auto path = p.hasChild(model_path) ? p[model_path].getValue<std::string>()
+                                         : p["path"].getValue<std::string>();
       bool has_normals = p["normals"].getValue<bool>();
       bool has_uvs     = p["uvs"].getValue<bool>();
       bool has_indices = p["indices"].getValue<bool>();
-      
-      models_->add(name, path, has_normals, has_uvs, has_indices);
+
+      auto model = std::make_shared<std::unique_ptr<Model> >();
+      jobs.push_back(jobs_->add("model:" + path,
+                                [model, path, has_normals, has_uvs, has_indices]() {
+                                  model->reset(new Model(path, has_normals, has_uvs, has_indices));
+                                },
+                                [this, model, name]() {
+                                  models_->add(name, std::move(*model));
+                                }));
     }
+
+    return jobs_->add("models:build", JobGraph::Work(),
+                      [this]() {
+                        models_->build();
+                      },
+                      jobs);
   }
 
   
@@ -468,23 +598,6 @@ class BrickTripApp : public ci::app::AppNative,
     return params;
   }
 
-  // FIXME:Easing elastic系は動きを決めるパラメーターが２つあり
-  //       それを渋々外部パラメータで決めている
-  static void setEasingParams(const ci::JsonTree& params) noexcept {
-    ease_in_elastic_a = params["easing.ease_in_elastic_a"].getValue<float>();
-    ease_in_elastic_b = params["easing.ease_in_elastic_b"].getValue<float>();
-
-    ease_out_elastic_a = params["easing.ease_out_elastic_a"].getValue<float>();
-    ease_out_elastic_b = params["easing.ease_out_elastic_b"].getValue<float>();
-
-    ease_inout_elastic_a = params["easing.ease_inout_elastic_a"].getValue<float>();
-    ease_inout_elastic_b = params["easing.ease_inout_elastic_b"].getValue<float>();
-
-    ease_outin_elastic_a = params["easing.ease_outin_elastic_a"].getValue<float>();
-    ease_outin_elastic_b = params["easing.ease_outin_elastic_b"].getValue<float>();
-  }
-
-
 #if !defined(CINDER_COCOA_TOUCH)
   void setupFrameRate() noexcept {
     // 垂直同期が有効なら、FrameRateを無効にした方が表示が安定する
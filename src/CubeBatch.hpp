@@ -0,0 +1,179 @@
+﻿#pragma once
+
+//
+// 同じModelをまとめて描画
+//   頂点をCPU側で変換して、動的なVBOから一度に描画する
+//   TIPS:固定機能パイプラインにはインスタンス描画が無い
+//
+
+#include <vector>
+#include <cstddef>
+#include <boost/noncopyable.hpp>
+#include <cinder/gl/gl.h>
+#include "Model.hpp"
+
+
+namespace ngs {
+
+class CubeBatch : private boost::noncopyable {
+  struct Vertex {
+    ci::Vec3f  position;
+    ci::Vec3f  normal;
+    ci::ColorA color;
+  };
+
+  enum {
+    // GL_UNSIGNED_SHORTで扱える数
+    VERTEX_MAX = 0x10000,
+  };
+
+  const ci::TriMesh* mesh_;
+  bool has_normals_;
+
+  std::vector<Vertex>   vertices_;
+  std::vector<GLushort> indices_;
+
+  GLuint vertex_buffer_;
+  GLuint index_buffer_;
+
+
+public:
+  CubeBatch() noexcept :
+    mesh_(nullptr),
+    has_normals_(false)
+  {
+    vertices_.reserve(VERTEX_MAX);
+    indices_.reserve(VERTEX_MAX * 3);
+
+    glGenBuffers(1, &vertex_buffer_);
+    glGenBuffers(1, &index_buffer_);
+  }
+
+  ~CubeBatch() {
+    glDeleteBuffers(1, &vertex_buffer_);
+    glDeleteBuffers(1, &index_buffer_);
+  }
+
+
+  void begin(const Model& model) noexcept {
+    assert(!mesh_ && "CubeBatch::end() was not called.");
+
+    mesh_        = &model.triMesh();
+    has_normals_ = mesh_->hasNormals();
+
+    vertices_.clear();
+    indices_.clear();
+  }
+
+  void end() noexcept {
+    flush();
+    mesh_ = nullptr;
+  }
+
+
+  // 平行移動だけのCubeを追加
+  void add(const ci::Vec3f& position, const ci::ColorA& color) noexcept {
+    size_t base = prepare();
+
+    const auto& vertices = mesh_->getVertices();
+    const auto& normals  = mesh_->getNormals();
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      Vertex v = {
+        vertices[i] + position,
+        has_normals_ ? normals[i] : ci::Vec3f::zero(),
+        color
+      };
+      vertices_.push_back(v);
+    }
+
+    addIndices(base);
+  }
+
+  // 行列で変換するCubeを追加
+  void add(const ci::Matrix44f& matrix, const ci::ColorA& color) noexcept {
+    size_t base = prepare();
+
+    // TIPS:法線は逆転置行列で変換(GL_NORMALIZEで正規化される)
+    ci::Matrix33f normal_matrix;
+    if (has_normals_) {
+      normal_matrix = matrix.subMatrix33(0, 0).inverted().transposed();
+    }
+
+    const auto& vertices = mesh_->getVertices();
+    const auto& normals  = mesh_->getNormals();
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      Vertex v = {
+        matrix.transformPointAffine(vertices[i]),
+        has_normals_ ? normal_matrix * normals[i] : ci::Vec3f::zero(),
+        color
+      };
+      vertices_.push_back(v);
+    }
+
+    addIndices(base);
+  }
+
+
+private:
+  // 頂点数が溢れる場合は先に描画しておく
+  size_t prepare() noexcept {
+    assert(mesh_ && "CubeBatch::begin() was not called.");
+
+    size_t num = mesh_->getNumVertices();
+    if ((vertices_.size() + num) > VERTEX_MAX) flush();
+
+    return vertices_.size();
+  }
+
+  void addIndices(const size_t base) noexcept {
+    const auto& indices = mesh_->getIndices();
+    if (indices.empty()) {
+      // glDrawArrays向けのデータ
+      for (size_t i = base; i < vertices_.size(); ++i) {
+        indices_.push_back(GLushort(i));
+      }
+    }
+    else {
+      for (const auto index : indices) {
+        indices_.push_back(GLushort(base + index));
+      }
+    }
+  }
+
+  void flush() noexcept {
+    if (indices_.empty()) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex), &vertices_[0], GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(GLushort), &indices_[0], GL_DYNAMIC_DRAW);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vertex), reinterpret_cast<const GLvoid*>(offsetof(Vertex, position)));
+
+    if (has_normals_) {
+      glEnableClientState(GL_NORMAL_ARRAY);
+      glNormalPointer(GL_FLOAT, sizeof(Vertex), reinterpret_cast<const GLvoid*>(offsetof(Vertex, normal)));
+    }
+
+    // TIPS:GL_COLOR_MATERIALでambientとdiffuseに反映される
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorPointer(4, GL_FLOAT, sizeof(Vertex), reinterpret_cast<const GLvoid*>(offsetof(Vertex, color)));
+
+    glDrawElements(GL_TRIANGLES, GLsizei(indices_.size()), GL_UNSIGNED_SHORT, 0);
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    if (has_normals_) glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    vertices_.clear();
+    indices_.clear();
+  }
+
+};
+
+}
@@ -2,9 +2,10 @@
 
 //
 // 立方体文字列表示
+//   文字はフォントのアトラスから描くので、テクスチャの設定は文字列ごとに一度だけ
+//   頂点はGeometryArenaをbindしてから描画する
 //
 
-#include <map>
 #include <cinder/Text.h>
 #include <cinder/gl/gl.h>
 #include <cinder/gl/Texture.h>
@@ -13,29 +14,23 @@
 #include "CubeText.hpp"
 #include "TextureFont.hpp"
 #include "Model.hpp"
+#include "GeometryArena.hpp"
 
 
 namespace ngs { namespace CubeTextDrawer {
 
-void drawCubeAndText(ci::gl::TextureRef texture,
-                     const Model& model,
+// アトラスのテクスチャとGeometryArenaは設定済み
+void drawCubeAndText(const ci::Rectf& uv,
+                     GeometryArena& arena, const Model& model,
                      const ci::Color& color, const ci::Color& text_color,
                      const ci::Vec3f& scale, const ci::Vec3f& offset) noexcept {
   ci::gl::color(color);
 
-  const auto& mesh = model.mesh();
   glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisable(GL_TEXTURE_2D);
 
   // 最初のgroupが後ろのパネル
-  int base_vtx_num = model.getGroupFaces(0) * 3;
-  
-#if defined(CINDER_GLES)
-  glDrawElements(mesh.getPrimitiveType(),
-                 base_vtx_num, GL_UNSIGNED_SHORT, (GLvoid*)(sizeof (uint16_t) * 0));
-#else
-  glDrawElements(mesh.getPrimitiveType(),
-                 base_vtx_num, GL_UNSIGNED_INT, (GLvoid*)(sizeof (uint32_t) * 0));
-#endif
+  arena.drawGroup(model.arenaIndex(), 0);
   
   ci::gl::color(text_color);
 
@@ -43,28 +38,26 @@ void drawCubeAndText(ci::gl::TextureRef texture,
   ci::gl::scale(scale);
   
   ci::gl::enable(GL_BLEND);
-  texture->enableAndBind();
+  glEnable(GL_TEXTURE_2D);
   glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
+  // モデルのUV(0~1)をテクスチャ行列でアトラス内の位置へ変換
+  glMatrixMode(GL_TEXTURE);
+  glLoadIdentity();
+  glTranslatef(uv.x1, uv.y1, 0.0f);
+  glScalef(uv.getWidth(), uv.getHeight(), 1.0f);
+  glMatrixMode(GL_MODELVIEW);
+
   // 2つ目のgroupが文字表示
-  int text_vtx_num = model.getGroupFaces(1) * 3;
-
-#if defined(CINDER_GLES)
-  glDrawElements(mesh.getPrimitiveType(),
-                 text_vtx_num, GL_UNSIGNED_SHORT, (GLvoid*)(sizeof (uint16_t) * (base_vtx_num)));
-#else
-  glDrawElements(mesh.getPrimitiveType(),
-                 text_vtx_num, GL_UNSIGNED_INT, (GLvoid*)(sizeof (uint32_t) * (base_vtx_num)));
-#endif
+  arena.drawGroup(model.arenaIndex(), 1);
   
-  texture->unbind();
-  texture->disable();
   ci::gl::disable(GL_BLEND);
 }
 
 
 void draw(const CubeText& cube_text,
           TextureFont& font,
+          GeometryArena& arena,
           const Model& text_model,
           const ci::Vec3f& pos,
           const ci::Vec3f& scale,
@@ -79,13 +72,12 @@ void draw(const CubeText& cube_text,
   
   const auto& text = cube_text.text();
 
-  const auto& mesh = text_model.mesh();
-  mesh.enableClientStates();
-  mesh.bindAllData();
+  // TIPS:文字の追加でアトラスが更新されても、テクスチャ自体は同じ
+  const auto& texture = font.texture();
+  texture->enableAndBind();
   
   for (size_t i = 0; i < text.size(); ++i) {
-    const auto& t = text[i];
-    auto texture = font.getTextureFromString(t);
+    const auto& uv = font.getGlyph(text[i]);
 
     ci::gl::pushModelView();
 
@@ -106,7 +98,7 @@ void draw(const CubeText& cube_text,
     }
     ci::gl::scale(cube_size);
       
-    drawCubeAndText(texture, text_model,
+    drawCubeAndText(uv, arena, text_model,
                     base_color, text_color,
                     font.scale(), font.offset());
       
@@ -114,9 +106,13 @@ void draw(const CubeText& cube_text,
 
     text_pos.x += chara_size + chara_spacing;
   }
+
+  glMatrixMode(GL_TEXTURE);
+  glLoadIdentity();
+  glMatrixMode(GL_MODELVIEW);
   
-  ci::gl::VboMesh::unbindBuffers();
-  mesh.disableClientStates();
+  texture->unbind();
+  texture->disable();
 }
 
 } }
@@ -14,12 +14,26 @@
 
 
 // TIPS:console() をReleaseビルドで排除する
+#if defined(HEADLESS)
+// Appが無い環境では標準エラー出力を使う
+#include <iostream>
+
+#ifdef DEBUG
+#define DOUT std::cerr
+#else
+#define DOUT 0 && std::cerr
+#endif
+
+#else
+
 #ifdef DEBUG
 #define DOUT ci::app::console()
 #else
 #define DOUT 0 && ci::app::console()
 #endif
 
+#endif
+
 // TIPS:プリプロセッサを文字列として定義する
 #define PREPRO_TO_STR(value) PREPRO_STR(value)
 #define PREPRO_STR(value)    #value
@@ -48,6 +62,28 @@ void glFogi(T1 pname, T2 param) { glFogx(pname, param); }
 // #define OBFUSCATION_PARAMS
 // stageの難読化
 // #define OBFUSCATION_STAGES
+// 変換済みのstage(.stage)をマップして読み込む
+// TIPS:無効の時は.jsonを読んでから変換するので、変換しない読み込みより遅い
+//      有効にする時は params/compilestage.sh で.stageを作ってassetsに入れる
+// #define COMPILED_STAGES
+// 処理時間の計測(DEBUGビルドでは常に有効)
+// #define PROFILER
+
+#if defined (DEBUG) && !defined (PROFILER)
+#define PROFILER
+#endif
+
+// SIMD命令を使わない
+// #define NO_SIMD
+
+// SIMD命令の選択(SSE/NEONが無ければスカラー演算)
+#if !defined (NO_SIMD)
+#if defined (__SSE__) || defined (_M_X64) || (defined (_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define USE_SSE
+#elif defined (__ARM_NEON__) || defined (__ARM_NEON)
+#define USE_NEON
+#endif
+#endif
 
 
 namespace ngs {
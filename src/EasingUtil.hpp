@@ -6,7 +6,10 @@
 
 #include <map>
 #include <string>
+#include <utility>
+#include <cassert>
 #include <cinder/Easing.h>
+#include <cinder/Json.h>
 
 
 namespace ngs {
@@ -30,19 +33,30 @@ public:
 };
 
 
-// FIXME:グローバル変数を排除
-float ease_in_elastic_a    = 2;
-float ease_in_elastic_b    = 1;
-float ease_out_elastic_a   = 2;
-float ease_out_elastic_b   = 1;
-float ease_inout_elastic_a = 2;
-float ease_inout_elastic_b = 1;
-float ease_outin_elastic_a = 2;
-float ease_outin_elastic_b = 1;
+using EaseTable = std::map<std::string, ci::EaseFn>;
 
+EaseTable& easeTable() noexcept {
+  static EaseTable tbl;
+  return tbl;
+}
 
-ci::EaseFn getEaseFunc(const std::string& name) noexcept {
-  static const std::map<std::string, ci::EaseFn> tbl = {
+
+// 名前からEase関数を引く表を作る
+// Easing elastic系は動きを決めるパラメーターが２つあるので、外部パラメータで決める
+// TIPS:FieldやSimThreadを作る前に一度だけ呼ぶ
+//      以後は読むだけなので、複数のスレッドから getEaseFunc を呼べる
+void setupEaseFunc(const ci::JsonTree& params) noexcept {
+  const auto& easing = params["easing"];
+  auto elastic = [&easing](const std::string& name) noexcept {
+    return std::make_pair(easing[name + "_a"].getValue<float>(),
+                          easing[name + "_b"].getValue<float>());
+  };
+  const auto in_elastic    = elastic("ease_in_elastic");
+  const auto out_elastic   = elastic("ease_out_elastic");
+  const auto inout_elastic = elastic("ease_inout_elastic");
+  const auto outin_elastic = elastic("ease_outin_elastic");
+
+  easeTable() = {
     { "EaseInQuad",    ci::EaseInQuad() },
     { "EaseOutQuad",   ci::EaseOutQuad() },
     { "EaseInOutQuad", ci::EaseInOutQuad() },
@@ -93,14 +107,14 @@ ci::EaseFn getEaseFunc(const std::string& name) noexcept {
     { "EaseInOutBounce", ci::EaseInOutBounce() },
     { "EaseOutInBounce", ci::EaseOutInBounce() },
       
-    { "EaseInElastic",    ci::EaseInElastic(ease_in_elastic_a,
-                                            ease_in_elastic_b) },
-    { "EaseOutElastic",   ci::EaseOutElastic(ease_out_elastic_a,
-                                             ease_out_elastic_b) },
-    { "EaseInOutElastic", ci::EaseInOutElastic(ease_inout_elastic_a,
-                                               ease_inout_elastic_b) },
-    { "EaseOutInElastic", ci::EaseOutInElastic(ease_outin_elastic_a,
-                                               ease_outin_elastic_b) },
+    { "EaseInElastic",    ci::EaseInElastic(in_elastic.first,
+                                            in_elastic.second) },
+    { "EaseOutElastic",   ci::EaseOutElastic(out_elastic.first,
+                                             out_elastic.second) },
+    { "EaseInOutElastic", ci::EaseInOutElastic(inout_elastic.first,
+                                               inout_elastic.second) },
+    { "EaseOutInElastic", ci::EaseOutInElastic(outin_elastic.first,
+                                               outin_elastic.second) },
 
     
     { "EasePingPongInQuad",    EasePingPong<ci::EaseInQuad>() },
@@ -153,16 +167,20 @@ ci::EaseFn getEaseFunc(const std::string& name) noexcept {
     { "EasePingPongInOutBounce", EasePingPong<ci::EaseInOutBounce>() },
     { "EasePingPongOutInBounce", EasePingPong<ci::EaseOutInBounce>() },
       
-    { "EasePingPongInElastic",    EasePingPong<ci::EaseInElastic>(ease_in_elastic_a,
-                                                                  ease_in_elastic_b) },
-    { "EasePingPongOutElastic",   EasePingPong<ci::EaseOutElastic>(ease_out_elastic_a,
-                                                                   ease_out_elastic_b) },
-    { "EasePingPongInOutElastic", EasePingPong<ci::EaseInOutElastic>(ease_inout_elastic_a,
-                                                                     ease_inout_elastic_b) },
-    { "EasePingPongOutInElastic", EasePingPong<ci::EaseOutInElastic>(ease_outin_elastic_a,
-                                                                     ease_outin_elastic_b) },
+    { "EasePingPongInElastic",    EasePingPong<ci::EaseInElastic>(in_elastic.first,
+                                                                  in_elastic.second) },
+    { "EasePingPongOutElastic",   EasePingPong<ci::EaseOutElastic>(out_elastic.first,
+                                                                   out_elastic.second) },
+    { "EasePingPongInOutElastic", EasePingPong<ci::EaseInOutElastic>(inout_elastic.first,
+                                                                     inout_elastic.second) },
+    { "EasePingPongOutInElastic", EasePingPong<ci::EaseOutInElastic>(outin_elastic.first,
+                                                                     outin_elastic.second) },
   };
+}
 
+ci::EaseFn getEaseFunc(const std::string& name) noexcept {
+  const auto& tbl = easeTable();
+  assert(!tbl.empty());
   return tbl.at(name);
 }
 
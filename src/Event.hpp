@@ -2,22 +2,138 @@
 
 //
 // boost::signals2を利用した汎用的なイベント
+//   メッセージ名は起動時に連番へ変換(EventId)して、配列から引く
+//   Event自体はスレッドをまたがないが、EventIdの変換表はプロセスで共有
 //
 
 #include <boost/signals2.hpp>
 #include <boost/noncopyable.hpp>
-#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <array>
+#include <cstring>
+#include <cassert>
 
 
 namespace ngs {
 
 using Connection = boost::signals2::connection;
 
+// メッセージ名を連番に変換したもの
+// TIPS:変換済みの名前はロックせずに引けるが、文字列のハッシュは毎回求める
+//      Fieldの更新中や毎フレーム使うものは static const EventId で一度だけ変換しておく
+class EventId {
+  u_int index_;
+
+
+public:
+  EventId(const std::string& msg) noexcept :
+    index_(intern(msg.data(), msg.size()))
+  {}
+
+  // TIPS:内容で引くので、一時的な文字列から作ってもよい
+  EventId(const char* msg) noexcept :
+    index_(intern(msg, std::strlen(msg)))
+  {}
+
+
+  u_int index() const noexcept { return index_; }
+
+  
+private:
+  enum {
+    // 開番地法のハッシュ表の大きさ(2の累乗)
+    // 登録数がこの半分を超えないようにする
+    TABLE_SIZE = 2048,
+    TABLE_MASK = TABLE_SIZE - 1,
+  };
+
+  struct Entry {
+    std::string name;
+    u_int index;
+  };
+
+  // TIPS:Fieldを別スレッドで動かす時や、複数のFieldを並行して動かす時のために、
+  //      登録だけをロックする。登録したものは消さないので、引く側はatomicに読むだけ
+  struct Table {
+    std::mutex mutex;
+    std::array<std::atomic<const Entry*>, TABLE_SIZE> slots;
+    std::vector<std::unique_ptr<Entry> > entries;
+
+    Table() noexcept {
+      for (auto& slot : slots) {
+        slot.store(nullptr, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  static Table& table() noexcept {
+    static Table table;
+    return table;
+  }
+
+  // FNV-1a
+  static u_int hashOf(const char* msg, const size_t length) noexcept {
+    u_int hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+      hash = (hash ^ u_int((unsigned char)msg[i])) * 16777619u;
+    }
+    return hash;
+  }
+
+  static bool isSame(const Entry& entry, const char* msg, const size_t length) noexcept {
+    return (entry.name.size() == length)
+      && (std::memcmp(entry.name.data(), msg, length) == 0);
+  }
+
+  static u_int intern(const char* msg, const size_t length) noexcept {
+    auto& t = table();
+    u_int hash = hashOf(msg, length);
+
+    // 登録済みならロックしない
+    for (u_int i = hash; ; ++i) {
+      const auto* entry = t.slots[i & TABLE_MASK].load(std::memory_order_acquire);
+      if (!entry) break;
+      if (isSame(*entry, msg, length)) return entry->index;
+    }
+
+    std::lock_guard<std::mutex> lock(t.mutex);
+
+    // ロックを待つ間に登録されているかもしれないので、もう一度探す
+    for (u_int i = hash; ; ++i) {
+      auto& slot = t.slots[i & TABLE_MASK];
+      const auto* entry = slot.load(std::memory_order_relaxed);
+      if (entry) {
+        if (isSame(*entry, msg, length)) return entry->index;
+        continue;
+      }
+
+      assert((t.entries.size() < (TABLE_SIZE / 2)) && "too many EventIds.");
+
+      u_int index = u_int(t.entries.size());
+      t.entries.emplace_back(new Entry{ std::string(msg, length), index });
+      slot.store(t.entries.back().get(), std::memory_order_release);
+      return index;
+    }
+  }
+  
+};
+
+
 template <typename... Args>
 class Event : private boost::noncopyable {
   using SignalType = boost::signals2::signal<void(Args&...)>;
 
-  std::map<std::string, SignalType> signals_;
+  // EventIdの連番で参照
+  // 接続の無いメッセージはnullptr
+  std::vector<std::unique_ptr<SignalType> > signals_;
+
+  // 接続の有無に関係なく、すべてのメッセージを受け取る
+  std::function<void (const EventId&, Args&...)> forward_;
 
 
 public:
@@ -25,15 +141,32 @@ public:
 
 
   template<typename F>
-  Connection connect(const std::string& msg, F callback) noexcept {
-    return signals_[msg].connect_extended(callback);
+  Connection connect(const EventId& msg, F callback) noexcept {
+    u_int index = msg.index();
+    if (index >= signals_.size()) signals_.resize(index + 1);
+
+    auto& signal = signals_[index];
+    if (!signal) signal.reset(new SignalType);
+
+    return signal->connect_extended(callback);
   }  
 
+  // 別スレッドで発生したメッセージを溜めておき、後で送り直す時などに使う
+  template<typename F>
+  void forward(F callback) noexcept {
+    forward_ = callback;
+  }
+
   
   template <typename... Args2>
-  void signal(const std::string& msg, Args2&&... args) noexcept {
-    // signals_[msg](std::forward<Args2>(args)...);
-    signals_[msg](args...);
+  void signal(const EventId& msg, Args2&&... args) noexcept {
+    if (forward_) forward_(msg, args...);
+
+    // 接続の無いメッセージのためにsignalを生成しない
+    u_int index = msg.index();
+    if (index >= signals_.size() || !signals_[index]) return;
+    
+    (*signals_[index])(args...);
   }
 
   
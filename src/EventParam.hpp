@@ -2,20 +2,294 @@
 
 //
 // Eventで送る汎用パラメーター
+//   キーはEventIdに変換して、固定長の配列に並べて保持する
+//   数値・ベクトル・短い文字列はヒープを使わない
 //
 
-#include <map>
+#include <array>
 #include <string>
-#include "boost/any.hpp"
+#include <cstring>
+#include <initializer_list>
+#include <boost/any.hpp>
+#include <cinder/Vector.h>
+#include <cinder/Color.h>
+#include "Event.hpp"
 
 
 namespace ngs {
 
-using EventParam = std::map<std::string, boost::any>;
+class EventValue {
+  enum Type {
+    NONE,
+    BOOL,
+    INT,
+    U_INT,
+    FLOAT,
+    DOUBLE,
+    VEC3F,
+    VEC3I,
+    COLOR,
+    STRING,
+    ANY,
+  };
 
-bool hasKey(const EventParam& params, const std::string& key) noexcept {
-  auto it = params.find(key);
-  return it != std::end(params);
+  enum {
+    STRING_MAX = 31,
+  };
+
+  Type type_;
+
+  union {
+    bool   b;
+    int    i;
+    u_int  u;
+    float  f;
+    double d;
+    float  fv[3];
+    int    iv[3];
+    char   str[STRING_MAX + 1];
+  } value_;
+
+  // 上記以外の型はboost::anyで保持(ヒープを使う)
+  boost::any any_;
+
+
+public:
+  EventValue() noexcept :
+    type_(NONE)
+  {}
+
+
+  template <typename T>
+  void set(const T& value) noexcept {
+    assign(value);
+  }
+
+  template <typename T>
+  T get() const noexcept {
+    return get(static_cast<T*>(nullptr));
+  }
+
+
+private:
+  void assign(const bool value) noexcept {
+    type_ = BOOL;
+    value_.b = value;
+  }
+
+  void assign(const int value) noexcept {
+    type_ = INT;
+    value_.i = value;
+  }
+
+  void assign(const u_int value) noexcept {
+    type_ = U_INT;
+    value_.u = value;
+  }
+
+  void assign(const float value) noexcept {
+    type_ = FLOAT;
+    value_.f = value;
+  }
+
+  void assign(const double value) noexcept {
+    type_ = DOUBLE;
+    value_.d = value;
+  }
+
+  void assign(const ci::Vec3f& value) noexcept {
+    type_ = VEC3F;
+    value_.fv[0] = value.x;
+    value_.fv[1] = value.y;
+    value_.fv[2] = value.z;
+  }
+
+  void assign(const ci::Vec3i& value) noexcept {
+    type_ = VEC3I;
+    value_.iv[0] = value.x;
+    value_.iv[1] = value.y;
+    value_.iv[2] = value.z;
+  }
+
+  void assign(const ci::Color& value) noexcept {
+    type_ = COLOR;
+    value_.fv[0] = value.r;
+    value_.fv[1] = value.g;
+    value_.fv[2] = value.b;
+  }
+
+  void assign(const char* value) noexcept {
+    size_t length = std::strlen(value);
+    if (length > STRING_MAX) {
+      assign(std::string(value));
+      return;
+    }
+
+    type_ = STRING;
+    std::memcpy(value_.str, value, length + 1);
+  }
+
+  void assign(const std::string& value) noexcept {
+    if (value.size() > STRING_MAX) {
+      type_ = ANY;
+      any_  = value;
+      return;
+    }
+
+    type_ = STRING;
+    std::memcpy(value_.str, value.c_str(), value.size() + 1);
+  }
+
+  template <typename T>
+  void assign(const T& value) noexcept {
+    type_ = ANY;
+    any_  = value;
+  }
+
+
+  bool get(bool*) const noexcept {
+    assert(type_ == BOOL);
+    return value_.b;
+  }
+
+  int get(int*) const noexcept {
+    assert(type_ == INT);
+    return value_.i;
+  }
+
+  u_int get(u_int*) const noexcept {
+    assert(type_ == U_INT);
+    return value_.u;
+  }
+
+  float get(float*) const noexcept {
+    assert(type_ == FLOAT);
+    return value_.f;
+  }
+
+  double get(double*) const noexcept {
+    assert(type_ == DOUBLE);
+    return value_.d;
+  }
+
+  ci::Vec3f get(ci::Vec3f*) const noexcept {
+    assert(type_ == VEC3F);
+    return ci::Vec3f(value_.fv[0], value_.fv[1], value_.fv[2]);
+  }
+
+  ci::Vec3i get(ci::Vec3i*) const noexcept {
+    assert(type_ == VEC3I);
+    return ci::Vec3i(value_.iv[0], value_.iv[1], value_.iv[2]);
+  }
+
+  ci::Color get(ci::Color*) const noexcept {
+    assert(type_ == COLOR);
+    return ci::Color(value_.fv[0], value_.fv[1], value_.fv[2]);
+  }
+
+  std::string get(std::string*) const noexcept {
+    if (type_ == STRING) return std::string(value_.str);
+
+    return boost::any_cast<std::string>(any_);
+  }
+
+  template <typename T>
+  T get(T*) const noexcept {
+    assert(type_ == ANY);
+    return boost::any_cast<T>(any_);
+  }
+
+};
+
+
+class EventParam {
+public:
+  struct Entry {
+    u_int      key;
+    EventValue value;
+
+    Entry() noexcept :
+      key(0)
+    {}
+
+    template <typename T>
+    Entry(const EventId& key_, const T& value_) noexcept :
+      key(key_.index())
+    {
+      value.set(value_);
+    }
+  };
+
+
+private:
+  enum {
+    CAPACITY = 24,
+  };
+
+  std::array<Entry, CAPACITY> entries_;
+  u_int num_;
+
+
+public:
+  EventParam() noexcept :
+    num_(0)
+  {}
+
+  EventParam(std::initializer_list<Entry> entries) noexcept :
+    num_(0)
+  {
+    assert((entries.size() <= CAPACITY) && "too many EventParam entries.");
+
+    for (const auto& entry : entries) {
+      entries_[num_] = entry;
+      num_ += 1;
+    }
+  }
+
+
+  template <typename T>
+  void set(const EventId& key, const T& value) noexcept {
+    auto* entry = find(key);
+    if (!entry) {
+      assert((num_ < CAPACITY) && "too many EventParam entries.");
+
+      entry = &entries_[num_];
+      entry->key = key.index();
+      num_ += 1;
+    }
+    entry->value.set(value);
+  }
+
+  template <typename T>
+  T get(const EventId& key) const noexcept {
+    const auto* entry = find(key);
+    assert(entry && "EventParam key not found.");
+
+    return entry->value.get<T>();
+  }
+
+  bool has(const EventId& key) const noexcept {
+    return find(key) != nullptr;
+  }
+
+
+private:
+  const Entry* find(const EventId& key) const noexcept {
+    for (u_int i = 0; i < num_; ++i) {
+      if (entries_[i].key == key.index()) return &entries_[i];
+    }
+    return nullptr;
+  }
+
+  Entry* find(const EventId& key) noexcept {
+    return const_cast<Entry*>(static_cast<const EventParam*>(this)->find(key));
+  }
+
+};
+
+
+bool hasKey(const EventParam& params, const EventId& key) noexcept {
+  return params.has(key);
 }
 
 }
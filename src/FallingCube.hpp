@@ -9,6 +9,7 @@
 #include <cinder/Rand.h>
 #include "EasingUtil.hpp"
 #include "Utility.hpp"
+#include "SoundHandle.hpp"
 
 
 namespace ngs {
@@ -16,6 +17,7 @@ namespace ngs {
 class FallingCube : private boost::noncopyable {
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
   
   bool active_;
 
@@ -59,10 +61,12 @@ public:
   FallingCube(ci::JsonTree& params,
               ci::TimelineRef timeline,
               Event<EventParam>& event,
+              ci::Rand& rand,
               const ci::Vec3i& entry_pos,
               const float interval, const float delay) noexcept :
     params_(params),
     event_(event),
+    rand_(rand),
     active_(true),
     id_(getUniqueNumber()),
     color_(Json::getColor<float>(params["game.falling.color"])),
@@ -94,7 +98,7 @@ public:
 
     // 登場演出
     auto entry_y = Json::getVec2<float>(params["game.falling.entry_y"]);
-    float y = ci::randFloat(entry_y.x, entry_y.y);
+    float y = rand_.nextFloat(entry_y.x, entry_y.y);
     ci::Vec3f start_value(position() + ci::Vec3f(0, y, 0));
     auto options = animation_timeline_->apply(&position_,
                                               start_value, position_(),
@@ -108,7 +112,8 @@ public:
           { "id", id_ },
           { "block_pos", block_position_ },
         };
-        event_.signal("falling-on-stage", params);
+        static const EventId falling_on_stage("falling-on-stage");
+        event_.signal(falling_on_stage, params);
 
         startUpEase(delay);
       });
@@ -210,15 +215,18 @@ private:
                                               getEaseFunc(down_ease_));
     options.delay(interval_);
     options.finishFn([this]() noexcept {
+        static const SoundHandle falling_se = getSoundHandle("falling");
         EventParam params = {
           { "duration", quake_duration_ },
           { "pos",      position() },
           { "size",     size() },
-          { "sound",    std::string("falling") },
+          { "sound",    falling_se },
         };
         
-        event_.signal("falling-down", params);
-        event_.signal("view-sound", params);
+        static const EventId falling_down("falling-down");
+        static const EventId view_sound("view-sound");
+        event_.signal(falling_down, params);
+        event_.signal(view_sound, params);
         startUpEase();
       });
   }
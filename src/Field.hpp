@@ -4,7 +4,6 @@
 // Fieldの定義
 //
 
-#include <deque>
 #include <vector>
 #include "StageCube.hpp"
 #include "PickableCube.hpp"
@@ -19,8 +18,7 @@
 namespace ngs {
 
 struct Field {
-  const std::deque<std::vector<StageCube> >& active_cubes;
-  const std::deque<std::vector<StageCube> >& collapse_cubes;
+  const StageCubes& stage_cubes;
 
   // VS2013には暗黙のmoveコンストラクタが無いのでstd::unique_ptrで保持
   // ※自前で用意するのではなくコンパイラ任せにしたい
@@ -32,7 +30,7 @@ struct Field {
   const std::vector<std::unique_ptr<Switch> >& switches;
   const std::vector<std::unique_ptr<Oneway> >& oneways;
 
-  const std::vector<Bg::Cube>& bg_cubes;
+  const Bg::Cubes& bg_cubes;
   
 #ifdef DEBUG
   ci::Vec3f bg_bbox_min;
@@ -4,12 +4,18 @@
 // ゲーム舞台のController
 //
 
+#include <functional>
+#include <cmath>
 #include "ControllerBase.hpp"
 #include "FieldView.hpp"
 #include "FieldEntity.hpp"
+#include "FieldSnapshot.hpp"
+#include "TripleBuffer.hpp"
+#include "SimThread.hpp"
 #include "EventParam.hpp"
 #include "ConnectionHolder.hpp"
 #include "SoundRequest.hpp"
+#include "Replay.hpp"
 #include "GameCenter.h"
 
 
@@ -20,7 +26,9 @@ class FieldController : public ControllerBase {
   Event<std::vector<Touch> >& touch_event_;
   Event<EventParam>& event_;
 
+  // FieldEntity用と、それ以外(メインスレッドで進める)用
   ci::TimelineRef timeline_;
+  ci::TimelineRef view_timeline_;
   ci::TimelineRef event_timeline_;
   bool paused_;
 
@@ -29,6 +37,31 @@ class FieldController : public ControllerBase {
   
   bool active_;
 
+  // Fieldの更新を別スレッドで行う時は、FieldEntityからのメッセージを
+  // field_event_ で受けて溜めておき、更新が終わってから event_ へ送り直す
+  bool sim_thread_enable_;
+  Event<EventParam> field_event_;
+  std::vector<std::pair<EventId, EventParam> > field_events_;
+  std::vector<std::pair<EventId, EventParam> > flushing_events_;
+
+  // Fieldの更新中に受け取ったメッセージの処理
+  std::vector<std::function<void ()> > deferred_calls_;
+
+  // 前回の更新が終わるまでの経過時間
+  double field_seconds_;
+  double max_field_seconds_;
+
+  // 固定間隔で更新する時の間隔と、一度に追いつく最大回数
+  bool fixed_step_;
+  double step_seconds_;
+  u_int max_step_num_;
+
+  // 更新結果の受け渡し(描画はこれだけを読む)
+  TripleBuffer<FieldSnapshot> snapshots_;
+
+  // UIからの操作を記録(FieldEntityにseedを渡すので先に初期化)
+  Replay::Recorder recorder_;
+
   FieldView view_;
   FieldEntity entity_;
 
@@ -39,6 +72,9 @@ class FieldController : public ControllerBase {
   float progress_continue_delay_;
 
   float continued_start_delay_;
+
+  // TIPS:entity_より後に宣言して先に破棄する(スレッドを止めてからFieldEntityを破棄)
+  std::unique_ptr<SimThread> sim_thread_;
   
 
 public:
@@ -50,11 +86,21 @@ public:
     touch_event_(touch_event),
     event_(event),
     timeline_(ci::Timeline::create()),
+    view_timeline_(ci::Timeline::create()),
     event_timeline_(ci::Timeline::create()),
     paused_(false),
     active_(true),
-    view_(params, timeline_, event_, touch_event),
-    entity_(params, timeline_, event_, records),
+    sim_thread_enable_(params["game.sim_thread.enable"].getValue<bool>()),
+    field_seconds_(0.0),
+    max_field_seconds_(params["game.sim_thread.max_seconds"].getValue<double>()),
+    fixed_step_(params["game.fixed_step.enable"].getValue<bool>()),
+    step_seconds_(1.0 / params["game.fixed_step.tick_rate"].getValue<double>()),
+    max_step_num_(params["game.fixed_step.max_catch_up"].getValue<u_int>()),
+    recorder_(u_int(ci::randInt()), records.toJson().serialize(),
+              params["game.replay.max_bytes"].getValue<size_t>()),
+    view_(params, view_timeline_, event_, touch_event),
+    entity_(params, timeline_, sim_thread_enable_ ? field_event_ : event_,
+            records, recorder_.seed()),
     stage_cleard_(false),
     stageclear_agree_(false),
     progress_start_delay_(params["game.progress_start_delay"].getValue<float>()),
@@ -62,39 +108,53 @@ public:
     continued_start_delay_(params["game.continued_start_delay"].getValue<float>())
   {
     DOUT << "FieldController()" << std::endl;
+
+    if (sim_thread_enable_) {
+      field_event_.forward([this](const EventId& msg, EventParam& param) noexcept {
+          field_events_.emplace_back(msg, param);
+        });
+      sim_thread_.reset(new SimThread);
+    }
+
+    // プレイ開始直後に鳴る効果音
+    requestSoundPrefetch(event_, Json::getArray<std::string>(params["game.prefetch_se"]));
     
-    connections_ += event_.connect("picking-start",
+    connections_ += connectToField("picking-start",
                                    [this](const Connection&, EventParam& param) noexcept {
-                                     entity_.pickPickableCube(boost::any_cast<u_int>(param["cube_id"]));
+                                     auto id = param.get<u_int>("cube_id");
+                                     recorder_.pick(entity_.pickableCubeIndex(id));
+                                     entity_.pickPickableCube(id);
                                    });
     
-    connections_ += event_.connect("move-pickable",
+    connections_ += connectToField("move-pickable",
                                    [this](const Connection&, EventParam& param) noexcept {
-                                     entity_.movePickableCube(boost::any_cast<u_int>(param["cube_id"]),
-                                                              boost::any_cast<int>(param["move_direction"]),
-                                                              boost::any_cast<int>(param["move_speed"]));
+                                     auto id        = param.get<u_int>("cube_id");
+                                     auto direction = param.get<int>("move_direction");
+                                     auto speed     = param.get<int>("move_speed");
+                                     recorder_.move(entity_.pickableCubeIndex(id), direction, speed);
+                                     entity_.movePickableCube(id, direction, speed);
                                    });
 
-    connections_ += event_.connect("pickable-moved",
+    connections_ += connectToField("pickable-moved",
                                    [this](const Connection&, EventParam& param) noexcept {
-                                     const auto& block_pos = boost::any_cast<const ci::Vec3i&>(param["block_pos"]);
-                                     const auto id = boost::any_cast<u_int>(param["id"]);
+                                     const auto& block_pos = param.get<ci::Vec3i>("block_pos");
+                                     const auto id = param.get<u_int>("id");
                                      entity_.movedPickableCube(id, block_pos);
 
-                                     auto move_step = boost::any_cast<int>(param["move_step"]);
+                                     auto move_step = param.get<int>("move_step");
                                      entity_.recordMoveStep(move_step);
                                    });
     
-    connections_ += event_.connect("pickable-on-stage",
+    connections_ += connectToField("pickable-on-stage",
                                    [this](const Connection&, EventParam& param) noexcept {
                                    });
     
-    connections_ += event_.connect("all-pickable-started",
+    connections_ += connectToField("all-pickable-started",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "all-pickable-started" << std::endl;
                                    });
 
-    connections_ += event_.connect("all-pickable-finished",
+    connections_ += connectToField("all-pickable-finished",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "all-pickable-finished" << std::endl;
                                      entity_.completeBuildAndCollapseStage();
@@ -104,7 +164,7 @@ public:
                                    });
 
     // stage-clearedとstageclear-agreeの両方が発行されたら次のステージへ
-    connections_ += event_.connect("stage-cleared",
+    connections_ += connectToField("stage-cleared",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "stage-cleared" << std::endl;
                                      stage_cleard_ = true;
@@ -114,9 +174,10 @@ public:
                                      }
                                    });
     
-    connections_ += event_.connect("stageclear-agree",
+    connections_ += connectToField("stageclear-agree",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "stageclear-agree" << std::endl;
+                                     recorder_.input(Replay::STAGECLEAR_AGREE);
                                      stageclear_agree_ = true;                                     
                                      view_.enableTouchInput();
 
@@ -125,123 +186,130 @@ public:
                                      }
                                    });
 
-    connections_ += event_.connect("begin-regulat-stageclear",
+    connections_ += connectToField("begin-regulat-stageclear",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "begin-regulat-stageclear" << std::endl;
                                      view_.endDistanceCloser();
                                    });
 
-    connections_ += event_.connect("begin-all-stageclear",
+    connections_ += connectToField("begin-all-stageclear",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "begin-all-stageclear" << std::endl;
                                      view_.endDistanceCloser();
                                    });
     
-    connections_ += event_.connect("regular-stage-clear-out",
+    connections_ += connectToField("regular-stage-clear-out",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "regular-stage-clear-out" << std::endl;
                                      view_.enableTouchInput();
                                    });
 
-    connections_ += event_.connect("all-stage-clear-out",
+    connections_ += connectToField("all-stage-clear-out",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "all-stage-clear-out" << std::endl;
+                                     recorder_.input(Replay::RISE);
                                      entity_.riseAllPickableCube();
                                    });
 
-    connections_ += event_.connect("collapse-stage",
+    connections_ += connectToField("collapse-stage",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "collapse-stage" << std::endl;
+                                     recorder_.input(Replay::COLLAPSE);
                                      entity_.collapseStage();
                                    });
     
-    connections_ += event_.connect("back-to-title",
+    connections_ += connectToField("back-to-title",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "back-to-title" << std::endl;
+                                     recorder_.cleanup(false);
                                      entity_.cleanupField();
                                    });
 
 
-    connections_ += event_.connect("build-one-line",
+    connections_ += connectToField("build-one-line",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "build-one-line" << std::endl;
-                                     int active_top_z = boost::any_cast<int>(param["active_top_z"]);
+                                     int active_top_z = param.get<int>("active_top_z");
                                      entity_.entryStageObjects(active_top_z);
                                    });
 
-    connections_ += event_.connect("build-finish-line",
+    connections_ += connectToField("build-finish-line",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "build-finish-line" << std::endl;
                                      // entity_.entryPickableCubes();
                                    });
 
-    connections_ += event_.connect("fall-pickable",
+    connections_ += connectToField("fall-pickable",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "fall-pickable" << std::endl;
-                                     if (boost::any_cast<bool>(param["first_out"])) {
+                                     if (param.get<bool>("first_out")) {
                                        GameCenter::submitAchievement("BRICKTRIP.ACHIEVEMENT.FALLEN");
                                      }
                                    });
 
     // ドッスンに踏まれた
-    connections_ += event_.connect("pressed-pickable",
+    connections_ += connectToField("pressed-pickable",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "pressed-pickable" << std::endl;
-                                     if (boost::any_cast<bool>(param["first_out"])) {
+                                     if (param.get<bool>("first_out")) {
                                        GameCenter::submitAchievement("BRICKTRIP.ACHIEVEMENT.SQUASHED");
                                      }
                                    });
 
     // pickablecubeの1つがやられたらgameover
-    connections_ += event_.connect("first-out-pickable",
+    connections_ += connectToField("first-out-pickable",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "first-out-pickable" << std::endl;
                                      beginGameover(param);
                                    });
 
-    connections_ += event_.connect("pickable-start-idle",
+    connections_ += connectToField("pickable-start-idle",
                                    [this](const Connection&, EventParam& param) noexcept {
-                                     u_int id = boost::any_cast<u_int>(param["id"]);
+                                     u_int id = param.get<u_int>("id");
                                      entity_.startIdlePickableCube(id);
                                    });
     
-    connections_ += event_.connect("startline-will-open",
+    connections_ += connectToField("startline-will-open",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "startline-will-open" << std::endl;
-                                     requestSound(event_, "start");
+                                     static const SoundHandle start_se = getSoundHandle("start");
+                                     requestSound(event_, start_se);
                                    });
     
-    connections_ += event_.connect("startline-opened",
+    connections_ += connectToField("startline-opened",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "startline-opened" << std::endl;
                                      entity_.enableRecordPlay();
                                    });
 
     
-    connections_ += event_.connect("gameover-agree",
+    connections_ += connectToField("gameover-agree",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "gameover-agree" << std::endl;
+                                     recorder_.cleanup(false);
                                      entity_.cleanupField();
                                    });
 
-    connections_ += event_.connect("gameover-continue",
+    connections_ += connectToField("gameover-continue",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "gameover-continue" << std::endl;
+                                     recorder_.cleanup(true);
                                      entity_.cleanupField(true);
                                      GameCenter::submitAchievement("BRICKTRIP.ACHIEVEMENT.CONTINUED");
                                    });
 
-    connections_ += event_.connect("stage-all-collapsed",
+    connections_ += connectToField("stage-all-collapsed",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "stage-all-collapsed" << std::endl;
+                                     writeReplay();
                                      entity_.restart();
                                      setup();
 
-                                     bool game_continued = boost::any_cast<bool>(param.at("game_continued"));
+                                     bool game_continued = param.get<bool>("game_continued");
                                      if (!game_continued) {
                                        // ステージの崩壊を待ってTitle起動
-                                       bool all_cleard = boost::any_cast<bool>(param.at("all_cleard"));
-                                       bool aborted    = boost::any_cast<bool>(param.at("game_aborted"));
+                                       bool all_cleard = param.get<bool>("all_cleard");
+                                       bool aborted    = param.get<bool>("game_aborted");
                                        EventParam params = {
                                          { "title-startup", all_cleard },
                                          { "game-aborted",  aborted },
@@ -250,30 +318,32 @@ public:
                                      }
                                    });
 
-    connections_ += event_.connect("continue-game",
+    connections_ += connectToField("continue-game",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "continue-game" << std::endl;
                                      view_.enableTouchInput();
                                    });
                                   
 
-    connections_ += event_.connect("pause-start",
+    connections_ += connectToField("pause-start",
                                    [this](const Connection&, EventParam& param) noexcept {
+                                     recorder_.input(Replay::CANCEL_PICK);
                                      entity_.cancelPickPickableCubes();
                                      view_.enableTouchInput(false);
                                      paused_ = true;
                                    });
 
-    connections_ += event_.connect("game-continue",
+    connections_ += connectToField("game-continue",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "game-continue" << std::endl;
                                      view_.enableTouchInput();
                                      paused_ = false;
                                    });
     
-    connections_ += event_.connect("game-abort",
+    connections_ += connectToField("game-abort",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "game-abort" << std::endl;
+                                     recorder_.input(Replay::ABORT);
                                      event_timeline_->clear();
                                      view_.enableFollowCamera(false);
                                      paused_ = false;
@@ -281,114 +351,115 @@ public:
                                    });
 
     
-    connections_ += event_.connect("field-update-stop",
+    connections_ += connectToField("field-update-stop",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      paused_ = true;
                                    });
 
-    connections_ += event_.connect("field-update-restart",
+    connections_ += connectToField("field-update-restart",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      paused_ = false;
                                    });
 
     
-    connections_ += event_.connect("pickuped-item",
+    connections_ += connectToField("pickuped-item",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "pickuped-item" << std::endl;
                                      entity_.pickupedItemCube();
                                    });
 
     
-    connections_ += event_.connect("field-input-stop",
+    connections_ += connectToField("field-input-stop",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "field-input-stop" << std::endl;
+                                     recorder_.input(Replay::INPUT_STOP);
                                      entity_.cancelPickPickableCubes();
                                      entity_.enablePickableCubeMovedEvent(false);
                                      view_.enableTouchInput(false);
                                    });
 
-    connections_ += event_.connect("field-input-start",
+    connections_ += connectToField("field-input-start",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "field-input-start" << std::endl;
+                                     recorder_.input(Replay::INPUT_START);
                                      entity_.enablePickableCubeMovedEvent();
                                      view_.enableTouchInput();
                                    });
 
-    connections_ += event_.connect("stage-color",
+    connections_ += connectToField("stage-color",
                                    [this](const Connection&, EventParam& param) noexcept {
-                                     const auto& color = boost::any_cast<const ci::Color&>(param["bg_color"]);
+                                     const auto& color = param.get<ci::Color>("bg_color");
                                      view_.setStageBgColor(color);
 
-                                     const auto& light_tween = boost::any_cast<const std::string&>(param["light_tween"]);
+                                     const auto& light_tween = param.get<std::string>("light_tween");
                                      view_.setStageLightTween(light_tween);
                                    });
 
     
-    connections_ += event_.connect("camera-change",
+    connections_ += connectToField("camera-change",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      DOUT << "camera-change" << std::endl;
-                                     const auto& name = boost::any_cast<const std::string&>(param["name"]);
+                                     const auto& name = param.get<std::string>("name");
                                      view_.changeCameraParams(name);
                                    });
 
     
-    connections_ += event_.connect("falling-down",
+    connections_ += connectToField("falling-down",
                                    [this](const Connection&, EventParam& param) noexcept {
-                                     auto duration = boost::any_cast<float>(param["duration"]);
-                                     const auto& pos      = boost::any_cast<const ci::Vec3f&>(param["pos"]);
-                                     const auto& size     = boost::any_cast<const ci::Vec3f&>(param["size"]);
+                                     auto duration = param.get<float>("duration");
+                                     const auto& pos      = param.get<ci::Vec3f>("pos");
+                                     const auto& size     = param.get<ci::Vec3f>("size");
                                      view_.startQuake(duration, pos, size);
                                    });
 
-    connections_ += event_.connect("begin-regulat-stageclear",
+    connections_ += connectToField("begin-regulat-stageclear",
                                    [this](const Connection&, EventParam& param) noexcept {
+                                     recorder_.input(Replay::RESTART_LINE);
                                      entity_.setRestartLine();
                                    });
     
-    connections_ += event_.connect("begin-all-stageclear",
+    connections_ += connectToField("begin-all-stageclear",
                                    [this](const Connection&, EventParam& param) noexcept {
+                                     recorder_.input(Replay::RESTART_LINE);
                                      entity_.setRestartLine();
                                    });
 
 
     // 効果音系
-    connections_ += event_.connect("view-sound",
+    connections_ += connectToField("view-sound",
                                    [this](const Connection&, EventParam& param) noexcept {
-                                     const auto& sound = boost::any_cast<const std::string&>(param["sound"]);
-                                     const auto& pos  = boost::any_cast<const ci::Vec3f&>(param["pos"]);
-                                     const auto& size = boost::any_cast<const ci::Vec3f&>(param["size"]);
+                                     auto sound = param.get<SoundHandle>("sound");
+                                     const auto& pos  = param.get<ci::Vec3f>("pos");
+                                     const auto& size = param.get<ci::Vec3f>("size");
                                      view_.startViewSound(sound, pos, size);
                                    });
     
 #ifdef DEBUG
-    connections_ += event_.connect("force-collapse",
+    connections_ += connectToField("force-collapse",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      entity_.startStageCollapse();
                                    });
     
-    connections_ += event_.connect("stop-build-and-collapse",
+    connections_ += connectToField("stop-build-and-collapse",
                                    [this](const Connection&, EventParam& param) noexcept {
                                      entity_.stopBuildAndCollapse();
                                    });
 
-    connections_ += event_.connect("entry-pickable",
+    connections_ += connectToField("entry-pickable",
                                    [this](const Connection&, EventParam& param) noexcept {
+                                     recorder_.input(Replay::ENTRY_PICKABLE);
                                      entity_.entryPickableCube();
                                    });
 #endif
 
-    auto current_time = timeline_->getCurrentTime();
-    event_timeline_->setStartTime(current_time);
-    timeline_->apply(event_timeline_);
-
     setup();
+    publishSnapshot();
   }
 
   ~FieldController() {
     DOUT << "~FieldController()" << std::endl;
 
-    // 再生途中のものもあるので、手動で取り除く
-    event_timeline_->removeSelf();
+    if (sim_thread_) sim_thread_->wait();
   }
 
 
@@ -405,15 +476,119 @@ private:
   
   void update(const double progressing_seconds) noexcept override {
     if (paused_) return;
-    
-    timeline_->step(progressing_seconds);
-    entity_.update(progressing_seconds);
-    view_.update(progressing_seconds);
+
+    updateField(progressing_seconds);
+
+    view_timeline_->step(progressing_seconds);
+    snapshots_.update();
+    view_.update(progressing_seconds, interpolation(), snapshots_.readBuffer());
   }
 
   void draw(FontHolder& fonts, ModelHolder& models) noexcept override {
-    const auto field = entity_.fieldData();
-    view_.draw(field, models);
+    view_.draw(snapshots_.readBuffer(), models);
+  }
+
+
+  bool isFieldBusy() const noexcept {
+    return sim_thread_ && sim_thread_->isBusy();
+  }
+
+  // Fieldの更新中はFieldEntityに触れないので、終わるまで処理を遅らせる
+  template <typename F>
+  Connection connectToField(const EventId& msg, F callback) noexcept {
+    return event_.connect(msg,
+                          [this, callback](const Connection& connection, EventParam& param) noexcept {
+                            if (!isFieldBusy()) {
+                              callback(connection, param);
+                              return;
+                            }
+
+                            deferred_calls_.push_back([callback, connection, param]() mutable noexcept {
+                                callback(connection, param);
+                              });
+                          });
+  }
+
+  // 前回の更新が終わっていたら、溜まった処理を片付けて次の更新を始める
+  // 終わっていなければ経過時間だけ貯めておき、描画は前回の結果で続ける
+  void updateField(const double progressing_seconds) noexcept {
+    // 固定間隔の時は、一度に追いつける分だけ貯める
+    double max_seconds = fixed_step_ ? step_seconds_ * max_step_num_ : max_field_seconds_;
+    field_seconds_ = std::min(field_seconds_ + progressing_seconds, max_seconds);
+    if (isFieldBusy()) return;
+
+    flushFieldEvents();
+    // 一時停止のメッセージが遅れて届いた
+    if (paused_) return;
+
+    double seconds = field_seconds_;
+    u_int step_num = 1;
+    if (fixed_step_) {
+      // 貯まった時間で進められる回数だけ、決まった間隔で進める
+      seconds  = step_seconds_;
+      step_num = std::min(u_int(field_seconds_ / step_seconds_), max_step_num_);
+      field_seconds_ -= step_seconds_ * step_num;
+      // 追いつけなかった分は捨てる
+      field_seconds_ = std::fmod(field_seconds_, step_seconds_);
+      if (!step_num) return;
+    }
+    else {
+      field_seconds_ = 0.0;
+    }
+
+    event_timeline_->step(seconds * step_num);
+    for (u_int i = 0; i < step_num; ++i) {
+      recorder_.frame(seconds);
+    }
+
+    if (sim_thread_) {
+      sim_thread_->run([this, seconds, step_num]() noexcept {
+          stepField(seconds, step_num);
+        });
+    }
+    else {
+      stepField(seconds, step_num);
+    }
+  }
+
+  // TIPS:sim_thread_ で実行される場合がある
+  void stepField(const double progressing_seconds, const u_int step_num) noexcept {
+    for (u_int i = 0; i < step_num; ++i) {
+      if (fixed_step_) entity_.keepPrevTransforms();
+
+      timeline_->step(progressing_seconds);
+      entity_.update(progressing_seconds);
+    }
+    publishSnapshot();
+  }
+
+  // 最後の更新結果から、どれだけ時間が進んでいるか(描画時の補間に使う)
+  float interpolation() const noexcept {
+    if (!fixed_step_) return 1.0f;
+    return float(std::min(field_seconds_ / step_seconds_, 1.0));
+  }
+
+  void publishSnapshot() noexcept {
+    snapshots_.writeBuffer().capture(entity_.fieldData());
+    snapshots_.publish();
+  }
+
+  // 更新中に溜まったメッセージを送り直す
+  // TIPS:受け取った側がFieldEntityを操作して、新たなメッセージが溜まる事もある
+  void flushFieldEvents() noexcept {
+    while (!field_events_.empty() || !deferred_calls_.empty()) {
+      flushing_events_.swap(field_events_);
+      for (auto& e : flushing_events_) {
+        event_.signal(e.first, e.second);
+      }
+      flushing_events_.clear();
+
+      std::vector<std::function<void ()> > calls;
+      calls.swap(deferred_calls_);
+      for (auto& call : calls) {
+        call();
+      }
+    }
   }
 
   
@@ -438,7 +613,7 @@ private:
         event_timeline_->getCurrentTime() + continued_start_delay_);
     }
     else {
-      disposable_connections_ += event_.connect("pickable-moved",
+      disposable_connections_ += connectToField("pickable-moved",
                                                 [this](const Connection& connection, EventParam& param) noexcept {
                                                   entity_.startStageBuild();
 
@@ -470,7 +645,7 @@ private:
   void startNextStage() noexcept {
     disposable_connections_.clear();
 
-    disposable_connections_ += event_.connect("pickable-moved",
+    disposable_connections_ += connectToField("pickable-moved",
                                               [this](const Connection& connection, EventParam& param) noexcept {
                                                 // このタイミングで光源設定を変更
                                                 view_.setStageBgColor(entity_.bgColor());
@@ -488,11 +663,18 @@ private:
     stageclear_agree_ = false;
   }
 
+  // ここまでの操作を書き出す
+  // TIPS:アプリが終了させられても直前のゲームまでは残るよう、ゲーム毎に書き出す
+  void writeReplay() noexcept {
+    auto path = getDocumentPath() / params_["game.replay.path"].getValue<std::string>();
+    recorder_.write(path.string());
+  }
+
   void beginGameover(const EventParam& params) noexcept {
     entity_.cancelPickPickableCubes();
     view_.enableTouchInput(false);
 
-    auto cube_id = boost::any_cast<u_int>(params.at("id"));
+    auto cube_id = params.get<u_int>("id");
     view_.beginPickableCubeCloser(cube_id);
 
     view_.beginDistanceCloser();
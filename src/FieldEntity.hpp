@@ -26,6 +26,9 @@
 #include "GameCenter.h"
 #include "Achievment.hpp"
 #include "StageData.hpp"
+#include "Occupancy.hpp"
+#include "RandStreams.hpp"
+#include "Profiler.hpp"
 
 
 namespace ngs {
@@ -67,6 +70,19 @@ class FieldEntity : private boost::noncopyable {
   int stage_num_;
 
   int restart_z_;
+
+  // 同じStageを繰り返して長いStageにする(耐久テスト用)
+  int stage_repeat_;
+
+  // 指定があれば、各ステージを自動生成したものに置き換える(パラメータ調整用)
+  // TIPS:Recordsのアイテム数などは手作りのStageのまま
+  boost::optional<StageGenerator::Settings> stage_generator_;
+  u_int stage_seed_;
+
+  // Stageや各Cubeから参照するので先に初期化
+  Occupancy occupancy_;
+  // 乱数はサブシステムごとの乱数列から引く(同じseedなら同じ展開になる)
+  RandStreams rand_;
   
   Stage stage_;
 
@@ -133,7 +149,8 @@ public:
   FieldEntity(ci::JsonTree& params,
               ci::TimelineRef timeline,
               Event<EventParam>& event,
-              Records& records) noexcept :
+              Records& records,
+              const u_int seed) noexcept :
     params_(params),
     timeline_(timeline),
     event_(event),
@@ -146,13 +163,16 @@ public:
     start_stage_num_(START_STAGE_NUM),
     stage_num_(start_stage_num_),
     restart_z_(0),
-    stage_(params, timeline, event),
-    items_(params, timeline, event),
-    moving_cubes_(params, timeline, event),
-    falling_cubes_(params, timeline, event),
-    switches_(timeline, event),
-    oneways_(timeline, event),
-    bg_(params, timeline, event),
+    stage_repeat_(Json::getValue(params["game"], "stage_repeat", 1)),
+    stage_seed_(seed),
+    rand_(seed),
+    stage_(params, timeline, event, rand_[RandStreams::STAGE], occupancy_),
+    items_(params, timeline, event, rand_[RandStreams::ITEMS], occupancy_),
+    moving_cubes_(params, timeline, event, rand_[RandStreams::MOVING_CUBES], occupancy_),
+    falling_cubes_(params, timeline, event, rand_[RandStreams::FALLING_CUBES], occupancy_),
+    switches_(params, timeline, event, rand_[RandStreams::SWITCHES]),
+    oneways_(params, timeline, event, rand_[RandStreams::ONEWAYS]),
+    bg_(params, event, rand_[RandStreams::BG]),
     first_started_pickable_(false),
     first_out_pickable_(false),
     collapse_speed_rate_(params["game.collapse_speed_rate"].getValue<float>()),
@@ -176,6 +196,10 @@ public:
     }
 
     setupRecords(params);
+
+    if (params["game"].hasChild("stage_generator")) {
+      stage_generator_ = StageGenerator::Settings(params["game.stage_generator"]);
+    }
     
     auto current_time = timeline->getCurrentTime();
     event_timeline_->setStartTime(current_time);
@@ -193,11 +217,18 @@ public:
 
 
   void update(const double progressing_seconds) noexcept {
+    PROFILE_ZONE("FieldEntity::update");
+
     records_.progressPlayTimeCurrntGame(progressing_seconds);
 
+    // 移動が終わったPickableの直前の位置を登録から外す
+    for (auto& cube : pickable_cubes_) {
+      updatePickableCubeGrid(*cube);
+    }
+
+    stage_.update(progressing_seconds);
     items_.update(progressing_seconds, stage_);
-    moving_cubes_.update(progressing_seconds,
-                         stage_, gatherPickableCubePosition());
+    moving_cubes_.update(progressing_seconds, stage_);
     falling_cubes_.update(progressing_seconds, stage_);
     switches_.update(progressing_seconds, stage_);
     oneways_.update(progressing_seconds, stage_);
@@ -207,8 +238,11 @@ public:
     decideEachPickableCubeAlive();
     
     boost::remove_erase_if(pickable_cubes_,
-                           [](const PickableCubePtr& cube) {
-                             return !cube->isActive();
+                           [this](const PickableCubePtr& cube) {
+                             if (cube->isActive()) return false;
+
+                             occupancy_.pickable_cubes.remove(*cube);
+                             return true;
                            });
 
     switch (mode_) {
@@ -223,7 +257,8 @@ public:
           { "bg_color", bg_color_ },
           { "light_tween", light_tween_ },
         };
-        event_.signal("first-pickable-started", params);
+        static const EventId first_pickable_started("first-pickable-started");
+        event_.signal(first_pickable_started, params);
       }
       break;
 
@@ -233,14 +268,16 @@ public:
         controlFinishedPickableCubes();
         
         mode_ = CLEAR;
-        event_.signal("all-pickable-finished", EventParam());
+        static const EventId all_pickable_finished("all-pickable-finished");
+        event_.signal(all_pickable_finished, EventParam());
         {
           EventParam params = {
             { "stage_color", finish_stage_color_ },
             { "bg_color",    finish_bg_color_ },
             { "light_tween", finish_light_tween_ },
           };
-          event_.signal("stage-color", params);
+          static const EventId stage_color("stage-color");
+          event_.signal(stage_color, params);
         }
       }
       break;
@@ -249,7 +286,8 @@ public:
       // finish後、stageの生成と崩壊の完了判定
       if (stage_.isFinishedBuildAndCollapse()) {
         mode_ = NONE;
-        event_.signal("stage-cleared", EventParam());
+        static const EventId stage_cleared("stage-cleared");
+        event_.signal(stage_cleared, EventParam());
       }
       break;
 
@@ -263,7 +301,8 @@ public:
           { "game_aborted",   game_aborted_ },
           { "game_continued", is_continued_ },
         };
-        event_.signal("stage-all-collapsed", params);
+        static const EventId stage_all_collapsed("stage-all-collapsed");
+        event_.signal(stage_all_collapsed, params);
       }
       break;
     }
@@ -282,7 +321,9 @@ public:
         EventParam params = {
           { "play-time", current_stage.play_time },
         };
-        event_.signal("update-record", params);
+        // 毎フレーム送るので変換済みのIdを使う
+        static const EventId update_record("update-record");
+        event_.signal(update_record, params);
       }
       break;
     }
@@ -311,7 +352,8 @@ public:
         { "bg_color",    stage_info.bg_color },
         { "light_tween", stage_info.light_tween }
       };
-      event_.signal("stage-color", params);
+      static const EventId stage_color("stage-color");
+      event_.signal(stage_color, params);
     }
     
     stage_.startBuildStage(1.0f, false);
@@ -349,7 +391,8 @@ public:
       EventParam params = {
         { "name", stage_info.camera },
       };
-      event_.signal("camera-change", params);
+      static const EventId camera_change("camera-change");
+      event_.signal(camera_change, params);
     }
 
     records_.prepareGameRecord(is_continued_);
@@ -364,7 +407,7 @@ public:
     switches_.clear();
     oneways_.clear();
     
-    auto stage_info     = addCubeStage(getStagePath(stage_num_));
+    auto stage_info     = addCubeStage(openStage(stage_num_));
     finish_line_z_      = stage_info.top_z;
     entry_packable_num_ = stage_info.entry_num;
     int entry_item_num  = stage_info.item_num;
@@ -420,9 +463,11 @@ public:
       EventParam params = {
         { "name", camera_ },
       };
-      event_.signal("camera-change", params);
+      static const EventId camera_change("camera-change");
+      event_.signal(camera_change, params);
     }
-    requestSound(event_, "build-start");
+    static const SoundHandle build_start_se = getSoundHandle("build-start");
+    requestSound(event_, build_start_se);
     
     DOUT << "Continue game:" << is_continued_ << std::endl;
     is_continued_ = false;
@@ -495,7 +540,8 @@ public:
         { "current_stage", stage_num_ },
       };
       
-      event_.signal("begin-stageclear", params);
+      static const EventId begin_stageclear("begin-stageclear");
+      event_.signal(begin_stageclear, params);
     }
     
     // sleep中のPickableCubeを起こす
@@ -526,7 +572,8 @@ public:
         { "total_items",  records_.getTotalItemNum() },
         { "can_continue", canContinue() },
       };
-      event_.signal("begin-gameover", params);
+      static const EventId begin_gameover("begin-gameover");
+      event_.signal(begin_gameover, params);
     }
   }
 
@@ -575,7 +622,8 @@ public:
     stage_.startCollapseStage(next_start_line_z_, finish_rate_);
     mode_ = CLEANUP;
     
-    requestSound(event_, "stage-collapse");
+    static const SoundHandle stage_collapse_se = getSoundHandle("stage-collapse");
+    requestSound(event_, stage_collapse_se);
 
     // 再開用情報
     start_stage_num_ = continue_game ? (stage_num_ - 1)
@@ -641,7 +689,8 @@ public:
     const auto* const targets = switches_.startSwitch(block_pos);
     if (targets) {
       startSwitchTargets(*targets);
-      requestSound(event_, "switch");
+      static const SoundHandle switch_se = getSoundHandle("switch");
+      requestSound(event_, switch_se);
       return;
     }
 
@@ -655,7 +704,8 @@ public:
       };
       
       movePickableCube(id, direction.at(oneway.first), oneway.second);
-      requestSound(event_, "oneway");
+      static const SoundHandle oneway_se = getSoundHandle("oneway");
+      requestSound(event_, oneway_se);
       
       return;
     }
@@ -752,6 +802,16 @@ public:
     }
   }
   
+  // 描画時の補間のため、更新前の位置を記録
+  // TIPS:Timelineを進める前に呼ぶ
+  void keepPrevTransforms() noexcept {
+    stage_.keepPrevPositions();
+    for (auto& cube : pickable_cubes_) {
+      cube->keepPrevTransform();
+    }
+    bg_.keepPrevPositions();
+  }
+  
   // 現在のFieldの状態を作成
   Field fieldData() noexcept {
 #ifdef DEBUG
@@ -759,8 +819,7 @@ public:
 #endif
     
     Field field = {
-      stage_.activeCubes(),
-      stage_.collapseCubes(),
+      stage_.cubes(),
       pickable_cubes_,
       items_.items(),
       moving_cubes_.cubes(),
@@ -795,6 +854,17 @@ public:
 
   const std::string& lightTween() const noexcept { return light_tween_; }
 
+  const std::vector<PickableCubePtr>& pickableCubes() const noexcept { return pickable_cubes_; }
+
+  // idの代わりに並び順を使う(記録と再生でidが一致しないため)
+  u_int pickableCubeIndex(const u_int id) const noexcept {
+    for (u_int i = 0; i < pickable_cubes_.size(); ++i) {
+      if (*pickable_cubes_[i] == id) return i;
+    }
+    assert(!"no PickableCube.");
+    return 0;
+  }
+
 
 private:
   // 参照の無効値をあらわすためにboost::optionalを利用
@@ -816,18 +886,20 @@ private:
                          const bool random, const bool sleep) noexcept {
     event_timeline_->add([this, entry_pos, offset_z, random, sleep]() {
         const auto& stage_width = stage_.getStageWidth();
+        auto& rand = rand_[RandStreams::PICKABLE];
         int entry_y = entry_pos.y + offset_z;
         while (1) {
           // 何度か試してみて、ダメなら登場Z位置を変えて試す
           for (int i = 0; i < 10; ++i) {
-            int x = random ? ci::randInt(stage_width.x + 1, stage_width.y - 1)
+            int x = random ? rand.nextInt(stage_width.x + 1, stage_width.y - 1)
                            : entry_pos.x;
             
             auto pos = ci::Vec3i(x, 0, entry_y);
             if (isPickableCube(pos)) continue;
           
-            pickable_cubes_.emplace_back(new PickableCube(params_, timeline_, event_, pos,
+            pickable_cubes_.emplace_back(new PickableCube(params_, timeline_, event_, rand, pos,
                                                           (mode_ == CLEAR) ? false : sleep));
+            updatePickableCubeGrid(*pickable_cubes_.back());
 
             // 再開用の位置を保存
             start_pickable_entry_.emplace_back(pos.x, pos.z - offset_z);
@@ -863,31 +935,35 @@ private:
 
   
   StageInfo addCubeStage(const std::string& path) noexcept {
-    auto stage = StageData::load(path);
+    return addCubeStage(StageData::open(path));
+  }
+
+  // TIPS:行や配置物は生成する時に読み出す
+  StageInfo addCubeStage(const std::shared_ptr<StageSource>& stage) noexcept {
     int current_z = stage_.getTopZ();
 
-    int x_offset = Json::getValue(stage, "x_offset", 0);
+    int x_offset = stage->header().x_offset;
     int top_z = stage_.addCubes(stage,
                                 x_offset,
                                 cube_stage_color_, cube_line_color_);
 
-    int entry_num = Json::getValue(stage, "pickable", 0);
+    int entry_num = stage->header().pickable;
 
     int item_num = items_.addItemCubes(stage, current_z, x_offset);
     moving_cubes_.addCubes(stage, current_z, x_offset);
     falling_cubes_.addCubes(stage, current_z, x_offset);
-    switches_.addSwitches(params_, stage, current_z, x_offset);
-    oneways_.addOneways(params_, stage, current_z, x_offset);
+    switches_.addSwitches(stage, current_z, x_offset);
+    oneways_.addOneways(stage, current_z, x_offset);
 
     StageInfo info = {
       top_z,
       current_z,
       entry_num,
       item_num,
-      Json::getColor<float>(stage["color"]),
-      Json::getColor<float>(stage["bg_color"]),
-      Json::getValue(stage, "light_tween", std::string("normal")),
-      Json::getValue(stage, "camera", std::string("normal")),
+      stage->color(),
+      stage->bgColor(),
+      stage->lightTween(),
+      stage->camera(),
     };
     
     return info;
@@ -900,6 +976,7 @@ private:
       if (cube->willRotationMove()) {
         if (canPickableCubeMove(cube, cube->blockPosition() + cube->moveVector())) {
           cube->startRotationMove();
+          updatePickableCubeGrid(*cube);
           // 回転開始時にitem pickup判定とか
           pickupStageItems(cube);
         }
@@ -942,18 +1019,18 @@ private:
 
   bool canPickableCubeMove(const PickableCubePtr& cube, const ci::Vec3i& block_pos) const noexcept {
     // 移動先に他のPickableCubeがいたら移動できない
-    for (const auto& other_cube : pickable_cubes_) {
-      // 自分自身との判定はスキップ
-      if (*cube == *other_cube) continue;
+    const auto* other = occupancy_.pickable_cubes.find(block_pos,
+                                                       [&cube, &block_pos](const PickableCube& other_cube) {
+                                                         // 自分自身との判定はスキップ
+                                                         if (*cube == other_cube) return false;
 
-      if (block_pos == other_cube->blockPosition()) return false;
+                                                         if (block_pos == other_cube.blockPosition()) return true;
 
-      // 相手が移動中の場合は直前の位置もダメ
-      if (other_cube->isMoving()
-          && (block_pos == other_cube->prevBlockPosition())) {
-        return false;
-      }
-    }
+                                                         // 相手が移動中の場合は直前の位置もダメ
+                                                         return other_cube.isMoving()
+                                                           && (block_pos == other_cube.prevBlockPosition());
+                                                       });
+    if (other) return false;
 
     // 移動先にMovingCubeがあってもダメ
     if (moving_cubes_.isCubeExists(block_pos)) return false;
@@ -968,14 +1045,20 @@ private:
   }
 
   bool isPickableCube(const ci::Vec3i& block_pos) const noexcept {
-    for (auto& cube : pickable_cubes_) {
-      const auto& pos = cube->blockPosition();
-      
-      if ((pos.x == block_pos.x) && (pos.z == block_pos.z)) {
-        return true;
-      }
+    return occupancy_.pickable_cubes.find(block_pos,
+                                          [&block_pos](const PickableCube& cube) {
+                                            const auto& pos = cube.blockPosition();
+                                            return (pos.x == block_pos.x) && (pos.z == block_pos.z);
+                                          }) != nullptr;
+  }
+
+  void updatePickableCubeGrid(PickableCube& cube) noexcept {
+    if (cube.isMoving()) {
+      occupancy_.pickable_cubes.update(cube, cube.blockPosition(), cube.prevBlockPosition());
+    }
+    else {
+      occupancy_.pickable_cubes.update(cube, cube.blockPosition());
     }
-    return false;
   }
   
   // PickableCubeの落下判定
@@ -993,11 +1076,13 @@ private:
             { "id",        cube->id() },
             { "first_out", !first_out_pickable_ },
           };
-          event_.signal("fall-pickable", params);
+          static const EventId fall_pickable("fall-pickable");
+          event_.signal(fall_pickable, params);
           
           if (!first_out_pickable_) {
             first_out_pickable_ = true;
-            event_.signal("first-out-pickable", params);
+            static const EventId first_out_pickable("first-out-pickable");
+            event_.signal(first_out_pickable, params);
           }
         }
       }
@@ -1018,11 +1103,13 @@ private:
           { "block_position", cube->blockPosition() },
           { "first_out",      !first_out_pickable_ },
         };
-        event_.signal("pressed-pickable", params);
+        static const EventId pressed_pickable("pressed-pickable");
+        event_.signal(pressed_pickable, params);
 
         if (!first_out_pickable_) {
           first_out_pickable_ = true;
-          event_.signal("first-out-pickable", params);
+          static const EventId first_out_pickable("first-out-pickable");
+          event_.signal(first_out_pickable, params);
         }
       }
     }
@@ -1061,22 +1148,6 @@ private:
     return false;
   }
 
-
-  std::vector<ci::Vec3i> gatherPickableCubePosition() const noexcept {
-    std::vector<ci::Vec3i> pos;
-    if (pickable_cubes_.empty()) return pos;
-
-    pos.reserve(pickable_cubes_.size() * 2);
-    
-    for (const auto& cube : pickable_cubes_) {
-      pos.push_back(cube->blockPosition());
-      if (cube->isMoving()) {
-        pos.push_back(cube->prevBlockPosition());
-      }
-    }
-    return pos;
-  }
-
   // すべてのPickableCubeがFinishしたか判定
   bool isAllPickableCubesFinished() noexcept {
     if (pickable_cubes_.empty()) return false;
@@ -1212,18 +1283,23 @@ private:
     }
   }
 
+  std::shared_ptr<StageSource> openStage(const int stage_num) noexcept {
+    if (stage_generator_) {
+      return StageData::generate(*stage_generator_, stage_seed_ + stage_num, stage_repeat_);
+    }
+    return StageData::open(getStagePath(stage_num), stage_repeat_);
+  }
+
   std::string getStagePath(const int stage_num) noexcept {
     return params_["game.stage_path"][stage_num].getValue<std::string>();
   }
 
-  static int getStageItemNum(const ci::JsonTree& stage) noexcept {
-    if (!stage.hasChild("items")) return 0;
-          
-    return int(stage["items"].getNumChildren());
+  static int getStageItemNum(const CompiledStage& stage) noexcept {
+    return int(stage.items().size());
   }
   
-  static int getPickableCubeEntryNum(const ci::JsonTree& stage) noexcept {
-    return Json::getValue(stage, "pickable", 0);
+  static int getPickableCubeEntryNum(const CompiledStage& stage) noexcept {
+    return stage.header().pickable;
   }
   
   int calcEntryPickableCube(const int stage_num) noexcept {
@@ -0,0 +1,334 @@
+﻿#pragma once
+
+//
+// 画面を持たないField
+//   FieldControllerからViewとUIを取り除いたもの
+//   UIでの同意操作は自動で済ませ、ゲームオーバーや全クリア後は最初からやり直す
+//   記録した操作を再生する時は、UIでの操作も記録に従う
+//
+
+#include <boost/noncopyable.hpp>
+#include <cinder/Json.h>
+#include <cinder/Timeline.h>
+#include "FieldEntity.hpp"
+#include "Event.hpp"
+#include "EventParam.hpp"
+#include "ConnectionHolder.hpp"
+#include "Records.hpp"
+#include "Replay.hpp"
+
+
+namespace ngs {
+
+class FieldSimulator : private boost::noncopyable {
+  ci::TimelineRef timeline_;
+  ci::TimelineRef event_timeline_;
+
+  Event<EventParam> event_;
+
+  ConnectionHolder connections_;
+  ConnectionHolder disposable_connections_;
+
+  FieldEntity entity_;
+
+  bool stage_cleard_;
+  bool stageclear_agree_;
+
+  // falseならUIでの操作を自動で行わない
+  bool auto_agree_;
+  float continued_start_delay_;
+
+  u_int frame_num_;
+  double simulated_seconds_;
+  u_int play_num_;
+  int   cleard_stage_num_;
+
+
+public:
+  FieldSimulator(ci::JsonTree& params, Records& records,
+                 const u_int seed, const bool auto_agree = true) noexcept :
+    timeline_(ci::Timeline::create()),
+    event_timeline_(ci::Timeline::create()),
+    entity_(params, timeline_, event_, records, seed),
+    stage_cleard_(false),
+    stageclear_agree_(false),
+    auto_agree_(auto_agree),
+    continued_start_delay_(params["game.continued_start_delay"].getValue<float>()),
+    frame_num_(0),
+    simulated_seconds_(0.0),
+    play_num_(0),
+    cleard_stage_num_(0)
+  {
+    DOUT << "FieldSimulator()" << std::endl;
+
+    connections_ += event_.connect("pickable-moved",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     const auto& block_pos = param.get<ci::Vec3i>("block_pos");
+                                     const auto id = param.get<u_int>("id");
+                                     entity_.movedPickableCube(id, block_pos);
+
+                                     auto move_step = param.get<int>("move_step");
+                                     entity_.recordMoveStep(move_step);
+                                   });
+
+    connections_ += event_.connect("all-pickable-finished",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     entity_.completeBuildAndCollapseStage();
+                                     entity_.cancelPickPickableCubes();
+                                   });
+
+    // StageclearControllerの代わりに即座に同意する
+    connections_ += event_.connect("begin-stageclear",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     cleard_stage_num_ += 1;
+                                     if (!auto_agree_) return;
+
+                                     if (param.get<bool>("all_cleared")) {
+                                       // 全クリア後はTitleに戻る時と同じ処理
+                                       entity_.setRestartLine();
+                                       event_timeline_->add([this]() noexcept {
+                                           entity_.cleanupField();
+                                         },
+                                         event_timeline_->getCurrentTime());
+                                       return;
+                                     }
+
+                                     stageclear_agree_ = true;
+                                     if (stage_cleard_ && stageclear_agree_) {
+                                       startNextStage();
+                                     }
+                                   });
+
+    connections_ += event_.connect("stage-cleared",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     stage_cleard_ = true;
+
+                                     if (stage_cleard_ && stageclear_agree_) {
+                                       startNextStage();
+                                     }
+                                   });
+
+    connections_ += event_.connect("build-one-line",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     int active_top_z = param.get<int>("active_top_z");
+                                     entity_.entryStageObjects(active_top_z);
+                                   });
+
+    connections_ += event_.connect("first-out-pickable",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     entity_.cancelPickPickableCubes();
+                                     entity_.gameover();
+                                   });
+
+    // GameoverControllerの代わりに同意する
+    // TIPS:FieldEntity::update中に呼ばれるので、次のフレームで処理する
+    connections_ += event_.connect("begin-gameover",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     if (!auto_agree_) return;
+
+                                     event_timeline_->add([this]() noexcept {
+                                         entity_.cleanupField();
+                                       },
+                                       event_timeline_->getCurrentTime());
+                                   });
+
+    connections_ += event_.connect("pickable-start-idle",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     u_int id = param.get<u_int>("id");
+                                     entity_.startIdlePickableCube(id);
+                                   });
+
+    connections_ += event_.connect("startline-opened",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     entity_.enableRecordPlay();
+                                   });
+
+    connections_ += event_.connect("pickuped-item",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     entity_.pickupedItemCube();
+                                   });
+
+    connections_ += event_.connect("stage-all-collapsed",
+                                   [this](const Connection&, EventParam& param) noexcept {
+                                     play_num_ += 1;
+
+                                     entity_.restart();
+                                     setup();
+                                   });
+
+    auto current_time = timeline_->getCurrentTime();
+    event_timeline_->setStartTime(current_time);
+    timeline_->apply(event_timeline_);
+
+    setup();
+  }
+
+  ~FieldSimulator() {
+    // 再生途中のものもあるので、手動で取り除く
+    event_timeline_->removeSelf();
+  }
+
+
+  // 1フレーム進める
+  void update(const double progressing_seconds) noexcept {
+    timeline_->step(progressing_seconds);
+    entity_.update(progressing_seconds);
+
+    frame_num_ += 1;
+    simulated_seconds_ += progressing_seconds;
+  }
+
+  // n番目のPickableCubeを動かす(無ければ何もしない)
+  void movePickableCube(const size_t index, const int direction, const int speed) noexcept {
+    const auto& cubes = entity_.pickableCubes();
+    if (index >= cubes.size()) return;
+
+    const auto& cube = cubes[index];
+    if (!cube->isOnStage() || cube->isSleep() || cube->isPressed()) return;
+
+    entity_.movePickableCube(cube->id(), direction, speed);
+  }
+
+  size_t pickableCubeNum() const noexcept {
+    return entity_.pickableCubes().size();
+  }
+
+  // 記録したUIからの操作を行う
+  // 記録時と状態が食い違っていたらfalse
+  bool apply(const Replay::Input& input) noexcept {
+    switch (input.type) {
+    case Replay::PICK:
+      if (!isValidPickableIndex(input)) return false;
+      entity_.pickPickableCube(pickableCubeId(input.index));
+      break;
+
+    case Replay::MOVE:
+      if (!isValidPickableIndex(input)) return false;
+      entity_.movePickableCube(pickableCubeId(input.index), input.direction, input.speed);
+      break;
+
+    case Replay::CANCEL_PICK:
+      entity_.cancelPickPickableCubes();
+      break;
+
+    case Replay::INPUT_STOP:
+      entity_.cancelPickPickableCubes();
+      entity_.enablePickableCubeMovedEvent(false);
+      break;
+
+    case Replay::INPUT_START:
+      entity_.enablePickableCubeMovedEvent();
+      break;
+
+    case Replay::STAGECLEAR_AGREE:
+      stageclear_agree_ = true;
+      if (stage_cleard_ && stageclear_agree_) {
+        startNextStage();
+      }
+      break;
+
+    case Replay::RESTART_LINE:
+      entity_.setRestartLine();
+      break;
+
+    case Replay::RISE:
+      entity_.riseAllPickableCube();
+      break;
+
+    case Replay::COLLAPSE:
+      entity_.collapseStage();
+      break;
+
+    case Replay::CLEANUP:
+      entity_.cleanupField(input.flag);
+      break;
+
+    case Replay::ABORT:
+      event_timeline_->clear();
+      entity_.abortGame();
+      break;
+
+    case Replay::ENTRY_PICKABLE:
+#ifdef DEBUG
+      entity_.entryPickableCube();
+#endif
+      break;
+
+    default:
+      break;
+    }
+
+    return true;
+  }
+
+
+  u_int frameNum() const noexcept { return frame_num_; }
+
+  double simulatedSeconds() const noexcept { return simulated_seconds_; }
+
+  // ゲームオーバーか全クリアで1回
+  u_int playNum() const noexcept { return play_num_; }
+
+  int cleardStageNum() const noexcept { return cleard_stage_num_; }
+
+  Event<EventParam>& event() noexcept { return event_; }
+
+  // 描画せずにFieldの状態を調べる時に使う
+  Field fieldData() noexcept { return entity_.fieldData(); }
+
+
+private:
+  void setup() noexcept {
+    disposable_connections_.clear();
+
+    if (entity_.isContinuedGame()) {
+      // Continue時はStageを一定時間後に生成開始
+      event_timeline_->add([this]() noexcept {
+          entity_.startStageBuild();
+        },
+        event_timeline_->getCurrentTime() + continued_start_delay_);
+    }
+    else {
+      // 最初にPickableを動かしたらステージ生成開始
+      disposable_connections_ += event_.connect("pickable-moved",
+                                                [this](const Connection& connection, EventParam& param) noexcept {
+                                                  entity_.startStageBuild();
+                                                  connection.disconnect();
+                                                });
+    }
+
+    stage_cleard_     = false;
+    stageclear_agree_ = false;
+
+    entity_.setupStartStage();
+  }
+
+  bool isValidPickableIndex(const Replay::Input& input) const noexcept {
+    if (input.index < entity_.pickableCubes().size()) return true;
+
+    DOUT << "FieldSimulator: replay desync frame:" << frame_num_
+         << " index:" << input.index
+         << " cubes:" << entity_.pickableCubes().size()
+         << std::endl;
+    return false;
+  }
+
+  u_int pickableCubeId(const u_int index) const noexcept {
+    const auto& cubes = entity_.pickableCubes();
+    assert(index < cubes.size());
+    return cubes[index]->id();
+  }
+
+  void startNextStage() noexcept {
+    disposable_connections_.clear();
+
+    entity_.entryPickableCubes();
+    entity_.startStageBuild();
+
+    stage_cleard_     = false;
+    stageclear_agree_ = false;
+  }
+
+};
+
+}
@@ -0,0 +1,199 @@
+﻿#pragma once
+
+//
+// 描画用に複製したFieldの状態
+//   Fieldは更新中のオブジェクトを参照するので、別スレッドの更新と並行して描画できるよう
+//   必要な値だけを書き写す
+//   TIPS:毎回clearして使い回すので、確保済みの領域は再利用される
+//   prev_* は直前の更新開始時の値で、描画時に補間する
+//   (補間しない種類は現在の値と同じ)
+//
+
+#include <vector>
+#include "Field.hpp"
+
+
+namespace ngs {
+
+struct FieldSnapshot {
+  struct StageCube {
+    ci::Vec3f position;
+    ci::Vec3f prev_position;
+    ci::Color color;
+  };
+
+  struct Cube {
+    ci::Vec3f position;
+    ci::Quatf rotation;
+    ci::Vec3f size;
+    ci::Color color;
+
+    ci::Vec3f prev_position;
+    ci::Quatf prev_rotation;
+  };
+
+  // 影はstage cubeの上面に描く
+  struct Shadow {
+    ci::Vec3f position;
+    ci::Quatf rotation;
+    ci::Vec3f size;
+    float alpha;
+  };
+
+  // pickとカメラ制御に使う情報(非アクティブなものも含む)
+  struct Pickable {
+    u_int     id;
+    ci::Vec3f position;
+    ci::Quatf rotation;
+    ci::Vec3f size;
+
+    bool  active;
+    bool  on_stage;
+    bool  sleep;
+    bool  pressed;
+    bool  adjoin_other;
+    float padding_size;
+  };
+
+  struct BgCube {
+    ci::Vec3f position;
+    ci::Vec3f prev_position;
+    ci::Vec3f size;
+    ci::Color color;
+  };
+
+  std::vector<StageCube> stage_cubes;
+
+  std::vector<Pickable> pickables;
+
+  // 以下はアクティブなものだけ
+  std::vector<Cube> pickable_cubes;
+  std::vector<Cube> item_cubes;
+  std::vector<Shadow> item_shadows;
+  std::vector<Cube> moving_cubes;
+  std::vector<Cube> falling_cubes;
+  std::vector<Cube> switches;
+  std::vector<Cube> oneways;
+
+  std::vector<BgCube> bg_cubes;
+
+#ifdef DEBUG
+  ci::Vec3f bg_bbox_min;
+  ci::Vec3f bg_bbox_max;
+#endif
+
+
+  void capture(const Field& field) noexcept {
+    stage_cubes.clear();
+    const auto& cubes = field.stage_cubes;
+    for (u_int row = cubes.headRow(); row != cubes.tailRow(); ++row) {
+      size_t index = cubes.rowIndex(row);
+      for (int i = 0; i < StageCubes::ROW_WIDTH; ++i, ++index) {
+        if (!cubes.exists(index)) continue;
+
+        StageCube cube = {
+          cubes.position(index),
+          cubes.prevPosition(index),
+          cubes.color(index),
+        };
+        stage_cubes.push_back(cube);
+      }
+    }
+
+    pickables.clear();
+    for (const auto& cube : field.pickable_cubes) {
+      Pickable pickable = {
+        cube->id(),
+        cube->position(),
+        cube->rotation(),
+        cube->size(),
+        cube->isActive(),
+        cube->isOnStage(),
+        cube->isSleep(),
+        cube->isPressed(),
+        cube->isAdjoinOther(),
+        cube->getPaddingSize(),
+      };
+      pickables.push_back(pickable);
+    }
+
+    pickable_cubes.clear();
+    for (const auto& cube : field.pickable_cubes) {
+      if (!cube->isActive()) continue;
+
+      Cube c = {
+        cube->position(),
+        cube->rotation(),
+        cube->size(),
+        cube->color(),
+        cube->prevPosition(),
+        cube->prevRotation(),
+      };
+      pickable_cubes.push_back(c);
+    }
+
+    copyCubes(item_cubes, field.item_cubes);
+    copyCubes(moving_cubes, field.moving_cubes);
+    copyCubes(falling_cubes, field.falling_cubes);
+    copyCubes(switches, field.switches);
+    copyCubes(oneways, field.oneways);
+
+    item_shadows.clear();
+    for (const auto& cube : field.item_cubes) {
+      if (!cube->isActive()) continue;
+
+      auto alpha = cube->shadowAlpha();
+      if (alpha == 0.0f) continue;
+
+      auto position = cube->position();
+      Shadow shadow = {
+        ci::Vec3f(position.x, cube->stageHeight(), position.z),
+        cube->rotation(),
+        cube->size(),
+        alpha,
+      };
+      item_shadows.push_back(shadow);
+    }
+
+    bg_cubes.clear();
+    for (size_t i = 0; i < field.bg_cubes.num; ++i) {
+      BgCube cube = {
+        field.bg_cubes.position(i),
+        field.bg_cubes.prevPosition(i),
+        field.bg_cubes.size[i],
+        field.bg_cubes.color[i],
+      };
+      bg_cubes.push_back(cube);
+    }
+
+#ifdef DEBUG
+    bg_bbox_min = field.bg_bbox_min;
+    bg_bbox_max = field.bg_bbox_max;
+#endif
+  }
+
+
+private:
+  template <typename T>
+  static void copyCubes(std::vector<Cube>& output, const std::vector<T>& cubes) noexcept {
+    output.clear();
+    for (const auto& cube : cubes) {
+      if (!cube->isActive()) continue;
+
+      auto position = cube->position();
+      auto rotation = cube->rotation();
+      Cube c = {
+        position,
+        rotation,
+        cube->size(),
+        cube->color(),
+        position,
+        rotation,
+      };
+      output.push_back(c);
+    }
+  }
+  
+};
+
+}
@@ -15,14 +15,17 @@
 #include <cinder/ImageIo.h>
 #include <cinder/Frustum.h>
 #include "Asset.hpp"
-#include "Field.hpp"
+#include "FieldSnapshot.hpp"
+#include "BoundingTree.hpp"
 #include "ConnectionHolder.hpp"
 #include "EventParam.hpp"
 #include "ModelHolder.hpp"
+#include "CubeBatch.hpp"
 #include "MaterialHolder.hpp"
 #include "FieldLights.hpp"
 #include "Quake.hpp"
 #include "SoundRequest.hpp"
+#include "Profiler.hpp"
 
 
 namespace ngs {
@@ -74,22 +77,21 @@ class FieldView : private boost::noncopyable {
   
   // pick用情報
   struct TouchCube {
-    u_int                id;
-    ci::Vec3f            position;
-    ci::Quatf            rotation;
-    ci::AxisAlignedBox3f bbox;
+    u_int     id;
+    ci::Vec3f position;
+    ci::Quatf rotation;
 
     TouchCube(const u_int id_,
-              const ci::Vec3f& position_, const ci::Quatf& rotation_,
-              const ci::AxisAlignedBox3f& bbox_) noexcept :
+              const ci::Vec3f& position_, const ci::Quatf& rotation_) noexcept :
       id(id_),
       position(position_),
-      rotation(rotation_),
-      bbox(bbox_)
+      rotation(rotation_)
     {}
   };
 
   std::vector<TouchCube> touch_cubes_;
+  // Rayとの当たり判定用(動いたCubeだけ更新する)
+  BoundingTree touch_tree_;
 
   struct Pick {
     u_int     touch_id;
@@ -122,6 +124,9 @@ class FieldView : private boost::noncopyable {
   ci::TimelineRef animation_timeline_;
   double progressing_seconds_;
 
+  // 直前の更新結果からどれだけ進めて描画するか(0~1)
+  float interpolation_;
+
   MaterialHolder materials_;
 
   ci::gl::Texture bg_texture_;
@@ -144,6 +149,9 @@ class FieldView : private boost::noncopyable {
 
   float shadow_alpha_;
 
+  // 同じModelのCubeはまとめて描画
+  CubeBatch batch_;
+
   ci::Area  bg_area_;
   ci::Rectf bg_rect_;
   
@@ -184,6 +192,7 @@ public:
     touch_input_(true),
     animation_timeline_(ci::Timeline::create()),
     progressing_seconds_(0.0),
+    interpolation_(1.0f),
     bg_texture_(ci::loadImage(Asset::load("bg.png"))),
     bg_tween_type_(params["game_view.bg_tween_type"].getValue<std::string>()),
     bg_tween_duration_(params["game_view.bg_tween_duration"].getValue<float>()),
@@ -254,17 +263,21 @@ public:
 
 
   // 時間経過での計算が必要なもの
-  void update(const double progressing_seconds) noexcept {
+  void update(const double progressing_seconds, const float interpolation,
+              const FieldSnapshot& field) noexcept {
     // 経過時間だけ記録しておいて、drawで計算する
     progressing_seconds_ = progressing_seconds;
+    interpolation_       = interpolation;
+
+    makeTouchCubeInfo(field.pickables);
+    updateCameraTarget(field.pickables);
   }
 
   
   // Fieldの表示
-  void draw(const Field& field, ModelHolder& models) noexcept {
-    // FIXME:drawの中で、PikableCubeからTouch情報を生成している
-    makeTouchCubeInfo(field.pickable_cubes);
-    updateCameraTarget(field.pickable_cubes);
+  void draw(const FieldSnapshot& field, ModelHolder& models) noexcept {
+    PROFILE_ZONE("FieldView::draw");
+
     updateCamera(progressing_seconds_);
     lights_.updateLights(target_point_);
 
@@ -297,22 +310,20 @@ public:
 
     lights_.enableLights();
 
-    drawStageCubes(field.active_cubes, models, frustum_);
-    drawStageCubes(field.collapse_cubes, models, frustum_);
+    drawStageCubes(field.stage_cubes, models, frustum_);
 
-    drawCubeShadow(field.item_cubes, models, "item_shadow", "item_shadow");
+    drawCubeShadow(field.item_shadows, models, "item_shadow", "item_shadow");
 
     auto pickable_matrix = [](const ci::Vec3f& position, const ci::Quatf& rotation, const ci::Vec3f& size) {
-      ci::gl::translate(position);
+      auto matrix = ci::Matrix44f::createTranslation(position);
 
       // FIXME:通常のscaleが1.0で、pickableが潰された時のみscaleが変わる
       //       ので、回転の後でscaleを掛けている
-      ci::gl::scale(size);
+      matrix.scale(size);
 
-      // TIPS:gl::rotate(Quarf)は、内部でglRotatefを使っている
-      //      この計算が正しく求まらない状況があるため、Quarf->Matrix
-      //      にしている。これだと問題ない
-      glMultMatrixf(rotation.toMatrix44());
+      // TIPS:Quarf->Matrixで回転を掛ける
+      matrix *= rotation.toMatrix44();
+      return matrix;
     };
     
     drawCubes(field.pickable_cubes, models,
@@ -320,9 +331,10 @@ public:
               pickable_matrix);
 
     auto matrix = [](const ci::Vec3f& position, const ci::Quatf& rotation, const ci::Vec3f& size) {
-      ci::gl::translate(position);
-      glMultMatrixf(rotation.toMatrix44());
-      ci::gl::scale(size);
+      auto matrix = ci::Matrix44f::createTranslation(position);
+      matrix *= rotation.toMatrix44();
+      matrix.scale(size);
+      return matrix;
     };
     
     drawCubes(field.item_cubes, models,
@@ -357,7 +369,7 @@ public:
 
 #ifdef DEBUG
     if (debug_info_) {
-      drawPickableCubesBBox(field.pickable_cubes);
+      drawPickableCubesBBox(field.pickables);
       drawBgBbox(field.bg_bbox_min, field.bg_bbox_max);
       drawCameraTargetRange();
       drawLightInfo();
@@ -418,7 +430,7 @@ public:
     quake_.start(*animation_timeline_, &quake_value_, duration);
   }
 
-  void startViewSound(const std::string& sound, const ci::Vec3f& pos, const ci::Vec3f& size) noexcept {
+  void startViewSound(const SoundHandle sound, const ci::Vec3f& pos, const ci::Vec3f& size) noexcept {
     // 視錐台外は無視
     if (!frustum_.intersects(pos, size)) return;
 
@@ -501,38 +513,26 @@ private:
     if (!touch_input_) return;
     
     for (const auto& touch : touches) {
-      auto  ray    = generateRay(touch.pos);
-      float near_z = std::numeric_limits<float>::max();
-      bool  picked = false;
-      
-      TouchCube* picked_cube = nullptr;
-      
-      for (auto& cube : touch_cubes_) {
-        if (isTouching(cube.id)) continue;
-        
-        if (isPickedCube(cube.bbox, ray)) {
-          // 複数のCubeをPickする可能性がある
-          // その場合は一番手前のを選ぶ
-          float z = getPickedCubeZ(cube.bbox, ray);
-          if (z > near_z) continue;
-          near_z = z;
-          picked = true;
-          picked_cube = &cube;
-        }
-      }
+      auto ray = generateRay(touch.pos);
+
+      // 複数のCubeをPickする可能性がある
+      // その場合は一番手前のを選ぶ
+      auto picked_id = touch_tree_.rayCast(ray,
+                                           [this](const u_int id) noexcept {
+                                             return isTouching(id);
+                                           });
       
-      if (picked) {
-        assert(picked_cube);
-          
+      if (picked_id) {
         pickings_.emplace_back(touch.id,
                                touch.pos, touch.timestamp,
-                               picked_cube->id,
+                               *picked_id,
                                false);
 
         EventParam params = {
-          { "cube_id", picked_cube->id },
+          { "cube_id", *picked_id },
         };
-        event_.signal("picking-start", params);
+        static const EventId picking_start("picking-start");
+        event_.signal(picking_start, params);
       }
     }
   }
@@ -595,7 +595,8 @@ private:
               { "move_direction", move_direction },
               { "move_speed",     1 },
             };
-            event_.signal("move-pickable", params);
+            static const EventId move_pickable("move-pickable");
+            event_.signal(move_pickable, params);
 
             pick->began_move = true;
             removePick(touch);
@@ -669,7 +670,8 @@ private:
             { "move_direction", move_direction },
             { "move_speed",     move_speed },
           };
-          event_.signal("move-pickable", params);
+          static const EventId move_pickable("move-pickable");
+          event_.signal(move_pickable, params);
 
           DOUT << "move:" << move_direction << " speed:" << move_speed << std::endl;
 
@@ -719,10 +721,7 @@ private:
   }
 
   bool isCubeExists(const u_int id) noexcept {
-    for (const auto& cube : touch_cubes_) {
-      if (cube.id == id) return true;
-    }
-    return false;
+    return touch_tree_.contains(id);
   }
   
 
@@ -743,40 +742,29 @@ private:
     return camera_.generateRay(u, 1.0f - v, camera_.getAspectRatio());
   }
 
-  bool isPickedCube(ci::AxisAlignedBox3f& bbox, const ci::Ray& ray) noexcept {
-    return bbox.intersects(ray);
-  }
-
-  float getPickedCubeZ(ci::AxisAlignedBox3f& bbox, const ci::Ray& ray) noexcept {
-    float intersections[3];
-    bbox.intersect(ray, intersections);
-
-    return std::min(intersections[0], intersections[1]);
-  }
-
-  
-  void makeTouchCubeInfo(const std::vector<std::unique_ptr<PickableCube> >& cubes) noexcept {
+  void makeTouchCubeInfo(const std::vector<FieldSnapshot::Pickable>& cubes) noexcept {
     touch_cubes_.clear();
+    touch_tree_.beginUpdate();
     
     for (const auto& cube : cubes) {
-      if (!cube->isActive() || !cube->isOnStage() || cube->isSleep() || cube->isPressed()) continue;
+      if (!cube.active || !cube.on_stage || cube.sleep || cube.pressed) continue;
 
-      const auto& pos = cube->position();
-      const auto& size = cube->size();
+      const auto& pos = cube.position;
+      const auto& size = cube.size;
       ci::Vec3f half_size = size / 2;
       
-      if (!cube->isAdjoinOther()) {
+      if (!cube.adjoin_other) {
         // 隣接がなければpaddingを加える
         // ※カメラの離れ具合で補正
-        float padding_size = reviseValueByCamera(cube->getPaddingSize());
+        float padding_size = reviseValueByCamera(cube.padding_size);
 
         half_size += ci::Vec3f(padding_size, padding_size, padding_size);
       }
       
-      touch_cubes_.emplace_back(cube->id(),
-                                pos, cube->rotation(),
-                                ci::AxisAlignedBox3f(pos - half_size, pos + half_size));
+      touch_cubes_.emplace_back(cube.id, pos, cube.rotation);
+      touch_tree_.update(cube.id, pos - half_size, pos + half_size);
     }
+    touch_tree_.endUpdate();
 
     // Pick中なのに含まれないCubeを削除
     boost::remove_erase_if(pickings_,
@@ -785,7 +773,7 @@ private:
                            });
   }
 
-  void updateCameraTarget(const std::vector<std::unique_ptr<PickableCube> >& cubes) noexcept {
+  void updateCameraTarget(const std::vector<FieldSnapshot::Pickable>& cubes) noexcept {
     if (!camera_follow_target_) return;
     
     std::vector<ci::Vec3f> cube_pos;
@@ -819,25 +807,25 @@ private:
     }
   }
 
-  std::vector<ci::Vec3f> searchAliveCube(const std::vector<std::unique_ptr<PickableCube> >& cubes) noexcept {
+  std::vector<ci::Vec3f> searchAliveCube(const std::vector<FieldSnapshot::Pickable>& cubes) noexcept {
     std::vector<ci::Vec3f> cube_pos;
     cube_pos.reserve(4);
     
     for (const auto& cube : cubes) {
-      if (!cube->isActive() || !cube->isOnStage() || cube->isSleep()) continue;
+      if (!cube.active || !cube.on_stage || cube.sleep) continue;
       
-      cube_pos.push_back(cube->position());
+      cube_pos.push_back(cube.position);
     }
     
     return cube_pos;
   }
 
-  std::vector<ci::Vec3f> searchCubeFromId(const std::vector<std::unique_ptr<PickableCube> >& cubes, const u_int id) noexcept {
+  std::vector<ci::Vec3f> searchCubeFromId(const std::vector<FieldSnapshot::Pickable>& cubes, const u_int id) noexcept {
     std::vector<ci::Vec3f> cube_pos;
 
     for (const auto& cube : cubes) {
-      if (cube->id() == id) {
-        cube_pos.push_back(cube->position());
+      if (cube.id == id) {
+        cube_pos.push_back(cube.position);
         break;
       }
     }
@@ -865,62 +853,58 @@ private:
   }
 
   
-  void drawStageCubes(const std::deque<std::vector<StageCube> >& cubes,
+  // 直前の更新結果との間を補間
+  ci::Vec3f interpolate(const ci::Vec3f& prev, const ci::Vec3f& current) const noexcept {
+    return prev.lerp(interpolation_, current);
+  }
+
+  ci::Quatf interpolate(const ci::Quatf& prev, const ci::Quatf& current) const noexcept {
+    if (interpolation_ >= 1.0f) return current;
+    return prev.slerp(interpolation_, current);
+  }
+
+  
+  void drawStageCubes(const std::vector<FieldSnapshot::StageCube>& cubes,
                       ModelHolder& models,
                       const ci::Frustumf& frustum) noexcept {
     auto& material = materials_.get("stage_cube");
     material.apply();
     
-    const auto& mesh = models.get("stage_cube").mesh();
+    batch_.begin(models.get("stage_cube"));
     
-    for (const auto& row : cubes) {
-      for (const auto& cube : row) {
-        if (!cube.active) continue;
-
-        if (!frustum.intersects(cube.position, ci::Vec3f::one())) continue;
+    for (const auto& cube : cubes) {
+      auto position = interpolate(cube.prev_position, cube.position);
+      if (!frustum.intersects(position, ci::Vec3f::one())) continue;
         
-        ci::gl::color(cube.color);
-
-        ci::gl::pushModelView();
-        ci::gl::translate(cube.position);
-        // TIPS:stagecubeはrotateとscalingが無い
-
-        ci::gl::draw(mesh);
-      
-        ci::gl::popModelView();
-      }
+      // TIPS:stagecubeはrotateとscalingが無い
+      batch_.add(position, cube.color);
     }
+
+    batch_.end();
   }
 
 
-  template<typename T>
-  void drawCubes(const std::vector<T>& cubes,
+  void drawCubes(const std::vector<FieldSnapshot::Cube>& cubes,
                  ModelHolder& models,
                  const std::string& model_name, const std::string& material_name,
-                 std::function<void (const ci::Vec3f& position, const ci::Quatf& rotation, const ci::Vec3f& size)> matrix) noexcept {
+                 std::function<ci::Matrix44f (const ci::Vec3f& position, const ci::Quatf& rotation, const ci::Vec3f& size)> matrix) noexcept {
     auto& material = materials_.get(material_name);
     material.apply();
 
-    const auto& mesh = models.get(model_name).mesh();
+    batch_.begin(models.get(model_name));
 
     for (const auto& cube : cubes) {
-      if (!cube->isActive()) continue;
-
-      ci::gl::color(cube->color());
-      
-      ci::gl::pushModelView();
-
       // TIPS:行列計算は引数で与えられたのを使う
-      matrix(cube->position(), cube->rotation(), cube->size());
+      batch_.add(matrix(interpolate(cube.prev_position, cube.position),
+                        interpolate(cube.prev_rotation, cube.rotation),
+                        cube.size),
+                 cube.color);
+    }
 
-      ci::gl::draw(mesh);
-      
-      ci::gl::popModelView();
-    }    
+    batch_.end();
   }
 
-  template<typename T>
-  void drawCubeShadow(const std::vector<T>& cubes,
+  void drawCubeShadow(const std::vector<FieldSnapshot::Shadow>& shadows,
                       ModelHolder& models,
                       const std::string& model_name, const std::string& material_name) noexcept {
     ci::gl::disableDepthRead();
@@ -931,31 +915,22 @@ private:
     auto& material = materials_.get(material_name);
     material.apply();
 
-    const auto& mesh = models.get(model_name).mesh();
-    for (const auto& cube : cubes) {
-      if (!cube->isActive()) continue;
-
-      auto alpha = cube->shadowAlpha();
-      if (alpha == 0.0f) continue;
-      
-      ci::gl::color(ci::ColorA(0, 0, 0, shadow_alpha_ * alpha));
-
-      ci::gl::pushModelView();
+    batch_.begin(models.get(model_name));
 
+    for (const auto& shadow : shadows) {
       // 位置は、stage cubeの上面
-      auto position = cube->position();
-      ci::gl::translate(ci::Vec3f(position.x, cube->stageHeight(), position.z));
+      auto matrix = ci::Matrix44f::createTranslation(shadow.position);
 
       // 影は、縦方向をぺちゃんこにすればよい
-      ci::gl::scale(1.0f, 0.0f, 1.0f);
+      matrix.scale(ci::Vec3f(1.0f, 0.0f, 1.0f));
       
-      glMultMatrixf(cube->rotation().toMatrix44());
-      ci::gl::scale(cube->size());
+      matrix *= shadow.rotation.toMatrix44();
+      matrix.scale(shadow.size);
 
-      ci::gl::draw(mesh);
-
-      ci::gl::popModelView();
+      batch_.add(matrix, ci::ColorA(0, 0, 0, shadow_alpha_ * shadow.alpha));
     }
+
+    batch_.end();
     
     ci::gl::disable(GL_BLEND);
     ci::gl::enableDepthRead();
@@ -963,42 +938,39 @@ private:
     ci::gl::enable(GL_LIGHTING);
   }
 
-  void drawBgCubes(const std::vector<Bg::Cube>& cubes,
+  void drawBgCubes(const std::vector<FieldSnapshot::BgCube>& cubes,
                    ModelHolder& models) noexcept {
     auto& material = materials_.get("bg_cube");
     material.apply();
 
-    const auto& mesh = models.get("bg_cube").mesh();
+    batch_.begin(models.get("bg_cube"));
     
     for (const auto& cube : cubes) {
-      ci::gl::color(cube.color);
-      
-      ci::gl::pushModelView();
-      ci::gl::translate(cube.position);
-      ci::gl::scale(cube.size);
+      auto matrix = ci::Matrix44f::createTranslation(interpolate(cube.prev_position, cube.position));
+      matrix.scale(cube.size);
 
-      ci::gl::draw(mesh);
-      
-      ci::gl::popModelView();
+      batch_.add(matrix, cube.color);
     }
+
+    batch_.end();
   }
 
   
 #ifdef DEBUG
-  void drawPickableCubesBBox(const std::vector<std::unique_ptr<PickableCube> >& cubes) const noexcept {
+  void drawPickableCubesBBox(const std::vector<FieldSnapshot::Pickable>& cubes) const noexcept {
     ci::gl::color(0, 1, 0);
     
     for (const auto& cube : cubes) {
-      if (!cube->isActive()) continue;
+      if (!cube.active) continue;
 
-      const auto& pos = cube->position();
-      const auto& size = cube->size();
+      const auto& pos = cube.position;
+      const auto& size = cube.size;
       ci::Vec3f half_size = size / 2;
 
-      if (!cube->isAdjoinOther()) {
+      if (!cube.adjoin_other) {
         // 隣接がなければpaddingを加える
         // ※カメラの離れ具合で補正
-        float padding_size = reviseValueByCamera(cube->getPaddingSize());
+        float padding_size = reviseValueByCamera(cube.padding_size);
 
         half_size += ci::Vec3f(padding_size, padding_size, padding_size);
       }
@@ -4,13 +4,25 @@
 // File関連の雑多な処理
 //
 
+#if defined(HEADLESS)
+#include <cinder/Filesystem.h>
+#else
 #include <cinder/app/App.h>
+#endif
 
 
 namespace ngs {
 
 // Fileを書き出すpathを取得
-#if defined(CINDER_COCOA_TOUCH)
+#if defined(HEADLESS)
+
+// Headless実行時は一時ディレクトリに書き出す
+template <typename T = void>
+ci::fs::path getDocumentPath() noexcept {
+  return ci::fs::temp_directory_path();
+}
+
+#elif defined(CINDER_COCOA_TOUCH)
 
 ci::fs::path getDocumentPath() noexcept;
 
@@ -17,6 +17,7 @@
 #include <cinder/ip/Fill.h>
 #include <cinder/ip/Resize.h>
 #include "Utility.hpp"
+#include "Asset.hpp"
 
 
 // VS:FreeType2のライブラリのリンク指定
@@ -75,7 +76,7 @@ public:
     DOUT << "Font()" << std::endl;
     
     auto error = FT_New_Face(creator.handle(),
-                             ci::app::getAssetPath(path).string().c_str(),
+                             Asset::fullPath(path).c_str(),
                              0,
                              &face_);
     if (error) {
@@ -35,14 +35,23 @@ public:
   TextureFont& addFont(const std::string& name, const std::string& path,
                        const int size,
                        const ci::Vec3f& scale, const ci::Vec3f& offset,
-                       const bool mipmap = true) noexcept {
+                       const bool mipmap = true,
+                       const int atlas_size = 1024, const int atlas_padding = 2,
+                       const std::string& baked = std::string()) noexcept {
     auto result = fonts_.emplace(std::piecewise_construct,
                                  std::forward_as_tuple(name),
-                                 std::forward_as_tuple(path, font_creator_, size, scale, offset, mipmap));
+                                 std::forward_as_tuple(path, font_creator_, size, scale, offset, mipmap,
+                                                       atlas_size, atlas_padding));
 
     assert(result.second);
+
+    auto& font = result.first->second;
+    if (!baked.empty()) {
+      // 読み込めなければ、すべての文字をFreeTypeで描く
+      font.loadBaked(baked);
+    }
     
-    return result.first->second;
+    return font;
   }
 
   void setDefaultFont(const std::string& name) noexcept {
@@ -50,6 +59,24 @@ public:
     fonts_.at(name);
     default_font_name_ = name;
   }
+
+
+#ifdef DEBUG
+  // アトラスの使用状況
+  void printStats() const noexcept {
+    for (const auto& font : fonts_) {
+      const auto& stats = font.second.stats();
+      u_int total = stats.hit + stats.miss;
+      DOUT << "font:" << font.first
+           << " hit:" << stats.hit << "/" << total
+           << "(" << (total ? stats.hit * 100.0f / total : 0.0f) << "%)"
+           << " evict:" << stats.evict
+           << " cells:" << stats.used << "/" << stats.capacity
+           << " bytes:" << stats.bytes
+           << std::endl;
+    }
+  }
+#endif
   
 
 private:
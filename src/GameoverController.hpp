@@ -119,7 +119,7 @@ public:
                                   });
     
     // 再開できるかどうかの判断
-    if (boost::any_cast<bool>(event_params.at("can_continue"))) {
+    if (event_params.get<bool>("can_continue")) {
       view_->getWidget("continue").setDisp(true);
       view_->getWidget("continue").setActive(true);
       view_->getWidget("done").setDisp(true);
@@ -130,21 +130,21 @@ public:
     }
 
     
-    auto game_score = boost::any_cast<int>(event_params.at("score"));
+    auto game_score = event_params.get<int>("score");
     view_->getWidget("score-result").setText(toFormatedString(game_score, 5));
-    auto total_items = boost::any_cast<int>(event_params.at("total_items"));
+    auto total_items = event_params.get<int>("total_items");
     GameCenter::submitScore(game_score, total_items);
 
     if (game_score == 0) {
       GameCenter::submitAchievement("BRICKTRIP.ACHIEVEMENT.NO_SCORE");
     }
     
-    if (boost::any_cast<bool>(event_params.at("hi_score"))) {
+    if (event_params.get<bool>("hi_score")) {
       view_->startWidgetTween("tween-hi-score");
     }
     
     view_->startWidgetTween("tween-in");
-    requestSound(event_, params["gameover.jingle-se"].getValue<std::string>());
+    requestSound(event_, getSoundHandle(params["gameover.jingle-se"].getValue<std::string>()));
 
     if (params.hasChild("gameover.active_delay")) {
       view_->setActive(false);
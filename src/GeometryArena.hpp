@@ -0,0 +1,202 @@
+﻿#pragma once
+
+//
+// 全Modelの頂点とindexをまとめたVBO
+//   位置、法線、UVを種類ごとに全Model分並べ、indexは頂点の位置を足して格納する
+//   一度bindすれば、どのModelも範囲を指定するだけで描画できる
+//   TIPS:OpenGL ES 1.1にはbase vertex付きの描画が無いので、indexは16bitに収める
+//
+
+#include <vector>
+#include <cstdint>
+#include <boost/noncopyable.hpp>
+#include <cinder/gl/gl.h>
+#include <cinder/TriMesh.h>
+
+
+namespace ngs {
+
+class GeometryArena : private boost::noncopyable {
+public:
+  struct Range {
+    u_int vertex_offset;
+    u_int vertex_num;
+    u_int index_offset;
+    u_int index_num;
+
+    // グループごとのindexの開始位置(末尾に終端を追加)
+    std::vector<u_int> group_offset;
+  };
+
+
+private:
+  enum {
+    // GL_UNSIGNED_SHORTで扱える数
+    VERTEX_MAX = 0x10000,
+  };
+
+  // 転送するまでの参照
+  std::vector<const ci::TriMesh*> meshes_;
+  std::vector<Range> ranges_;
+
+  u_int vertex_num_;
+  u_int index_num_;
+
+  GLuint vertex_buffer_;
+  GLuint index_buffer_;
+
+
+public:
+  GeometryArena() noexcept :
+    vertex_num_(0),
+    index_num_(0)
+  {
+    glGenBuffers(1, &vertex_buffer_);
+    glGenBuffers(1, &index_buffer_);
+  }
+
+  ~GeometryArena() {
+    glDeleteBuffers(1, &vertex_buffer_);
+    glDeleteBuffers(1, &index_buffer_);
+  }
+
+
+  // TIPS:meshはbuild()まで保持しておくこと
+  u_int add(const ci::TriMesh& mesh, const std::vector<int>& group_face) noexcept {
+    Range range;
+    range.vertex_offset = vertex_num_;
+    range.vertex_num    = u_int(mesh.getNumVertices());
+    range.index_offset  = index_num_;
+    // glDrawArrays向けのデータは連番のindexを用意する
+    range.index_num     = mesh.getIndices().empty() ? range.vertex_num
+                                                    : u_int(mesh.getNumIndices());
+
+    u_int offset = range.index_offset;
+    for (const auto face : group_face) {
+      range.group_offset.push_back(offset);
+      offset += face * 3;
+    }
+    range.group_offset.push_back(offset);
+
+    vertex_num_ += range.vertex_num;
+    index_num_  += range.index_num;
+    assert((vertex_num_ <= VERTEX_MAX) && "too many vertices.");
+
+    meshes_.push_back(&mesh);
+    ranges_.push_back(range);
+
+    return u_int(ranges_.size() - 1);
+  }
+
+  // すべてのModelを追加した後で、まとめて転送する
+  void build() noexcept {
+    const size_t normal_offset = sizeof(ci::Vec3f) * vertex_num_;
+    const size_t uv_offset     = normal_offset * 2;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, uv_offset + sizeof(ci::Vec2f) * vertex_num_, nullptr, GL_STATIC_DRAW);
+
+    std::vector<GLushort> indices;
+    indices.reserve(index_num_);
+
+    // 法線やUVの無いModelは0で埋めておく
+    std::vector<ci::Vec3f> zero(vertex_num_, ci::Vec3f::zero());
+
+    for (size_t i = 0; i < meshes_.size(); ++i) {
+      const auto& mesh  = *meshes_[i];
+      const auto& range = ranges_[i];
+
+      const auto& vertices = mesh.getVertices();
+      const auto& normals  = mesh.getNormals();
+      const auto& coords   = mesh.getTexCoords();
+
+      glBufferSubData(GL_ARRAY_BUFFER,
+                      sizeof(ci::Vec3f) * range.vertex_offset,
+                      sizeof(ci::Vec3f) * range.vertex_num, &vertices[0]);
+      glBufferSubData(GL_ARRAY_BUFFER,
+                      normal_offset + sizeof(ci::Vec3f) * range.vertex_offset,
+                      sizeof(ci::Vec3f) * range.vertex_num,
+                      mesh.hasNormals() ? &normals[0] : &zero[0]);
+      glBufferSubData(GL_ARRAY_BUFFER,
+                      uv_offset + sizeof(ci::Vec2f) * range.vertex_offset,
+                      sizeof(ci::Vec2f) * range.vertex_num,
+                      mesh.hasTexCoords() ? static_cast<const GLvoid*>(&coords[0])
+                                          : static_cast<const GLvoid*>(&zero[0]));
+
+      if (mesh.getIndices().empty()) {
+        for (u_int v = 0; v < range.vertex_num; ++v) {
+          indices.push_back(GLushort(range.vertex_offset + v));
+        }
+      }
+      else {
+        for (const auto index : mesh.getIndices()) {
+          indices.push_back(GLushort(range.vertex_offset + index));
+        }
+      }
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    meshes_.clear();
+
+    DOUT << "GeometryArena:"
+         << " models:" << ranges_.size()
+         << " v:" << vertex_num_
+         << " i:" << index_num_
+         << std::endl;
+  }
+
+
+  const Range& range(const u_int index) const noexcept { return ranges_[index]; }
+
+
+  void bind() noexcept {
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+
+    const size_t normal_offset = sizeof(ci::Vec3f) * vertex_num_;
+    const size_t uv_offset     = normal_offset * 2;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, reinterpret_cast<const GLvoid*>(0));
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, 0, reinterpret_cast<const GLvoid*>(normal_offset));
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, 0, reinterpret_cast<const GLvoid*>(uv_offset));
+  }
+
+  void unbind() noexcept {
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
+
+
+  // bind()してから呼ぶ
+  void draw(const u_int index) noexcept {
+    const auto& r = ranges_[index];
+    drawElements(r.index_offset, r.index_num);
+  }
+
+  void drawGroup(const u_int index, const size_t group) noexcept {
+    const auto& r = ranges_[index];
+    drawElements(r.group_offset[group], r.group_offset[group + 1] - r.group_offset[group]);
+  }
+
+
+private:
+  void drawElements(const u_int offset, const u_int num) noexcept {
+    glDrawElements(GL_TRIANGLES, GLsizei(num), GL_UNSIGNED_SHORT,
+                   reinterpret_cast<const GLvoid*>(sizeof(GLushort) * offset));
+  }
+
+};
+
+}
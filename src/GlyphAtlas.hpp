@@ -0,0 +1,279 @@
+﻿#pragma once
+
+//
+// 文字テクスチャのアトラス
+//   1枚のテクスチャを同じ大きさの枠に分け、文字を詰めて配置する
+//   枠が足りなくなったら、最も長く使われていない文字を追い出す
+//
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+#include <cinder/gl/gl.h>
+#include <cinder/gl/Texture.h>
+#include <cinder/Surface.h>
+#include <cinder/ip/Fill.h>
+
+
+namespace ngs {
+
+class GlyphAtlas : private boost::noncopyable {
+public:
+  struct Stats {
+    u_int hit;
+    u_int miss;
+    u_int evict;
+
+    // 使用中と全体の枠数
+    size_t used;
+    size_t capacity;
+    // テクスチャの大きさ(mipmapは含まない)
+    size_t bytes;
+  };
+
+
+private:
+  enum {
+    NONE = ~0u,
+  };
+
+  int glyph_size_;
+  int padding_;
+  int cell_size_;
+  int columns_;
+  int atlas_size_;
+
+  ci::gl::TextureRef texture_;
+
+  // 書き込み用(枠と同じ大きさ)
+  ci::Surface8u cell_surface_;
+
+  struct Cell {
+    std::string key;
+    ci::Rectf uv;
+
+    // 使用順の双方向リスト(先頭が最新)
+    u_int prev;
+    u_int next;
+  };
+  std::vector<Cell> cells_;
+  u_int used_num_;
+  u_int lru_head_;
+  u_int lru_tail_;
+
+  std::unordered_map<std::string, u_int> index_;
+
+  Stats stats_;
+
+
+public:
+  GlyphAtlas(const int glyph_size, const int atlas_size, const int padding,
+             const bool mipmap) noexcept :
+    glyph_size_(glyph_size),
+    padding_(padding),
+    cell_size_(glyph_size + padding * 2),
+    columns_(atlas_size / cell_size_),
+    atlas_size_(atlas_size),
+    cell_surface_(cell_size_, cell_size_, true, ci::SurfaceChannelOrder::RGBA),
+    used_num_(0),
+    lru_head_(NONE),
+    lru_tail_(NONE)
+  {
+    assert((columns_ > 0) && "atlas is smaller than glyph.");
+
+    ci::gl::Texture::Format format;
+    if (mipmap) {
+      // TIPS:文字はmipmapを利用(縮小時の見栄えが良くなる)
+      format.enableMipmapping();
+    }
+
+    // 透明で初期化
+    ci::Surface8u surface(atlas_size_, atlas_size_, true, ci::SurfaceChannelOrder::RGBA);
+    ci::ip::fill(&surface, ci::ColorAT<uint8_t>(255, 255, 255, 0));
+    texture_ = ci::gl::Texture::create(surface, format);
+    if (mipmap) {
+      texture_->setMinFilter(GL_LINEAR_MIPMAP_NEAREST);
+      texture_->setMagFilter(GL_LINEAR);
+
+      // TIPS:部分更新でもmipmapが作り直されるようにする
+      texture_->bind();
+      glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
+      texture_->unbind();
+    }
+    else {
+      texture_->setMinFilter(GL_LINEAR);
+      texture_->setMagFilter(GL_LINEAR);
+    }
+
+    size_t cell_num = columns_ * columns_;
+    cells_.resize(cell_num);
+    for (size_t i = 0; i < cell_num; ++i) {
+      auto pos = glyphPosition(u_int(i), glyph_size_, atlas_size_, padding_);
+      cells_[i].uv = ci::Rectf(float(pos.x) / atlas_size_,
+                               float(pos.y) / atlas_size_,
+                               float(pos.x + glyph_size_) / atlas_size_,
+                               float(pos.y + glyph_size_) / atlas_size_);
+      cells_[i].prev = NONE;
+      cells_[i].next = NONE;
+    }
+    index_.reserve(cell_num);
+
+    stats_.hit      = 0;
+    stats_.miss     = 0;
+    stats_.evict    = 0;
+    stats_.used     = 0;
+    stats_.capacity = cell_num;
+    stats_.bytes    = atlas_size_ * atlas_size_ * 4;
+
+    DOUT << "GlyphAtlas size:" << atlas_size_ << " cells:" << cell_num << std::endl;
+  }
+
+
+  // 配置済みの文字のUVを返す(無ければnullptr)
+  const ci::Rectf* find(const std::string& key) noexcept {
+    auto it = index_.find(key);
+    if (it == std::end(index_)) {
+      stats_.miss += 1;
+      return nullptr;
+    }
+
+    stats_.hit += 1;
+    touch(it->second);
+    return &cells_[it->second].uv;
+  }
+
+  // 文字を配置してUVを返す
+  // surfaceはglyph_size以下の大きさ
+  const ci::Rectf& insert(const std::string& key, const ci::Surface8u& surface) noexcept {
+    assert((surface.getWidth() <= glyph_size_) && (surface.getHeight() <= glyph_size_));
+    
+    u_int cell;
+    if (used_num_ < cells_.size()) {
+      cell = used_num_;
+      used_num_ += 1;
+    }
+    else {
+      // 最も長く使われていない枠を使い回す
+      cell = lru_tail_;
+      unlink(cell);
+      index_.erase(cells_[cell].key);
+      stats_.evict += 1;
+    }
+
+    cells_[cell].key = key;
+    index_.insert(std::make_pair(key, cell));
+    pushFront(cell);
+    stats_.used = used_num_;
+
+    upload(cell, surface);
+
+    return cells_[cell].uv;
+  }
+
+
+  // 事前に作ったアトラス画像を読み込む
+  // keysの並びが枠の番号
+  bool load(const ci::Surface8u& image, const std::vector<std::string>& keys) noexcept {
+    if ((image.getWidth() != atlas_size_) || (image.getHeight() != atlas_size_)
+        || (keys.size() > cells_.size())) {
+      DOUT << "GlyphAtlas: mismatched image." << std::endl;
+      return false;
+    }
+
+    index_.clear();
+    used_num_ = 0;
+    lru_head_ = NONE;
+    lru_tail_ = NONE;
+    for (const auto& key : keys) {
+      u_int cell = used_num_;
+      used_num_ += 1;
+      
+      cells_[cell].key = key;
+      index_.insert(std::make_pair(key, cell));
+      pushFront(cell);
+    }
+    stats_.used = used_num_;
+
+    // TIPS:画像のチャンネル並びが違う場合もあるので、RGBAに揃えてから転送
+    ci::Surface8u surface(atlas_size_, atlas_size_, true, ci::SurfaceChannelOrder::RGBA);
+    surface.copyFrom(image, image.getBounds());
+
+    texture_->bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlas_size_, atlas_size_,
+                    GL_RGBA, GL_UNSIGNED_BYTE, surface.getData());
+    texture_->unbind();
+
+    return true;
+  }
+
+
+  // 枠の中で文字を置く位置(左上)
+  // TIPS:アトラス画像を作るツールと共通
+  static ci::Vec2i glyphPosition(const u_int cell,
+                                 const int glyph_size, const int atlas_size, const int padding) noexcept {
+    int cell_size = glyph_size + padding * 2;
+    int columns   = atlas_size / cell_size;
+    return ci::Vec2i(int(cell % columns) * cell_size + padding,
+                     int(cell / columns) * cell_size + padding);
+  }
+
+  static size_t cellNum(const int glyph_size, const int atlas_size, const int padding) noexcept {
+    int columns = atlas_size / (glyph_size + padding * 2);
+    return columns * columns;
+  }
+
+
+  const ci::gl::TextureRef& texture() const noexcept { return texture_; }
+  int glyphSize() const noexcept { return glyph_size_; }
+
+  const Stats& stats() const noexcept { return stats_; }
+
+  
+private:
+  void upload(const u_int cell, const ci::Surface8u& surface) noexcept {
+    // 余白ごと書き換えて、追い出した文字を消す
+    ci::ip::fill(&cell_surface_, ci::ColorAT<uint8_t>(255, 255, 255, 0));
+    cell_surface_.copyFrom(surface, surface.getBounds(), ci::Vec2i(padding_, padding_));
+
+    auto pos = glyphPosition(cell, glyph_size_, atlas_size_, padding_);
+    int x = pos.x - padding_;
+    int y = pos.y - padding_;
+
+    // TIPS:描画中に呼ばれるので、バインドしたままにしておく
+    texture_->bind();
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, cell_size_, cell_size_,
+                    GL_RGBA, GL_UNSIGNED_BYTE, cell_surface_.getData());
+  }
+
+  void touch(const u_int cell) noexcept {
+    if (cell == lru_head_) return;
+
+    unlink(cell);
+    pushFront(cell);
+  }
+
+  void pushFront(const u_int cell) noexcept {
+    cells_[cell].prev = NONE;
+    cells_[cell].next = lru_head_;
+    if (lru_head_ != NONE) cells_[lru_head_].prev = cell;
+    lru_head_ = cell;
+    if (lru_tail_ == NONE) lru_tail_ = cell;
+  }
+
+  void unlink(const u_int cell) noexcept {
+    auto& c = cells_[cell];
+    if (c.prev != NONE) cells_[c.prev].next = c.next;
+    else                lru_head_ = c.next;
+    if (c.next != NONE) cells_[c.next].prev = c.prev;
+    else                lru_tail_ = c.prev;
+
+    c.prev = NONE;
+    c.next = NONE;
+  }
+  
+};
+
+}
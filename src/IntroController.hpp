@@ -20,7 +20,7 @@ class IntroController : public ControllerBase {
   bool active_;
 
   float tween_out_delay_;
-  std::string jingle_se_;
+  SoundHandle jingle_se_;
   
   ci::TimelineRef event_timeline_;
   
@@ -36,7 +36,7 @@ public:
     view_(std::move(view)),
     active_(true),
     tween_out_delay_(params["intro.tween_out_delay"].getValue<float>()),
-    jingle_se_(params["intro.jingle-se"].getValue<std::string>()),
+    jingle_se_(getSoundHandle(params["intro.jingle-se"].getValue<std::string>())),
     event_timeline_(ci::Timeline::create())
   {
     DOUT << "IntroController()" << std::endl;
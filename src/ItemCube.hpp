@@ -6,7 +6,9 @@
 
 #include <set>
 #include <boost/noncopyable.hpp>
+#include <cinder/Rand.h>
 #include "TweenUtil.hpp"
+#include "SoundHandle.hpp"
 
 
 namespace ngs {
@@ -14,6 +16,7 @@ namespace ngs {
 class ItemCube : private boost::noncopyable {
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
 
   bool active_;
 
@@ -54,9 +57,11 @@ public:
   ItemCube(ci::JsonTree& params,
            ci::TimelineRef timeline,
            Event<EventParam>& event,
+           ci::Rand& rand,
            const ci::Vec3i& entry_pos) noexcept :
     params_(params),
     event_(event),
+    rand_(rand),
     active_(true),
     id_(getUniqueNumber()),
     color_(Json::getHsvColor(params["game.item.color"])),
@@ -92,7 +97,7 @@ public:
 
     // 登場演出
     auto entry_y = Json::getVec2<float>(params["game.item.entry_y"]);
-    float y = ci::randFloat(entry_y.x, entry_y.y);
+    float y = rand_.nextFloat(entry_y.x, entry_y.y);
     ci::Vec3f start_value(position() + ci::Vec3f(0, y, 0));
     float duration = params["game.item.entry_duration"].getValue<float>();
     auto options = animation_timeline_->apply(&position_,
@@ -109,7 +114,8 @@ public:
         EventParam params = {
           { "block_pos", block_position_ },
         };
-        event_.signal("item-on-stage", params);
+        static const EventId item_on_stage("item-on-stage");
+        event_.signal(item_on_stage, params);
       });
     
     setFloatTween(*animation_timeline_,
@@ -163,12 +169,14 @@ public:
 
     startShadowAlphaTween(0.0f);
 
+    static const SoundHandle item_pickup_se = getSoundHandle("item-pickup");
     EventParam params = {
       { "pos",      position() },
       { "size",     size() },
-      { "sound",    std::string("item-pickup") },
+      { "sound",    item_pickup_se },
     };
-    event_.signal("view-sound", params);
+    static const EventId view_sound("view-sound");
+    event_.signal(view_sound, params);
   }
 
   void moveDown() noexcept {
@@ -0,0 +1,412 @@
+﻿#pragma once
+
+//
+// 依存関係つきの並列処理
+//   work はワーカースレッドで、finish はメインスレッドの update() で実行する
+//   (OpenGLへの転送など、メインスレッドでしかできない処理は finish に書く)
+//   依存先の finish まで終わったら、次のジョブを始める
+//   ジョブごとの所要時間と、依存関係の中で最も長い経路(クリティカルパス)を記録する
+//   すべて終わったら、その回の分を報告して破棄する(番号は使い回さない)
+//   TIPS:add, update, wait, finishNow, cancel はメインスレッドから呼ぶ
+//
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <boost/noncopyable.hpp>
+#include "Profiler.hpp"
+
+
+namespace ngs {
+
+class JobGraph : private boost::noncopyable {
+public:
+  using Work   = std::function<void ()>;
+  using Finish = std::function<void ()>;
+
+
+private:
+  enum State {
+    WAITING,
+    READY,
+    RUNNING,
+    WORKED,
+    DONE,
+  };
+
+  struct Job {
+    std::string name;
+    Work work;
+    Finish finish;
+
+    std::vector<u_int> depends;
+    std::vector<u_int> dependents;
+    u_int remaining;
+
+    State state;
+    bool cancelled;
+
+    // 開始からの経過時間(ms)
+    double ready_time;
+    double work_begin;
+    double work_end;
+    double finish_begin;
+    double finish_end;
+    // 0がメインスレッド
+    u_int thread;
+  };
+
+  // TIPS:ワーカーが参照している間も追加できるように、ポインタで保持
+  //      先頭のジョブの番号が first_id_ で、それより前は破棄済み(終わっている)
+  std::deque<std::unique_ptr<Job> > jobs_;
+  u_int first_id_;
+  // 終わっていないジョブの数
+  u_int unfinished_;
+
+  std::deque<u_int> ready_;
+  std::vector<u_int> worked_;
+
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  std::condition_variable worked_cv_;
+
+  std::vector<std::thread> threads_;
+  bool stop_;
+
+  std::chrono::steady_clock::time_point start_time_;
+
+
+public:
+  // thread_num が0ならCPUの数に合わせる(メインスレッドの分は除く)
+  explicit JobGraph(u_int thread_num = 0) noexcept :
+    first_id_(0),
+    unfinished_(0),
+    stop_(false),
+    start_time_(std::chrono::steady_clock::now())
+  {
+    if (!thread_num) {
+      u_int cpu_num = std::thread::hardware_concurrency();
+      thread_num = std::max(cpu_num, 2u) - 1;
+    }
+
+    DOUT << "JobGraph threads:" << thread_num << std::endl;
+    for (u_int i = 0; i < thread_num; ++i) {
+      threads_.emplace_back([this, i]() { workerMain(i + 1); });
+    }
+  }
+
+  ~JobGraph() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    ready_cv_.notify_all();
+
+    // TIPS:実行中のworkは最後まで処理される
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+
+  // depends のジョブがすべて終わってから実行する
+  u_int add(const std::string& name,
+            Work work, Finish finish = Finish(),
+            const std::vector<u_int>& depends = std::vector<u_int>()) noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    u_int id = first_id_ + u_int(jobs_.size());
+    std::unique_ptr<Job> job(new Job());
+    job->name      = name;
+    job->work      = std::move(work);
+    job->finish    = std::move(finish);
+    job->depends   = depends;
+    job->remaining = 0;
+    job->state     = WAITING;
+    job->cancelled = false;
+    job->ready_time = job->work_begin = job->work_end = job->finish_begin = job->finish_end = 0.0;
+    job->thread    = 0;
+
+    for (auto dep : depends) {
+      assert((dep < id) && "invalid depend job.");
+      if (dep < first_id_) continue;
+
+      auto& d = this->job(dep);
+      if (d.state != DONE) {
+        job->remaining += 1;
+        d.dependents.push_back(id);
+      }
+    }
+
+    jobs_.push_back(std::move(job));
+    unfinished_ += 1;
+    if (!jobs_.back()->remaining) makeReady(id);
+
+    return id;
+  }
+
+  // 終わったworkの後処理をメインスレッドで実行
+  void update() noexcept {
+    PROFILE_ZONE("JobGraph::update");
+
+    while (true) {
+      std::vector<u_int> worked;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::swap(worked, worked_);
+      }
+      if (worked.empty()) break;
+
+      for (auto id : worked) {
+        complete(id);
+      }
+    }
+
+    // すべて終わったら、今回の分を報告して破棄
+    // TIPS:終わっていれば依存待ちのジョブも無い
+    if (!jobs_.empty() && isAllFinished()) {
+      printTimings();
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      first_id_ += u_int(jobs_.size());
+      jobs_.clear();
+    }
+  }
+
+  // 指定したジョブが終わるまで待つ
+  // 待っている間、メインスレッドも実行待ちのworkを処理する
+  void wait(const std::vector<u_int>& ids) noexcept {
+    while (true) {
+      update();
+      if (isFinished(ids)) break;
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (!ready_.empty()) {
+        auto id = ready_.front();
+        ready_.pop_front();
+        runWork(id, 0, lock);
+      }
+      else {
+        worked_cv_.wait(lock, [this]() { return !worked_.empty(); });
+      }
+    }
+  }
+
+  void wait(const u_int id) noexcept {
+    wait(std::vector<u_int>(1, id));
+  }
+
+  // 指定したジョブだけを終わらせる(他のジョブの work や finish は実行しない)
+  // 実行待ちならメインスレッドで実行し、実行中なら終わるのを待つ
+  // TIPS:依存先の無いジョブ用。finish もここで実行する
+  void finishNow(const u_int id) noexcept {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (isDone(id)) return;
+
+      auto& job = this->job(id);
+      assert((job.state != WAITING) && "job has pending depends.");
+
+      if (job.state == READY) {
+        auto it = std::find(std::begin(ready_), std::end(ready_), id);
+        if (it != std::end(ready_)) {
+          ready_.erase(it);
+          runWork(id, 0, lock);
+        }
+      }
+      worked_cv_.wait(lock, [&job]() { return job.state == WORKED; });
+
+      // update() で二重に後処理しないよう取り除く
+      worked_.erase(std::remove(std::begin(worked_), std::end(worked_), id), std::end(worked_));
+    }
+
+    complete(id);
+  }
+
+  // 中止したジョブは finish を実行しない
+  // TIPS:finish で参照しているオブジェクトを破棄する時に呼ぶ
+  void cancel(const u_int id) noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id < first_id_) return;
+    job(id).cancelled = true;
+  }
+
+
+  bool isFinished(const u_int id) noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return isDone(id);
+  }
+
+  bool isFinished(const std::vector<u_int>& ids) noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::all_of(std::begin(ids), std::end(ids),
+                       [this](const u_int id) { return isDone(id); });
+  }
+
+  bool isAllFinished() noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return unfinished_ == 0;
+  }
+
+  u_int threadNum() const noexcept { return u_int(threads_.size()); }
+
+
+  // 破棄していないジョブの時間とクリティカルパス
+  void printTimings() noexcept {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // TIPS:依存先は必ず先に追加されているので、番号順に求めれば良い
+    //      添え字は first_id_ からの相対値
+    std::vector<double> path_time(jobs_.size(), 0.0);
+    std::vector<int> path_prev(jobs_.size(), -1);
+    int last = -1;
+    double begin_time = jobs_.empty() ? 0.0 : jobs_.front()->ready_time;
+    double end_time = 0.0;
+    for (u_int id = 0; id < jobs_.size(); ++id) {
+      const auto& job = *jobs_[id];
+      for (auto dep_id : job.depends) {
+        // 前回までに終わったものは含めない
+        if (dep_id < first_id_) continue;
+
+        auto dep = dep_id - first_id_;
+        if (path_time[dep] > path_time[id]) {
+          path_time[id] = path_time[dep];
+          path_prev[id] = int(dep);
+        }
+      }
+      path_time[id] += (job.work_end - job.work_begin) + (job.finish_end - job.finish_begin);
+      if ((last < 0) || (path_time[id] > path_time[last])) last = int(id);
+
+      begin_time = std::min(begin_time, job.ready_time);
+      end_time   = std::max(end_time, job.finish_end);
+
+      DOUT << "job:" << job.name
+           << " thread:" << job.thread
+           << " wait:" << (job.work_begin - job.ready_time) << "ms"
+           << " work:" << (job.work_end - job.work_begin) << "ms"
+           << " main:" << (job.finish_end - job.finish_begin) << "ms"
+           << " end:" << job.finish_end << "ms"
+           << (job.cancelled ? " (cancelled)" : "")
+           << std::endl;
+    }
+    if (last < 0) return;
+
+    std::string path;
+    for (int id = last; id >= 0; id = path_prev[id]) {
+      path = jobs_[id]->name + (path.empty() ? "" : " > ") + path;
+    }
+    DOUT << "jobs:" << jobs_.size()
+         << " total:" << (end_time - begin_time) << "ms"
+         << " critical path:" << path_time[last] << "ms (" << path << ")"
+         << std::endl;
+  }
+
+
+private:
+  // mutex_ をロックしてから呼ぶ
+  Job& job(const u_int id) noexcept {
+    assert((id >= first_id_) && "job already released.");
+    return *jobs_[id - first_id_];
+  }
+
+  bool isDone(const u_int id) noexcept {
+    return (id < first_id_) || (job(id).state == DONE);
+  }
+
+  double elapsedTime() const noexcept {
+    using ms = std::chrono::duration<double, std::milli>;
+    return ms(std::chrono::steady_clock::now() - start_time_).count();
+  }
+
+  // mutex_ をロックしてから呼ぶ
+  void makeReady(const u_int id) noexcept {
+    auto& job = this->job(id);
+    job.state      = READY;
+    job.ready_time = elapsedTime();
+
+    if (job.work && !job.cancelled) {
+      ready_.push_back(id);
+      ready_cv_.notify_one();
+    }
+    else {
+      // workが無ければすぐに後処理へ
+      job.work_begin = job.work_end = job.ready_time;
+      job.state = WORKED;
+      worked_.push_back(id);
+      worked_cv_.notify_all();
+    }
+  }
+
+  // mutex_ をロックしてから呼ぶ(work の実行中はロックを外す)
+  void runWork(const u_int id, const u_int thread, std::unique_lock<std::mutex>& lock) noexcept {
+    auto& job = this->job(id);
+    job.state      = RUNNING;
+    job.thread     = thread;
+    job.work_begin = elapsedTime();
+
+    auto work = std::move(job.work);
+    if (!job.cancelled) {
+      lock.unlock();
+      {
+        // TIPS:Profilerは名前のポインタを保持するので、解放されるjob.nameは使わない
+        PROFILE_ZONE("JobGraph::job");
+        work();
+      }
+      lock.lock();
+    }
+
+    job.work_end = elapsedTime();
+    job.state    = WORKED;
+    worked_.push_back(id);
+    worked_cv_.notify_all();
+  }
+
+  void complete(const u_int id) noexcept {
+    Finish finish;
+    bool cancelled;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& job = this->job(id);
+      finish    = std::move(job.finish);
+      cancelled = job.cancelled;
+      job.finish_begin = elapsedTime();
+    }
+
+    // TIPS:finish の中で add を呼べるように、ロックを外しておく
+    if (finish && !cancelled) finish();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& job = this->job(id);
+    job.finish_end = elapsedTime();
+    job.state      = DONE;
+    unfinished_ -= 1;
+
+    for (auto dep : job.dependents) {
+      auto& d = this->job(dep);
+      d.remaining -= 1;
+      if (!d.remaining) makeReady(dep);
+    }
+  }
+
+  void workerMain(const u_int thread) noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      ready_cv_.wait(lock, [this]() { return stop_ || !ready_.empty(); });
+      if (stop_) break;
+
+      auto id = ready_.front();
+      ready_.pop_front();
+      runWork(id, thread, lock);
+    }
+  }
+
+};
+
+}
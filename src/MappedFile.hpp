@@ -0,0 +1,160 @@
+﻿#pragma once
+
+//
+// 読み込み専用のファイルをメモリにマップする
+//   マップできない環境では、全体を読み込んで代用する
+//
+
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <boost/noncopyable.hpp>
+
+#if defined(CINDER_MSW)
+// TIPS:std::min/maxと衝突させない
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace ngs {
+
+class MappedFile : private boost::noncopyable {
+  const char* data_;
+  size_t size_;
+
+#if defined(CINDER_MSW)
+  HANDLE file_;
+  HANDLE mapping_;
+  LPVOID view_;
+#else
+  void* mapped_;
+#endif
+
+  // マップできなかった時やメモリ上で作ったデータ
+  std::string bytes_;
+
+
+public:
+  explicit MappedFile(const std::string& path) noexcept :
+    data_(nullptr),
+    size_(0)
+#if defined(CINDER_MSW)
+    , file_(INVALID_HANDLE_VALUE),
+    mapping_(nullptr),
+    view_(nullptr)
+#else
+    , mapped_(nullptr)
+#endif
+  {
+    if (!map(path)) {
+      DOUT << "MappedFile: can't map " << path << std::endl;
+      read(path);
+    }
+  }
+
+  // TIPS:メモリ上のデータも同じように扱う
+  struct InMemory {};
+
+  MappedFile(InMemory, std::string bytes) noexcept :
+#if defined(CINDER_MSW)
+    file_(INVALID_HANDLE_VALUE),
+    mapping_(nullptr),
+    view_(nullptr),
+#else
+    mapped_(nullptr),
+#endif
+    bytes_(std::move(bytes))
+  {
+    data_ = bytes_.data();
+    size_ = bytes_.size();
+  }
+
+  ~MappedFile() {
+#if defined(CINDER_MSW)
+    if (view_) UnmapViewOfFile(view_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+    if (mapped_) munmap(mapped_, size_);
+#endif
+  }
+
+
+  const char* data() const noexcept { return data_; }
+  size_t size() const noexcept { return size_; }
+
+#if defined(CINDER_MSW)
+  bool isMapped() const noexcept { return view_ != nullptr; }
+#else
+  bool isMapped() const noexcept { return mapped_ != nullptr; }
+#endif
+
+
+private:
+#if defined(CINDER_MSW)
+
+  bool map(const std::string& path) noexcept {
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || !size.QuadPart) return false;
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) return false;
+
+    view_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (!view_) return false;
+
+    data_ = static_cast<const char*>(view_);
+    size_ = size_t(size.QuadPart);
+    return true;
+  }
+
+#else
+
+  bool map(const std::string& path) noexcept {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if ((fstat(fd, &st) < 0) || !st.st_size) {
+      close(fd);
+      return false;
+    }
+
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // TIPS:マップした後はファイルを閉じても良い
+    close(fd);
+    if (mapped == MAP_FAILED) return false;
+
+    mapped_ = mapped;
+    data_   = static_cast<const char*>(mapped);
+    size_   = size_t(st.st_size);
+    return true;
+  }
+
+#endif
+
+  void read(const std::string& path) noexcept {
+    std::ifstream fstr(path, std::ios::binary);
+    if (!fstr) return;
+
+    bytes_.assign(std::istreambuf_iterator<char>(fstr),
+                  std::istreambuf_iterator<char>());
+    data_ = bytes_.data();
+    size_ = bytes_.size();
+  }
+
+};
+
+}
@@ -0,0 +1,291 @@
+﻿#pragma once
+
+//
+// Modelのバイナリ形式(.mesh)
+//   固定長のヘッダ、頂点、index(16bit)、グループごとの面数を並べる
+//   頂点はGeometryArenaと同じ並び(位置、法線、UVの順に種類ごと)で格納し、
+//   マップした領域から種類ごとにそのまま複製する
+//   元の.objのサイズとハッシュ値を持ち、.objが変わっていたら使わない
+//   TIPS:起動時はサイズだけを比べ、中身はDEBUGビルドとビルド時の meshc -c で比べる
+//   TIPS:対象環境はすべてリトルエンディアン
+//
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <boost/range/iterator_range.hpp>
+#include <cinder/TriMesh.h>
+#include <cinder/ObjLoader.h>
+#include "Utility.hpp"
+#include "MappedFile.hpp"
+
+
+namespace ngs {
+
+namespace MeshFormat {
+
+enum {
+  // "BTMS"
+  MAGIC   = 0x534d5442,
+  VERSION = 1,
+};
+
+enum {
+  HAS_NORMALS = 1 << 0,
+  HAS_UVS     = 1 << 1,
+  HAS_INDICES = 1 << 2,
+};
+
+
+// 先頭からのbyte位置と要素数
+struct Table {
+  u_int offset;
+  u_int num;
+};
+
+struct Header {
+  u_int magic;
+  u_int version;
+  u_int size;
+  u_int flags;
+
+  // 変換元の.obj
+  u_int source_size;
+  u_int source_hash;
+
+  u_int vertex_num;
+  // 位置、法線、UVを種類ごとに並べたもの(numはbyte数)
+  Table vertices;
+  Table indices;
+  Table group_faces;
+};
+
+
+// .objを読み込み、描画に使う形に揃える
+void loadObj(const ci::DataSourceRef& source,
+             const bool has_normals, const bool has_uv, const bool has_indices,
+             ci::TriMesh& mesh, std::vector<int>& group_face) noexcept {
+  ci::ObjLoader loader(source);
+  loader.load(&mesh);
+
+  //glDrawArrays向けのデータ
+  if (!has_indices) {
+    ci::TriMesh mesh_new;
+      
+    const auto& vertices = mesh.getVertices();
+    const auto& normals  = mesh.getNormals();
+    const auto& coords   = mesh.getTexCoords();
+    const auto& indices  = mesh.getIndices();
+
+    for (const auto index : indices) {
+      mesh_new.appendVertex(vertices[index]);
+      mesh_new.appendNormal(normals[index]);
+      mesh_new.appendTexCoord(coords[index]);
+    }
+      
+    std::swap(mesh, mesh_new);
+  }
+    
+  if (!has_normals) {
+    mesh.getNormals().clear();
+  }
+  if (!has_uv) {
+    mesh.getTexCoords().clear();
+  }
+
+  const auto& groups = loader.getGroups();
+  group_face.clear();
+  group_face.reserve(groups.size());
+  for (const auto& g : groups) {
+    group_face.push_back(int(g.mFaces.size()));
+  }
+}
+
+
+// TriMeshから変換
+std::string compile(const ci::TriMesh& mesh, const std::vector<int>& group_face,
+                    const std::string& source) noexcept {
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+
+  header.magic   = MAGIC;
+  header.version = VERSION;
+
+  header.source_size = u_int(source.size());
+  header.source_hash = hashBytes(source.data(), source.size());
+
+  const auto& vertices = mesh.getVertices();
+  const auto& normals  = mesh.getNormals();
+  const auto& coords   = mesh.getTexCoords();
+  const auto& indices  = mesh.getIndices();
+
+  // OpenGL ES はindexはshort型
+  assert((vertices.size() <= 0x10000) && "too many vertices.");
+
+  if (mesh.hasNormals())   header.flags |= HAS_NORMALS;
+  if (mesh.hasTexCoords()) header.flags |= HAS_UVS;
+  if (!indices.empty())    header.flags |= HAS_INDICES;
+
+  header.vertex_num = u_int(vertices.size());
+
+  std::vector<uint16_t> indices16(std::begin(indices), std::end(indices));
+  std::vector<int32_t> faces(std::begin(group_face), std::end(group_face));
+
+  // ヘッダの後ろにテーブルを並べる
+  std::string output(sizeof(Header), 0);
+
+  auto align = [&output]() {
+    // 4byte境界に揃える
+    output.resize((output.size() + 3) & ~size_t(3), 0);
+  };
+  auto append = [&output](const void* data, const size_t size) {
+    if (size) output.append(static_cast<const char*>(data), size);
+  };
+
+  header.vertices.offset = u_int(output.size());
+  append(vertices.data(), sizeof(ci::Vec3f) * vertices.size());
+  if (mesh.hasNormals())   append(normals.data(), sizeof(ci::Vec3f) * normals.size());
+  if (mesh.hasTexCoords()) append(coords.data(), sizeof(ci::Vec2f) * coords.size());
+  header.vertices.num = u_int(output.size() - header.vertices.offset);
+  align();
+
+  header.indices.offset = u_int(output.size());
+  header.indices.num    = u_int(indices16.size());
+  append(indices16.data(), sizeof(uint16_t) * indices16.size());
+  align();
+
+  header.group_faces.offset = u_int(output.size());
+  header.group_faces.num    = u_int(faces.size());
+  append(faces.data(), sizeof(int32_t) * faces.size());
+  align();
+
+  header.size = u_int(output.size());
+  std::memcpy(&output[0], &header, sizeof(header));
+
+  return output;
+}
+
+}
+
+
+// 変換済みのModel
+//   中身はマップしたファイルかメモリ上のデータを直接参照する
+class CompiledMesh {
+  std::shared_ptr<MappedFile> file_;
+  const MeshFormat::Header* header_;
+
+
+public:
+  explicit CompiledMesh(std::shared_ptr<MappedFile> file) noexcept :
+    file_(std::move(file)),
+    header_(reinterpret_cast<const MeshFormat::Header*>(file_->data()))
+  {}
+
+  explicit CompiledMesh(std::string bytes) noexcept :
+    CompiledMesh(std::make_shared<MappedFile>(MappedFile::InMemory(), std::move(bytes)))
+  {}
+
+
+  // TIPS:壊れたファイルや古いファイルを範囲外まで読まないよう、
+  //      すべてのテーブルとindexの範囲を調べる
+  bool isValid() const noexcept {
+    if (!header_
+        || (file_->size() < sizeof(MeshFormat::Header))
+        || (header_->magic != MeshFormat::MAGIC)
+        || (header_->version != MeshFormat::VERSION)
+        || (header_->size != file_->size())) return false;
+
+    const auto& h = *header_;
+    uint64_t vertex_size = sizeof(ci::Vec3f)
+                         + (hasNormals() ? sizeof(ci::Vec3f) : 0)
+                         + (hasTexCoords() ? sizeof(ci::Vec2f) : 0);
+    if ((vertex_size * h.vertex_num != h.vertices.num)
+        || !inRange(h.vertices,    1)
+        || !inRange(h.indices,     sizeof(uint16_t))
+        || !inRange(h.group_faces, sizeof(int32_t))) return false;
+
+    for (auto index : indices()) {
+      if (index >= h.vertex_num) return false;
+    }
+    return true;
+  }
+
+  // 読み込み時の指定と変換元のサイズが一致しているか
+  bool isMatch(const bool has_normals, const bool has_uv, const bool has_indices,
+               const u_int source_size) const noexcept {
+    return isValid()
+      && (hasNormals() == has_normals)
+      && (hasTexCoords() == has_uv)
+      && (hasIndices() == has_indices)
+      && (header_->source_size == source_size);
+  }
+
+  // 変換元の中身まで一致しているか
+  // TIPS:編集してもサイズが変わらない場合があるので、中身のハッシュ値も比べる
+  bool isMatch(const bool has_normals, const bool has_uv, const bool has_indices,
+               const std::string& source) const noexcept {
+    return isMatch(has_normals, has_uv, has_indices, u_int(source.size()))
+      && (header_->source_hash == hashBytes(source.data(), source.size()));
+  }
+
+  const MeshFormat::Header& header() const noexcept { return *header_; }
+
+  bool hasNormals() const noexcept { return header_->flags & MeshFormat::HAS_NORMALS; }
+  bool hasTexCoords() const noexcept { return header_->flags & MeshFormat::HAS_UVS; }
+  bool hasIndices() const noexcept { return header_->flags & MeshFormat::HAS_INDICES; }
+
+  size_t vertexNum() const noexcept { return header_->vertex_num; }
+
+  // 種類ごとに並べた頂点データ
+  const char* vertexData() const noexcept { return file_->data() + header_->vertices.offset; }
+  size_t vertexDataSize() const noexcept { return header_->vertices.num; }
+
+  boost::iterator_range<const ci::Vec3f*> positions() const noexcept {
+    return vertexTable<ci::Vec3f>(0);
+  }
+
+  boost::iterator_range<const ci::Vec3f*> normals() const noexcept {
+    if (!hasNormals()) return boost::iterator_range<const ci::Vec3f*>();
+    return vertexTable<ci::Vec3f>(sizeof(ci::Vec3f) * vertexNum());
+  }
+
+  boost::iterator_range<const ci::Vec2f*> texCoords() const noexcept {
+    if (!hasTexCoords()) return boost::iterator_range<const ci::Vec2f*>();
+    size_t offset = (hasNormals() ? 2 : 1) * sizeof(ci::Vec3f) * vertexNum();
+    return vertexTable<ci::Vec2f>(offset);
+  }
+
+  boost::iterator_range<const uint16_t*> indices() const noexcept {
+    return table<uint16_t>(header_->indices);
+  }
+
+  boost::iterator_range<const int32_t*> groupFaces() const noexcept {
+    return table<int32_t>(header_->group_faces);
+  }
+
+
+private:
+  // テーブルがヘッダより後ろ、ファイルの内側に収まっているか
+  bool inRange(const MeshFormat::Table& t, const size_t element_size) const noexcept {
+    return (t.offset >= sizeof(MeshFormat::Header))
+      && !(t.offset & 3)
+      && (uint64_t(t.offset) + uint64_t(t.num) * element_size <= file_->size());
+  }
+
+  template <typename T>
+  boost::iterator_range<const T*> table(const MeshFormat::Table& t) const noexcept {
+    const T* top = reinterpret_cast<const T*>(file_->data() + t.offset);
+    return boost::make_iterator_range(top, top + t.num);
+  }
+
+  template <typename T>
+  boost::iterator_range<const T*> vertexTable(const size_t offset) const noexcept {
+    const T* top = reinterpret_cast<const T*>(vertexData() + offset);
+    return boost::make_iterator_range(top, top + vertexNum());
+  }
+
+};
+
+}
@@ -2,86 +2,99 @@
 
 //
 // .obj保持
+//   変換済みの.meshがあればそちらを読み込む
+//   描画用の頂点はModelHolderがGeometryArenaにまとめて転送する
 //
 
 #include <boost/noncopyable.hpp>
 #include <cinder/TriMesh.h>
-#include <cinder/ObjLoader.h>
-#include <cinder/gl/Vbo.h>
+#include "Utility.hpp"
 #include "Asset.hpp"
+#include "MeshFormat.hpp"
 
 
 namespace ngs {
 
 class Model : private boost::noncopyable {
-  ci::gl::VboMeshRef mesh_;
+  // まとめて描画する時にCPU側で変換する
+  ci::TriMesh tri_mesh_;
 
   std::vector<int> group_face_;
 
+  // GeometryArena内の番号
+  u_int arena_index_;
+
 
 public:
   Model(const std::string& path,
         const bool has_normals = true, const bool has_uv = true,
-        const bool has_indics = true) noexcept {
-    ci::ObjLoader loader(Asset::load(path));
-
-    ci::TriMesh mesh;
-    loader.load(&mesh);
-
-    //glDrawArrays向けのデータ
-    if (!has_indics) {
-      ci::TriMesh mesh_new;
-      
-      const auto& vertices = mesh.getVertices();
-      const auto& normals  = mesh.getNormals();
-      const auto& coords   = mesh.getTexCoords();
-      const auto& indices  = mesh.getIndices();
-
-      for (const auto index : indices) {
-        mesh_new.appendVertex(vertices[index]);
-        mesh_new.appendNormal(normals[index]);
-        mesh_new.appendTexCoord(coords[index]);
-      }
-      
-      std::swap(mesh, mesh_new);
-    }
-    
-    if (!has_normals) {
-      mesh.getNormals().clear();
-    }
-    if (!has_uv) {
-      mesh.getTexCoords().clear();
+        const bool has_indics = true) noexcept :
+    arena_index_(0)
+  {
+    if (!loadCompiled(path, has_normals, has_uv, has_indics)) {
+      loadObj(path, has_normals, has_uv, has_indics);
     }
 
-    const auto& groups = loader.getGroups();
-    
     DOUT << "model:" << path
-         << " v:" << mesh.getVertices().size()
-         << " n:" << mesh.getNormals().size()
-         << " t:" << mesh.getTexCoords().size()
-         << " i:" << mesh.getIndices().size()
-         << " g:" << groups.size()
+         << " v:" << tri_mesh_.getVertices().size()
+         << " n:" << tri_mesh_.getNormals().size()
+         << " t:" << tri_mesh_.getTexCoords().size()
+         << " i:" << tri_mesh_.getIndices().size()
+         << " g:" << group_face_.size()
          << std::endl;
-
-    group_face_.reserve(groups.size());
-    for (const auto& g : groups) {
-      group_face_.push_back(int(g.mFaces.size()));
-      DOUT << "face:"
-           <<  g.mFaces.size()
-           << std::endl;
-    }
-    
-    mesh_ = ci::gl::VboMesh::create(mesh);
   }
   
 
-  const ci::gl::VboMesh& mesh() const noexcept { return *mesh_; }
+  const ci::TriMesh& triMesh() const noexcept { return tri_mesh_; }
+  const std::vector<int>& groupFaces() const noexcept { return group_face_; }
   int getGroupFaces(const size_t index) const noexcept { return group_face_[index]; }
+
+  u_int arenaIndex() const noexcept { return arena_index_; }
+  void setArenaIndex(const u_int index) noexcept { arena_index_ = index; }
   
 
 private:
+  void loadObj(const std::string& path,
+               const bool has_normals, const bool has_uv,
+               const bool has_indics) noexcept {
+    MeshFormat::loadObj(Asset::load(path), has_normals, has_uv, has_indics,
+                        tri_mesh_, group_face_);
+  }
 
-  
+  // 変換済みの.meshをマップして、そのまま複製する
+  // TIPS:.objを毎回読まないよう、通常はサイズだけを比べる
+  //      中身の比較はビルド時に meshc -c で行い、DEBUGビルドでは起動時にも行う
+  bool loadCompiled(const std::string& path,
+                    const bool has_normals, const bool has_uv,
+                    const bool has_indics) noexcept {
+    auto mesh_path = Asset::fullPath(replaceFilenameExt(path, "mesh"));
+    if (!isValidPath(mesh_path)) return false;
+
+    CompiledMesh compiled(std::make_shared<MappedFile>(mesh_path));
+#ifdef DEBUG
+    auto source = readFile(Asset::fullPath(path));
+#else
+    auto source = fileSize(Asset::fullPath(path));
+#endif
+    if (!compiled.isMatch(has_normals, has_uv, has_indics, source)) {
+      DOUT << "model:" << mesh_path << " is out of date." << std::endl;
+      return false;
+    }
+
+    const auto& positions = compiled.positions();
+    const auto& normals   = compiled.normals();
+    const auto& coords    = compiled.texCoords();
+    const auto& indices   = compiled.indices();
+    tri_mesh_.getVertices().assign(std::begin(positions), std::end(positions));
+    tri_mesh_.getNormals().assign(std::begin(normals), std::end(normals));
+    tri_mesh_.getTexCoords().assign(std::begin(coords), std::end(coords));
+    tri_mesh_.getIndices().assign(std::begin(indices), std::end(indices));
+
+    const auto& faces = compiled.groupFaces();
+    group_face_.assign(std::begin(faces), std::end(faces));
+
+    return true;
+  }
   
 };
 
@@ -2,17 +2,23 @@
 
 //
 // Modelを名前で管理
+//   頂点は全ModelをGeometryArenaにまとめて描画する
 //
 
 #include "Model.hpp"
+#include "GeometryArena.hpp"
 #include <boost/noncopyable.hpp>
 #include <map>
+#include <memory>
 
 
 namespace ngs {
 
 class ModelHolder : private boost::noncopyable {
-  std::map<std::string, Model> models_;
+  // TIPS:別スレッドで読み込んだModelを後から登録するのでstd::unique_ptrで保持
+  using ModelPtr = std::unique_ptr<Model>;
+  std::map<std::string, ModelPtr> models_;
+  GeometryArena arena_;
   
 
 public:
@@ -22,16 +28,27 @@ public:
   void add(const std::string& name, const std::string& path,
            const bool has_normals = true, const bool has_uvs = true,
            const bool has_indices = true) noexcept {
-    models_.emplace(std::piecewise_construct,
-                    std::forward_as_tuple(name),
-                    std::forward_as_tuple(path, has_normals, has_uvs, has_indices));
+    add(name, ModelPtr(new Model(path, has_normals, has_uvs, has_indices)));
+  }
+
+  // 読み込み済みのModelを登録
+  void add(const std::string& name, ModelPtr model) noexcept {
+    model->setArenaIndex(arena_.add(model->triMesh(), model->groupFaces()));
+    models_.insert({ name, std::move(model) });
+  }
+
+  // すべて追加した後で呼ぶ
+  void build() noexcept {
+    arena_.build();
   }
 
   
   const Model& get(const std::string& name) const noexcept {
-    return models_.at(name);
+    return *models_.at(name);
   }
 
+  GeometryArena& arena() noexcept { return arena_; }
+
   
 private:
 
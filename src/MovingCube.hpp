@@ -9,6 +9,7 @@
 #include <cinder/Rand.h>
 #include "EasingUtil.hpp"
 #include "Utility.hpp"
+#include "SoundHandle.hpp"
 
 namespace ngs {
 
@@ -27,6 +28,7 @@ class MovingCube : private boost::noncopyable {
 
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
   
   bool active_;
 
@@ -75,10 +77,12 @@ public:
   MovingCube(ci::JsonTree& params,
              ci::TimelineRef timeline,
              Event<EventParam>& event,
+             ci::Rand& rand,
              const ci::Vec3i& entry_pos,
              const std::vector<int>& move_pattern) noexcept :
     params_(params),
     event_(event),
+    rand_(rand),
     active_(true),
     id_(getUniqueNumber()),
     color_(Json::getColor<float>(params["game.moving.color"])),
@@ -129,7 +133,7 @@ public:
 
     // 登場演出
     auto entry_y = Json::getVec2<float>(params["game.moving.entry_y"]);
-    float y = ci::randFloat(entry_y.x, entry_y.y);
+    float y = rand_.nextFloat(entry_y.x, entry_y.y);
     ci::Vec3f start_value(position() + ci::Vec3f(0, y, 0));
     auto options = animation_timeline_->apply(&position_,
                                               start_value, position_(),
@@ -143,7 +147,8 @@ public:
           { "id", id_ },
           { "block_pos", block_position_ },
         };
-        event_.signal("moving-on-stage", params);
+        static const EventId moving_on_stage("moving-on-stage");
+        event_.signal(moving_on_stage, params);
       });
   }
     
@@ -245,11 +250,11 @@ public:
         moving_    = false;
         stop_time_ = 0.0f;
 
-        std::string sound_tbl[] = {
-          "moving-up",
-          "moving-down",
-          "moving-left",
-          "moving-right",
+        static const SoundHandle sound_tbl[] = {
+          getSoundHandle("moving-up"),
+          getSoundHandle("moving-down"),
+          getSoundHandle("moving-left"),
+          getSoundHandle("moving-right"),
         };
         
         EventParam params = {
@@ -259,8 +264,10 @@ public:
           { "size",      size() },
           { "sound",     sound_tbl[move_direction_] },
         };
-        event_.signal("moving-moved", params);
-        event_.signal("view-sound", params);
+        static const EventId moving_moved("moving-moved");
+        static const EventId view_sound("view-sound");
+        event_.signal(moving_moved, params);
+        event_.signal(view_sound, params);
       });
 
     animation_timeline_->add([this]() noexcept {
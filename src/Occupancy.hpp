@@ -0,0 +1,176 @@
+﻿#pragma once
+
+//
+// Block位置からCubeを引くための占有グリッド
+//   zはStageの有効範囲に追従する環状バッファ
+//   xは固定幅で折り返すので、判定は呼び出し側の条件で確定させる
+//
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <boost/noncopyable.hpp>
+#include <cinder/Vector.h>
+
+
+namespace ngs {
+
+template <typename T>
+class BlockGrid : private boost::noncopyable {
+  enum {
+    WIDTH_BITS = 5,
+    WIDTH      = 1 << WIDTH_BITS,
+    WIDTH_MASK = WIDTH - 1,
+
+    DEPTH_MIN = 64,
+  };
+
+  // 登録中の位置(現在位置と、移動中なら直前の位置)
+  struct Entry {
+    ci::Vec2i cell[2];
+    int num;
+  };
+
+  std::vector<std::vector<T*> > cells_;
+  std::unordered_map<T*, Entry> entries_;
+
+  int depth_;
+
+
+public:
+  BlockGrid() noexcept :
+    depth_(DEPTH_MIN)
+  {
+    cells_.resize(WIDTH * depth_);
+    entries_.reserve(64);
+  }
+
+
+  // Stageの有効範囲に合わせてzの幅を広げる
+  void setWindow(const int bottom_z, const int top_z) noexcept {
+    int span = top_z - bottom_z + 1;
+    if (span <= depth_) return;
+
+    int depth = depth_;
+    while (depth < span) depth *= 2;
+
+    resize(depth);
+  }
+
+  // 現在位置を登録
+  void update(T& object, const ci::Vec3i& pos) noexcept {
+    Entry entry = { { ci::Vec2i(pos.x, pos.z), ci::Vec2i(pos.x, pos.z) }, 1 };
+    update(&object, entry);
+  }
+
+  // 移動中は直前の位置も登録
+  void update(T& object, const ci::Vec3i& pos, const ci::Vec3i& prev_pos) noexcept {
+    Entry entry = { { ci::Vec2i(pos.x, pos.z), ci::Vec2i(prev_pos.x, prev_pos.z) }, 2 };
+    if (entry.cell[0] == entry.cell[1]) entry.num = 1;
+    update(&object, entry);
+  }
+
+  void remove(T& object) noexcept {
+    auto it = entries_.find(&object);
+    if (it == std::end(entries_)) return;
+
+    removeCells(&object, it->second);
+    entries_.erase(it);
+  }
+
+  void clear() noexcept {
+    for (auto& cell : cells_) {
+      cell.clear();
+    }
+    entries_.clear();
+  }
+
+  // 指定位置に登録されているCubeから、条件を満たす最初のものを返す
+  // TIPS:xとzが折り返すので、位置の一致はpredで判定する
+  template <typename F>
+  T* find(const ci::Vec3i& pos, F pred) const noexcept {
+    for (auto* object : cells_[index(pos.x, pos.z)]) {
+      if (pred(*object)) return object;
+    }
+    return nullptr;
+  }
+
+
+private:
+  size_t index(const int x, const int z) const noexcept {
+    return (size_t(z & (depth_ - 1)) << WIDTH_BITS) | size_t(x & WIDTH_MASK);
+  }
+
+  void update(T* object, const Entry& entry) noexcept {
+    auto it = entries_.find(object);
+    if (it != std::end(entries_)) {
+      auto& current = it->second;
+      if ((current.num == entry.num)
+          && (current.cell[0] == entry.cell[0])
+          && (current.cell[1] == entry.cell[1])) return;
+
+      removeCells(object, current);
+      current = entry;
+    }
+    else {
+      entries_.emplace(object, entry);
+    }
+
+    addCells(object, entry);
+  }
+
+  void addCells(T* object, const Entry& entry) noexcept {
+    for (int i = 0; i < entry.num; ++i) {
+      auto& cell = cells_[index(entry.cell[i].x, entry.cell[i].y)];
+      // xとzの折り返しで同じマスになることがある
+      if (std::find(std::begin(cell), std::end(cell), object) == std::end(cell)) {
+        cell.push_back(object);
+      }
+    }
+  }
+
+  void removeCells(T* object, const Entry& entry) noexcept {
+    for (int i = 0; i < entry.num; ++i) {
+      auto& cell = cells_[index(entry.cell[i].x, entry.cell[i].y)];
+      auto it = std::find(std::begin(cell), std::end(cell), object);
+      if (it != std::end(cell)) cell.erase(it);
+    }
+  }
+
+  void resize(const int depth) noexcept {
+    DOUT << "BlockGrid depth:" << depth << std::endl;
+
+    depth_ = depth;
+    cells_.clear();
+    cells_.resize(WIDTH * depth_);
+
+    for (const auto& it : entries_) {
+      addCells(it.first, it.second);
+    }
+  }
+
+};
+
+
+class PickableCube;
+class MovingCube;
+class FallingCube;
+class ItemCube;
+
+// Field上のCubeの占有状況
+struct Occupancy : private boost::noncopyable {
+  BlockGrid<PickableCube> pickable_cubes;
+  BlockGrid<MovingCube>   moving_cubes;
+  BlockGrid<FallingCube>  falling_cubes;
+  BlockGrid<ItemCube>     item_cubes;
+
+
+  void setWindow(const int bottom_z, const int top_z) noexcept {
+    pickable_cubes.setWindow(bottom_z, top_z);
+    moving_cubes.setWindow(bottom_z, top_z);
+    falling_cubes.setWindow(bottom_z, top_z);
+    item_cubes.setWindow(bottom_z, top_z);
+  }
+};
+
+}
@@ -4,6 +4,9 @@
 // 一方通行
 //
 
+#include <cinder/Rand.h>
+#include "StageFormat.hpp"
+
 
 namespace ngs {
 
@@ -22,6 +25,7 @@ public:
 private:
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
 
   bool alive_;
   bool active_;
@@ -47,12 +51,14 @@ private:
 
 public:
   Oneway(ci::JsonTree& params,
-         const ci::JsonTree& entry_params,
+         const StageFormat::Oneway& entry_params,
          ci::TimelineRef timeline,
          Event<EventParam>& event,
+         ci::Rand& rand,
          const int offset_x, const int bottom_z) noexcept :
     params_(params),
     event_(event),
+    rand_(rand),
     alive_(true),
     active_(false),
     color_(Json::getColor<float>(params["game.oneway.color"])),
@@ -70,23 +76,17 @@ public:
     timeline->apply(animation_timeline_);
     
     ci::Vec3i offset(offset_x, 0, bottom_z);
-    block_position_ = Json::getVec3<int>(entry_params["position"]) + offset;
+    block_position_ = CompiledStage::toVec3i(entry_params.position) + offset;
 
-    static std::map<std::string, int> direction = {
-      { "up",    UP },
-      { "down",  DOWN },
-      { "left",  LEFT },
-      { "right", RIGHT },
-    };
-    
-    direction_ = direction.at(entry_params["direction"].getValue<std::string>());
-    power_ = entry_params["power"].getValue<int>();
+    // TIPS:変換時にUP〜RIGHTの値にしてある
+    direction_ = entry_params.direction;
+    power_ = entry_params.power;
     
     position_ = ci::Vec3f(block_position_);
     // block_positionが同じ高さなら、StageCubeの上に乗るように位置を調整
     position_().y += 1.0f;
 
-    static std::map<int, ci::Quatf> rotation = {
+    static const std::map<int, ci::Quatf> rotation = {
       { UP,    ci::Quatf(ci::Vec3f::yAxis(), ci::toRadians(0.0f)) },
       { DOWN,  ci::Quatf(ci::Vec3f::yAxis(), ci::toRadians(180.0f)) },
       { LEFT,  ci::Quatf(ci::Vec3f::yAxis(), ci::toRadians(90.0f)) },
@@ -110,7 +110,7 @@ public:
     
     // 登場演出
     auto entry_y = Json::getVec2<float>(params_["game.oneway.entry_y"]);
-    float y = ci::randFloat(entry_y.x, entry_y.y);
+    float y = rand_.nextFloat(entry_y.x, entry_y.y);
     ci::Vec3f start_value(position() + ci::Vec3f(0, y, 0));
     auto options = animation_timeline_->apply(&position_,
                                               start_value, position_(),
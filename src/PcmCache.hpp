@@ -0,0 +1,108 @@
+﻿#pragma once
+
+//
+// デコード済みの効果音(.pcm)
+//   固定長のヘッダの後に、ci::audio::Bufferと同じ並び(チャンネルごと)で
+//   floatのサンプルを格納する。読み込みは複製一回で済む
+//   assetは書き換えられないので、書き出し可能な場所に置く
+//   元のファイルのサイズとハッシュ値を持ち、変わっていたら使わない
+//   TIPS:書き出し先はアプリの更新でも消えないので、サイズだけでは判定しない
+//   出力のサンプリングレートでデコードするので、レートやチャンネル数が
+//   変わっていても使わない
+//   TIPS:対象環境はすべてリトルエンディアン
+//
+
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cinder/audio/Buffer.h>
+#include "Utility.hpp"
+#include "FileUtil.hpp"
+#include "MappedFile.hpp"
+
+
+namespace ngs { namespace PcmCache {
+
+enum {
+  // "BTPC"
+  MAGIC   = 0x43505442,
+  VERSION = 2,
+};
+
+struct Header {
+  u_int magic;
+  u_int version;
+  u_int size;
+
+  // 変換元のファイル
+  u_int source_size;
+  u_int source_hash;
+
+  u_int sample_rate;
+  u_int channels;
+  u_int frames;
+};
+
+
+// assetのpathから書き出し先を決める
+std::string cachePath(const std::string& path) noexcept {
+  return (getDocumentPath() / ("pcm_" + replaceFilenameExt(path, "pcm"))).string();
+}
+
+
+// 一致しなければnullptrを返す
+ci::audio::BufferRef read(const std::string& cache_path,
+                          const u_int source_size, const u_int source_hash,
+                          const u_int sample_rate, const u_int channels) noexcept {
+  if (!isValidPath(cache_path)) return ci::audio::BufferRef();
+
+  MappedFile file(cache_path);
+  if (file.size() < sizeof(Header)) return ci::audio::BufferRef();
+
+  Header header;
+  std::memcpy(&header, file.data(), sizeof(Header));
+  size_t data_size = sizeof(float) * header.channels * header.frames;
+  if ((header.magic != MAGIC)
+      || (header.version != VERSION)
+      || (header.size != file.size())
+      || (header.size != sizeof(Header) + data_size)
+      || (header.source_size != source_size)
+      || (header.source_hash != source_hash)
+      || (header.sample_rate != sample_rate)
+      || (header.channels != channels)) {
+    DOUT << "PcmCache: mismatch " << cache_path << std::endl;
+    return ci::audio::BufferRef();
+  }
+
+  auto buffer = std::make_shared<ci::audio::Buffer>(header.frames, header.channels);
+  std::memcpy(buffer->getData(), file.data() + sizeof(Header), data_size);
+  return buffer;
+}
+
+// TIPS:失敗しても次回またデコードするだけなので、結果は報告のみ
+bool write(const std::string& cache_path,
+           const u_int source_size, const u_int source_hash,
+           const u_int sample_rate, const ci::audio::Buffer& buffer) noexcept {
+  size_t data_size = sizeof(float) * buffer.getSize();
+
+  Header header;
+  header.magic       = MAGIC;
+  header.version     = VERSION;
+  header.size        = u_int(sizeof(Header) + data_size);
+  header.source_size = source_size;
+  header.source_hash = source_hash;
+  header.sample_rate = sample_rate;
+  header.channels    = u_int(buffer.getNumChannels());
+  header.frames      = u_int(buffer.getNumFrames());
+
+  std::ofstream fstr(cache_path, std::ios::binary);
+  fstr.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  fstr.write(reinterpret_cast<const char*>(buffer.getData()), data_size);
+  if (!fstr) {
+    DOUT << "PcmCache: can't write " << cache_path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+} }
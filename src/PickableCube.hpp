@@ -9,6 +9,7 @@
 #include <cinder/Rand.h>
 #include "EasingUtil.hpp"
 #include "Utility.hpp"
+#include "SoundHandle.hpp"
 
 
 namespace ngs {
@@ -30,6 +31,7 @@ public:
 private:
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
   
   bool active_;
 
@@ -44,6 +46,10 @@ private:
   ci::Anim<ci::Vec3f> position_;
   ci::Anim<ci::Quatf> rotation_;
 
+  // 直前の更新開始時の姿勢(描画時の補間用)
+  ci::Vec3f prev_position_;
+  ci::Quatf prev_rotation_;
+
   // ドッスンに潰された時用
   ci::Vec3f scale_;
   // 操作時の"のりしろ"
@@ -69,7 +75,7 @@ private:
   // 移動予約を受け付けた
   bool      move_requested_;
 
-  std::vector<std::string> move_sounds_;
+  std::vector<SoundHandle> move_sounds_;
   
   std::string rotate_ease_;
   std::string rotate_ease_end_;
@@ -113,9 +119,11 @@ public:
   PickableCube(ci::JsonTree& params,
                ci::TimelineRef timeline,
                Event<EventParam>& event,
+               ci::Rand& rand,
                const ci::Vec3i& entry_pos, const bool sleep = false) noexcept :
     params_(params),
     event_(event),
+    rand_(rand),
     active_(true),
     id_(getUniqueNumber()),
     orig_color_(Json::getColor<float>(params["game.pickable.color"])),
@@ -136,7 +144,7 @@ public:
     move_speed_(0),
     move_step_(0),
     move_requested_(false),
-    move_sounds_(Json::getArray<std::string>(params["game.pickable.move_sounds"])),
+    move_sounds_(getSoundHandle(Json::getArray<std::string>(params["game.pickable.move_sounds"]))),
     rotate_ease_(params["game.pickable.rotate_ease"].getValue<std::string>()),
     rotate_ease_end_(params["game.pickable.rotate_ease_end"].getValue<std::string>()),
     rotate_duration_(params["game.pickable.rotate_duration"].getValue<float>()),
@@ -176,12 +184,14 @@ public:
 
     // 登場演出
     auto entry_y = Json::getVec2<float>(params["game.pickable.entry_y"]);
-    float y = ci::randFloat(entry_y.x, entry_y.y);
+    float y = rand_.nextFloat(entry_y.x, entry_y.y);
     ci::Vec3f start_value = position() + ci::Vec3f(0, y, 0);
     auto options = animation_timeline_->apply(&position_,
                                               start_value, position_(),
                                               params["game.pickable.entry_duration"].getValue<float>(),
                                               getEaseFunc(params["game.pickable.entry_ease"].getValue<std::string>()));
+    prev_position_ = start_value;
+    prev_rotation_ = rotation_();
 
     options.finishFn([this]() noexcept {
         on_stage_ = true;
@@ -190,7 +200,8 @@ public:
           { "id", id_ },
           { "block_pos", block_position_ },
         };
-        event_.signal("pickable-on-stage", params);
+        static const EventId pickable_on_stage("pickable-on-stage");
+        event_.signal(pickable_on_stage, params);
 
         // 時間差でidle動作
         animation_timeline_->add([this]() noexcept {
@@ -199,10 +210,11 @@ public:
                 { "id", id_ },
                 { "block_pos", block_position_ },
               };
-              event_.signal("pickable-start-idle", params);
+              static const EventId pickable_start_idle("pickable-start-idle");
+              event_.signal(pickable_start_idle, params);
             }
           },
-          animation_timeline_->getCurrentTime() + ci::randFloat(idle_delay_.x, idle_delay_.y));
+          animation_timeline_->getCurrentTime() + rand_.nextFloat(idle_delay_.x, idle_delay_.y));
       });
 
     // sleep開始演出
@@ -277,9 +289,9 @@ public:
     
     float duration = rotate_duration_ * speed_rate;
 
-    size_t index = ci::randInt(4) + std::min(move_step_,
+    size_t index = rand_.nextInt(4) + std::min(move_step_,
                                              int(move_sounds_.size() - 4));
-    const auto& move_sound = move_sounds_[index];
+    auto move_sound = move_sounds_[index];
 
     move_step_  += 1;
     move_speed_ -= 1;
@@ -344,9 +356,11 @@ public:
           { "sound",     move_sound },
         };
         if (move_event_) {
-          event_.signal("pickable-moved", params);
+          static const EventId pickable_moved("pickable-moved");
+          event_.signal(pickable_moved, params);
         }
-        event_.signal("view-sound", params);
+        static const EventId view_sound("view-sound");
+        event_.signal(view_sound, params);
       });
   }
 
@@ -358,7 +372,7 @@ public:
       { ci::Vec3f(0, 0, 1),  idle_angle_ },
     };
 
-    int move_direction = directions[ci::randInt(int(directions.size()))];
+    int move_direction = directions[rand_.nextInt(int(directions.size()))];
     auto options = animation_timeline_->apply(&move_rotation_,
                                               ci::Quatf::identity(), rotation_table[move_direction],
                                               idle_duration_,
@@ -397,10 +411,11 @@ public:
                 { "id", id_ },
                 { "block_pos", block_position_ },
               };
-              event_.signal("pickable-start-idle", params);
+              static const EventId pickable_start_idle("pickable-start-idle");
+              event_.signal(pickable_start_idle, params);
             }
           },
-          animation_timeline_->getCurrentTime() + ci::randFloat(idle_delay_.x, idle_delay_.y));
+          animation_timeline_->getCurrentTime() + rand_.nextFloat(idle_delay_.x, idle_delay_.y));
       });    
   }
 
@@ -459,7 +474,7 @@ public:
     float     duration  = params_["game.pickable.rise_duration"].getValue<float>();
     ci::Vec2f height    = Json::getVec2<float>(params_["game.pickable.rise_height"]);
 
-    ci::Vec3f end_value = position() + ci::Vec3f(0.0, ci::randFloat(height.x, height.y), 0.0);
+    ci::Vec3f end_value = position() + ci::Vec3f(0.0, rand_.nextFloat(height.x, height.y), 0.0);
     
     auto options = animation_timeline_->apply(&position_,
                                               end_value,
@@ -516,6 +531,14 @@ public:
   const ci::Vec3f& position() const noexcept { return position_(); }
   const ci::Quatf& rotation() const noexcept { return rotation_(); }
 
+  const ci::Vec3f& prevPosition() const noexcept { return prev_position_; }
+  const ci::Quatf& prevRotation() const noexcept { return prev_rotation_; }
+
+  void keepPrevTransform() noexcept {
+    prev_position_ = position_();
+    prev_rotation_ = rotation_();
+  }
+
   const ci::Vec3i& blockPosition() const noexcept { return block_position_; }
   const ci::Vec3i& prevBlockPosition() const noexcept { return prev_block_position_; }
   
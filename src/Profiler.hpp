@@ -0,0 +1,249 @@
+﻿#pragma once
+
+//
+// 処理時間の計測
+//   PROFILE_ZONE("名前") を置いたスコープの開始と終了の時刻を記録する
+//   記録はスレッドごとのリングバッファに書き込み、ロックは使わない
+//   Chrome(chrome://tracing)で読めるJSONに書き出せる
+//   TIPS:名前はポインタのまま記録するので、文字列リテラルを渡す
+//   TIPS:PROFILERが未定義の時は何もしない
+//
+
+#include <atomic>
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+
+
+#if defined (PROFILER)
+
+// TIPS:VS2013はthread_localが使えないので、PODだけ置ける指定を使う
+#if defined (_MSC_VER)
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL __thread
+#endif
+
+#define PROFILE_ZONE_CONCAT(a, b)  PROFILE_ZONE_CONCAT_(a, b)
+#define PROFILE_ZONE_CONCAT_(a, b) a ## b
+#define PROFILE_ZONE(name) ngs::Profiler::Zone PROFILE_ZONE_CONCAT(profile_zone_, __LINE__)(name)
+
+#else
+
+#define PROFILE_ZONE(name)
+
+#endif
+
+
+namespace ngs { namespace Profiler {
+
+#if defined (PROFILER)
+
+enum {
+  // 1スレッドで保持する記録の数(2のべき乗)
+  RING_SIZE  = 1 << 13,
+  THREAD_MAX = 16,
+
+  // 画面に表示するフレーム数
+  FRAME_HISTORY = 120,
+};
+
+struct Record {
+  // 文字列リテラルを指す
+  const char* name;
+  int64_t begin;
+  int64_t end;
+  u_int depth;
+};
+
+// 書き込むのは持ち主のスレッドだけ
+// 読み出す側はheadを見て、読んでいる間に上書きされた分を捨てる
+struct Ring {
+  std::array<Record, RING_SIZE> records;
+  std::atomic<u_int> head;
+  u_int depth;
+
+  Ring() noexcept :
+    head(0),
+    depth(0)
+  {}
+};
+
+std::array<std::atomic<Ring*>, THREAD_MAX> rings;
+std::atomic<u_int> ring_num(0);
+
+const auto start_time = std::chrono::steady_clock::now();
+
+// 計測開始からのナノ秒
+int64_t now() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+// 呼び出したスレッドのバッファ(初回に確保)
+// TIPS:THREAD_MAXを超えたスレッドは記録しない
+Ring* threadRing() noexcept {
+  static PROFILER_THREAD_LOCAL Ring* ring = nullptr;
+  static PROFILER_THREAD_LOCAL bool registered = false;
+  if (!registered) {
+    registered = true;
+    u_int index = ring_num++;
+    if (index < THREAD_MAX) {
+      ring = new Ring();
+      rings[index].store(ring, std::memory_order_release);
+    }
+  }
+  return ring;
+}
+
+
+class Zone {
+  Ring* ring_;
+  const char* name_;
+  int64_t begin_;
+
+
+public:
+  explicit Zone(const char* name) noexcept :
+    ring_(threadRing()),
+    name_(name),
+    begin_(now())
+  {
+    if (ring_) ring_->depth += 1;
+  }
+
+  ~Zone() {
+    if (!ring_) return;
+
+    ring_->depth -= 1;
+
+    u_int head = ring_->head.load(std::memory_order_relaxed);
+    auto& record = ring_->records[head & (RING_SIZE - 1)];
+    record.name  = name_;
+    record.begin = begin_;
+    record.end   = now();
+    record.depth = ring_->depth;
+    ring_->head.store(head + 1, std::memory_order_release);
+  }
+
+};
+
+
+// フレームごとの時間(ミリ秒)
+struct Frame {
+  // 前のフレームからの経過時間
+  float interval;
+  // 一番外側の区間の合計
+  float busy;
+};
+
+struct FrameHistory {
+  std::array<Frame, FRAME_HISTORY> frames;
+  u_int head;
+  int64_t last_time;
+  u_int last_head;
+
+  FrameHistory() noexcept :
+    head(0),
+    last_time(0),
+    last_head(0)
+  {
+    frames.fill(Frame());
+  }
+};
+
+FrameHistory frame_history;
+
+
+// フレームの区切り(メインスレッドから呼ぶ)
+void frame() noexcept {
+  auto* ring = threadRing();
+  if (!ring) return;
+
+  auto& history = frame_history;
+  int64_t current_time = now();
+
+  // 前のフレームから増えた分の一番外側の区間を合計
+  u_int head = ring->head.load(std::memory_order_relaxed);
+  u_int first = std::max(history.last_head, (head > RING_SIZE) ? (head - RING_SIZE) : 0u);
+  int64_t busy = 0;
+  for (u_int i = first; i < head; ++i) {
+    const auto& record = ring->records[i & (RING_SIZE - 1)];
+    if (record.depth == 0) busy += record.end - record.begin;
+  }
+
+  if (history.last_time > 0) {
+    auto& frame = history.frames[history.head % FRAME_HISTORY];
+    frame.interval = (current_time - history.last_time) / 1000000.0f;
+    frame.busy     = busy / 1000000.0f;
+    history.head += 1;
+  }
+  history.last_time = current_time;
+  history.last_head = head;
+}
+
+const FrameHistory& frameHistory() noexcept {
+  return frame_history;
+}
+
+
+// Chrome trace形式で書き出す
+bool writeChromeTrace(const std::string& path) noexcept {
+  std::string output("{\"traceEvents\":[\n");
+  char line[256];
+  bool first_line = true;
+
+  u_int num = std::min(u_int(ring_num), u_int(THREAD_MAX));
+  for (u_int tid = 0; tid < num; ++tid) {
+    const auto* ring = rings[tid].load(std::memory_order_acquire);
+    if (!ring) continue;
+
+    std::snprintf(line, sizeof(line),
+                  "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                  first_line ? "" : ",\n", tid, tid);
+    output += line;
+    first_line = false;
+
+    // 読んでいる間に上書きされたものは捨てる
+    u_int head  = ring->head.load(std::memory_order_acquire);
+    u_int first = (head > RING_SIZE) ? (head - RING_SIZE) : 0;
+    std::vector<Record> records;
+    records.reserve(head - first);
+    for (u_int i = first; i < head; ++i) {
+      records.push_back(ring->records[i & (RING_SIZE - 1)]);
+    }
+    // TIPS:書き込み側はrecords[latest]を埋めてからheadを進めるので、
+    //      latest - RING_SIZE 番目も書きかけの可能性がある
+    u_int latest = ring->head.load(std::memory_order_acquire);
+    u_int overwritten = (latest >= (first + RING_SIZE)) ? (latest - first - RING_SIZE + 1) : 0;
+
+    for (u_int i = std::min(overwritten, u_int(records.size())); i < records.size(); ++i) {
+      const auto& record = records[i];
+      std::snprintf(line, sizeof(line),
+                    ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    record.name, tid,
+                    record.begin / 1000.0, (record.end - record.begin) / 1000.0);
+      output += line;
+    }
+  }
+  output += "\n]}\n";
+
+  std::ofstream fstr(path);
+  if (!fstr) return false;
+  fstr << output;
+
+  DOUT << "trace writed. " << path << std::endl;
+  return true;
+}
+
+#else
+
+bool writeChromeTrace(const std::string& path) noexcept { return false; }
+
+#endif
+
+} }
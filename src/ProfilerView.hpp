@@ -0,0 +1,81 @@
+﻿#pragma once
+
+//
+// フレーム時間のグラフ表示
+//   画面下に直近のフレームを棒グラフで並べる
+//   棒の高さが前フレームからの経過時間、濃い部分が計測区間の合計
+//
+
+#include <boost/noncopyable.hpp>
+#include "Profiler.hpp"
+
+
+namespace ngs {
+
+class ProfilerView : private boost::noncopyable {
+  bool disp_;
+
+  // 縦軸の上限と目標(ミリ秒)
+  float range_;
+  float budget_;
+  // 画面の高さに対するグラフの高さ
+  float height_;
+
+  ci::ColorA interval_color_;
+  ci::ColorA busy_color_;
+  ci::ColorA budget_color_;
+
+
+public:
+  explicit ProfilerView(const ci::JsonTree& params) noexcept :
+    disp_(params["disp"].getValue<bool>()),
+    range_(params["range"].getValue<float>()),
+    budget_(params["budget"].getValue<float>()),
+    height_(params["height"].getValue<float>()),
+    interval_color_(Json::getColorA<float>(params["interval_color"])),
+    busy_color_(Json::getColorA<float>(params["busy_color"])),
+    budget_color_(Json::getColorA<float>(params["budget_color"]))
+  {}
+
+
+  void toggle() noexcept {
+    disp_ = !disp_;
+  }
+
+  void draw() noexcept {
+#if defined (PROFILER)
+    if (!disp_) return;
+
+    // 横はフレーム数、縦はミリ秒
+    ci::CameraOrtho camera(0, float(Profiler::FRAME_HISTORY),
+                           0, range_ / height_,
+                           -1, 1);
+    ci::gl::setMatrices(camera);
+
+    ci::gl::disableDepthRead();
+    ci::gl::disableDepthWrite();
+    ci::gl::disable(GL_LIGHTING);
+    ci::gl::enableAlphaBlending();
+
+    const auto& history = Profiler::frameHistory();
+    for (u_int i = 0; i < Profiler::FRAME_HISTORY; ++i) {
+      // 古い順に左から並べる
+      const auto& frame = history.frames[(history.head + i) % Profiler::FRAME_HISTORY];
+      float x = float(i);
+
+      ci::gl::color(interval_color_);
+      ci::gl::drawSolidRect(ci::Rectf(x, 0, x + 0.8f, std::min(frame.interval, range_)));
+      ci::gl::color(busy_color_);
+      ci::gl::drawSolidRect(ci::Rectf(x, 0, x + 0.8f, std::min(frame.busy, range_)));
+    }
+
+    ci::gl::color(budget_color_);
+    ci::gl::drawLine(ci::Vec2f(0, budget_), ci::Vec2f(float(Profiler::FRAME_HISTORY), budget_));
+
+    ci::gl::disableAlphaBlending();
+#endif
+  }
+
+};
+
+}
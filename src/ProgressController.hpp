@@ -58,7 +58,7 @@ public:
                                     view_->setActive(false);
                                     event_.signal("pause-start", EventParam());
 
-                                    if (hasKey(param, "force") && boost::any_cast<bool>(param.at("force"))) {
+                                    if (hasKey(param, "force") && param.get<bool>("force")) {
                                       // 強制PAUSEはタイミングが違う
                                       event_.signal("begin-pause", EventParam());
                                       view_->startWidgetTween("tween-out");
@@ -105,7 +105,7 @@ public:
     connections_ += event.connect("begin-stageclear",
                                   [this](const Connection&, EventParam& param) noexcept {
                                     view_->setActive(false);
-                                    bool all_cleard = boost::any_cast<bool>(param.at("all_cleared"));
+                                    bool all_cleard = param.get<bool>("all_cleared");
                                     if (all_cleard) {
                                       deactivateView();
                                     }
@@ -133,7 +133,7 @@ public:
 
     connections_ += event_.connect("update-record",
                                    [this](const Connection&, EventParam& param) noexcept {
-                                     auto play_time = boost::any_cast<double>(param["play-time"]);
+                                     auto play_time = param.get<double>("play-time");
                                      auto& widget = view_->getWidget("play-time");
                                      widget.setText(toFormatedString(play_time));
                                    });
@@ -0,0 +1,67 @@
+﻿#pragma once
+
+//
+// サブシステムごとに独立した乱数列
+//   TIPS:ひとつの乱数列を共有すると、どこかで引く回数が変わっただけで
+//        他のサブシステムの展開まで変わってしまう
+//        セッションのseedと乱数列の番号からそれぞれのseedを作るので、
+//        同じseedなら引く順番に関係なく同じ展開になる
+//
+
+#include <cstdint>
+#include <array>
+#include <boost/noncopyable.hpp>
+#include <cinder/Rand.h>
+
+
+namespace ngs {
+
+class RandStreams : private boost::noncopyable {
+public:
+  enum Stream {
+    STAGE,
+    ITEMS,
+    MOVING_CUBES,
+    FALLING_CUBES,
+    SWITCHES,
+    ONEWAYS,
+    PICKABLE,
+    BG,
+
+    STREAM_NUM
+  };
+
+
+  explicit RandStreams(const u_int seed) noexcept :
+    seed_(seed)
+  {
+    for (int i = 0; i < STREAM_NUM; ++i) {
+      streams_[i].seed(streamSeed(seed, i));
+    }
+  }
+
+
+  ci::Rand& operator[](const Stream stream) noexcept { return streams_[stream]; }
+
+  u_int seed() const noexcept { return seed_; }
+
+
+  // seedと番号から各乱数列のseedを作る(SplitMix64)
+  //   TIPS:近いseedや番号でも結果が大きくばらけるので、乱数列同士が似ない
+  static u_int streamSeed(const u_int seed, const int stream) noexcept {
+    uint64_t z = (uint64_t(seed) << 32) + uint64_t(stream) + 1;
+    z *= 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    return u_int(z ^ (z >> 32));
+  }
+
+
+private:
+  u_int seed_;
+  std::array<ci::Rand, STREAM_NUM> streams_;
+
+};
+
+}
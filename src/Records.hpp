@@ -368,6 +368,30 @@ public:
     }
 #endif
 
+    fromJson(record);
+
+    DOUT << "record loaded." << std::endl
+         << "stage:" << stage_records_.size() << std::endl
+         << full_path << std::endl;
+  }
+  
+  void write(const std::string& path) const noexcept {
+    auto record = toJson();
+
+    auto full_path = getDocumentPath() / path;
+#if defined(OBFUSCATION_RECORD)
+    TextCodec::write(full_path.string(), record.serialize());
+#else
+    record.write(full_path);
+#endif
+
+    DOUT << "record writed. " << std::endl
+         << "stage:" << stage_records_.size() << std::endl
+         << full_path << std::endl;
+  }
+
+  // 保存する内容をJSONで読み書き(入力の記録にも使う)
+  void fromJson(const ci::JsonTree& record) noexcept {
     total_play_num_  = Json::getValue(record, "total_play_num", 0);
     total_play_time_ = Json::getValue(record, "total_play_time", 0.0);
     high_score_      = Json::getValue(record, "high_score", 0);
@@ -394,13 +418,9 @@ public:
         stage_records_.push_back(std::move(s));
       }
     }
-
-    DOUT << "record loaded." << std::endl
-         << "stage:" << stage_records_.size() << std::endl
-         << full_path << std::endl;
   }
-  
-  void write(const std::string& path) const noexcept {
+
+  ci::JsonTree toJson() const noexcept {
     ci::JsonTree record = ci::JsonTree::makeObject("records");
 
     record.addChild(ci::JsonTree("total_play_num", total_play_num_))
@@ -428,16 +448,7 @@ public:
       record.addChild(stage);
     }
 
-    auto full_path = getDocumentPath() / path;
-#if defined(OBFUSCATION_RECORD)
-    TextCodec::write(full_path.string(), record.serialize());
-#else
-    record.write(full_path);
-#endif
-
-    DOUT << "record writed. " << std::endl
-         << "stage:" << stage_records_.size() << std::endl
-         << full_path << std::endl;
+    return record;
   }
 
   int getTotalPlayNum() const noexcept { return total_play_num_; }
@@ -104,7 +104,7 @@ public:
     setupView(params, records);
     
     view_->startWidgetTween("tween-in");
-    requestSound(event_, params["records.jingle-se"].getValue<std::string>());
+    requestSound(event_, getSoundHandle(params["records.jingle-se"].getValue<std::string>()));
 
     if (params.hasChild("records.active_delay")) {
       view_->setActive(false);
@@ -144,27 +144,27 @@ private:
   void setupView(const ci::JsonTree& params, const EventParam& records) noexcept {
     {
       // constなのでatを使っている
-      auto total_play = boost::any_cast<int>(records.at("total_play"));
+      auto total_play = records.get<int>("total_play");
       view_->getWidget("total_play").setText(toFormatedString(total_play, 4));
     }
 
     {
-      auto total_time = boost::any_cast<double>(records.at("total_time"));
+      auto total_time = records.get<double>("total_time");
       view_->getWidget("total_time").setText(toFormatedString(total_time, true));
     }
 
     {
-      auto total_score = boost::any_cast<int>(records.at("high_score"));
+      auto total_score = records.get<int>("high_score");
       view_->getWidget("high_score").setText(toFormatedString(total_score, 5));
     }
     
     {
-      auto total_item = boost::any_cast<int>(records.at("total_item"));
+      auto total_item = records.get<int>("total_item");
       view_->getWidget("total_item").setText(toFormatedString(total_item, 5));
     }
 
     {
-      const auto& stage_ranks = boost::any_cast<const std::vector<int>& >(records.at("stage_ranks"));
+      const auto& stage_ranks = records.get<std::vector<int> >("stage_ranks");
 
       auto& rank_text = params_["stageclear.rank"];
       
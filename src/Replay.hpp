@@ -0,0 +1,319 @@
+﻿#pragma once
+
+//
+// FieldEntityへの操作の記録と再生
+//   UIからの操作を、何回目の更新の前に行われたかと共にバイナリで記録する
+//   更新間隔も記録するので、同じseedとRecordsから始めれば同じ展開になる
+//
+//   [Header][開始時のRecords(JSON)][操作...]
+//   操作は種類(1byte)と、種類ごとの引数を並べる
+//   同じ間隔の更新はまとめて1つにする
+//   TIPS:対象環境はすべてリトルエンディアン
+//
+
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <boost/noncopyable.hpp>
+#include "Utility.hpp"
+
+
+namespace ngs { namespace Replay {
+
+enum {
+  // "BTRP"
+  MAGIC   = 0x50525442,
+  // TIPS:seedから乱数列を作る方法が変わったら上げる
+  //      2:処理ごとに別の乱数列を使うようにした
+  VERSION = 2,
+};
+
+enum Type {
+  FRAME,              // 更新(間隔、回数)
+
+  PICK,               // PickableCubeを掴む(番号)
+  MOVE,               // PickableCubeを動かす(番号、向き、速さ)
+  CANCEL_PICK,        // 掴むのをやめる
+  INPUT_STOP,         // 操作禁止
+  INPUT_START,        // 操作再開
+  STAGECLEAR_AGREE,   // ステージクリア後の同意
+  RESTART_LINE,       // 再開位置の決定
+  RISE,               // 全クリア後の昇天
+  COLLAPSE,           // 全クリア後の崩壊
+  CLEANUP,            // ゲームの後始末(コンティニューするか)
+  ABORT,              // ゲーム中断
+  ENTRY_PICKABLE,     // PickableCubeを追加(DEBUG)
+
+  TYPE_NUM
+};
+
+struct Header {
+  u_int magic;
+  u_int version;
+  u_int seed;
+  // 開始時のRecords(JSON)のbyte数
+  u_int records_size;
+};
+
+
+// 取り出した操作
+struct Input {
+  Type type;
+  // 何回目の更新の前か
+  u_int frame;
+
+  // FRAME
+  double dt;
+  u_int frame_num;
+
+  // PICK MOVE:PickableCubeの並び順
+  u_int index;
+  int direction;
+  int speed;
+
+  // CLEANUP
+  bool flag;
+};
+
+
+class Recorder : private boost::noncopyable {
+  std::string bytes_;
+  size_t max_bytes_;
+  bool full_;
+
+  u_int seed_;
+  u_int frame_;
+
+  // まだ書き出していない更新
+  double dt_;
+  u_int dt_num_;
+
+
+public:
+  // 上限を超えたら以降は記録しない(そこまでは再生できる)
+  Recorder(const u_int seed, const std::string& records, const size_t max_bytes) noexcept :
+    max_bytes_(max_bytes),
+    full_(false),
+    seed_(seed),
+    frame_(0),
+    dt_(0.0),
+    dt_num_(0)
+  {
+    Header header = {
+      MAGIC,
+      VERSION,
+      seed,
+      u_int(records.size()),
+    };
+    put(header);
+    bytes_ += records;
+  }
+
+
+  u_int seed() const noexcept { return seed_; }
+
+  u_int frameNum() const noexcept { return frame_; }
+
+
+  void frame(const double dt) noexcept {
+    frame_ += 1;
+    if (dt_num_ && (dt == dt_)) {
+      dt_num_ += 1;
+      return;
+    }
+
+    flushFrame();
+    dt_     = dt;
+    dt_num_ = 1;
+  }
+
+  void pick(const u_int index) noexcept {
+    if (!beginInput(PICK)) return;
+    put(uint16_t(index));
+  }
+
+  void move(const u_int index, const int direction, const int speed) noexcept {
+    if (!beginInput(MOVE)) return;
+    put(uint16_t(index));
+    put(int8_t(direction));
+    put(int8_t(speed));
+  }
+
+  void cleanup(const bool continue_game) noexcept {
+    if (!beginInput(CLEANUP)) return;
+    put(uint8_t(continue_game));
+  }
+
+  // 引数の無い操作
+  void input(const Type type) noexcept {
+    beginInput(type);
+  }
+
+
+  bool write(const std::string& path) noexcept {
+    flushFrame();
+
+    std::ofstream fstr(path, std::ios::binary);
+    fstr.write(bytes_.data(), bytes_.size());
+    if (!fstr) {
+      DOUT << "Replay: can't write " << path << std::endl;
+      return false;
+    }
+
+    DOUT << "Replay: " << path << " " << bytes_.size() << " bytes "
+         << frame_ << " frames" << std::endl;
+    return true;
+  }
+
+
+private:
+  template <typename T>
+  void put(const T& value) noexcept {
+    bytes_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void flushFrame() noexcept {
+    if (!dt_num_ || full_) return;
+
+    put(uint8_t(FRAME));
+    put(dt_);
+    put(dt_num_);
+    dt_num_ = 0;
+  }
+
+  bool beginInput(const Type type) noexcept {
+    flushFrame();
+
+    if (!full_ && (bytes_.size() >= max_bytes_)) {
+      DOUT << "Replay: reached max bytes." << std::endl;
+      full_ = true;
+    }
+    if (full_) return false;
+
+    put(uint8_t(type));
+    put(frame_);
+    return true;
+  }
+
+};
+
+
+class Player : private boost::noncopyable {
+  std::string bytes_;
+  size_t pos_;
+
+  Header header_;
+  std::string records_;
+
+  u_int frame_;
+
+
+public:
+  Player() noexcept :
+    pos_(0),
+    frame_(0)
+  {
+    std::memset(&header_, 0, sizeof(header_));
+  }
+
+
+  bool load(const std::string& path) noexcept {
+    bytes_ = readFile(path);
+    pos_   = 0;
+    frame_ = 0;
+
+    if (!get(header_)
+        || (header_.magic != MAGIC)
+        || (header_.version != VERSION)
+        || ((bytes_.size() - pos_) < header_.records_size)) {
+      DOUT << "Replay: invalid file " << path << std::endl;
+      return false;
+    }
+
+    records_ = bytes_.substr(pos_, header_.records_size);
+    pos_ += header_.records_size;
+    return true;
+  }
+
+  u_int seed() const noexcept { return header_.seed; }
+
+  // 記録開始時のRecords(JSON)
+  const std::string& records() const noexcept { return records_; }
+
+
+  // 最後まで取り出したか(falseなら途中で壊れている)
+  bool isEnd() const noexcept { return pos_ == bytes_.size(); }
+
+  // 次の操作を取り出す(終わりか、壊れていたらfalse)
+  bool next(Input& input) noexcept {
+    uint8_t type;
+    if (!get(type)) return false;
+
+    // 知らない種類は、以降の引数の長さも分からない
+    if (type >= TYPE_NUM) {
+      DOUT << "Replay: unknown type " << int(type) << " frame:" << frame_ << std::endl;
+      pos_ -= sizeof(type);
+      return false;
+    }
+
+    input.type = Type(type);
+    if (input.type == FRAME) {
+      input.frame = frame_;
+      if (!get(input.dt) || !get(input.frame_num)) return false;
+
+      frame_ += input.frame_num;
+      return true;
+    }
+
+    if (!get(input.frame)) return false;
+    switch (input.type) {
+    case PICK:
+      {
+        uint16_t index;
+        if (!get(index)) return false;
+        input.index = index;
+      }
+      break;
+
+    case MOVE:
+      {
+        uint16_t index;
+        int8_t direction;
+        int8_t speed;
+        if (!get(index) || !get(direction) || !get(speed)) return false;
+        input.index     = index;
+        input.direction = direction;
+        input.speed     = speed;
+      }
+      break;
+
+    case CLEANUP:
+      {
+        uint8_t flag;
+        if (!get(flag)) return false;
+        input.flag = flag != 0;
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    return true;
+  }
+
+
+private:
+  template <typename T>
+  bool get(T& value) noexcept {
+    if ((bytes_.size() - pos_) < sizeof(T)) return false;
+
+    std::memcpy(&value, bytes_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+};
+
+} }
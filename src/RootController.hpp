@@ -25,6 +25,9 @@
 #include "UIView.hpp"
 #include "UIViewCreator.hpp"
 #include "SoundPlayer.hpp"
+#include "Profiler.hpp"
+#include "ProfilerView.hpp"
+#include "JobGraph.hpp"
 #include "Rating.h"
 
 
@@ -51,6 +54,13 @@ class RootController : public ControllerBase {
   ci::Color background_;
 
   Records records_;
+
+  ProfilerView profiler_view_;
+
+#ifdef DEBUG
+  // 次の描画でFontの使用状況を表示
+  bool print_font_stats_;
+#endif
   
   using ControllerPtr = std::unique_ptr<ControllerBase>;
   // TIPS:イテレート中にpush_backされるのでstd::listを使っている
@@ -62,7 +72,8 @@ class RootController : public ControllerBase {
 public:
   RootController(ci::JsonTree& params,
                  ci::TimelineRef timeline,
-                 Event<std::vector<Touch> >& touch_event) noexcept :
+                 Event<std::vector<Touch> >& touch_event,
+                 JobGraph& jobs) noexcept :
     params_(params),
     timeline_(timeline),
     ui_camera_(createCamera(params["ui_view.camera"])),
@@ -72,9 +83,16 @@ public:
     autolayout_(ui_camera_),
     touch_event_(touch_event),
     view_creator_(params, timeline, ui_camera_, autolayout_, event_, touch_event),
-    sound_(params["sounds"]),
+    sound_(params["sounds"],
+           params["app.sound_cache_size"].getValue<size_t>(),
+           params["app.sound_voices"].getValue<size_t>(),
+           &jobs),
     background_(Json::getColor<float>(params["app.background"])),
-    records_(params["version"].getValue<float>())
+    records_(params["version"].getValue<float>()),
+    profiler_view_(params["app.profiler"])
+#ifdef DEBUG
+    , print_font_stats_(false)
+#endif
   {
     DOUT << "RootController()" << std::endl;
     
@@ -164,20 +182,23 @@ public:
     // サウンド再生
     event_.connect("sound-play",
                    [this](const Connection&, EventParam& param) noexcept {
-                     auto& name = boost::any_cast<const std::string&>(param.at("sound"));
-                     player_.play(name);
-                     // DOUT << "sound:" << name << std::endl;
+                     player_.play(param.get<Sound::Handle>("sound"));
+                   });
+
+    event_.connect("sound-prefetch",
+                   [this](const Connection&, EventParam& param) noexcept {
+                     sound_.prefetch(param.get<std::vector<std::string> >("sounds"));
                    });
 
     
     event_.connect("se-silent",
                    [this](const Connection&, EventParam& param) noexcept {
-                     sound_.setBufferSilent(boost::any_cast<bool>(param["silent"]));
+                     sound_.setBufferSilent(param.get<bool>("silent"));
                    });
 
     event_.connect("bgm-silent",
                    [this](const Connection&, EventParam& param) noexcept {
-                     sound_.setFileSilent(boost::any_cast<bool>(param["silent"]));
+                     sound_.setFileSilent(param.get<bool>("silent"));
                    });
 
     
@@ -214,6 +235,23 @@ public:
                      DOUT << "reset-achievement" << std::endl;
                      GameCenter::resetAchievement();
                    });
+
+    event_.connect("font-stats",
+                   [this](const Connection&, EventParam& param) noexcept {
+                     print_font_stats_ = true;
+                   });
+#endif
+
+#if defined (PROFILER)
+    event_.connect("profiler-trace",
+                   [this](const Connection&, EventParam& param) noexcept {
+                     writeProfilerTrace();
+                   });
+
+    event_.connect("profiler-graph",
+                   [this](const Connection&, EventParam& param) noexcept {
+                     profiler_view_.toggle();
+                   });
 #endif
 
     records_.load(params["game.records"].getValue<std::string>());
@@ -238,6 +276,11 @@ public:
         event_.signal("pause-agree", params);
         
         GameCenter::writeCachedAchievement();
+
+#if defined (PROFILER)
+        // 実機ではバックグラウンドに回した時に書き出す
+        writeProfilerTrace();
+#endif
       });
   }
 
@@ -250,6 +293,13 @@ public:
 
 
 private:
+#if defined (PROFILER)
+  void writeProfilerTrace() noexcept {
+    auto full_path = getDocumentPath() / std::string("trace" + createUniquePath() + ".json");
+    Profiler::writeChromeTrace(full_path.string());
+  }
+#endif
+
   void startTitle(const EventParam& exec_params) noexcept {
     addController<TitleController>(params_, timeline_, event_, exec_params, records_,
                                    view_creator_.create("ui_title.json"));
@@ -289,6 +339,11 @@ private:
   }
   
   void update(const double progressing_seconds) noexcept override {
+#if defined (PROFILER)
+    Profiler::frame();
+#endif
+    PROFILE_ZONE("RootController::update");
+
     for (auto& controller : children_) {
       controller->update(progressing_seconds);
     }
@@ -304,6 +359,8 @@ private:
   }
   
   void draw(FontHolder& fonts, ModelHolder& models) noexcept override {
+    PROFILE_ZONE("RootController::draw");
+
     // ci::gl::clear(background_);
     ci::gl::enableDepthWrite();
     glClear(GL_DEPTH_BUFFER_BIT);
@@ -311,6 +368,15 @@ private:
     for (auto& child : children_) {
       child->draw(fonts, models);
     }
+
+    profiler_view_.draw();
+
+#ifdef DEBUG
+    if (print_font_stats_) {
+      fonts.printStats();
+      print_font_stats_ = false;
+    }
+#endif
   }
 
 
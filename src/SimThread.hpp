@@ -0,0 +1,97 @@
+﻿#pragma once
+
+//
+// 更新処理を一つずつ実行する専用スレッド
+//   メインスレッドが run() で渡し、終わったかどうかを isBusy() で調べる
+//   終わるまでメインスレッドは処理対象に触れない(fork-join)
+//   TIPS:run, wait はメインスレッドから呼ぶ
+//
+
+#include <cassert>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <boost/noncopyable.hpp>
+
+
+namespace ngs {
+
+class SimThread : private boost::noncopyable {
+public:
+  using Work = std::function<void ()>;
+
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  Work work_;
+  std::atomic<bool> busy_;
+  bool stop_;
+
+  std::thread thread_;
+
+
+public:
+  SimThread() noexcept :
+    busy_(false),
+    stop_(false),
+    thread_([this]() { loop(); })
+  {}
+
+  ~SimThread() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+
+  bool isBusy() const noexcept { return busy_.load(std::memory_order_acquire); }
+
+  // 前の処理が終わってから呼ぶ
+  void run(Work work) noexcept {
+    assert(!isBusy() && "SimThread::run() was called while busy.");
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      work_ = std::move(work);
+      busy_.store(true, std::memory_order_release);
+    }
+    cv_.notify_all();
+  }
+
+  void wait() noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return !isBusy(); });
+  }
+
+
+private:
+  void loop() noexcept {
+    while (true) {
+      Work work;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stop_ || isBusy(); });
+        if (!isBusy()) return;
+
+        work.swap(work_);
+      }
+
+      work();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        busy_.store(false, std::memory_order_release);
+      }
+      cv_.notify_all();
+    }
+  }
+  
+};
+
+}
@@ -2,65 +2,138 @@
 
 //
 // BGM処理
+//   効果音は最初に鳴らす時にデコードする
+//   先読みの指定があれば、JobGraphのワーカーで前もってデコードしておく
+//   デコード済みの効果音はbyte数で上限を決め、古いものから破棄する
+//
+//   効果音は決まった数のVoiceで鳴らす
+//   categoryごとに同時発声数の上限があり、Voiceが足りなければ
+//   優先度が低く、音量が小さい(鳴り終わりに近い)ものを止めて使う
 //
 
+#include <list>
 #include <boost/noncopyable.hpp>
 #include <cinder/audio/Context.h>
 #include <cinder/audio/SamplePlayerNode.h>
+#include <cinder/audio/NodeEffects.h>
 #include "Asset.hpp"
+#include "JobGraph.hpp"
+#include "PcmCache.hpp"
+#include "SoundHandle.hpp"
 
 
 namespace ngs {
 
 class Sound : private boost::noncopyable {
-  // 各音源情報
-  struct Object : private boost::noncopyable {
-    std::string type;
-    std::string category;
-    
-    std::vector<std::string> poly_category;
-    size_t category_index;
+public:
+  // 音源の名前を読み込み時に変換した番号
+  // TIPS:paramsの並び順なので、objects_の添え字と同じ
+  using Handle = SoundHandle;
 
-    bool loop;
+  
+private:
+  enum Type {
+    FILE,
+    BUFFER,
+  };
 
-    // TIPS:std::map::emplaceを使って構築したいので
-    //      コンストラクタを定義している
-    Object(std::string type_,
-           std::string category_,
-           std::vector<std::string> poly_category_,
-           const size_t category_index_,
-           const bool loop_) noexcept :
-      type(std::move(type_)),
-      category(std::move(category_)),
-      poly_category(std::move(poly_category_)),
-      category_index(category_index_),
-      loop(loop_)
+  // デコード済みの効果音
+  //   同じファイルを使う効果音で共有する
+  struct Pcm {
+    std::string path;
+
+    ci::audio::BufferRef buffer;
+    size_t bytes;
+
+    // 先読み中
+    bool loading;
+    u_int job;
+
+    std::list<Pcm*>::iterator lru;
+
+    explicit Pcm(std::string path_) noexcept :
+      path(std::move(path_)),
+      bytes(0),
+      loading(false),
+      job(0)
     {}
   };
+  std::map<std::string, Pcm> pcm_;
 
-  std::map<std::string, Object> objects_;
+  // 先頭ほど最近鳴らしたもの
+  std::list<Pcm*> lru_;
+  size_t resident_bytes_;
+  size_t cache_bytes_;
 
   
-  // 効果音用の定義
-  std::map<std::string, ci::audio::BufferRef> buffer_;
-  std::map<std::string, ci::audio::BufferPlayerNodeRef> buffer_node_;
+  // 各音源情報
+  struct Object {
+    Type type;
+    bool loop;
 
-  // ストリーミング再生用の定義
-  std::map<std::string, ci::audio::SourceFileRef> source_;
-  std::map<std::string, ci::audio::FilePlayerNodeRef> file_node_;
+    // ストリーミング再生用
+    ci::audio::SourceFileRef source;
+    ci::audio::FilePlayerNodeRef file_node;
+
+    // 効果音用
+    Pcm* pcm;
+    // 同時発声数を数える単位
+    u_int category;
+    u_int max_instances;
+    int priority;
+    float gain;
+
+    Object() noexcept :
+      type(FILE),
+      loop(false),
+      pcm(nullptr),
+      category(0),
+      max_instances(1),
+      priority(0),
+      gain(1.0f)
+    {}
+  };
+
+  std::vector<Object> objects_;
 
   
-  // 停止用
-  std::map<std::string, ci::audio::SamplePlayerNodeRef> category_node_;
+  // 効果音を鳴らすVoice
+  struct Voice {
+    ci::audio::BufferPlayerNodeRef node;
+    ci::audio::GainNodeRef gain_node;
+    bool connected;
+
+    // 鳴らしている効果音の情報
+    u_int category;
+    int priority;
+    float gain;
+    bool loop;
+  };
+  std::vector<Voice> voices_;
+
+  std::map<std::string, u_int> buffer_category_;
+
+  // ストリーミング再生用の定義(category毎)
+  std::map<std::string, ci::audio::FilePlayerNodeRef> file_node_;
 
   bool buffer_silent_;
   bool file_silent_;
+
+  // 先読みに使う
+  JobGraph* jobs_;
   
   
 public:
-  Sound(const ci::JsonTree& params) noexcept :
+  // cache_bytes:デコード済みの効果音を保持する上限
+  // voice_num:効果音の同時発声数
+  // jobsがnullptrなら先読みはしない
+  Sound(const ci::JsonTree& params, const size_t cache_bytes, const size_t voice_num,
+        JobGraph* jobs = nullptr) noexcept :
+    resident_bytes_(0),
+    cache_bytes_(cache_bytes),
     buffer_silent_(false),
-    file_silent_(false)
+    file_silent_(false),
+    jobs_(jobs)
   {
     auto* ctx = ci::audio::Context::master();
     ctx->getOutput()->enableClipDetection(false);
@@ -68,17 +141,15 @@ public:
     
     // TIPS:文字列による処理の分岐をstd::mapとラムダ式で実装
     std::map<std::string,
-             std::function<void (ci::audio::Context*, const ci::JsonTree&)> > creator = {
+             std::function<void (ci::audio::Context*, const ci::JsonTree&, Object&)> > creator = {
       { "file", 
-        [this](ci::audio::Context* ctx, const ci::JsonTree& param) {
+        [this](ci::audio::Context* ctx, const ci::JsonTree& param, Object& object) {
           auto path = param["path"].getValue<std::string>();
           auto source = ci::audio::load(Asset::load(path));
           DOUT << "source:" << path << " ch:" << source->getNumChannels() << std::endl;
 
           // TIPS:初期値より増やしておかないと、処理負荷で音が切れる
           source->setMaxFramesPerRead(8192);
-          
-          source_.insert({ param["name"].getValue<std::string>(), source });
 
           const auto& category = param["category"].getValue<std::string>();
           if (!file_node_.count(category)) {
@@ -88,134 +159,158 @@ public:
 
             auto node = ctx->makeNode(new ci::audio::FilePlayerNode(format));
             file_node_.insert({ category, node });
-            category_node_.insert({ category, node });
           }
+
+          object.type      = FILE;
+          object.source    = source;
+          object.file_node = file_node_.at(category);
         }
       },
 
       { "buffer",
-        [this](ci::audio::Context* ctx, const ci::JsonTree& param) {
+        [this](ci::audio::Context* ctx, const ci::JsonTree& param, Object& object) {
+          // デコードは鳴らす時か先読みの時まで遅らせる
           auto path = param["path"].getValue<std::string>();
-          auto source = ci::audio::load(Asset::load(path));
-          DOUT << "source:" << path << " ch:" << source->getNumChannels() << std::endl;
-
-          buffer_.insert({ param["name"].getValue<std::string>(), source->loadBuffer() });
-
-          if (param.hasChild("poly-category")) {
-            auto categories = Json::getArray<std::string>(param["poly-category"]);
-            for (const auto& category : categories) {
-              makeBufferNode(ctx, category);
-            }
+          if (!pcm_.count(path)) {
+            pcm_.emplace(std::piecewise_construct,
+                         std::forward_as_tuple(path),
+                         std::forward_as_tuple(path));
           }
-          else {
-            const auto& category = param["category"].getValue<std::string>();
-            makeBufferNode(ctx, category);
+
+          const auto& category = param["category"].getValue<std::string>();
+          if (!buffer_category_.count(category)) {
+            buffer_category_.insert({ category, u_int(buffer_category_.size()) });
           }
+
+          object.type          = BUFFER;
+          object.pcm           = &pcm_.at(path);
+          object.category      = buffer_category_.at(category);
+          object.max_instances = Json::getValue(param, "max_instances", 1u);
+          object.priority      = Json::getValue(param, "priority", 0);
+          object.gain          = Json::getValue(param, "gain", 1.0f);
         }
       }
     };
 
     for (const auto& it : params) {
-      std::string category;
-      std::vector<std::string> poly_category;
-      
-      if (it.hasChild("poly-category")) {
-        poly_category = Json::getArray<std::string>(it["poly-category"]);
-      }
-      else {
-        category = it["category"].getValue<std::string>();
-      }
+      Object object;
+      object.loop = it["loop"].getValue<bool>();
+      creator[it["type"].getValue<std::string>()](ctx, it, object);
+
+      objects_.push_back(object);
+    }
+
+    for (size_t i = 0; i < voice_num; ++i) {
+      // TIPS:SPECIFIEDにしないと、STEREOの音源を直接MONO出力できない
+      ci::audio::Node::Format format;
+      format.channelMode(ci::audio::Node::ChannelMode::SPECIFIED);
 
-      const auto& name = it["name"].getValue<std::string>();
-      const auto& type = it["type"].getValue<std::string>();
-      objects_.emplace(std::piecewise_construct,
-                       std::forward_as_tuple(name),
-                       std::forward_as_tuple(type,
-                                             category,
-                                             poly_category,
-                                             0,
-                                             it["loop"].getValue<bool>()));
-
-      creator[type](ctx, it);
+      Voice voice;
+      voice.node      = ctx->makeNode(new ci::audio::BufferPlayerNode(format));
+      voice.gain_node = ctx->makeNode(new ci::audio::GainNode(1.0f));
+      voice.node >> voice.gain_node;
+      voice.connected = false;
+      voice.category  = 0;
+      voice.priority  = 0;
+      voice.gain      = 0.0f;
+      voice.loop      = false;
+
+      voices_.push_back(voice);
     }
   }
 
   ~Sound() {
+    // 先読み中のものは破棄
+    // TIPS:デコード中のものは終わるのを待ってから、Contextを止める
+    for (const auto& it : pcm_) {
+      if (!it.second.loading) continue;
+      jobs_->cancel(it.second.job);
+      jobs_->finishNow(it.second.job);
+    }
+
     auto* ctx = ci::audio::Context::master();
     ctx->disable();
     ctx->disconnectAllNodes();
   }
-  
 
-  void play(const std::string& name) noexcept {
-    disconnectInactiveNode();
-    
-    // TIPS:文字列による分岐をstd::mapとラムダ式で実装
-    std::map<std::string,
-             std::function<void (const std::string&, Object&)> > assign = {
-      { "file",
-        [this](const std::string& name, Object& object) {
-          if (file_silent_) return;
-          
-          auto& source = source_.at(name);
-          auto& node   = file_node_.at(object.category);
-          
-          if (node->isEnabled()) {
-            node->stop();
-          }
-          auto* ctx = ci::audio::Context::master();
 
-          node->setSourceFile(source);
-          node->setLoopEnabled(object.loop);
-
-          node >> ctx->getOutput();
-          node->start();
-        }
-      },
+  // 名前から番号へ変換
+  Handle handle(const std::string& name) const noexcept {
+    return getSoundHandle(name);
+  }
+  
 
-      { "buffer",
-        [this](const std::string& name, Object& object) {
-          if (buffer_silent_) return;
+  void play(const Handle handle) noexcept {
+    disconnectInactiveNode();
 
-          auto& buffer = buffer_.at(name);
-          auto& node   = buffer_node_.at(getCategory(object));
+    auto& object = objects_[handle];
+    switch (object.type) {
+    case FILE:
+      playFile(object);
+      break;
 
-          if (node->isEnabled()) {
-            node->stop();
-          }
-          
-          auto* ctx = ci::audio::Context::master();
-
-          node->setBuffer(buffer);
-          node->setLoopEnabled(object.loop);
-          
-          node >> ctx->getOutput();
-          node->start();
-        }
-      }
-    };
+    case BUFFER:
+      playBuffer(object);
+      break;
+    }
+  }
 
-    auto& object = objects_.at(name);
-    assign[object.type](name, object);
+  // 効果音を前もってデコードしておく
+  void prefetch(const std::vector<std::string>& names) noexcept {
+    if (!jobs_) return;
+
+    for (const auto& name : names) {
+      const auto& object = objects_[handle(name)];
+      if (object.type != BUFFER) continue;
+
+      auto& pcm = *object.pcm;
+      if (pcm.buffer || pcm.loading) continue;
+
+      // TIPS:workはワーカーで動くので、pathは複製しておく
+      auto buffer = std::make_shared<ci::audio::BufferRef>();
+      auto* target = &pcm;
+      auto path = pcm.path;
+      pcm.job = jobs_->add("sound:" + path,
+                           [buffer, path]() {
+                             *buffer = decodeBuffer(path);
+                           },
+                           [this, buffer, target]() {
+                             target->loading = false;
+                             insertBuffer(*target, *buffer);
+                             evictBuffer();
+                           });
+      pcm.loading = true;
+    }
   }
 
+  
   void stop(const std::string& category) noexcept {
-    if (category_node_.count(category)) {
-      auto node = category_node_.at(category);
+    if (file_node_.count(category)) {
+      auto node = file_node_.at(category);
       if (node->isEnabled()) {
         node->stop();
       }
     }
+
+    if (buffer_category_.count(category)) {
+      auto index = buffer_category_.at(category);
+      for (auto& voice : voices_) {
+        if ((voice.category == index) && voice.node->isEnabled()) {
+          voice.node->stop();
+        }
+      }
+    }
     
     disconnectInactiveNode();
   }
 
   void stopAll() noexcept {
-    for (auto& it : category_node_) {
+    for (auto& it : file_node_) {
       if (it.second->isEnabled()) {
         it.second->stop();
       }
     }
+    stopAllVoices();
 
     disconnectInactiveNode();
   }
@@ -226,12 +321,7 @@ public:
 
     // 無音モードになった瞬間から音を止める
     if (value) {
-      for (auto& it : buffer_node_) {
-        if (it.second->isEnabled()) {
-          it.second->stop();
-        }
-      }
-
+      stopAllVoices();
       disconnectInactiveNode();
     }
   }
@@ -253,34 +343,198 @@ public:
   
 
 private:
-  void makeBufferNode(ci::audio::Context* ctx, const std::string& category) noexcept {
-    if (!buffer_node_.count(category)) {
-      // TIPS:SPECIFIEDにしないと、STEREOの音源を直接MONO出力できない
-      ci::audio::Node::Format format;
-      format.channelMode(ci::audio::Node::ChannelMode::SPECIFIED);
+  void playFile(const Object& object) noexcept {
+    if (file_silent_) return;
 
-      auto node = ctx->makeNode(new ci::audio::BufferPlayerNode(format));
-      buffer_node_.insert({ category, node });
-      category_node_.insert({ category, node });
+    auto& node = object.file_node;
+    if (node->isEnabled()) {
+      node->stop();
+    }
+    auto* ctx = ci::audio::Context::master();
+
+    node->setSourceFile(object.source);
+    node->setLoopEnabled(object.loop);
+
+    node >> ctx->getOutput();
+    node->start();
+  }
+
+  void playBuffer(const Object& object) noexcept {
+    if (buffer_silent_) return;
+
+    auto* voice = assignVoice(object);
+    if (!voice) {
+      DOUT << "Sound: no voice for " << object.pcm->path << std::endl;
+      return;
+    }
+
+    auto buffer = acquireBuffer(*object.pcm);
+
+    auto& node = voice->node;
+    if (node->isEnabled()) {
+      node->stop();
+    }
+
+    voice->category = object.category;
+    voice->priority = object.priority;
+    voice->gain     = object.gain;
+    voice->loop     = object.loop;
+
+    node->setBuffer(buffer);
+    node->setLoopEnabled(object.loop);
+    voice->gain_node->setValue(object.gain);
+
+    if (!voice->connected) {
+      auto* ctx = ci::audio::Context::master();
+      voice->gain_node >> ctx->getOutput();
+      voice->connected = true;
+    }
+    node->start();
+  }
+
+  // 効果音を鳴らすVoiceを決める
+  //   同じcategoryが上限まで鳴っていれば、その中から奪う
+  //   空きがなければ、優先度が同じか低いものから奪う
+  //   どれも奪えなければnullptr
+  Voice* assignVoice(const Object& object) noexcept {
+    Voice* free_voice = nullptr;
+    Voice* victim = nullptr;
+    Voice* category_victim = nullptr;
+    u_int instances = 0;
+    
+    for (auto& voice : voices_) {
+      if (!voice.node->isEnabled()) {
+        if (!free_voice) free_voice = &voice;
+        continue;
+      }
+
+      if (voice.category == object.category) {
+        instances += 1;
+        if (!category_victim || isWeaker(voice, *category_victim)) category_victim = &voice;
+      }
+      if (!victim || isWeaker(voice, *victim)) victim = &voice;
+    }
+
+    if (instances >= object.max_instances) return category_victim;
+    if (free_voice) return free_voice;
+    if (victim && (victim->priority <= object.priority)) return victim;
+
+    return nullptr;
+  }
+
+  // 止めても目立たない方がtrue
+  static bool isWeaker(const Voice& lhs, const Voice& rhs) noexcept {
+    if (lhs.priority != rhs.priority) return lhs.priority < rhs.priority;
+    return loudness(lhs) < loudness(rhs);
+  }
+
+  // 音量と残りの長さから、聴こえ方を見積もる
+  // TIPS:効果音は鳴り終わりに向けて減衰するので、古いものほど小さくなる
+  static float loudness(const Voice& voice) noexcept {
+    if (voice.loop) return voice.gain;
+
+    auto frames = voice.node->getNumFrames();
+    if (frames == 0) return 0.0f;
+
+    auto remain = 1.0f - float(voice.node->getReadPosition()) / float(frames);
+    return voice.gain * remain;
+  }
+
+  void stopAllVoices() noexcept {
+    for (auto& voice : voices_) {
+      if (voice.node->isEnabled()) {
+        voice.node->stop();
+      }
     }
   }
 
   
-  const std::string& getCategory(Object& object) noexcept {
-    if (object.poly_category.empty()) {
-      return object.category;
+  // TIPS:別スレッドからも呼ばれる
+  static ci::audio::BufferRef decodeBuffer(const std::string& path) noexcept {
+    // TIPS:開くだけならデコードしない
+    auto source = ci::audio::load(Asset::load(path));
+    DOUT << "source:" << path << " ch:" << source->getNumChannels() << std::endl;
+
+    // 前回デコードしたものがあれば使う
+    // 出力先の変更でサンプリングレートが変わっていたらデコードし直す
+    // TIPS:元のファイルの中身が変わっていないかはハッシュ値で調べる
+    MappedFile source_file(Asset::fullPath(path));
+    auto source_size = u_int(source_file.size());
+    auto source_hash = hashBytes(source_file.data(), source_file.size());
+
+    auto cache_path  = PcmCache::cachePath(path);
+    auto sample_rate = u_int(ci::audio::Context::master()->getSampleRate());
+    auto channels    = u_int(source->getNumChannels());
+    auto buffer = PcmCache::read(cache_path, source_size, source_hash, sample_rate, channels);
+    if (buffer) return buffer;
+
+    buffer = source->loadBuffer();
+    PcmCache::write(cache_path, source_size, source_hash, sample_rate, *buffer);
+
+    return buffer;
+  }
+
+  // デコード済みの効果音を取り出す
+  ci::audio::BufferRef acquireBuffer(Pcm& pcm) noexcept {
+    // 先読みが間に合わなければ、そのジョブだけ終わらせる
+    if (pcm.loading) {
+      DOUT << "Sound: wait for " << pcm.path << std::endl;
+      jobs_->finishNow(pcm.job);
+    }
+
+    if (!pcm.buffer) {
+      DOUT << "Sound: decode " << pcm.path << std::endl;
+      insertBuffer(pcm, decodeBuffer(pcm.path));
     }
     else {
-      object.category_index = (object.category_index + 1) % object.poly_category.size();
-      return object.poly_category[object.category_index];
+      lru_.splice(std::begin(lru_), lru_, pcm.lru);
     }
+
+    // TIPS:破棄しても再生中のNodeが参照を持っているので、鳴り終わるまでは残る
+    auto buffer = pcm.buffer;
+    evictBuffer();
+
+    return buffer;
+  }
+
+  void insertBuffer(Pcm& pcm, ci::audio::BufferRef buffer) noexcept {
+    pcm.buffer = std::move(buffer);
+    pcm.bytes  = sizeof(float) * pcm.buffer->getSize();
+    lru_.push_front(&pcm);
+    pcm.lru = std::begin(lru_);
+
+    resident_bytes_ += pcm.bytes;
+    DOUT << "Sound: resident " << resident_bytes_ << " bytes" << std::endl;
   }
+
+  // 上限を超えた分を古いものから破棄
+  // 先頭(使ったばかりのもの)は上限を超えていても残す
+  void evictBuffer() noexcept {
+    while ((resident_bytes_ > cache_bytes_) && (lru_.size() > 1)) {
+      auto& pcm = *lru_.back();
+      resident_bytes_ -= pcm.bytes;
+      pcm.buffer.reset();
+      pcm.bytes = 0;
+
+      DOUT << "Sound: evict " << pcm.path << " resident " << resident_bytes_ << " bytes" << std::endl;
+      lru_.pop_back();
+    }
+  }
+
   
   // FIXME:iOSではNodeをOutputにたくさん繋げると、音量が小さくなる
   void disconnectInactiveNode() noexcept {
     auto output = ci::audio::Context::master()->getOutput();
     // DOUT << "active nodes:" << output->getNumConnectedInputs() << std::endl;
 
+    // Voiceは鳴り終わったらGainNodeごと外す
+    for (auto& voice : voices_) {
+      if (voice.connected && !voice.node->isEnabled()) {
+        voice.gain_node->disconnect(output);
+        voice.connected = false;
+      }
+    }
+
     std::set<ci::audio::NodeRef> nodes = output->getInputs();
     for (auto node : nodes) {
       if (!node->isEnabled()) node->disconnect(output);
@@ -0,0 +1,55 @@
+﻿#pragma once
+
+//
+// 効果音の番号
+//   paramsの"sounds"の並び順を番号にして、Soundも同じ番号で鳴らす
+//   鳴らすたびに名前から引かないよう、鳴らす側は読み込み時に変換しておく
+//   TIPS:表は起動時(Fieldやスレッドを作る前)に一度だけ作り、以後は読むだけ
+//
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cassert>
+#include <cinder/Json.h>
+
+
+namespace ngs {
+
+using SoundHandle = u_int;
+
+
+std::map<std::string, SoundHandle>& soundHandleTable() noexcept {
+  static std::map<std::string, SoundHandle> tbl;
+  return tbl;
+}
+
+
+void setupSoundHandle(const ci::JsonTree& sounds) noexcept {
+  auto& tbl = soundHandleTable();
+  tbl.clear();
+
+  SoundHandle handle = 0;
+  for (const auto& it : sounds) {
+    tbl.insert({ it["name"].getValue<std::string>(), handle });
+    handle += 1;
+  }
+}
+
+// 名前から番号へ変換
+SoundHandle getSoundHandle(const std::string& name) noexcept {
+  const auto& tbl = soundHandleTable();
+  assert(tbl.count(name) && "unknown sound.");
+  return tbl.at(name);
+}
+
+std::vector<SoundHandle> getSoundHandle(const std::vector<std::string>& names) noexcept {
+  std::vector<SoundHandle> handles;
+  handles.reserve(names.size());
+  for (const auto& name : names) {
+    handles.push_back(getSoundHandle(name));
+  }
+  return handles;
+}
+
+}
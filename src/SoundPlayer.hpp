@@ -5,29 +5,32 @@
 // 同じタイミングで同じ音が発声しないよう管理
 //
 
-#include <set>
+#include <vector>
+#include <algorithm>
 #include "Sound.hpp"
 
 
 namespace ngs {
 
 class SoundPlayer : private boost::noncopyable {
-  std::set<std::string> reserved_;
+  // TIPS:clearしても確保した領域は残るので、毎フレームのヒープ確保はない
+  std::vector<Sound::Handle> reserved_;
   
 
 public:
   SoundPlayer()  = default;
   
 
-  void play(const std::string& name) noexcept {
-    reserved_.insert(name);
+  void play(const Sound::Handle handle) noexcept {
+    if (std::find(std::begin(reserved_), std::end(reserved_), handle) != std::end(reserved_)) return;
+    reserved_.push_back(handle);
   }  
   
   void update(Sound& sound) noexcept {
     if (reserved_.empty()) return;
 
-    for (const auto& name : reserved_) {
-      sound.play(name);
+    for (const auto handle : reserved_) {
+      sound.play(handle);
     }
 
     reserved_.clear();
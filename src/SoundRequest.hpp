@@ -6,16 +6,29 @@
 
 #include "Event.hpp"
 #include "EventParam.hpp"
+#include "SoundHandle.hpp"
 
 
 namespace ngs {
 
-void requestSound(Event<EventParam>& event, const std::string& sound_name) noexcept {
+// TIPS:番号は鳴らす側で読み込み時に getSoundHandle で変換しておく
+void requestSound(Event<EventParam>& event, const SoundHandle sound) noexcept {
   EventParam params = {
-    { "sound", sound_name }
+    { "sound", sound }
   };
   
-  event.signal("sound-play", params);
+  static const EventId sound_play("sound-play");
+  event.signal(sound_play, params);
+}
+
+// 効果音を前もってデコードしておく
+void requestSoundPrefetch(Event<EventParam>& event, const std::vector<std::string>& sound_names) noexcept {
+  EventParam params = {
+    { "sounds", sound_names }
+  };
+
+  static const EventId sound_prefetch("sound-prefetch");
+  event.signal(sound_prefetch, params);
 }
 
 }
@@ -6,25 +6,42 @@
 
 #include <vector>
 #include <deque>
+#include <memory>
 #include <limits>
 #include <boost/noncopyable.hpp>
+#include <cinder/Rand.h>
 #include "StageCube.hpp"
 #include "EasingUtil.hpp"
+#include "Occupancy.hpp"
+#include "StageSource.hpp"
+#include "Profiler.hpp"
 
 
 namespace ngs {
 
 class Stage : private boost::noncopyable {
   Event<EventParam>& event_;
+  ci::Rand& rand_;
+  Occupancy& occupancy_;
   
-  // ステージ全体
-  std::deque<std::vector<StageCube> > cubes_;
-
-  // 現在表示中のCube
-  std::deque<std::vector<StageCube> > active_cubes_;
-
-  // 崩れ中のCube
-  std::deque<std::vector<StageCube> > collapse_cubes_;
+  // 未生成のStage
+  // TIPS:行は生成する時に供給元から1行ずつ取り出すので、Stageの長さによらず保持する量は一定
+  struct Segment {
+    std::shared_ptr<StageSource> source;
+    int x;
+    int z;
+    int next_iz;
+    // (x + z) & 1 で選ぶ
+    ci::Color color[2];
+    ci::Color line_color[2];
+  };
+  std::deque<Segment> segments_;
+
+  // 表示中のCube
+  // 先頭から崩れ中の行、表示中の行の順に並ぶ
+  StageCubes cubes_;
+  int collapse_num_;
+  int active_num_;
   
   int top_z_;
   int active_top_z_;
@@ -37,19 +54,20 @@ class Stage : private boost::noncopyable {
   ci::Anim<float> build_speed_rate_;
   float collapse_speed_rate_;
   
-  std::string build_ease_;
+  // TIPS:Cubeの演出のイージングはTweenPoolでの番号で保持
+  u_int       build_ease_;
   float       build_duration_;
   ci::Vec2f   build_y_;
 
-  std::string collapse_ease_;
+  u_int       collapse_ease_;
   float       collapse_duration_;
   ci::Vec2f   collapse_y_;
 
-  std::string open_ease_;
+  u_int       open_ease_;
   float       open_duration_;
   float       open_delay_;
 
-  std::string move_ease_;
+  u_int       move_ease_;
   float       move_duration_;
   float       move_delay_;
 
@@ -70,8 +88,14 @@ class Stage : private boost::noncopyable {
 public:
   Stage(const ci::JsonTree& params,
         ci::TimelineRef timeline,
-        Event<EventParam>& event) noexcept :
+        Event<EventParam>& event,
+        ci::Rand& rand,
+        Occupancy& occupancy) noexcept :
     event_(event),
+    rand_(rand),
+    occupancy_(occupancy),
+    collapse_num_(0),
+    active_num_(0),
     top_z_(0),
     active_top_z_(0),
     finish_line_z_(-1),
@@ -80,16 +104,16 @@ public:
     auto_collapse_(params["game.stage.auto_collapse"].getValue<float>()),
     build_speed_rate_(1.0f),
     collapse_speed_rate_(1.0f),
-    build_ease_(params["game.stage.build_ease"].getValue<std::string>()),
+    build_ease_(cubes_.ease(params["game.stage.build_ease"].getValue<std::string>())),
     build_duration_(params["game.stage.build_duration"].getValue<float>()),
     build_y_(Json::getVec2<float>(params["game.stage.build_y"])),
-    collapse_ease_(params["game.stage.collapse_ease"].getValue<std::string>()),
+    collapse_ease_(cubes_.ease(params["game.stage.collapse_ease"].getValue<std::string>())),
     collapse_duration_(params["game.stage.collapse_duration"].getValue<float>()),
     collapse_y_(Json::getVec2<float>(params["game.stage.collapse_y"])),
-    open_ease_(params["game.stage.open_ease"].getValue<std::string>()),
+    open_ease_(cubes_.ease(params["game.stage.open_ease"].getValue<std::string>())),
     open_duration_(params["game.stage.open_duration"].getValue<float>()),
     open_delay_(params["game.stage.open_delay"].getValue<float>()),
-    move_ease_(params["game.stage.move_ease"].getValue<std::string>()),
+    move_ease_(cubes_.ease(params["game.stage.move_ease"].getValue<std::string>())),
     move_duration_(params["game.stage.move_duration"].getValue<float>()),
     move_delay_(params["game.stage.move_delay"].getValue<float>()),
     build_start_ease_(params["game.stage.build_start_ease"].getValue<std::string>()),
@@ -117,6 +141,14 @@ public:
   }
 
 
+  // Cubeの演出を進める
+  void update(const double progressing_seconds) noexcept {
+    PROFILE_ZONE("Stage::update");
+
+    cubes_.update(progressing_seconds);
+  }
+
+
   // 生成開始
   void startBuildStage(const float speed_rate, const bool start_speedup) noexcept {
     if (start_speedup) {
@@ -156,8 +188,9 @@ public:
     if (!finished_build_ || !finished_collapse_) return false;
 
     // Build演出の完了も調べる
-    for (const auto& cube : topLine()) {
-      if (!cube.position.isComplete()) return false;
+    size_t index = cubes_.rowIndex(topRow());
+    for (int i = 0; i < StageCubes::ROW_WIDTH; ++i, ++index) {
+      if (cubes_.exists(index) && cubes_.isAnimating(index)) return false;
     }
     
     return true;
@@ -165,7 +198,7 @@ public:
 
   // 崩壊完了()
   bool isFinishedCollapse() noexcept {
-    return active_cubes_.empty();
+    return active_num_ == 0;
   }
 
   void restart(const int restart_z) noexcept {
@@ -179,32 +212,39 @@ public:
     finished_build_    = false;
     finished_collapse_ = false;
 
-    cubes_.clear();
+    segments_.clear();
   }
   
 
   // StartLineを下げる
   void openStartLine() noexcept {
-    size_t iz = active_cubes_.size() - 1;
+    u_int row = topRow();
 
-    for (auto& cube : active_cubes_[iz]) {
-      ci::Vec3f end_value(cube.position() + ci::Vec3f(0.0f, -1.0f, 0.0f));
-      auto option = animation_timeline_->apply(&cube.position, end_value,
-                                               open_duration_, getEaseFunc(open_ease_));
+    size_t index = cubes_.rowIndex(row);
+    for (int i = 0; i < StageCubes::ROW_WIDTH; ++i, ++index) {
+      if (!cubes_.exists(index)) continue;
 
-      option.delay(open_delay_);
+      // TIPS:開始値は再生が始まった時の位置
+      ci::Vec3f end_value(cubes_.position(index) + ci::Vec3f(0.0f, -1.0f, 0.0f));
+      cubes_.animate(index, end_value,
+                     open_duration_, open_ease_, open_delay_);
     }
 
     event_timeline_->add([this]() noexcept {
-        event_.signal("startline-will-open", EventParam());
+        static const EventId startline_will_open("startline-will-open");
+        event_.signal(startline_will_open, EventParam());
       }, event_timeline_->getCurrentTime() + open_delay_);
     
-    event_timeline_->add([this, iz]() noexcept {
-        // コンテナへの参照が無効になっている場合があるので、関数経由で取得
-        for (auto& cube : active_cubes_[iz]) {
-          cube.block_position.y -= 1;
+    event_timeline_->add([this, row]() noexcept {
+        // コンテナへの参照が無効になっている場合があるので、通し番号から取得
+        if (cubes_.isValidRow(row)) {
+          size_t index = cubes_.rowIndex(row);
+          for (int i = 0; i < StageCubes::ROW_WIDTH; ++i, ++index) {
+            if (cubes_.exists(index)) cubes_.blockPosition(index).y -= 1;
+          }
         }
-        event_.signal("startline-opened", EventParam());
+        static const EventId startline_opened("startline-opened");
+        event_.signal(startline_opened, EventParam());
       },
       event_timeline_->getCurrentTime() + open_delay_ + open_duration_);
   }
@@ -231,68 +271,45 @@ public:
 
   int getTopZ() const noexcept { return top_z_; }
   int getActiveTopZ() const noexcept { return active_top_z_; }
-  int getActiveBottomZ() const noexcept { return active_top_z_ - int(active_cubes_.size()); }
+  int getActiveBottomZ() const noexcept { return active_top_z_ - active_num_; }
 
   const ci::Vec2i& getStageWidth() const noexcept { return stage_width_; }
   
-  int addCubes(const ci::JsonTree& stage_data,
+  int addCubes(const std::shared_ptr<StageSource>& source,
                const int x_offset,
                const std::vector<ci::Color>& cube_color,
                const ci::Color& line_color) noexcept {
     // finishlineにはデータが入っていてはいけない
-    build_speed_    = Json::getValue<float>(stage_data, "build_speed", build_speed_);
-    collapse_speed_ = Json::getValue<float>(stage_data, "collapse_speed", collapse_speed_);
-    auto_collapse_  = Json::getValue<float>(stage_data, "auto_collapse", auto_collapse_);
+    const auto& header = source->header();
+    if (header.flags & StageFormat::HAS_BUILD_SPEED)    build_speed_    = header.build_speed;
+    if (header.flags & StageFormat::HAS_COLLAPSE_SPEED) collapse_speed_ = header.collapse_speed;
+    if (header.flags & StageFormat::HAS_AUTO_COLLAPSE)  auto_collapse_  = header.auto_collapse;
 
-    const auto stage_color = Json::getColor<float>(stage_data["color"]);
+    const auto stage_color = source->color();
 
-    stage_width_.x = x_offset;
-    // yにはstageの最大値を入れたいので、初期値として最小値を入れておく
-    stage_width_.y = std::numeric_limits<int>::min();
-    
-    
-    const auto& body = stage_data["body"];
-    int last_iz = int(body.getNumChildren()) - 1;
-    int iz = 0;
-    for (const auto& row : body) {
-      std::vector<StageCube> cube_row;
-      cube_row.reserve(16);
-      
-      int x = x_offset;
-      int z = iz + top_z_;
-
-      const auto& base_color = (iz == last_iz) ? line_color
-                                               : stage_color;
-      
-      for (const auto& p : row) {
-        int y = p.getValue<int>();
-        
-        if (y >= 0) {
-          ci::Vec3i block_pos(x, y, z);
-          ci::Vec3f pos = ci::Vec3f(x, y, z);
-
-          StageCube cube = {
-            pos,
-            ci::Quatf::identity(),
-            block_pos,
-            block_pos,
-            base_color * cube_color[(x + z) & 1],
-            true, true
-          };
+    // TIPS:幅はStageFormatの変換と読み込みで、ビルド設定に関係なく弾いている
+    static_assert(int(StageCubes::ROW_WIDTH) == int(StageFormat::MAX_WIDTH), "row width mismatch.");
+    assert((source->width() <= StageCubes::ROW_WIDTH) && "stage row is too wide.");
 
-          cube_row.push_back(std::move(cube));
-        }
-        x += 1;
+    stage_width_.x = x_offset;
+    // 格子の幅がそのままstageの幅になる
+    stage_width_.y = x_offset + source->width();
+
+    int depth = source->depth();
+    if (depth > 0) {
+      Segment segment;
+      segment.source  = source;
+      segment.x       = x_offset;
+      segment.z       = top_z_;
+      segment.next_iz = 0;
+      for (int i = 0; i < 2; ++i) {
+        segment.color[i]      = stage_color * cube_color[i];
+        segment.line_color[i] = line_color * cube_color[i];
       }
-      cubes_.push_back(std::move(cube_row));
-
-      // stageのxの最大値を保持
-      if (x > stage_width_.y) stage_width_.y = x;
-      
-      iz += 1;
+      segments_.push_back(segment);
     }
 
-    top_z_ += body.getNumChildren();
+    top_z_ += depth;
     
     return top_z_; 
   }
@@ -300,17 +317,17 @@ public:
   
   // 「この場所にはCubeが無い」も結果に含めるので、std::pairを利用
   std::pair<bool, int> getStageHeight(const ci::Vec3i& block_pos) const noexcept {
-    const auto* const cube = getStageCube(block_pos);
-    if (!cube) return std::make_pair(false, 0);
+    int index = findStageCube(block_pos);
+    if (index < 0) return std::make_pair(false, 0);
     
-    return std::make_pair(cube->can_ride, cube->block_position.y);
+    return std::make_pair(cubes_.canRide(index), cubes_.blockPosition(index).y);
   }
 
   void moveStageCube(const ci::Vec3i& block_pos) noexcept {
-    auto* const target = getStageCube(block_pos);
-    if (!target) return;
+    int index = findStageCube(block_pos);
+    if (index < 0) return;
 
-    moveStageCube(*target);
+    moveStageCube(size_t(index));
   }
 
   void cleanup() noexcept {
@@ -321,12 +338,12 @@ public:
   float buildSpeed() const noexcept { return build_speed_; }
   
   
-  const std::deque<std::vector<StageCube> >& activeCubes() const noexcept {
-    return active_cubes_;
+  const StageCubes& cubes() const noexcept {
+    return cubes_;
   }
 
-  const std::deque<std::vector<StageCube> >& collapseCubes() const noexcept {
-    return collapse_cubes_;
+  void keepPrevPositions() noexcept {
+    cubes_.keepPrevPositions();
   }
 
   
@@ -347,32 +364,34 @@ private:
           EventParam params = {
             { "active_top_z", active_top_z_ - 1 }
           };
-          event_.signal("build-one-line", params);
+          static const EventId build_one_line("build-one-line");
+          event_.signal(build_one_line, params);
         }
 
         // active_top_z_には次のzが入っている
         if ((active_top_z_ - 1) == finish_line_z_) {
-          event_.signal("build-finish-line", EventParam());
+          static const EventId build_finish_line("build-finish-line");
+          event_.signal(build_finish_line, EventParam());
         }
 
         // 生成演出
-        auto& cubes = topLine();
-        for (auto& cube : cubes) {
-          cube.can_ride = false;
+        u_int row = topRow();
+        size_t index = cubes_.rowIndex(row);
+        for (int i = 0; i < StageCubes::ROW_WIDTH; ++i, ++index) {
+          if (!cubes_.exists(index)) continue;
+
+          cubes_.setCanRide(index, false);
           
-          float y = ci::randFloat(build_y_.x, build_y_.y);
-          ci::Vec3f start_value(cube.position() + ci::Vec3f(0, y, 0));
-          ci::Vec3f end_value = cube.position();
-          auto options = animation_timeline_->apply(&cube.position,
-                                                    start_value, end_value,
-                                                    build_duration_, getEaseFunc(build_ease_));
-
-          // lambda内でcubeを書き換えるので、mutable指定
-          options.finishFn([&cube]() mutable {
-              cube.can_ride = true;
-            });
-
-          cube.position = start_value;
+          float y = rand_.nextFloat(build_y_.x, build_y_.y);
+          ci::Vec3f end_value = cubes_.position(index);
+          ci::Vec3f start_value(end_value + ci::Vec3f(0, y, 0));
+          auto handle = cubes_.animate(index,
+                                       start_value, end_value,
+                                       build_duration_, build_ease_);
+
+          // バッファが広がると配列の位置が変わるので、通し番号から引き直す
+          cubes_.setFinishFn(handle, &Stage::finishBuildCube, this,
+                             row * StageCubes::ROW_WIDTH + i);
         }
         
         buildStage();
@@ -382,7 +401,7 @@ private:
 
   // 崩壊(再帰)
   void collapseStage(const int stop_z) noexcept {
-    int bottom_z = active_top_z_ - int(active_cubes_.size()) - 1;
+    int bottom_z = getActiveBottomZ() - 1;
     
     if (!canCollapse() || (bottom_z == stop_z)) {
       finished_collapse_ = true;
@@ -393,15 +412,18 @@ private:
 
     // 落下開始
     collapseStartOneLine();
-    event_.signal("collapse-one-line", EventParam());
-    auto& cubes = collapseLine();
-    for (auto& cube : cubes) {
-      cube.can_ride = false;
-
-      float y = ci::randFloat(collapse_y_.x, collapse_y_.y);
-      ci::Vec3f end_value(cube.position() + ci::Vec3f(0, y, 0));
-      animation_timeline_->apply(&cube.position, end_value,
-                                 collapse_duration_, getEaseFunc(collapse_ease_));
+    static const EventId collapse_one_line("collapse-one-line");
+    event_.signal(collapse_one_line, EventParam());
+    size_t index = cubes_.rowIndex(collapseRow());
+    for (int i = 0; i < StageCubes::ROW_WIDTH; ++i, ++index) {
+      if (!cubes_.exists(index)) continue;
+
+      cubes_.setCanRide(index, false);
+
+      float y = rand_.nextFloat(collapse_y_.x, collapse_y_.y);
+      ci::Vec3f end_value(cubes_.position(index) + ci::Vec3f(0, y, 0));
+      cubes_.animate(index, end_value,
+                     collapse_duration_, collapse_ease_);
     }
 
     animation_timeline_->add([this]() noexcept {
@@ -413,85 +435,117 @@ private:
                           event_timeline_->getCurrentTime() + collapse_speed_ * collapse_speed_rate_);
   }
   
-  const StageCube* const getStageCube(const ci::Vec3i& block_pos) const noexcept {
+  // 表示中のCubeの添え字を返す(無ければ負の値)
+  int findStageCube(const ci::Vec3i& block_pos) const noexcept {
     int top_z    = active_top_z_ - 1;
-    int bottom_z = active_top_z_ - int(active_cubes_.size());
+    int bottom_z = getActiveBottomZ();
 
-    if ((block_pos.z < bottom_z) || (block_pos.z > top_z)) return nullptr;
+    if ((block_pos.z < bottom_z) || (block_pos.z > top_z)) return -1;
     
-    int iz = block_pos.z - bottom_z;
-    for (auto& cube : active_cubes_[iz]) {
-      if (cube.block_position.x == block_pos.x) {
-        return &cube;
-      }
-    }
-    return nullptr;
-  }
-
-  StageCube* const getStageCube(const ci::Vec3i& block_pos) noexcept {
-    // TIPS:constなし版のための策
-    return const_cast<StageCube*>(static_cast<const Stage*>(this)->getStageCube(block_pos));
+    // TIPS:行の並びとzが一致しているので、xとzから直接引ける
+    u_int row = bottomRow() + (block_pos.z - bottom_z);
+    return cubes_.findCube(row, block_pos.x);
   }
   
 
   
   bool canBuild() const {
-    return !cubes_.empty();
+    return !segments_.empty();
   }
 
   bool canCollapse() const {
-    return !active_cubes_.empty();
+    return active_num_ > 0;
   }
   
   void buildOneLine() {
-    // TIPS:frontは参照を返すので、実体で受け取ってから
-    //      当該要素をコンテナから取り除く
-    std::vector<StageCube> row = cubes_.front();
-    cubes_.pop_front();
-    
-    active_cubes_.push_back(std::move(row));
+    auto& segment = segments_.front();
+    auto& source  = *segment.source;
+
+    int iz    = segment.next_iz;
+    int z     = segment.z + iz;
+    int depth = source.depth();
+    const auto* color  = (iz == (depth - 1)) ? segment.line_color : segment.color;
+    const auto* height = source.row(iz);
+
+    u_int cube_row = cubes_.pushRow(segment.x);
+    for (int i = 0; i < source.width(); ++i) {
+      if (height[i] < 0) continue;
+
+      int x = segment.x + i;
+      cubes_.setCube(cube_row, i,
+                     ci::Vec3i(x, height[i], z),
+                     color[(x + z) & 1]);
+    }
+
+    segment.next_iz += 1;
+    if (segment.next_iz == depth) segments_.pop_front();
+
+    active_num_   += 1;
     active_top_z_ += 1;
+
+    occupancy_.setWindow(getActiveBottomZ(), active_top_z_ - 1);
   }
 
   void collapseStartOneLine() {
-    collapse_cubes_.push_back(active_cubes_.front());
-    active_cubes_.pop_front();
+    collapse_num_ += 1;
+    active_num_   -= 1;
+
+    occupancy_.setWindow(getActiveBottomZ(), active_top_z_ - 1);
   }
 
   void collapseFinishOneLine() {
-    collapse_cubes_.pop_front();
+    cubes_.popRow();
+    collapse_num_ -= 1;
   }
 
-  std::vector<StageCube>& topLine() {
-    return active_cubes_.back();
+  // 表示中の行の通し番号
+  u_int topRow() const {
+    return cubes_.tailRow() - 1;
   }
   
-  std::vector<StageCube>& bottomLine() {
-    return active_cubes_.front();
+  u_int bottomRow() const {
+    return cubes_.headRow() + collapse_num_;
   }
 
-  std::vector<StageCube>& collapseLine() {
-    return collapse_cubes_.back();
+  u_int collapseRow() const {
+    return bottomRow() - 1;
   }
 
 
-  void moveStageCube(StageCube& cube) {
-    cube.block_position_new.y -= 1;
+  void moveStageCube(const size_t index) {
+    auto& block_position_new = cubes_.blockPositionNew(index);
+    block_position_new.y -= 1;
     
-    auto end_value = ci::Vec3f(cube.block_position_new);
-    auto option = animation_timeline_->appendTo(&cube.position, end_value,
-                                                move_duration_, getEaseFunc(move_ease_));
-
-    option.delay(move_delay_);
-
-    ci::Vec3f block_position = cube.block_position;
-    option.finishFn([this, block_position]() noexcept {
-        auto* cube = getStageCube(block_position);
-        if (cube) {
-          cube->block_position.y -= 1;
-          DOUT << cube->block_position << std::endl;
-        }
-      });
+    auto end_value = ci::Vec3f(block_position_new);
+    auto handle = cubes_.animateAppend(index, end_value,
+                                       move_duration_, move_ease_, move_delay_);
+
+    // TIPS:行の並びとzが一致しているので、zから通し番号を求められる
+    u_int row = bottomRow() + (cubes_.blockPosition(index).z - getActiveBottomZ());
+    cubes_.setFinishFn(handle, &Stage::finishMoveCube, this,
+                       row * StageCubes::ROW_WIDTH + index % StageCubes::ROW_WIDTH);
+  }
+
+
+  static void finishBuildCube(void* context, const u_int tag) noexcept {
+    auto* stage = static_cast<Stage*>(context);
+
+    u_int row = tag / StageCubes::ROW_WIDTH;
+    if (stage->cubes_.isValidRow(row)) {
+      stage->cubes_.setCanRide(stage->cubes_.rowIndex(row) + tag % StageCubes::ROW_WIDTH, true);
+    }
+  }
+
+  static void finishMoveCube(void* context, const u_int tag) noexcept {
+    auto* stage = static_cast<Stage*>(context);
+
+    // 崩れ始めた行は対象外
+    u_int row = tag / StageCubes::ROW_WIDTH;
+    if ((row - stage->bottomRow()) >= u_int(stage->active_num_)) return;
+
+    auto& cube_position = stage->cubes_.blockPosition(stage->cubes_.rowIndex(row) + tag % StageCubes::ROW_WIDTH);
+    cube_position.y -= 1;
+    DOUT << cube_position << std::endl;
   }
   
 };
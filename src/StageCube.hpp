@@ -2,26 +2,268 @@
 
 //
 // Stageを構成するCube
+//   固定幅の行を環状バッファで保持し、要素ごとに配列を分けている
+//   行は通し番号で指定するので、バッファを広げても番号は変わらない
+//   位置の演出はTweenPoolで動かす
 //
 
+#include <vector>
 #include <boost/noncopyable.hpp>
-#include <cinder/Tween.h>
+#include "TweenPool.hpp"
 
 
 namespace ngs {
 
-struct StageCube {
-  ci::Anim<ci::Vec3f> position;
-  ci::Anim<ci::Quatf> rotation;
+class StageCubes : private boost::noncopyable {
+public:
+  enum {
+    // 1行の最大数
+    ROW_WIDTH = 16,
+  };
 
-  ci::Vec3i block_position;
+  enum {
+    EXISTS   = 1 << 0,
+    CAN_RIDE = 1 << 1,
+  };
+
+
+private:
+  enum {
+    ROW_NUM_MIN = 64,
+  };
+
+  int row_num_;
+
+  // 通し番号(先頭と末尾の次)
+  u_int head_row_;
+  u_int tail_row_;
+
+  // 行ごとの先頭のx
+  std::vector<int> row_x_;
+
+  // 行 * ROW_WIDTH + 列 で参照
+  std::vector<ci::Vec3f> position_;
+  // 直前の更新開始時の位置(描画時の補間用)
+  std::vector<ci::Vec3f> prev_position_;
+  // 最後に仕掛けたTween
+  std::vector<TweenHandle> tween_;
+  std::vector<ci::Vec3i> block_position_;
   // Switchでの移動用
-  ci::Vec3i block_position_new;
-  
-  ci::Color color;
+  std::vector<ci::Vec3i> block_position_new_;
+  std::vector<ci::Color> color_;
+  std::vector<u_char> flags_;
+
+  TweenPool<ci::Vec3f> tween_pool_;
+
+
+public:
+  StageCubes() noexcept :
+    StageCubes(ROW_NUM_MIN)
+  {
+    tween_pool_.reserve(row_num_ * ROW_WIDTH);
+  }
+
+
+  // 末尾に空の行を追加して、その通し番号を返す
+  u_int pushRow(const int x) noexcept {
+    if (size() == u_int(row_num_)) {
+      resize(row_num_ * 2);
+    }
+
+    u_int row = tail_row_;
+    tail_row_ += 1;
+
+    row_x_[slot(row)] = x;
+    size_t index = rowIndex(row);
+    std::fill(std::begin(flags_) + index, std::begin(flags_) + index + ROW_WIDTH, 0);
+
+    return row;
+  }
+
+  void setCube(const u_int row, const int column,
+               const ci::Vec3i& block_pos, const ci::Color& color) noexcept {
+    size_t index = rowIndex(row) + column;
+
+    tween_pool_.stop(tween_[index]);
+    tween_[index]              = TweenHandle();
+    position_[index]           = ci::Vec3f(block_pos);
+    prev_position_[index]      = position_[index];
+    block_position_[index]     = block_pos;
+    block_position_new_[index] = block_pos;
+    color_[index]              = color;
+    flags_[index]              = EXISTS | CAN_RIDE;
+  }
+
+  // 先頭の行を取り除く
+  void popRow() noexcept {
+    assert(size() > 0);
+
+    // 再利用された時に古いTweenが残らないようにする
+    size_t index = rowIndex(head_row_);
+    for (int i = 0; i < ROW_WIDTH; ++i) {
+      tween_pool_.stop(tween_[index + i]);
+      tween_[index + i] = TweenHandle();
+    }
+    head_row_ += 1;
+  }
+
+  void clear() noexcept {
+    while (size() > 0) popRow();
+  }
+
+
+  u_int headRow() const noexcept { return head_row_; }
+  u_int tailRow() const noexcept { return tail_row_; }
+  u_int size() const noexcept { return tail_row_ - head_row_; }
+
+  bool isValidRow(const u_int row) const noexcept {
+    return (row - head_row_) < size();
+  }
+
+  size_t rowIndex(const u_int row) const noexcept {
+    return slot(row) * ROW_WIDTH;
+  }
+
+  // xからCubeを探す(無ければ負の値)
+  int findCube(const u_int row, const int x) const noexcept {
+    int column = x - row_x_[slot(row)];
+    if ((column < 0) || (column >= ROW_WIDTH)) return -1;
+
+    int index = int(rowIndex(row)) + column;
+    return (flags_[index] & EXISTS) ? index : -1;
+  }
+
+
+  bool exists(const size_t index) const noexcept { return (flags_[index] & EXISTS) != 0; }
+  bool canRide(const size_t index) const noexcept { return (flags_[index] & CAN_RIDE) != 0; }
+
+  void setCanRide(const size_t index, const bool can_ride) noexcept {
+    if (can_ride) flags_[index] |= CAN_RIDE;
+    else          flags_[index] &= ~CAN_RIDE;
+  }
+
+  const ci::Vec3f& position(const size_t index) const noexcept { return position_[index]; }
+  const ci::Vec3f& prevPosition(const size_t index) const noexcept { return prev_position_[index]; }
+
+  // 更新前に呼んで、現在の位置を記録しておく
+  void keepPrevPositions() noexcept {
+    std::copy(std::begin(position_), std::end(position_), std::begin(prev_position_));
+  }
+
+  ci::Vec3i& blockPosition(const size_t index) noexcept { return block_position_[index]; }
+  const ci::Vec3i& blockPosition(const size_t index) const noexcept { return block_position_[index]; }
+
+  ci::Vec3i& blockPositionNew(const size_t index) noexcept { return block_position_new_[index]; }
+
+  const ci::Color& color(const size_t index) const noexcept { return color_[index]; }
+
+
+  // イージングの番号
+  u_int ease(const std::string& name) noexcept { return tween_pool_.ease(name); }
+
+  // 再生中のTweenを止めて、新しく仕掛ける
+  TweenHandle animate(const size_t index,
+                      const ci::Vec3f& start_value, const ci::Vec3f& end_value,
+                      const float duration, const u_int ease, const float delay = 0.0f) noexcept {
+    tween_pool_.stop(tween_[index]);
+    tween_[index] = tween_pool_.apply(&position_[index], start_value, end_value, duration, ease, delay);
+    return tween_[index];
+  }
+
+  // 開始時の位置から動かす
+  TweenHandle animate(const size_t index, const ci::Vec3f& end_value,
+                      const float duration, const u_int ease, const float delay = 0.0f) noexcept {
+    tween_pool_.stop(tween_[index]);
+    tween_[index] = tween_pool_.apply(&position_[index], end_value, duration, ease, delay);
+    return tween_[index];
+  }
+
+  // 再生中のTweenの後につなげる
+  TweenHandle animateAppend(const size_t index, const ci::Vec3f& end_value,
+                            const float duration, const u_int ease, const float delay = 0.0f) noexcept {
+    tween_[index] = tween_pool_.appendTo(tween_[index], &position_[index], end_value, duration, ease, delay);
+    return tween_[index];
+  }
+
+  void setFinishFn(const TweenHandle& handle,
+                   TweenPool<ci::Vec3f>::FinishFn fn, void* context, const u_int tag) noexcept {
+    tween_pool_.setFinishFn(handle, fn, context, tag);
+  }
+
+  bool isAnimating(const size_t index) const noexcept {
+    return tween_pool_.isPlaying(tween_[index]);
+  }
+
+  void update(const double progressing_seconds) noexcept {
+    tween_pool_.update(progressing_seconds);
+  }
+
+
+private:
+  size_t slot(const u_int row) const noexcept {
+    return row & (row_num_ - 1);
+  }
+
+  void allocate(const int row_num) noexcept {
+    row_x_.resize(row_num);
+
+    size_t num = row_num * ROW_WIDTH;
+    position_.resize(num);
+    prev_position_.resize(num);
+    tween_.resize(num);
+    block_position_.resize(num);
+    block_position_new_.resize(num);
+    color_.resize(num);
+    flags_.resize(num);
+  }
+
+  void resize(const int row_num) noexcept {
+    DOUT << "StageCubes row:" << row_num << std::endl;
+
+    StageCubes cubes(row_num);
+    cubes.head_row_ = head_row_;
+    cubes.tail_row_ = tail_row_;
+
+    for (u_int row = head_row_; row != tail_row_; ++row) {
+      cubes.row_x_[cubes.slot(row)] = row_x_[slot(row)];
+
+      size_t src = rowIndex(row);
+      size_t dst = cubes.rowIndex(row);
+      for (int i = 0; i < ROW_WIDTH; ++i) {
+        cubes.position_[dst + i]           = position_[src + i];
+        cubes.prev_position_[dst + i]      = prev_position_[src + i];
+        cubes.tween_[dst + i]              = tween_[src + i];
+        // 再生中のTweenの書き込み先を移動先に付け替える
+        tween_pool_.retarget(tween_[src + i], &cubes.position_[dst + i]);
+        cubes.block_position_[dst + i]     = block_position_[src + i];
+        cubes.block_position_new_[dst + i] = block_position_new_[src + i];
+        cubes.color_[dst + i]              = color_[src + i];
+        cubes.flags_[dst + i]              = flags_[src + i];
+      }
+    }
+
+    row_num_ = row_num;
+    row_x_.swap(cubes.row_x_);
+    // TIPS:swapではバッファの場所は変わらないので、付け替えた先はそのまま使える
+    position_.swap(cubes.position_);
+    prev_position_.swap(cubes.prev_position_);
+    tween_.swap(cubes.tween_);
+
+    tween_pool_.reserve(row_num_ * ROW_WIDTH);
+    block_position_.swap(cubes.block_position_);
+    block_position_new_.swap(cubes.block_position_new_);
+    color_.swap(cubes.color_);
+    flags_.swap(cubes.flags_);
+  }
+
+  explicit StageCubes(const int row_num) noexcept :
+    row_num_(row_num),
+    head_row_(0),
+    tail_row_(0)
+  {
+    allocate(row_num_);
+  }
 
-  bool can_ride;
-  bool active;
 };
 
 }
@@ -5,17 +5,65 @@
 //
 
 #include "Params.hpp"
+#include "StageFormat.hpp"
+#include "StageSource.hpp"
+#include "StageGenerator.hpp"
 
 
 namespace ngs { namespace StageData {
 
-ci::JsonTree load(const std::string& path) noexcept {
+namespace detail {
+
+CompiledStage compile(const std::string& path) noexcept {
 #if defined (OBFUSCATION_STAGES)
   auto file_path = replaceFilenameExt(path, "data");
-  return ci::JsonTree(TextCodec::load(Asset::fullPath(file_path)));
+  CompiledStage stage(StageFormat::compile(ci::JsonTree(TextCodec::load(Asset::fullPath(file_path)))));
 #else
-  return ci::JsonTree(Asset::load(path));
+  CompiledStage stage(StageFormat::compile(ci::JsonTree(Asset::load(path))));
+#endif
+  if (stage.isValid()) return stage;
+
+  // 扱えないStageは空にする
+  DOUT << "StageData: can't compile " << path << std::endl;
+  return CompiledStage(StageFormat::empty());
+}
+
+}
+
+// TIPS:JSONで用意した場合もバイナリ形式に変換して扱う
+CompiledStage load(const std::string& path) noexcept {
+#if defined (COMPILED_STAGES)
+  auto file_path = replaceFilenameExt(path, "stage");
+  CompiledStage stage(std::make_shared<MappedFile>(Asset::fullPath(file_path)));
+  if (stage.isValid()) return stage;
+
+  // 壊れているか古い形式のファイルはJSONから作り直す
+  DOUT << "StageData: invalid " << file_path << std::endl;
 #endif
+  return detail::compile(path);
+}
+
+// 行ごとに読み出す供給元を用意
+// TIPS:repeatを指定すると同じStageを繰り返す(耐久テスト用)
+std::shared_ptr<StageSource> open(const std::string& path, const int repeat = 1) noexcept {
+  return std::make_shared<StageFileSource>(load(path), repeat);
+}
+
+// 自動生成したStageから読み出す供給元を用意
+// TIPS:同じsettingsとseedなら同じStageになる
+std::shared_ptr<StageSource> generate(const StageGenerator::Settings& settings,
+                                      const u_int seed, const int repeat = 1) noexcept {
+  if (!settings.isValid()) {
+    DOUT << "StageData: invalid generator settings. width:" << settings.width << std::endl;
+    return std::make_shared<StageFileSource>(CompiledStage(StageFormat::empty()));
+  }
+
+  CompiledStage stage(StageFormat::compile(StageGenerator::generate(settings, seed)));
+  if (!stage.isValid()) {
+    DOUT << "StageData: can't compile generated stage. seed:" << seed << std::endl;
+    return std::make_shared<StageFileSource>(CompiledStage(StageFormat::empty()));
+  }
+  return std::make_shared<StageFileSource>(std::move(stage), repeat);
 }
 
 #ifdef DEBUG
@@ -5,7 +5,11 @@
 //
 
 #include "FallingCube.hpp"
+#include "Occupancy.hpp"
+#include "StageSource.hpp"
+#include "Profiler.hpp"
 #include <boost/noncopyable.hpp>
+#include <cinder/Rand.h>
 
 
 namespace ngs {
@@ -13,21 +17,9 @@ namespace ngs {
 class StageFallingCubes : private boost::noncopyable {
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
 
-  struct Entry {
-    ci::Vec3i position;
-    float interval;
-    float delay;
-
-    Entry(const ci::Vec3i& position_,
-          const float interval_, const float delay_) noexcept :
-      position(position_),
-      interval(interval_),
-      delay(delay_)
-    {}
-  };
-  
-  std::vector<Entry> entry_cubes_;
+  StageSourceQueue sources_;
 
   // VS2013には暗黙のmoveコンストラクタが無いのでstd::unique_ptrで保持
   // std::vectorに格納するときに、copyやmoveコンストラクタが呼ばれる
@@ -36,19 +28,27 @@ class StageFallingCubes : private boost::noncopyable {
 
   ci::TimelineRef timeline_;
 
+  BlockGrid<FallingCube>& grid_;
+
   
 public:
   StageFallingCubes(ci::JsonTree& params,
                     ci::TimelineRef timeline,
-                    Event<EventParam>& event) noexcept :
+                    Event<EventParam>& event,
+                    ci::Rand& rand,
+                    Occupancy& occupancy) noexcept :
     params_(params),
     event_(event),
-    timeline_(timeline)
+    rand_(rand),
+    timeline_(timeline),
+    grid_(occupancy.falling_cubes)
   {}
 
   
   void update(const double progressing_seconds,
               const Stage& stage) noexcept {
+    PROFILE_ZONE("StageFallingCubes::update");
+
     for (auto& cube : cubes_) {
       cube->update(progressing_seconds);
     }
@@ -56,8 +56,11 @@ public:
     decideEachCubeFalling(stage);
     
     boost::remove_erase_if(cubes_,
-                           [](const FallingCubePtr& cube) {
-                             return !cube->isActive();
+                           [this](const FallingCubePtr& cube) {
+                             if (cube->isActive()) return false;
+
+                             grid_.remove(*cube);
+                             return true;
                            });
   }
 
@@ -65,49 +68,43 @@ public:
   void cleanup() noexcept { }
   
   void clear() noexcept {
-    entry_cubes_.clear();
+    sources_.clear();
   }
 
 
-  void addCubes(const ci::JsonTree& params, const int start_z, const int x_offset) noexcept {
-    if (!params.hasChild("falling")) return;
-
-    ci::Vec3i start_pos(x_offset, 0, start_z);
-
-    for (const auto& p : params["falling"]) {
-      auto entry_pos = Json::getVec3<int>(p["entry"]) + start_pos;
-      auto interval  = p["interval"].getValue<float>();
-      auto delay     = p["delay"].getValue<float>();
-
-      entry_cubes_.emplace_back(entry_pos, interval, delay);
-    }
+  void addCubes(const std::shared_ptr<StageSource>& source, const int start_z, const int x_offset) noexcept {
+    sources_.push(source, start_z, x_offset);
   }
 
   void entryCube(const int current_z) noexcept {
-    for (const auto& entry : entry_cubes_) {
-      if (entry.position.z == current_z) {
-        cubes_.emplace_back(new FallingCube(params_,
-                                            timeline_, event_,
-                                            entry.position,
-                                            entry.interval, entry.delay));
-      }
+    const auto* entry = sources_.find(current_z);
+    if (!entry) return;
+
+    ci::Vec3i start_pos(entry->x, 0, entry->offsetZ(current_z));
+    for (const auto& p : entry->source->falling(current_z - entry->z)) {
+      auto entry_pos = CompiledStage::toVec3i(p.entry) + start_pos;
+      cubes_.emplace_back(new FallingCube(params_,
+                                          timeline_, event_, rand_,
+                                          entry_pos,
+                                          p.interval, p.delay));
+      // ドッスンは移動しないので登録は一度だけ
+      grid_.update(*cubes_.back(), entry_pos);
     }
   }
 
   bool isCubeExists(const ci::Vec3i& block_pos) const noexcept {
-    for (const auto& cube : cubes_) {
-      if (cube->canBlock() && (block_pos == cube->blockPosition())) return true;
-    }
-    return false;
+    return grid_.find(block_pos,
+                      [&block_pos](const FallingCube& cube) {
+                        return cube.canBlock() && (block_pos == cube.blockPosition());
+                      }) != nullptr;
   }
 
   bool isCubePressed(const ci::Vec3i& block_pos) const noexcept {
-    for (const auto& cube : cubes_) {
-      if (block_pos != cube->blockPosition()) continue;
-      
-      return cube->canPress();
-    }
-    return false;
+    const auto* cube = grid_.find(block_pos,
+                                  [&block_pos](const FallingCube& cube) {
+                                    return block_pos == cube.blockPosition();
+                                  });
+    return cube && cube->canPress();
   }
 
   
@@ -123,7 +120,8 @@ private:
       if (!height.first) {
         cube->fallFromStage();
 
-        event_.signal("fall-falling", EventParam());
+        static const EventId fall_falling("fall-falling");
+        event_.signal(fall_falling, EventParam());
       }
     }
   }
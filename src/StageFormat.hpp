@@ -0,0 +1,449 @@
+﻿#pragma once
+
+//
+// Stageのバイナリ形式
+//   固定長のヘッダ、高さの格子、種類ごとの配置テーブルを並べる
+//   マップした領域をそのまま参照できるように、すべて4byte境界に揃えている
+//   配置物のテーブルはzの順に並べてあり、行ごとに先頭から読み進められる
+//   TIPS:対象環境はすべてリトルエンディアン
+//
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <map>
+#include <algorithm>
+#include <boost/range/iterator_range.hpp>
+#include "JsonUtil.hpp"
+#include "MappedFile.hpp"
+
+
+namespace ngs {
+
+namespace StageFormat {
+
+enum {
+  // "BTSG"
+  MAGIC   = 0x47535442,
+  VERSION = 2,
+
+  NAME_LENGTH = 16,
+
+  // 1行の最大数(StageCubes::ROW_WIDTH)
+  MAX_WIDTH = 16,
+};
+
+enum {
+  HAS_BUILD_SPEED    = 1 << 0,
+  HAS_COLLAPSE_SPEED = 1 << 1,
+  HAS_AUTO_COLLAPSE  = 1 << 2,
+};
+
+
+struct Position {
+  int32_t x, y, z;
+};
+
+// 先頭からのbyte位置と要素数
+struct Table {
+  u_int offset;
+  u_int num;
+};
+
+struct Header {
+  u_int magic;
+  u_int version;
+  u_int size;
+  u_int flags;
+
+  int32_t x_offset;
+  int32_t pickable;
+
+  float build_speed;
+  float collapse_speed;
+  float auto_collapse;
+
+  float color[3];
+  float bg_color[3];
+
+  char light_tween[NAME_LENGTH];
+  char camera[NAME_LENGTH];
+
+  // 行ごとにwidth個の高さ(負の値はCube無し)
+  u_int width;
+  u_int depth;
+  Table height;
+
+  Table items;
+  Table moving;
+  Table patterns;
+  Table falling;
+  Table switches;
+  Table targets;
+  Table oneways;
+};
+
+struct Moving {
+  Position entry;
+  u_int pattern_index;
+  u_int pattern_num;
+};
+
+struct Falling {
+  Position entry;
+  float interval;
+  float delay;
+};
+
+struct Switch {
+  Position position;
+  u_int target_index;
+  u_int target_num;
+};
+
+struct Oneway {
+  Position position;
+  // Oneway::UP 〜 Oneway::RIGHT
+  int32_t direction;
+  int32_t power;
+};
+
+
+// JSONから変換
+// TIPS:行がMAX_WIDTHより長いStageは扱えないので、空の結果を返す
+std::string compile(const ci::JsonTree& stage) noexcept {
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+
+  header.magic   = MAGIC;
+  header.version = VERSION;
+
+  header.x_offset = Json::getValue(stage, "x_offset", 0);
+  header.pickable = Json::getValue(stage, "pickable", 0);
+
+  if (stage.hasChild("build_speed")) {
+    header.flags |= HAS_BUILD_SPEED;
+    header.build_speed = stage["build_speed"].getValue<float>();
+  }
+  if (stage.hasChild("collapse_speed")) {
+    header.flags |= HAS_COLLAPSE_SPEED;
+    header.collapse_speed = stage["collapse_speed"].getValue<float>();
+  }
+  if (stage.hasChild("auto_collapse")) {
+    header.flags |= HAS_AUTO_COLLAPSE;
+    header.auto_collapse = stage["auto_collapse"].getValue<float>();
+  }
+
+  auto color    = Json::getColor<float>(stage["color"]);
+  auto bg_color = Json::getColor<float>(stage["bg_color"]);
+  for (int i = 0; i < 3; ++i) {
+    header.color[i]    = color[i];
+    header.bg_color[i] = bg_color[i];
+  }
+
+  auto light_tween = Json::getValue(stage, "light_tween", std::string("normal"));
+  auto camera      = Json::getValue(stage, "camera", std::string("normal"));
+  assert((light_tween.size() < NAME_LENGTH) && (camera.size() < NAME_LENGTH) && "name is too long.");
+  std::strncpy(header.light_tween, light_tween.c_str(), NAME_LENGTH - 1);
+  std::strncpy(header.camera, camera.c_str(), NAME_LENGTH - 1);
+
+  // 高さは短い行を-1で埋めて格子にする
+  // TIPS:Stage::addCubesは最長の行でStageの幅を決めるので、埋めても結果は同じ
+  const auto& body = stage["body"];
+  header.depth = u_int(body.getNumChildren());
+  for (const auto& row : body) {
+    header.width = std::max(header.width, u_int(row.getNumChildren()));
+  }
+  if (header.width > MAX_WIDTH) {
+    DOUT << "StageFormat: too wide " << header.width << std::endl;
+    return std::string();
+  }
+
+  std::vector<signed char> height(header.width * header.depth, -1);
+  {
+    size_t iz = 0;
+    for (const auto& row : body) {
+      size_t ix = 0;
+      for (const auto& p : row) {
+        int y = p.getValue<int>();
+        assert((y < 128) && "stage height is too high.");
+        height[iz * header.width + ix] = static_cast<signed char>(std::max(y, -1));
+        ix += 1;
+      }
+      iz += 1;
+    }
+  }
+
+  auto getPosition = [](const ci::JsonTree& json) {
+    auto pos = Json::getVec3<int>(json);
+    Position p = { pos.x, pos.y, pos.z };
+    return p;
+  };
+
+  std::vector<Position> items;
+  if (stage.hasChild("items")) {
+    for (const auto& entry : stage["items"]) {
+      items.push_back(getPosition(entry));
+    }
+  }
+
+  std::vector<Moving> moving;
+  std::vector<int32_t> patterns;
+  if (stage.hasChild("moving")) {
+    for (const auto& entry : stage["moving"]) {
+      auto pattern = Json::getArray<int>(entry["pattern"]);
+      Moving m = {
+        getPosition(entry["entry"]),
+        u_int(patterns.size()),
+        u_int(pattern.size())
+      };
+      moving.push_back(m);
+      patterns.insert(std::end(patterns), std::begin(pattern), std::end(pattern));
+    }
+  }
+
+  std::vector<Falling> falling;
+  if (stage.hasChild("falling")) {
+    for (const auto& entry : stage["falling"]) {
+      Falling f = {
+        getPosition(entry["entry"]),
+        entry["interval"].getValue<float>(),
+        entry["delay"].getValue<float>()
+      };
+      falling.push_back(f);
+    }
+  }
+
+  std::vector<Switch> switches;
+  std::vector<Position> targets;
+  if (stage.hasChild("switches")) {
+    for (const auto& entry : stage["switches"]) {
+      Switch s = {
+        getPosition(entry["position"]),
+        u_int(targets.size()),
+        u_int(entry["target"].getNumChildren())
+      };
+      switches.push_back(s);
+
+      for (const auto& target : entry["target"]) {
+        targets.push_back(getPosition(target));
+      }
+    }
+  }
+
+  std::vector<Oneway> oneways;
+  if (stage.hasChild("oneways")) {
+    static const std::map<std::string, int> direction = {
+      { "up",    0 },
+      { "down",  1 },
+      { "left",  2 },
+      { "right", 3 },
+    };
+
+    for (const auto& entry : stage["oneways"]) {
+      Oneway o = {
+        getPosition(entry["position"]),
+        direction.at(entry["direction"].getValue<std::string>()),
+        entry["power"].getValue<int>()
+      };
+      oneways.push_back(o);
+    }
+  }
+
+  // 行ごとに読み出せるようにzの順に並べる
+  // TIPS:同じ行の中では記述順を保つ
+  std::stable_sort(std::begin(items), std::end(items),
+                   [](const Position& a, const Position& b) { return a.z < b.z; });
+  std::stable_sort(std::begin(moving), std::end(moving),
+                   [](const Moving& a, const Moving& b) { return a.entry.z < b.entry.z; });
+  std::stable_sort(std::begin(falling), std::end(falling),
+                   [](const Falling& a, const Falling& b) { return a.entry.z < b.entry.z; });
+  std::stable_sort(std::begin(switches), std::end(switches),
+                   [](const Switch& a, const Switch& b) { return a.position.z < b.position.z; });
+  std::stable_sort(std::begin(oneways), std::end(oneways),
+                   [](const Oneway& a, const Oneway& b) { return a.position.z < b.position.z; });
+
+  // ヘッダの後ろにテーブルを並べる
+  std::string output(sizeof(Header), 0);
+
+  auto append = [&output](Table& table, const void* data, const size_t size, const size_t num) {
+    table.offset = u_int(output.size());
+    table.num    = u_int(num);
+
+    if (num) output.append(static_cast<const char*>(data), size * num);
+    // 4byte境界に揃える
+    output.resize((output.size() + 3) & ~size_t(3), 0);
+  };
+
+  append(header.height,   height.data(),   sizeof(signed char), height.size());
+  append(header.items,    items.data(),    sizeof(Position),    items.size());
+  append(header.moving,   moving.data(),   sizeof(Moving),      moving.size());
+  append(header.patterns, patterns.data(), sizeof(int32_t),     patterns.size());
+  append(header.falling,  falling.data(),  sizeof(Falling),     falling.size());
+  append(header.switches, switches.data(), sizeof(Switch),      switches.size());
+  append(header.targets,  targets.data(),  sizeof(Position),    targets.size());
+  append(header.oneways,  oneways.data(),  sizeof(Oneway),      oneways.size());
+
+  header.size = u_int(output.size());
+  std::memcpy(&output[0], &header, sizeof(header));
+
+  return output;
+}
+
+// 何も無いStage
+// TIPS:読み込めなかったStageの代わりに使う
+std::string empty() noexcept {
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+
+  header.magic   = MAGIC;
+  header.version = VERSION;
+  header.size    = sizeof(Header);
+
+  std::strncpy(header.light_tween, "normal", NAME_LENGTH - 1);
+  std::strncpy(header.camera, "normal", NAME_LENGTH - 1);
+
+  for (auto* table : { &header.height, &header.items, &header.moving, &header.patterns,
+                       &header.falling, &header.switches, &header.targets, &header.oneways }) {
+    table->offset = sizeof(Header);
+  }
+
+  return std::string(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+}
+
+
+// 変換済みのStage
+//   中身はマップしたファイルかメモリ上のデータを直接参照する
+class CompiledStage {
+  std::shared_ptr<MappedFile> file_;
+  const StageFormat::Header* header_;
+
+
+public:
+  explicit CompiledStage(std::shared_ptr<MappedFile> file) noexcept :
+    file_(std::move(file)),
+    header_(reinterpret_cast<const StageFormat::Header*>(file_->data()))
+  {}
+
+  explicit CompiledStage(std::string bytes) noexcept :
+    CompiledStage(std::make_shared<MappedFile>(MappedFile::InMemory(), std::move(bytes)))
+  {}
+
+
+  // TIPS:壊れたファイルや古いファイルを範囲外まで読まないよう、
+  //      すべてのテーブルと添字の範囲をビルド設定に関係なく調べる
+  bool isValid() const noexcept {
+    if (!header_
+        || (file_->size() < sizeof(StageFormat::Header))
+        || (header_->magic != StageFormat::MAGIC)
+        || (header_->version != StageFormat::VERSION)
+        || (header_->size != file_->size())) return false;
+
+    const auto& h = *header_;
+    if (!inRange(h.height,   sizeof(signed char))
+        || !inRange(h.items,    sizeof(StageFormat::Position))
+        || !inRange(h.moving,   sizeof(StageFormat::Moving))
+        || !inRange(h.patterns, sizeof(int32_t))
+        || !inRange(h.falling,  sizeof(StageFormat::Falling))
+        || !inRange(h.switches, sizeof(StageFormat::Switch))
+        || !inRange(h.targets,  sizeof(StageFormat::Position))
+        || !inRange(h.oneways,  sizeof(StageFormat::Oneway))) return false;
+
+    if ((h.width > StageFormat::MAX_WIDTH)
+        || (uint64_t(h.width) * h.depth != h.height.num)) return false;
+
+    // 名前はNUL終端されていること
+    if (!isTerminated(h.light_tween) || !isTerminated(h.camera)) return false;
+
+    for (const auto& m : moving()) {
+      if (uint64_t(m.pattern_index) + m.pattern_num > h.patterns.num) return false;
+    }
+    for (const auto& s : switches()) {
+      if (uint64_t(s.target_index) + s.target_num > h.targets.num) return false;
+    }
+    return true;
+  }
+
+  const StageFormat::Header& header() const noexcept { return *header_; }
+
+  ci::Color color() const noexcept {
+    return ci::Color(header_->color[0], header_->color[1], header_->color[2]);
+  }
+
+  ci::Color bgColor() const noexcept {
+    return ci::Color(header_->bg_color[0], header_->bg_color[1], header_->bg_color[2]);
+  }
+
+  std::string lightTween() const noexcept { return std::string(header_->light_tween); }
+  std::string camera() const noexcept { return std::string(header_->camera); }
+
+  int width() const noexcept { return int(header_->width); }
+  int depth() const noexcept { return int(header_->depth); }
+
+  // iz行目の高さ(width個)
+  const signed char* row(const int iz) const noexcept {
+    return table<signed char>(header_->height).begin() + iz * header_->width;
+  }
+
+  boost::iterator_range<const StageFormat::Position*> items() const noexcept {
+    return table<StageFormat::Position>(header_->items);
+  }
+
+  boost::iterator_range<const StageFormat::Moving*> moving() const noexcept {
+    return table<StageFormat::Moving>(header_->moving);
+  }
+
+  boost::iterator_range<const int32_t*> pattern(const StageFormat::Moving& moving) const noexcept {
+    auto patterns = table<int32_t>(header_->patterns).begin() + moving.pattern_index;
+    return boost::make_iterator_range(patterns, patterns + moving.pattern_num);
+  }
+
+  boost::iterator_range<const StageFormat::Falling*> falling() const noexcept {
+    return table<StageFormat::Falling>(header_->falling);
+  }
+
+  boost::iterator_range<const StageFormat::Switch*> switches() const noexcept {
+    return table<StageFormat::Switch>(header_->switches);
+  }
+
+  boost::iterator_range<const StageFormat::Position*> targets(const StageFormat::Switch& s) const noexcept {
+    auto targets = table<StageFormat::Position>(header_->targets).begin() + s.target_index;
+    return boost::make_iterator_range(targets, targets + s.target_num);
+  }
+
+  boost::iterator_range<const StageFormat::Oneway*> oneways() const noexcept {
+    return table<StageFormat::Oneway>(header_->oneways);
+  }
+
+
+  static ci::Vec3i toVec3i(const StageFormat::Position& pos) noexcept {
+    return ci::Vec3i(pos.x, pos.y, pos.z);
+  }
+
+
+private:
+  static bool isTerminated(const char (&name)[StageFormat::NAME_LENGTH]) noexcept {
+    return std::memchr(name, '\0', sizeof(name)) != nullptr;
+  }
+
+  // テーブルがヘッダより後ろ、ファイルの内側に収まっているか
+
+  bool inRange(const StageFormat::Table& t, const size_t element_size) const noexcept {
+    return (t.offset >= sizeof(StageFormat::Header))
+      && !(t.offset & 3)
+      && (uint64_t(t.offset) + uint64_t(t.num) * element_size <= file_->size());
+  }
+
+  template <typename T>
+  boost::iterator_range<const T*> table(const StageFormat::Table& t) const noexcept {
+    const T* top = reinterpret_cast<const T*>(file_->data() + t.offset);
+    return boost::make_iterator_range(top, top + t.num);
+  }
+
+};
+
+}
@@ -0,0 +1,210 @@
+﻿#pragma once
+
+//
+// Stageの自動生成
+//   通り道を蛇行させながら1行ずつ作り、周りに壁と穴を散らす
+//   出力は手作りのStageと同じ形式のJSON
+//   TIPS:乱数はseedごとに持つので、複数のスレッドで同時に生成できる
+//
+
+#include <vector>
+#include <algorithm>
+#include <cinder/Json.h>
+#include <cinder/Rand.h>
+#include <cinder/CinderMath.h>
+#include "JsonUtil.hpp"
+#include "StageFormat.hpp"
+
+
+namespace ngs { namespace StageGenerator {
+
+// 生成に使う乱数の範囲など(params/stagegen.json)
+struct Settings {
+  int width;
+  ci::Vec2i depth;
+  ci::Vec2i corridor_width;
+  float turn_rate;
+  float wall_rate;
+  float hole_rate;
+  int   margin_rows;
+
+  ci::Vec2i items;
+  ci::Vec2i falling;
+  ci::Vec2f falling_interval;
+
+  ci::Vec2f build_speed;
+  ci::Vec2f collapse_speed;
+  ci::Vec2f auto_collapse;
+
+  int pickable;
+
+
+  explicit Settings(const ci::JsonTree& params) noexcept :
+    width(params["width"].getValue<int>()),
+    depth(Json::getVec2<int>(params["depth"])),
+    corridor_width(Json::getVec2<int>(params["corridor_width"])),
+    turn_rate(params["turn_rate"].getValue<float>()),
+    wall_rate(params["wall_rate"].getValue<float>()),
+    hole_rate(params["hole_rate"].getValue<float>()),
+    margin_rows(params["margin_rows"].getValue<int>()),
+    items(Json::getVec2<int>(params["items"])),
+    falling(Json::getVec2<int>(params["falling"])),
+    falling_interval(Json::getVec2<float>(params["falling_interval"])),
+    build_speed(Json::getVec2<float>(params["build_speed"])),
+    collapse_speed(Json::getVec2<float>(params["collapse_speed"])),
+    auto_collapse(Json::getVec2<float>(params["auto_collapse"])),
+    pickable(params["pickable"].getValue<int>())
+  {}
+
+  // TIPS:StageはStageFormat::MAX_WIDTHより広くできない
+  bool isValid() const noexcept {
+    return (width > 0) && (width <= StageFormat::MAX_WIDTH);
+  }
+};
+
+
+namespace detail {
+
+// [min, max]の範囲
+int randRange(ci::Rand& rand, const ci::Vec2i& range) noexcept {
+  return rand.nextInt(range.x, range.y + 1);
+}
+
+float randRange(ci::Rand& rand, const ci::Vec2f& range) noexcept {
+  return rand.nextFloat(range.x, range.y);
+}
+
+ci::JsonTree makeVec3(const std::string& key, const int x, const int y, const int z) noexcept {
+  ci::JsonTree json = ci::JsonTree::makeArray(key);
+  json.pushBack(ci::JsonTree("", x))
+    .pushBack(ci::JsonTree("", y))
+    .pushBack(ci::JsonTree("", z));
+  return json;
+}
+
+ci::JsonTree makeColor(const std::string& key, const ci::Color& color) noexcept {
+  ci::JsonTree json = ci::JsonTree::makeArray(key);
+  json.pushBack(ci::JsonTree("", color.r))
+    .pushBack(ci::JsonTree("", color.g))
+    .pushBack(ci::JsonTree("", color.b));
+  return json;
+}
+
+}
+
+
+ci::JsonTree generate(const Settings& settings, const u_int seed) noexcept {
+  assert(settings.isValid() && "invalid settings.");
+  ci::Rand rand(seed);
+
+  const int width = settings.width;
+  const int depth = detail::randRange(rand, settings.depth);
+
+  // 高さ(-1:穴 0:通り道 1:壁)
+  std::vector<int> height(width * depth, 0);
+  // 必ず通れる道筋(アイテムやドッスンを置かない)
+  std::vector<bool> spine(width * depth, false);
+
+  int center   = width / 2;
+  int corridor = detail::randRange(rand, settings.corridor_width);
+  for (int iz = 0; iz < depth; ++iz) {
+    int* row = &height[iz * width];
+
+    // 前後のStageとつながるように、先頭と末尾は全面を通れるようにしておく
+    if ((iz < settings.margin_rows) || (iz >= (depth - settings.margin_rows))) {
+      std::fill(row, row + width, 0);
+      spine[iz * width + center] = true;
+      continue;
+    }
+
+    if (rand.nextFloat() < settings.turn_rate) {
+      // 道筋を左右にずらす時は、つながるように一度幅を広げる
+      int next_center = ci::math<int>::clamp(center + (rand.nextBool() ? 1 : -1), 0, width - 1);
+      spine[iz * width + center] = true;
+      center = next_center;
+      corridor = detail::randRange(rand, settings.corridor_width);
+    }
+    spine[iz * width + center] = true;
+
+    int left  = std::max(center - corridor / 2, 0);
+    int right = std::min(left + corridor, width);
+    for (int ix = 0; ix < width; ++ix) {
+      if (spine[iz * width + ix]) {
+        row[ix] = 0;
+      }
+      else if ((ix >= left) && (ix < right)) {
+        row[ix] = (rand.nextFloat() < settings.hole_rate) ? -1 : 0;
+      }
+      else {
+        row[ix] = (rand.nextFloat() < settings.wall_rate) ? 1 : -1;
+      }
+    }
+  }
+
+  // 道筋以外の通り道にItemとドッスンを置く
+  std::vector<int> free_cells;
+  for (int i = 0; i < (width * depth); ++i) {
+    int iz = i / width;
+    if ((height[i] == 0) && !spine[i]
+        && (iz >= settings.margin_rows) && (iz < (depth - settings.margin_rows))) {
+      free_cells.push_back(i);
+    }
+  }
+  for (size_t i = free_cells.size(); i > 1; --i) {
+    std::swap(free_cells[i - 1], free_cells[rand.nextInt(int(i))]);
+  }
+  int item_num    = std::min(detail::randRange(rand, settings.items), int(free_cells.size()));
+  int falling_num = std::min(detail::randRange(rand, settings.falling), int(free_cells.size()) - item_num);
+
+  ci::JsonTree stage = ci::JsonTree::makeObject();
+
+  float hue = rand.nextFloat();
+  stage.addChild(detail::makeColor("color", ci::Color(ci::CM_HSV, hue, 0.55f, 0.9f)))
+    .addChild(detail::makeColor("bg_color", ci::Color(ci::CM_HSV, hue, 0.25f, 0.6f)))
+    .addChild(ci::JsonTree("light_tween", std::string("normal")))
+    .addChild(ci::JsonTree("camera", std::string("normal")))
+    .addChild(ci::JsonTree("x_offset", 0))
+    .addChild(ci::JsonTree("pickable", settings.pickable))
+    .addChild(ci::JsonTree("build_speed", detail::randRange(rand, settings.build_speed)))
+    .addChild(ci::JsonTree("collapse_speed", detail::randRange(rand, settings.collapse_speed)))
+    .addChild(ci::JsonTree("auto_collapse", detail::randRange(rand, settings.auto_collapse)));
+
+  {
+    ci::JsonTree body = ci::JsonTree::makeArray("body");
+    for (int iz = 0; iz < depth; ++iz) {
+      ci::JsonTree row = ci::JsonTree::makeArray();
+      for (int ix = 0; ix < width; ++ix) {
+        row.pushBack(ci::JsonTree("", height[iz * width + ix]));
+      }
+      body.pushBack(row);
+    }
+    stage.addChild(body);
+  }
+
+  {
+    ci::JsonTree items = ci::JsonTree::makeArray("items");
+    for (int i = 0; i < item_num; ++i) {
+      int cell = free_cells[i];
+      items.pushBack(detail::makeVec3("", cell % width, 0, cell / width));
+    }
+    stage.addChild(items);
+  }
+
+  if (falling_num > 0) {
+    ci::JsonTree falling = ci::JsonTree::makeArray("falling");
+    for (int i = 0; i < falling_num; ++i) {
+      int cell = free_cells[item_num + i];
+
+      ci::JsonTree entry;
+      entry.addChild(detail::makeVec3("entry", cell % width, 0, cell / width))
+        .addChild(ci::JsonTree("interval", detail::randRange(rand, settings.falling_interval)))
+        .addChild(ci::JsonTree("delay", rand.nextFloat(0.0f, 1.0f)));
+      falling.pushBack(entry);
+    }
+    stage.addChild(falling);
+  }
+
+  return stage;
+}
+
+} }
@@ -5,8 +5,12 @@
 //
 
 #include <boost/noncopyable.hpp>
+#include <cinder/Rand.h>
 #include "Stage.hpp"
 #include "ItemCube.hpp"
+#include "Occupancy.hpp"
+#include "StageSource.hpp"
+#include "Profiler.hpp"
 
 
 namespace ngs {
@@ -14,8 +18,9 @@ namespace ngs {
 class StageItems : private boost::noncopyable {
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
   
-  std::vector<ci::Vec3i> entry_items_;
+  StageSourceQueue sources_;
 
   // VS2013には暗黙のmoveコンストラクタが無いのでstd::unique_ptrで保持
   // std::vectorに格納するときに、copyやmoveコンストラクタが呼ばれる
@@ -24,16 +29,22 @@ class StageItems : private boost::noncopyable {
 
   ci::TimelineRef timeline_;
   ci::TimelineRef event_timeline_;
+
+  BlockGrid<ItemCube>& grid_;
   
 
 public:
   StageItems(ci::JsonTree& params,
              ci::TimelineRef timeline,
-             Event<EventParam>& event) noexcept :
+             Event<EventParam>& event,
+             ci::Rand& rand,
+             Occupancy& occupancy) noexcept :
     params_(params),
     event_(event),
+    rand_(rand),
     timeline_(timeline),
-    event_timeline_(ci::Timeline::create())
+    event_timeline_(ci::Timeline::create()),
+    grid_(occupancy.item_cubes)
   {
     auto current_time = timeline->getCurrentTime();
     event_timeline_->setStartTime(current_time);
@@ -46,6 +57,8 @@ public:
 
 
   void update(const double progressing_seconds, const Stage& stage) noexcept {
+    PROFILE_ZONE("StageItems::update");
+
     for (auto& cube : items_) {
       cube->update(progressing_seconds);
     }
@@ -53,8 +66,11 @@ public:
     decideEachItemCubeFalling(stage);
     
     boost::remove_erase_if(items_,
-                           [](const ItemCubePtr& cube) {
-                             return !cube->isActive();
+                           [this](const ItemCubePtr& cube) {
+                             if (cube->isActive()) return false;
+
+                             grid_.remove(*cube);
+                             return true;
                            });
   }
 
@@ -65,40 +81,40 @@ public:
   
   
   void clear() noexcept {
-    entry_items_.clear();
+    sources_.clear();
   }
   
-  int addItemCubes(const ci::JsonTree& params, const int start_z, const int x_offset) noexcept {
-    if (!params.hasChild("items")) return 0;
-
-    ci::Vec3i start_pos(x_offset, 0, start_z);
+  int addItemCubes(const std::shared_ptr<StageSource>& source, const int start_z, const int x_offset) noexcept {
+    sources_.push(source, start_z, x_offset);
 
-    for (const auto& entry : params["items"]) {
-      entry_items_.push_back(Json::getVec3<int>(entry) + start_pos);
-    }
-
-    return static_cast<int>(entry_items_.size());
+    return source->itemNum();
   }
 
   void entryItemCube(const int current_z) noexcept {
-    for (const auto& entry : entry_items_) {
-      if (entry.z == current_z) {
-        items_.emplace_back(new ItemCube(params_, timeline_, event_, entry));
-      }
+    const auto* entry = sources_.find(current_z);
+    if (!entry) return;
+
+    ci::Vec3i start_pos(entry->x, 0, entry->offsetZ(current_z));
+    for (const auto& p : entry->source->items(current_z - entry->z)) {
+      auto pos = CompiledStage::toVec3i(p) + start_pos;
+      items_.emplace_back(new ItemCube(params_, timeline_, event_, rand_, pos));
+      // 移動はyだけなので登録は一度だけ
+      grid_.update(*items_.back(), pos);
     }
   }
 
 
   std::pair<bool, u_int> canGetItemCube(const ci::Vec3i& block_pos) noexcept {
     if (items_.empty()) return std::make_pair(false, 0);
-    
-    for (const auto& cube : items_) {
-      if (cube->isGetatable()
-          && (block_pos == cube->blockPosition())) {
-        return std::make_pair(true, cube->id());
-      }
-    }
-    return std::make_pair(false, 0);
+
+    const auto* cube = grid_.find(block_pos,
+                                  [&block_pos](const ItemCube& cube) {
+                                    return cube.isGetatable()
+                                      && (block_pos == cube.blockPosition());
+                                  });
+    if (!cube) return std::make_pair(false, 0);
+
+    return std::make_pair(true, cube->id());
   }
 
   void pickupItemCube(const u_int id) noexcept {
@@ -111,19 +127,19 @@ public:
 
     // 演出上、signalは時間差で
     event_timeline_->add([this]() {
-        event_.signal("pickuped-item", EventParam());
+        static const EventId pickuped_item("pickuped-item");
+        event_.signal(pickuped_item, EventParam());
       },
       event_timeline_->getCurrentTime() + params_["game.item.pickup_delay"].getValue<float>());
   }
   
   void moveCube(const ci::Vec3i& block_pos) noexcept {
-    for (auto& cube : items_) {
-      const auto& cube_block_pos = cube->blockPosition();
-      if ((cube_block_pos.x == block_pos.x) && (cube_block_pos.z == block_pos.z)) {
-        cube->moveDown();
-        return;
-      }
-    }
+    auto* cube = grid_.find(block_pos,
+                            [&block_pos](const ItemCube& cube) {
+                              const auto& cube_block_pos = cube.blockPosition();
+                              return (cube_block_pos.x == block_pos.x) && (cube_block_pos.z == block_pos.z);
+                            });
+    if (cube) cube->moveDown();
   }
 
   
@@ -139,7 +155,8 @@ private:
       if (!height.first) {
         cube->fallFromStage();
 
-        event_.signal("fall-item", EventParam());
+        static const EventId fall_item("fall-item");
+        event_.signal(fall_item, EventParam());
       }
     }
   }
@@ -5,7 +5,12 @@
 //
 
 #include "MovingCube.hpp"
+#include "PickableCube.hpp"
+#include "Occupancy.hpp"
+#include "StageSource.hpp"
+#include "Profiler.hpp"
 #include <boost/noncopyable.hpp>
+#include <cinder/Rand.h>
 
 
 namespace ngs {
@@ -13,17 +18,9 @@ namespace ngs {
 class StageMovingCubes : private boost::noncopyable {
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
 
-  struct Entry {
-    ci::Vec3i pos;
-    std::vector<int> move_pattern;
-
-    Entry(const ci::Vec3i& pos_, const std::vector<int>& move_pattern_) noexcept :
-      pos(pos_),
-      move_pattern(move_pattern_)
-    {}
-  };
-  std::vector<Entry> entry_cubes_;
+  StageSourceQueue sources_;
 
   // VS2013には暗黙のmoveコンストラクタが無いのでstd::unique_ptrで保持
   // std::vectorに格納するときに、copyやmoveコンストラクタが呼ばれる
@@ -32,30 +29,44 @@ class StageMovingCubes : private boost::noncopyable {
 
   ci::TimelineRef timeline_;
 
+  BlockGrid<MovingCube>& grid_;
+  const BlockGrid<PickableCube>& pickable_grid_;
+
   
 public:
   StageMovingCubes(ci::JsonTree& params,
              ci::TimelineRef timeline,
-                   Event<EventParam>& event) noexcept :
+                   Event<EventParam>& event,
+                   ci::Rand& rand,
+                   Occupancy& occupancy) noexcept :
     params_(params),
     event_(event),
-    timeline_(timeline)
+    rand_(rand),
+    timeline_(timeline),
+    grid_(occupancy.moving_cubes),
+    pickable_grid_(occupancy.pickable_cubes)
   {}
 
   
   void update(const double progressing_seconds,
-              const Stage& stage,
-              const std::vector<ci::Vec3i>& pickables) noexcept {
+              const Stage& stage) noexcept {
+    PROFILE_ZONE("StageMovingCubes::update");
+
     for (auto& cube : cubes_) {
       cube->update(progressing_seconds);
+      // 移動が終わったら直前の位置を登録から外す
+      updateGrid(*cube);
     }
     
     decideEachCubeFalling(stage);
-    decideEachCubeMoving(stage, pickables);
+    decideEachCubeMoving(stage);
     
     boost::remove_erase_if(cubes_,
-                           [](const MovingCubePtr& cube) {
-                             return !cube->isActive();
+                           [this](const MovingCubePtr& cube) {
+                             if (cube->isActive()) return false;
+
+                             grid_.remove(*cube);
+                             return true;
                            });
   }
 
@@ -63,50 +74,47 @@ public:
   void cleanup() noexcept { }
   
   void clear() noexcept {
-    entry_cubes_.clear();
+    sources_.clear();
   }
 
 
-  void addCubes(const ci::JsonTree& params, const int start_z, const int x_offset) noexcept {
-    if (!params.hasChild("moving")) return;
-
-    ci::Vec3i start_pos(x_offset, 0, start_z);
-
-    for (const auto& p : params["moving"]) {
-      entry_cubes_.emplace_back(Json::getVec3<int>(p["entry"]) + start_pos,
-                                Json::getArray<int>(p["pattern"]));
-    }
+  void addCubes(const std::shared_ptr<StageSource>& source, const int start_z, const int x_offset) noexcept {
+    sources_.push(source, start_z, x_offset);
   }
 
   void entryCube(const int current_z) noexcept {
-    for (const auto& entry : entry_cubes_) {
-      if (entry.pos.z == current_z) {
-        cubes_.emplace_back(new MovingCube(params_,
-                                           timeline_, event_,
-                                           entry.pos, entry.move_pattern));
-      }
+    const auto* entry = sources_.find(current_z);
+    if (!entry) return;
+
+    ci::Vec3i start_pos(entry->x, 0, entry->offsetZ(current_z));
+    for (const auto& p : entry->source->moving(current_z - entry->z)) {
+      auto pattern = entry->source->pattern(p);
+      cubes_.emplace_back(new MovingCube(params_,
+                                         timeline_, event_, rand_,
+                                         CompiledStage::toVec3i(p.entry) + start_pos,
+                                         std::vector<int>(std::begin(pattern), std::end(pattern))));
+      updateGrid(*cubes_.back());
     }
   }
 
   bool isCubeExists(const ci::Vec3i& block_pos) const noexcept {
-    for (const auto& cube : cubes_) {
-      if (block_pos == cube->blockPosition()) return true;
-
-      // 移動中の場合は直前の位置も判定
-      if (cube->isMoving()
-          && (block_pos == cube->prevBlockPosition())) return true;
-    }
-    return false;
+    return grid_.find(block_pos,
+                      [&block_pos](const MovingCube& cube) {
+                        if (block_pos == cube.blockPosition()) return true;
+
+                        // 移動中の場合は直前の位置も判定
+                        return cube.isMoving()
+                          && (block_pos == cube.prevBlockPosition());
+                      }) != nullptr;
   }
 
   void moveCube(const ci::Vec3i& block_pos) noexcept {
-    for (auto& cube : cubes_) {
-      const auto& cube_block_pos = cube->blockPosition();
-      if ((cube_block_pos.x == block_pos.x) && (cube_block_pos.z == block_pos.z)) {
-        cube->moveDown();
-        return;
-      }
-    }
+    auto* cube = grid_.find(block_pos,
+                            [&block_pos](const MovingCube& cube) {
+                              const auto& cube_block_pos = cube.blockPosition();
+                              return (cube_block_pos.x == block_pos.x) && (cube_block_pos.z == block_pos.z);
+                            });
+    if (cube) cube->moveDown();
   }
 
   
@@ -114,8 +122,7 @@ public:
 
   
 private:
-  void decideEachCubeMoving(const Stage& stage,
-                            const std::vector<ci::Vec3i>& pickables) noexcept {
+  void decideEachCubeMoving(const Stage& stage) noexcept {
     for (auto& cube : cubes_) {
       if (cube->willRotationMove()) {
         // 移動できなかったときにすこし間をおいて
@@ -128,12 +135,13 @@ private:
         if (isOtherMovingCubeExists(cube, moving_pos)) continue;
 
         // 他のPickableがいたらダメ
-        if (isPickableCubeExists(moving_pos, pickables)) continue;
+        if (isPickableCubeExists(moving_pos)) continue;
 
         // stageの高さが違ったらダメ
         if (!isStageHeightSame(moving_pos, stage)) continue;
         
         cube->startRotationMove();
+        updateGrid(*cube);
       }
     }
   }
@@ -146,7 +154,8 @@ private:
       if (!height.first) {
         cube->fallFromStage();
 
-        event_.signal("fall-moving", EventParam());
+        static const EventId fall_moving("fall-moving");
+        event_.signal(fall_moving, EventParam());
       }
     }
   }
@@ -154,25 +163,26 @@ private:
 
   bool isOtherMovingCubeExists(const MovingCubePtr& cube,
                                const ci::Vec3i& block_pos) const noexcept {
-    for (const auto& other_cube : cubes_) {
-      if (*cube == *other_cube) continue;
+    return grid_.find(block_pos,
+                      [&cube, &block_pos](const MovingCube& other_cube) {
+                        if (*cube == other_cube) return false;
 
-      if (block_pos == other_cube->blockPosition()) return true;
+                        if (block_pos == other_cube.blockPosition()) return true;
 
-      // 移動中の場合は直前の位置も判定
-      if (other_cube->isMoving()
-          && block_pos == other_cube->prevBlockPosition()) return true;
-      
-    }
-    return false;
+                        // 移動中の場合は直前の位置も判定
+                        return other_cube.isMoving()
+                          && (block_pos == other_cube.prevBlockPosition());
+                      }) != nullptr;
   }
 
-  bool isPickableCubeExists(const ci::Vec3i& block_pos,
-                            const std::vector<ci::Vec3i>& pickables) const noexcept {
-    for (const auto& pos : pickables) {
-      if (pos == block_pos) return true;
-    }
-    return false;
+  bool isPickableCubeExists(const ci::Vec3i& block_pos) const noexcept {
+    return pickable_grid_.find(block_pos,
+                               [&block_pos](const PickableCube& cube) {
+                                 if (block_pos == cube.blockPosition()) return true;
+
+                                 return cube.isMoving()
+                                   && (block_pos == cube.prevBlockPosition());
+                               }) != nullptr;
   }
 
   bool isStageHeightSame(const ci::Vec3i& block_pos,
@@ -180,6 +190,15 @@ private:
     auto height = stage.getStageHeight(block_pos);
     return height.first && (height.second == block_pos.y);
   }
+
+  void updateGrid(MovingCube& cube) noexcept {
+    if (cube.isMoving()) {
+      grid_.update(cube, cube.blockPosition(), cube.prevBlockPosition());
+    }
+    else {
+      grid_.update(cube, cube.blockPosition());
+    }
+  }
   
 };
 
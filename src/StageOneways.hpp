@@ -5,25 +5,37 @@
 //
 
 #include "Oneway.hpp"
+#include "StageSource.hpp"
+#include "Profiler.hpp"
 #include <boost/noncopyable.hpp>
+#include <cinder/Rand.h>
 
 
 namespace ngs {
 
 class StageOneways : private boost::noncopyable {
+  ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
 
   ci::TimelineRef timeline_;
   ci::TimelineRef event_timeline_;
   
+  // 登場前のonewayは作らず、生成する行に来たら供給元から取り出す
+  StageSourceQueue sources_;
+
   using OnewayPtr = std::unique_ptr<Oneway>;
   std::vector<OnewayPtr> objects_;
 
   
 public:
-  StageOneways(ci::TimelineRef timeline,
-               Event<EventParam>& event) noexcept :
+  StageOneways(ci::JsonTree& params,
+               ci::TimelineRef timeline,
+               Event<EventParam>& event,
+               ci::Rand& rand) noexcept :
+    params_(params),
     event_(event),
+    rand_(rand),
     timeline_(timeline),
     event_timeline_(ci::Timeline::create())
   {
@@ -39,6 +51,8 @@ public:
 
   void update(const double progressing_seconds,
               const Stage& stage) noexcept {
+    PROFILE_ZONE("StageOneways::update");
+
     for (auto& obj : objects_) {
       obj->update(progressing_seconds);
     }
@@ -52,22 +66,20 @@ public:
   }
 
   
-  void addOneways(ci::JsonTree& params,
-                  const ci::JsonTree& entry_params,
+  void addOneways(const std::shared_ptr<StageSource>& source,
                   const int bottom_z, const int offset_x) noexcept {
-    if (!entry_params.hasChild("oneways")) return;
-
-    for (const auto& p : entry_params["oneways"]) {
-      objects_.emplace_back(new Oneway(params, p,
-                                       timeline_, event_,offset_x, bottom_z));
-    }
+    sources_.push(source, bottom_z, offset_x);
   }
 
   void entryOneways(const int current_z) noexcept {
-    for (const auto& obj : objects_) {
-      if (obj->blockPosition().z == current_z) {
-        obj->entry();
-      }
+    const auto* entry = sources_.find(current_z);
+    if (!entry) return;
+
+    for (const auto& p : entry->source->oneways(current_z - entry->z)) {
+      objects_.emplace_back(new Oneway(params_, p,
+                                       timeline_, event_, rand_,
+                                       entry->x, entry->offsetZ(current_z)));
+      objects_.back()->entry();
     }
   }
 
@@ -84,11 +96,7 @@ public:
 
   void clear() noexcept {
     // 待機中のonewayをすべて削除
-    for (auto& cube : objects_) {
-      if (cube->isAlive() && !cube->isActive()) {
-        cube->alive(false);
-      }
-    }
+    sources_.clear();
   }
 
 
@@ -104,7 +112,8 @@ private:
       if (!height.first) {
         obj->fallFromStage();
 
-        event_.signal("fall-oneway", EventParam());
+        static const EventId fall_oneway("fall-oneway");
+        event_.signal(fall_oneway, EventParam());
       }
     }
   }
@@ -0,0 +1,173 @@
+﻿#pragma once
+
+//
+// Stageを通り抜けられるか調べる
+//   Stageは1行ずつ生成され、auto_collapse秒後から後ろの行から崩れていく
+//   PickableCubeが生成済みの行を通って崩壊に追いつかれずにFinishLineへ届くかを
+//   各マスへの最短到着時刻で探索する
+//
+//   TIPS:移動は連続回転の最高速、switchは押した後の高さで見積もる
+//        それ以外は安全側に見積もっている
+//          生成開始時の加速は無視する
+//          複数のPickableCubeは同じ道筋を1マス間隔で続けて進む
+//        ドッスン、MovingCube、onewayは避けて通れるものとして扱わない
+//
+
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <limits>
+#include <cinder/Json.h>
+#include "StageFormat.hpp"
+
+
+namespace ngs { namespace StageSolver {
+
+struct Settings {
+  // 行ごとのbuild_speedなどの既定値(Stageに指定があればそちらを使う)
+  float build_speed;
+  float collapse_speed;
+  float auto_collapse;
+
+  // 生成されてから乗れるようになるまで
+  float build_duration;
+  // StartLineが開いて動けるようになるまで
+  float start_time;
+  // 1マスの移動時間(連続回転の最高速)
+  float step_time;
+
+
+  explicit Settings(const ci::JsonTree& params) noexcept :
+    build_speed(params["game.stage.build_speed"].getValue<float>()),
+    collapse_speed(params["game.stage.collapse_speed"].getValue<float>()),
+    auto_collapse(params["game.stage.auto_collapse"].getValue<float>()),
+    build_duration(params["game.stage.build_duration"].getValue<float>()),
+    start_time(params["game.stage.open_delay"].getValue<float>()
+               + params["game.stage.open_duration"].getValue<float>()),
+    step_time(params["game.pickable.rotate_duration"].getValue<float>()
+              * params["game.pickable.rotate_remap"][0].getValue<float>())
+  {}
+};
+
+struct Result {
+  bool  solved;
+  // 最後のPickableCubeがFinishLineに着いた時刻
+  float arrival_time;
+  // 探索したマスの数
+  u_int visited;
+};
+
+
+// start_line:開始地点(最終行)
+// finish_line:到着地点(先頭行)
+Result solve(const Settings& settings,
+             const CompiledStage& start_line,
+             const CompiledStage& stage,
+             const CompiledStage& finish_line,
+             const int pickable_num) noexcept {
+  const auto& header = stage.header();
+  float build_speed    = (header.flags & StageFormat::HAS_BUILD_SPEED)    ? header.build_speed    : settings.build_speed;
+  float collapse_speed = (header.flags & StageFormat::HAS_COLLAPSE_SPEED) ? header.collapse_speed : settings.collapse_speed;
+  float auto_collapse  = (header.flags & StageFormat::HAS_AUTO_COLLAPSE)  ? header.auto_collapse  : settings.auto_collapse;
+
+  // 探索範囲はStartLineの最終行(iz = 0)、Stage、FinishLineの先頭行
+  // xは各Stageのx_offsetを反映した共通の座標で扱う
+  const int depth = stage.depth() + 2;
+  int min_x = std::min({ start_line.header().x_offset, header.x_offset, finish_line.header().x_offset });
+  int max_x = std::max({ start_line.header().x_offset + start_line.width(),
+                         header.x_offset + stage.width(),
+                         finish_line.header().x_offset + finish_line.width() });
+  const int width = max_x - min_x;
+
+  // 乗れない場所はINT_MIN
+  const int NONE = std::numeric_limits<int>::min();
+  std::vector<int> height(width * depth, NONE);
+  auto copyRow = [&](const CompiledStage& src, const int src_iz, const int iz, const int offset_y) {
+    const auto* row = src.row(src_iz);
+    for (int ix = 0; ix < src.width(); ++ix) {
+      if (row[ix] < 0) continue;
+      height[iz * width + (src.header().x_offset + ix - min_x)] = row[ix] + offset_y;
+    }
+  };
+  // StartLineの最終行は開いてから動けるようになる
+  copyRow(start_line, start_line.depth() - 1, 0, -1);
+  for (int iz = 0; iz < stage.depth(); ++iz) {
+    copyRow(stage, iz, iz + 1, 0);
+  }
+  copyRow(finish_line, 0, depth - 1, 0);
+
+  for (const auto& s : stage.switches()) {
+    for (const auto& target : stage.targets(s)) {
+      auto& h = height[(target.z + 1) * width + (header.x_offset + target.x - min_x)];
+      if (h != NONE) h -= 1;
+    }
+  }
+
+  // 後続のPickableCubeは先頭から(pickable_num - 1)マス遅れてついて来る
+  float follow_time = std::max(pickable_num - 1, 0) * settings.step_time;
+
+  // 行が乗れるようになる時刻、崩れ始める時刻
+  // TIPS:StartLineの最終行から生成済みなので、StartLineは0秒から乗れる
+  auto buildTime = [&](const int iz) {
+    return (iz == 0) ? 0.0f
+                     : iz * build_speed + settings.build_duration;
+  };
+  auto collapseTime = [&](const int iz) {
+    return (iz == (depth - 1)) ? std::numeric_limits<float>::max()
+                               : auto_collapse + iz * collapse_speed - follow_time;
+  };
+
+  std::vector<float> arrival(width * depth, std::numeric_limits<float>::max());
+  using Node = std::pair<float, int>;
+  std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+  for (int ix = 0; ix < width; ++ix) {
+    if (height[ix] == NONE) continue;
+    arrival[ix] = settings.start_time;
+    queue.emplace(settings.start_time, ix);
+  }
+
+  Result result = { false, 0.0f, 0 };
+  static const int dx[] = { 0, 0, -1, 1 };
+  static const int dz[] = { 1, -1, 0, 0 };
+  while (!queue.empty()) {
+    auto node = queue.top();
+    queue.pop();
+
+    float time = node.first;
+    int index  = node.second;
+    if (time > arrival[index]) continue;
+    result.visited += 1;
+
+    int ix = index % width;
+    int iz = index / width;
+    if (iz == (depth - 1)) {
+      result.solved       = true;
+      result.arrival_time = time + follow_time;
+      break;
+    }
+
+    for (int i = 0; i < 4; ++i) {
+      int nx = ix + dx[i];
+      int nz = iz + dz[i];
+      if ((nx < 0) || (nx >= width) || (nz < 0) || (nz >= depth)) continue;
+
+      int next = nz * width + nx;
+      // 同じ高さにしか移動できない
+      if ((height[next] == NONE) || (height[next] != height[index])) continue;
+
+      // 移動先が乗れるようになるまで待つ
+      float next_time = std::max(time, buildTime(nz) - settings.step_time) + settings.step_time;
+      // 移動し終わる前に今の行や移動先が崩れたらダメ
+      if ((next_time > collapseTime(iz)) || (next_time > collapseTime(nz))) continue;
+      
+      if (next_time < arrival[next]) {
+        arrival[next] = next_time;
+        queue.emplace(next_time, next);
+      }
+    }
+  }
+
+  return result;
+}
+
+} }
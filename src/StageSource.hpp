@@ -0,0 +1,227 @@
+﻿#pragma once
+
+//
+// Stageの供給元
+//   Stageや配置物は、生成する行の分だけ順番に問い合わせる
+//   ファイルから読むものと、手続き的に作るものがある
+//
+
+#include <deque>
+#include <memory>
+#include <boost/noncopyable.hpp>
+#include <boost/range/iterator_range.hpp>
+#include "StageFormat.hpp"
+
+
+namespace ngs {
+
+class StageSource : private boost::noncopyable {
+public:
+  template <typename T>
+  using Range = boost::iterator_range<const T*>;
+
+
+  virtual ~StageSource() = default;
+
+  // 色や速度、幅や行数などStage全体の情報
+  virtual const StageFormat::Header& header() const noexcept = 0;
+
+  // iz行目の高さ(width個、負の値はCube無し)
+  // TIPS:izは0から順に増えていく。戻り値は次の行を問い合わせるまで有効
+  virtual const signed char* row(const int iz) noexcept = 0;
+
+  // iz行目に登場する配置物(座標はStage先頭からの相対値)
+  // TIPS:rowと同じくizは増える一方。同じ行は何度問い合わせてもよい
+  //      繰り返して長くしたStageでは、その回の先頭からの相対値になるので
+  //      repeatOffsetを加える
+  virtual Range<StageFormat::Position> items(const int iz) noexcept = 0;
+  virtual Range<StageFormat::Moving> moving(const int iz) noexcept = 0;
+  virtual Range<int32_t> pattern(const StageFormat::Moving& moving) const noexcept = 0;
+  virtual Range<StageFormat::Falling> falling(const int iz) noexcept = 0;
+  virtual Range<StageFormat::Switch> switches(const int iz) noexcept = 0;
+  virtual Range<StageFormat::Position> targets(const StageFormat::Switch& s) const noexcept = 0;
+  virtual Range<StageFormat::Oneway> oneways(const int iz) noexcept = 0;
+
+  // iz行目を含む繰り返しの、Stage先頭からの行数
+  virtual int repeatOffset(const int iz) const noexcept { return 0; }
+
+
+  int width() const noexcept { return int(header().width); }
+  int depth() const noexcept { return int(header().depth); }
+  int itemNum() const noexcept { return int(header().items.num); }
+
+  ci::Color color() const noexcept {
+    const auto& h = header();
+    return ci::Color(h.color[0], h.color[1], h.color[2]);
+  }
+
+  ci::Color bgColor() const noexcept {
+    const auto& h = header();
+    return ci::Color(h.bg_color[0], h.bg_color[1], h.bg_color[2]);
+  }
+
+  std::string lightTween() const noexcept { return std::string(header().light_tween); }
+  std::string camera() const noexcept { return std::string(header().camera); }
+
+};
+
+
+// 変換済みのStageから読み出す
+//   テーブルはzの順に並んでいるので、行ごとに読み出し位置を進めるだけ
+//   repeatを指定すると、同じStageを繰り返し並べた長いStageになる
+class StageFileSource : public StageSource {
+  CompiledStage stage_;
+  StageFormat::Header header_;
+
+  int repeat_;
+  int last_iz_;
+
+  // 各テーブルの読み出し位置
+  size_t item_index_;
+  size_t moving_index_;
+  size_t falling_index_;
+  size_t switch_index_;
+  size_t oneway_index_;
+
+
+public:
+  explicit StageFileSource(CompiledStage stage, const int repeat = 1) noexcept :
+    stage_(std::move(stage)),
+    header_(stage_.header()),
+    repeat_(std::max(repeat, 1)),
+    last_iz_(0),
+    item_index_(0),
+    moving_index_(0),
+    falling_index_(0),
+    switch_index_(0),
+    oneway_index_(0)
+  {
+    header_.depth     *= repeat_;
+    header_.items.num *= repeat_;
+  }
+
+
+  const StageFormat::Header& header() const noexcept override { return header_; }
+
+  const signed char* row(const int iz) noexcept override {
+    return stage_.row(localZ(iz));
+  }
+
+  Range<StageFormat::Position> items(const int iz) noexcept override {
+    return rowRange(stage_.items(), item_index_, localZ(iz),
+                    [](const StageFormat::Position& p) { return p.z; });
+  }
+
+  Range<StageFormat::Moving> moving(const int iz) noexcept override {
+    return rowRange(stage_.moving(), moving_index_, localZ(iz),
+                    [](const StageFormat::Moving& p) { return p.entry.z; });
+  }
+
+  Range<int32_t> pattern(const StageFormat::Moving& moving) const noexcept override {
+    return stage_.pattern(moving);
+  }
+
+  Range<StageFormat::Falling> falling(const int iz) noexcept override {
+    return rowRange(stage_.falling(), falling_index_, localZ(iz),
+                    [](const StageFormat::Falling& p) { return p.entry.z; });
+  }
+
+  Range<StageFormat::Switch> switches(const int iz) noexcept override {
+    return rowRange(stage_.switches(), switch_index_, localZ(iz),
+                    [](const StageFormat::Switch& p) { return p.position.z; });
+  }
+
+  Range<StageFormat::Position> targets(const StageFormat::Switch& s) const noexcept override {
+    return stage_.targets(s);
+  }
+
+  Range<StageFormat::Oneway> oneways(const int iz) noexcept override {
+    return rowRange(stage_.oneways(), oneway_index_, localZ(iz),
+                    [](const StageFormat::Oneway& p) { return p.position.z; });
+  }
+
+  int repeatOffset(const int iz) const noexcept override {
+    return (iz / stage_.depth()) * stage_.depth();
+  }
+
+
+private:
+  // 繰り返しの中での行
+  // 先頭に戻ったら読み出し位置も戻す
+  int localZ(const int iz) noexcept {
+    int local_z = iz % stage_.depth();
+    if (local_z < last_iz_) {
+      item_index_    = 0;
+      moving_index_  = 0;
+      falling_index_ = 0;
+      switch_index_  = 0;
+      oneway_index_  = 0;
+    }
+    last_iz_ = local_z;
+
+    return local_z;
+  }
+
+  template <typename T, typename F>
+  static Range<T> rowRange(const Range<T>& table, size_t& index, const int iz, F z_of) noexcept {
+    auto first = std::begin(table) + index;
+    while ((first != std::end(table)) && (z_of(*first) < iz)) ++first;
+
+    auto last = first;
+    while ((last != std::end(table)) && (z_of(*last) == iz)) ++last;
+
+    index = first - std::begin(table);
+    return boost::make_iterator_range(first, last);
+  }
+
+};
+
+
+// 配置物を取り出すためのStageの並び
+//   FieldEntityはStageと終了ラインを続けて追加するので、複数を順に保持する
+class StageSourceQueue {
+public:
+  struct Entry {
+    std::shared_ptr<StageSource> source;
+    int x;
+    int z;
+
+    // current_z行目の配置物の座標に加えるz(繰り返し分も含む)
+    int offsetZ(const int current_z) const noexcept {
+      return z + source->repeatOffset(current_z - z);
+    }
+  };
+
+
+private:
+  std::deque<Entry> entries_;
+
+
+public:
+  void push(const std::shared_ptr<StageSource>& source, const int z, const int x) noexcept {
+    if (source->depth() == 0) return;
+
+    Entry entry = { source, x, z };
+    entries_.push_back(entry);
+  }
+
+  void clear() noexcept {
+    entries_.clear();
+  }
+
+  // current_zを含むStageを探す(無ければnullptr)
+  // TIPS:zは増える一方なので、通り過ぎたものは捨てる
+  Entry* find(const int current_z) noexcept {
+    while (!entries_.empty()) {
+      const auto& front = entries_.front();
+      if ((front.z + front.source->depth()) > current_z) break;
+      entries_.pop_front();
+    }
+    if (entries_.empty() || (entries_.front().z > current_z)) return nullptr;
+
+    return &entries_.front();
+  }
+
+};
+
+}
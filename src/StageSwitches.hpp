@@ -5,25 +5,37 @@
 //
 
 #include "Switch.hpp"
+#include "StageSource.hpp"
+#include "Profiler.hpp"
 #include <boost/noncopyable.hpp>
+#include <cinder/Rand.h>
 
 
 namespace ngs {
 
 class StageSwitches : private boost::noncopyable {
+  ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
 
   ci::TimelineRef timeline_;
   ci::TimelineRef event_timeline_;
   
+  // 登場前のswitchは作らず、生成する行に来たら供給元から取り出す
+  StageSourceQueue sources_;
+
   using SwitchPtr = std::unique_ptr<Switch>;
   std::vector<SwitchPtr> switches_;
 
   
 public:
-  StageSwitches(ci::TimelineRef timeline,
-                Event<EventParam>& event) noexcept :
+  StageSwitches(ci::JsonTree& params,
+                ci::TimelineRef timeline,
+                Event<EventParam>& event,
+                ci::Rand& rand) noexcept :
+    params_(params),
     event_(event),
+    rand_(rand),
     timeline_(timeline),
     event_timeline_(ci::Timeline::create())
   {
@@ -38,6 +50,8 @@ public:
   
 
   void update(const double progressing_seconds, const Stage& stage) noexcept {
+    PROFILE_ZONE("StageSwitches::update");
+
     for (auto& cube : switches_) {
       cube->update(progressing_seconds);
     }
@@ -51,23 +65,20 @@ public:
   }
 
   
-  void addSwitches(ci::JsonTree& params,
-                   const ci::JsonTree& entry_params,
+  void addSwitches(const std::shared_ptr<StageSource>& source,
                    const int bottom_z, const int offset_x) noexcept {
-    if (!entry_params.hasChild("switches")) return;
-
-    for (const auto& p : entry_params["switches"]) {
-      switches_.emplace_back(new Switch(params, p,
-                                        timeline_, event_,
-                                        offset_x, bottom_z));
-    }
+    sources_.push(source, bottom_z, offset_x);
   }
 
   void entrySwitches(const int current_z) noexcept {
-    for (const auto& s : switches_) {
-      if (s->blockPosition().z == current_z) {
-        s->entry();
-      }
+    const auto* entry = sources_.find(current_z);
+    if (!entry) return;
+
+    for (const auto& p : entry->source->switches(current_z - entry->z)) {
+      switches_.emplace_back(new Switch(params_, *entry->source, p,
+                                        timeline_, event_, rand_,
+                                        entry->x, entry->offsetZ(current_z)));
+      switches_.back()->entry();
     }
   }
   
@@ -85,11 +96,7 @@ public:
 
   void clear() noexcept {
     // 待機中のswitchをすべて削除
-    for (auto& cube : switches_) {
-      if (cube->isAlive() && !cube->isActive()) {
-        cube->alive(false);
-      }
-    }
+    sources_.clear();
   }
 
 
@@ -105,7 +112,8 @@ private:
       if (!height.first) {
         cube->fallFromStage();
 
-        event_.signal("fall-switch", EventParam());
+        static const EventId fall_switch("fall-switch");
+        event_.signal(fall_switch, EventParam());
       }
     }
   }
@@ -61,10 +61,10 @@ public:
     sns_delay_(params["stageclear.sns_delay"].getValue<float>()),
     view_(std::move(view)),
     active_(true),
-    all_cleard_(boost::any_cast<bool>(result.at("all_cleared"))),
-    regular_stage_(boost::any_cast<bool>(result.at("regular_stage"))),
-    all_stage_(boost::any_cast<bool>(result.at("all_stage"))),
-    current_stage_(boost::any_cast<int>(result.at("current_stage"))),
+    all_cleard_(result.get<bool>("all_cleared")),
+    regular_stage_(result.get<bool>("regular_stage")),
+    all_stage_(result.get<bool>("all_stage")),
+    current_stage_(result.get<int>("current_stage")),
     game_result_(result),
     sns_url_(Localize::get(params["stageclear.sns_url"].getValue<std::string>())),
     clear_time_(0.0),
@@ -131,7 +131,7 @@ public:
     setupView(params, result);
 
     view_->startWidgetTween("tween-in");
-    requestSound(event_, params["stageclear.jingle-se"].getValue<std::string>());
+    requestSound(event_, getSoundHandle(params["stageclear.jingle-se"].getValue<std::string>()));
 
     if (params.hasChild("stageclear.active_delay")) {
       view_->setActive(false);
@@ -163,7 +163,7 @@ private:
     
     // constなのでatを使っている
     // GameCenterに送信するので、ここで定義
-    auto clear_time = boost::any_cast<double>(result.at("clear_time"));
+    auto clear_time = result.get<double>("clear_time");
     {
       // カウントアップ演出
       auto options = animation_timeline_->apply(&clear_time_,
@@ -177,7 +177,7 @@ private:
         });
       
       // カウントアップ演出が終わったあとで記録更新演出
-      if (boost::any_cast<bool>(result.at("fastest_time"))) {
+      if (result.get<bool>("fastest_time")) {
         options.finishFn([this]() noexcept {
             view_->startWidgetTween("tween-fastest-time");
           });
@@ -187,8 +187,8 @@ private:
     // SNS投稿で使うのでここで定義
     int item_rate = 0;
     {
-      auto item_num = boost::any_cast<int>(result.at("item_num"));
-      auto item_total_num = boost::any_cast<int>(result.at("item_total_num"));
+      auto item_num = result.get<int>("item_num");
+      auto item_total_num = result.get<int>("item_total_num");
 
       if (item_total_num > 0) {
         item_rate = item_num * 100 / item_total_num;
@@ -205,7 +205,7 @@ private:
           });
 
         // カウントアップ演出が終わったあとで100%達成演出
-        if (boost::any_cast<bool>(result.at("complete_item"))) {
+        if (result.get<bool>("complete_item")) {
           options.finishFn([this]() noexcept {
               view_->startWidgetTween("tween-complete-item");
             });
@@ -214,7 +214,7 @@ private:
     }
 
     // SNS投稿テキストでも使うのでblockの外で定義
-    auto game_score = boost::any_cast<int>(result.at("score"));
+    auto game_score = result.get<int>("score");
     {
       // カウントアップ演出
       auto options = animation_timeline_->apply(&score_,
@@ -228,7 +228,7 @@ private:
           view_->getWidget("score-result").setText(toFormatedString(score_(), 5), false);
         });
 
-      if (boost::any_cast<bool>(result.at("highest_score"))) {
+      if (result.get<bool>("highest_score")) {
           options.finishFn([this]() noexcept {
               view_->startWidgetTween("tween-highest-score");
             });
@@ -239,13 +239,13 @@ private:
     std::string game_rank;
     {
       auto& rank_text = params["stageclear.rank"];
-      auto rank = boost::any_cast<int>(result.at("rank"));
+      auto rank = result.get<int>("rank");
 
       game_rank = rank_text[rank].getValue<std::string>();
 
       view_->getWidget("rank-result").setText(game_rank);
 
-      if (boost::any_cast<bool>(result.at("highest_rank"))) {
+      if (result.get<bool>("highest_rank")) {
         view_->startWidgetTween("tween-highest-rank");
       }
     }
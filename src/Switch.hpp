@@ -5,12 +5,16 @@
 // PickableCubeが踏むと指定ブロックの高さが書き換えられる
 //
 
+#include <cinder/Rand.h>
+#include "StageSource.hpp"
+
 
 namespace ngs {
 
 class Switch : private boost::noncopyable {
   ci::JsonTree& params_;
   Event<EventParam>& event_;
+  ci::Rand& rand_;
 
   bool alive_;
   bool active_;
@@ -36,12 +40,15 @@ class Switch : private boost::noncopyable {
 
 public:
   Switch(ci::JsonTree& params,
-         const ci::JsonTree& entry_params,
+         const StageSource& stage,
+         const StageFormat::Switch& entry_params,
          ci::TimelineRef timeline,
          Event<EventParam>& event,
+         ci::Rand& rand,
          const int offset_x, const int bottom_z) noexcept :
     params_(params),
     event_(event),
+    rand_(rand),
     alive_(true),
     active_(false),
     color_(Json::getColor<float>(params["game.switch.color"])),
@@ -61,10 +68,10 @@ public:
     timeline->apply(animation_timeline_);
     
     ci::Vec3i offset(offset_x, 0, bottom_z);
-    block_position_ = Json::getVec3<int>(entry_params["position"]) + offset;
+    block_position_ = CompiledStage::toVec3i(entry_params.position) + offset;
     
-    for (const auto& target : entry_params["target"]) {
-      targets_.push_back(Json::getVec3<int>(target) + offset);
+    for (const auto& target : stage.targets(entry_params)) {
+      targets_.push_back(CompiledStage::toVec3i(target) + offset);
     }
 
     position_ = ci::Vec3f(block_position_);
@@ -89,7 +96,7 @@ public:
     
     // 登場演出
     auto entry_y = Json::getVec2<float>(params_["game.switch.entry_y"]);
-    float y = ci::randFloat(entry_y.x, entry_y.y);
+    float y = rand_.nextFloat(entry_y.x, entry_y.y);
     ci::Vec3f start_value(position() + ci::Vec3f(0, y, 0));
     auto options = animation_timeline_->apply(&position_,
                                               start_value, position_(),
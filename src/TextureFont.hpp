@@ -2,79 +2,142 @@
 
 //
 // テクスチャ化フォント
-// キャッシュ管理付き
+//   文字列ごとのテクスチャは作らず、GlyphAtlasに詰めて保持する
+//   アトラスの大きさを超えた分は使われていないものから追い出すので、使用メモリは一定
+//   事前に作ったアトラス(tools/fontbake)があれば読み込み、無い文字だけFreeTypeで描く
 //
 
-#include <map>
+#include <memory>
 #include <boost/noncopyable.hpp>
 #include <cinder/gl/Texture.h>
+#include <cinder/ImageIo.h>
+#include <cinder/ip/Resize.h>
 #include "Font.hpp"
+#include "GlyphAtlas.hpp"
+#include "Asset.hpp"
 
 
 namespace ngs {
 
 class TextureFont : private boost::noncopyable {
-  Font font_;
+  // TIPS:FreeTypeは必要になるまで使わない(起動時間の短縮)
+  std::string path_;
+  FontCreator& creator_;
+  std::unique_ptr<Font> font_;
 
+  int size_;
+  
   ci::Vec3f scale_;
   ci::Vec3f offset_;
-  bool mipmap_;
-  
-  std::map<std::string, ci::gl::TextureRef> texture_cache_;
+
+  int atlas_size_;
+  int atlas_padding_;
+  GlyphAtlas atlas_;
 
 
 public:
   explicit TextureFont(const std::string& path, FontCreator& creator,
                        const int size,
                        const ci::Vec3f& scale, const ci::Vec3f& offset,
-                       const bool mipmap) noexcept :
-    font_(path, creator),
+                       const bool mipmap,
+                       const int atlas_size = 1024, const int atlas_padding = 2) noexcept :
+    path_(path),
+    creator_(creator),
+    size_(size),
     scale_(scale),
     offset_(offset),
-    mipmap_(mipmap)
-  {
-    font_.setSize(size);
-  }
+    atlas_size_(atlas_size),
+    atlas_padding_(atlas_padding),
+    atlas_(size, atlas_size, atlas_padding, mipmap)
+  {}
 
   
-  // 文字列から生成したテクスチャを取得
-  ci::gl::TextureRef getTextureFromString(const std::string& str) noexcept {
-    // キャッシュ済みなら、それを返却
-    auto cached = isCachedTexture(str);
-    if (cached.first) {
-      return cached.second->second;
-    }
+  // 文字列のアトラス内でのUVを取得
+  // TIPS:1つの立方体に複数の文字を表示する場合もあるので、文字列単位で配置する
+  const ci::Rectf& getGlyph(const std::string& str) noexcept {
+    // 配置済みなら、それを返却
+    const auto* uv = atlas_.find(str);
+    if (uv) return *uv;
+
+    return atlas_.insert(str, renderGlyph(font(), size_, str));
+  }
+
+  // tools/fontbakeで作ったアトラス
+  struct Baked {
+    std::vector<std::string> keys;
+    ci::Surface8u image;
+  };
 
-    ci::gl::Texture::Format format;
-    if (mipmap_) {
-      // TIPS:文字はmipmapを利用(縮小時の見栄えが良くなる)
-      format.enableMipmapping();
+  // アトラスの表と画像を読み込む(OpenGLは使わないので別スレッドでも良い)
+  // 設定が食い違う場合は読み込まない
+  static bool readBaked(const std::string& path,
+                        const int size, const int atlas_size, const int atlas_padding,
+                        Baked& baked) noexcept {
+    if (!isValidPath(Asset::fullPath(path))) {
+      DOUT << "no baked font:" << path << std::endl;
+      return false;
     }
-    
-    auto texture  = ci::gl::Texture::create(font_.rendering(str), format);
-    if (mipmap_) {
-      texture->setMinFilter(GL_LINEAR_MIPMAP_NEAREST);
-      texture->setMagFilter(GL_LINEAR);
+
+    ci::JsonTree table(Asset::load(path));
+    if ((table["size"].getValue<int>() != size)
+        || (table["atlas_size"].getValue<int>() != atlas_size)
+        || (table["atlas_padding"].getValue<int>() != atlas_padding)) {
+      DOUT << "baked font mismatch:" << path << std::endl;
+      return false;
     }
-    else {
-      texture->setMinFilter(GL_LINEAR);
-      texture->setMagFilter(GL_LINEAR);
+
+    for (const auto& glyph : table["glyphs"]) {
+      baked.keys.push_back(glyph["text"].getValue<std::string>());
     }
-    
-    auto inserted = texture_cache_.emplace(std::move(str), std::move(texture));
 
-    return inserted.first->second;
+    baked.image = ci::Surface8u(ci::loadImage(Asset::load(table["image"].getValue<std::string>())));
+    return true;
+  }
+
+  // 読み込めなければ、すべての文字をFreeTypeで描く
+  bool loadBaked(const std::string& path) noexcept {
+    Baked baked;
+    if (!readBaked(path, size_, atlas_size_, atlas_padding_, baked)) return false;
+    return loadBaked(baked);
   }
 
+  bool loadBaked(const Baked& baked) noexcept {
+    return atlas_.load(baked.image, baked.keys);
+  }
+
+  // 別の場所で描いた文字をアトラスに入れる
+  void insertGlyph(const std::string& str, const ci::Surface8u& surface) noexcept {
+    if (atlas_.find(str)) return;
+    atlas_.insert(str, surface);
+  }
+
+  const ci::gl::TextureRef& texture() const noexcept { return atlas_.texture(); }
+
   const ci::Vec3f& scale() const noexcept { return scale_; }
   const ci::Vec3f& offset() const noexcept { return offset_; }
 
+  const GlyphAtlas::Stats& stats() const noexcept { return atlas_.stats(); }
+
+
+  // アトラスの1枠分の文字を描く
+  // TIPS:tools/fontbakeと共通
+  static ci::Surface8u renderGlyph(Font& font, const int size, const std::string& str) noexcept {
+    auto surface = font.rendering(str);
+    if (surface.getWidth() > size) {
+      // 幅の広い文字列は立方体の面に合わせて縮める
+      surface = ci::ip::resizeCopy(surface, surface.getBounds(), ci::Vec2i(size, size));
+    }
+    return surface;
+  }
+
   
 private:
-  // キャッシュされている文字テクスチャを返却
-  std::pair<bool, std::map<std::string, ci::gl::TextureRef>::iterator> isCachedTexture(const std::string& str) noexcept {
-    auto it = texture_cache_.find(str);
-    return std::make_pair(it != std::end(texture_cache_), it);
+  Font& font() noexcept {
+    if (!font_) {
+      font_ = std::unique_ptr<Font>(new Font(path_, creator_));
+      font_->setSize(size_);
+    }
+    return *font_;
   }
   
 };
@@ -50,6 +50,8 @@ public:
   {
     DOUT << "TitleController()" << std::endl;
 
+    requestSoundPrefetch(event_, Json::getArray<std::string>(params["title.prefetch_se"]));
+
     auto current_time = timeline->getCurrentTime();
     event_timeline_->setStartTime(current_time);
     timeline->apply(event_timeline_);
@@ -159,12 +161,12 @@ public:
     // アプリ起動直後のタイトル画面か??
     bool startup = false;
     if (hasKey(exec_params, "title-startup")) {
-      startup = boost::any_cast<bool>(exec_params.at("title-startup"));
+      startup = exec_params.get<bool>("title-startup");
     }
     // 各種menuから戻ってきた??
     bool from_menu = false;
     if (hasKey(exec_params, "menu-to-title")) {
-      from_menu = boost::any_cast<bool>(exec_params.at("menu-to-title"));
+      from_menu = exec_params.get<bool>("menu-to-title");
     }
 
     {
@@ -173,7 +175,7 @@ public:
       if (startup)        jingle_name = "title.jingle-full";
       else if (from_menu) jingle_name = "title.jingle-mini";
       
-      requestSound(event_, params[jingle_name].getValue<std::string>());
+      requestSound(event_, getSoundHandle(params[jingle_name].getValue<std::string>()));
     }
     
     event_.signal("field-input-start", EventParam());
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+//
+// 書き込み側と読み込み側が待ち合わせずに受け渡すための三重バッファ
+//   書き込み側: writeBuffer() に書いて publish()
+//   読み込み側: update() で最新に切り替えて readBuffer() を読む
+//   TIPS:書き込み側・読み込み側それぞれ一つのスレッドからのみ呼ぶ
+//        受け渡し用の一枚の添え字をatomicに交換するだけなのでロックしない
+//
+
+#include <atomic>
+#include <boost/noncopyable.hpp>
+
+
+namespace ngs {
+
+template <typename T>
+class TripleBuffer : private boost::noncopyable {
+  enum {
+    INDEX_MASK = 3,
+    // 受け渡し用のバッファに未読のデータがある
+    FRESH = 4,
+  };
+
+  T buffers_[3];
+
+  u_int write_;
+  std::atomic<u_int> middle_;
+  u_int read_;
+
+
+public:
+  TripleBuffer() noexcept :
+    write_(0),
+    middle_(1),
+    read_(2)
+  {}
+
+
+  T& writeBuffer() noexcept { return buffers_[write_]; }
+
+  // 書き終えたバッファを受け渡し用と交換
+  void publish() noexcept {
+    write_ = middle_.exchange(write_ | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+  }
+
+
+  // 新しいデータがあれば読み込み用と交換
+  bool update() noexcept {
+    if (!(middle_.load(std::memory_order_relaxed) & FRESH)) return false;
+
+    read_ = middle_.exchange(read_, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+  }
+
+  const T& readBuffer() const noexcept { return buffers_[read_]; }
+  
+};
+
+}
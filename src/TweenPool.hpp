@@ -0,0 +1,371 @@
+﻿#pragma once
+
+//
+// 使い回すTween
+//   ci::Timelineは再生ごとにTweenとオプションを確保するので、数の多いものはこちらで動かす
+//   要素ごとに配列を分けて持ち、同じイージングのTweenをまとめて計算する
+//   終わったTweenの枠は次の再生で使い回す
+//   外からは世代付きのハンドルで指定するので、使い回された枠を誤って操作しない
+//   TIPS:今はStageCubesとBgだけがこちらを使う
+//        PickableCube ItemCube MovingCube FallingCube Switch Oneway UIWidgetは
+//        ci::Timelineのままで、動かすたびにTweenとupdateFn/finishFnのstd::functionを確保する
+//        (途中の値から回転と位置を計算したり、終了時にEventを送るため)
+//
+
+#include <vector>
+#include <map>
+#include <string>
+#include <cinder/Tween.h>
+#include <cinder/Quaternion.h>
+#include <boost/noncopyable.hpp>
+#include "EasingUtil.hpp"
+
+
+namespace ngs {
+
+struct TweenHandle {
+  u_int index;
+  // 0は無効
+  u_int generation;
+
+  TweenHandle() noexcept :
+    index(0),
+    generation(0)
+  {}
+
+  TweenHandle(const u_int index_, const u_int generation_) noexcept :
+    index(index_),
+    generation(generation_)
+  {}
+};
+
+
+// 補間(TweenPool用)
+inline float tweenLerp(const float a, const float b, const float t) noexcept {
+  return a + (b - a) * t;
+}
+
+inline ci::Vec3f tweenLerp(const ci::Vec3f& a, const ci::Vec3f& b, const float t) noexcept {
+  return a + (b - a) * t;
+}
+
+inline ci::Quatf tweenLerp(const ci::Quatf& a, const ci::Quatf& b, const float t) noexcept {
+  return a.slerp(t, b);
+}
+
+
+template <typename T>
+class TweenPool : private boost::noncopyable {
+public:
+  // 再生終了時に呼ばれる(確保を避けるため関数ポインタと引数で指定)
+  using FinishFn = void (*)(void* context, const u_int tag);
+
+
+private:
+  enum State : u_char {
+    FREE,
+    // 開始待ち(delayやappendTo)
+    WAITING,
+    PLAYING,
+  };
+
+  // 同じイージングのTween
+  struct Lane {
+    ci::EaseFn ease;
+    // 再生中の枠
+    std::vector<u_int> slots;
+  };
+
+  std::vector<Lane> lanes_;
+  std::map<std::string, u_int> lane_ids_;
+
+  // 枠ごとの情報
+  std::vector<T*> target_;
+  std::vector<T> start_;
+  std::vector<T> end_;
+  std::vector<double> begin_time_;
+  std::vector<float> duration_;
+  std::vector<u_int> generation_;
+  std::vector<State> state_;
+  std::vector<u_int> lane_;
+  // Lane::slots内の位置
+  std::vector<u_int> lane_pos_;
+  // 開始時に対象の値を開始値にする
+  std::vector<bool> copy_start_;
+  // appendToの前のTween(止める時に辿る)
+  std::vector<TweenHandle> prev_;
+
+  std::vector<FinishFn> finish_fn_;
+  std::vector<void*> finish_context_;
+  std::vector<u_int> finish_tag_;
+
+  std::vector<u_int> free_;
+  std::vector<u_int> waiting_;
+
+  // まとめて計算する時の作業領域
+  std::vector<float> work_;
+  // 終了処理中に止められたり使い回される場合があるのでハンドルで保持
+  std::vector<TweenHandle> finished_;
+
+  double time_;
+
+
+public:
+  TweenPool() noexcept :
+    time_(0.0)
+  {}
+
+
+  // イージングの番号(準備時に引いておく)
+  u_int ease(const std::string& name) noexcept {
+    auto it = lane_ids_.find(name);
+    if (it != std::end(lane_ids_)) return it->second;
+
+    u_int id = u_int(lanes_.size());
+    lanes_.push_back(Lane());
+    lanes_.back().ease = getEaseFunc(name);
+    lanes_.back().slots.reserve(capacity());
+    lane_ids_.insert(std::make_pair(name, id));
+    return id;
+  }
+
+  // 確保済みの枠の数を増やしておく
+  void reserve(const size_t num) noexcept {
+    while (capacity() < num) {
+      free_.push_back(allocate());
+    }
+    work_.reserve(num);
+    finished_.reserve(num);
+    waiting_.reserve(num);
+    for (auto& lane : lanes_) {
+      lane.slots.reserve(num);
+    }
+  }
+
+  size_t capacity() const noexcept { return target_.size(); }
+  size_t playingNum() const noexcept { return capacity() - free_.size(); }
+
+
+  // 開始値を指定して再生
+  TweenHandle apply(T* target, const T& start_value, const T& end_value,
+                    const float duration, const u_int ease, const float delay = 0.0f) noexcept {
+    *target = start_value;
+    return entry(target, start_value, end_value, duration, ease, delay, false, TweenHandle());
+  }
+
+  // 開始時の値から再生
+  TweenHandle apply(T* target, const T& end_value,
+                    const float duration, const u_int ease, const float delay = 0.0f) noexcept {
+    return entry(target, *target, end_value, duration, ease, delay, true, TweenHandle());
+  }
+
+  // prevの再生が終わってから再生
+  TweenHandle appendTo(const TweenHandle& prev, T* target, const T& end_value,
+                       const float duration, const u_int ease, const float delay = 0.0f) noexcept {
+    double begin_time = time_;
+    if (isValid(prev)) {
+      begin_time = std::max(begin_time, begin_time_[prev.index] + duration_[prev.index]);
+    }
+
+    return entry(target, *target, end_value, duration, ease, float(begin_time - time_) + delay, true, prev);
+  }
+
+  void setFinishFn(const TweenHandle& handle,
+                   FinishFn fn, void* context, const u_int tag) noexcept {
+    if (!isValid(handle)) return;
+
+    finish_fn_[handle.index]      = fn;
+    finish_context_[handle.index] = context;
+    finish_tag_[handle.index]     = tag;
+  }
+
+
+  // appendToでつながっている前のTweenも止める
+  void stop(TweenHandle handle) noexcept {
+    while (isValid(handle)) {
+      auto prev = prev_[handle.index];
+      release(handle.index);
+      handle = prev;
+    }
+  }
+
+  // 対象の場所が変わった時に付け替える
+  void retarget(TweenHandle handle, T* target) noexcept {
+    while (isValid(handle)) {
+      target_[handle.index] = target;
+      handle = prev_[handle.index];
+    }
+  }
+
+  bool isValid(const TweenHandle& handle) const noexcept {
+    return handle.generation
+      && (handle.index < capacity())
+      && (generation_[handle.index] == handle.generation);
+  }
+
+  // 再生中か開始待ち
+  bool isPlaying(const TweenHandle& handle) const noexcept {
+    return isValid(handle);
+  }
+
+  
+  void update(const double progressing_seconds) noexcept {
+    time_ += progressing_seconds;
+
+    // 開始時刻になったものを再生中にする
+    for (size_t i = 0; i < waiting_.size(); ) {
+      u_int slot = waiting_[i];
+      if (begin_time_[slot] > time_) {
+        ++i;
+        continue;
+      }
+
+      waiting_[i] = waiting_.back();
+      waiting_.pop_back();
+
+      if (copy_start_[slot]) start_[slot] = *target_[slot];
+      play(slot);
+    }
+
+    // 再生中のものをイージングごとにまとめて計算
+    for (u_int id = 0; id < lanes_.size(); ++id) {
+      auto& lane = lanes_[id];
+      size_t num = lane.slots.size();
+      if (!num) continue;
+
+      work_.resize(num);
+      for (size_t i = 0; i < num; ++i) {
+        u_int slot = lane.slots[i];
+        float t = float((time_ - begin_time_[slot]) / duration_[slot]);
+        work_[i] = std::min(std::max(t, 0.0f), 1.0f);
+      }
+      for (size_t i = 0; i < num; ++i) {
+        if (work_[i] >= 1.0f) {
+          u_int slot = lane.slots[i];
+          finished_.push_back(TweenHandle(slot, generation_[slot]));
+        }
+        work_[i] = lane.ease(work_[i]);
+      }
+      for (size_t i = 0; i < num; ++i) {
+        u_int slot = lane.slots[i];
+        *target_[slot] = tweenLerp(start_[slot], end_[slot], work_[i]);
+      }
+    }
+
+    // 終了したものは最後の値を書いてから片付ける
+    for (const auto& handle : finished_) {
+      if (!isValid(handle)) continue;
+
+      u_int slot = handle.index;
+      *target_[slot] = end_[slot];
+      auto fn      = finish_fn_[slot];
+      auto context = finish_context_[slot];
+      auto tag     = finish_tag_[slot];
+      release(slot);
+      if (fn) fn(context, tag);
+    }
+    finished_.clear();
+  }
+
+
+private:
+  u_int allocate() noexcept {
+    u_int slot = u_int(target_.size());
+    target_.push_back(nullptr);
+    start_.push_back(T());
+    end_.push_back(T());
+    begin_time_.push_back(0.0);
+    duration_.push_back(0.0f);
+    generation_.push_back(1);
+    state_.push_back(FREE);
+    lane_.push_back(0);
+    lane_pos_.push_back(0);
+    copy_start_.push_back(false);
+    prev_.push_back(TweenHandle());
+    finish_fn_.push_back(nullptr);
+    finish_context_.push_back(nullptr);
+    finish_tag_.push_back(0);
+    return slot;
+  }
+
+  TweenHandle entry(T* target, const T& start_value, const T& end_value,
+                    const float duration, const u_int ease, const float delay,
+                    const bool copy_start, const TweenHandle& prev) noexcept {
+    assert((ease < lanes_.size()) && "unknown ease.");
+
+    u_int slot;
+    if (free_.empty()) {
+      slot = allocate();
+    }
+    else {
+      slot = free_.back();
+      free_.pop_back();
+    }
+
+    target_[slot]     = target;
+    start_[slot]      = start_value;
+    end_[slot]        = end_value;
+    begin_time_[slot] = time_ + delay;
+    // 長さ0は次の更新で終わる
+    duration_[slot]   = std::max(duration, 1.0e-6f);
+    lane_[slot]       = ease;
+    copy_start_[slot] = copy_start;
+    prev_[slot]       = prev;
+    finish_fn_[slot]  = nullptr;
+
+    if (delay > 0.0f) {
+      state_[slot] = WAITING;
+      waiting_.push_back(slot);
+    }
+    else {
+      play(slot);
+    }
+
+    return TweenHandle(slot, generation_[slot]);
+  }
+
+  void play(const u_int slot) noexcept {
+    auto& lane = lanes_[lane_[slot]];
+    state_[slot]    = PLAYING;
+    lane_pos_[slot] = u_int(lane.slots.size());
+    lane.slots.push_back(slot);
+  }
+
+  void release(const u_int slot) noexcept {
+    switch (state_[slot]) {
+    case PLAYING:
+      {
+        // 末尾と入れ替えて取り除く
+        auto& slots = lanes_[lane_[slot]].slots;
+        u_int pos  = lane_pos_[slot];
+        u_int last = slots.back();
+        slots[pos] = last;
+        lane_pos_[last] = pos;
+        slots.pop_back();
+      }
+      break;
+
+    case WAITING:
+      for (auto& s : waiting_) {
+        if (s != slot) continue;
+
+        s = waiting_.back();
+        waiting_.pop_back();
+        break;
+      }
+      break;
+
+    case FREE:
+      return;
+    }
+
+    state_[slot] = FREE;
+    // 0にはしない
+    generation_[slot] += 1;
+    if (!generation_[slot]) generation_[slot] = 1;
+    free_.push_back(slot);
+  }
+
+};
+
+}
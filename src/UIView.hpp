@@ -19,6 +19,7 @@
 #include "FontHolder.hpp"
 #include "ModelHolder.hpp"
 #include "SoundRequest.hpp"
+#include "Profiler.hpp"
 
 
 namespace ngs {
@@ -107,6 +108,8 @@ public:
   
   
   void draw(FontHolder& fonts, ModelHolder& models) noexcept {
+    PROFILE_ZONE("UIView::draw");
+
 #ifdef DEBUG
     if (hide_) return;
 #endif
@@ -118,17 +121,25 @@ public:
 
     ci::gl::setMatrices(camera_);
 
+    // 全Widgetで一度だけbindする
+    auto& arena = models.arena();
+    arena.bind();
     for (auto& widget : widgets_) {
       if (!widget->isDisp()) continue;
       
       widget->draw(fonts, models);
+    }
+    arena.unbind();
 
 #ifdef DEBUG
-      if (debug_info_) {
+    // TIPS:VBOをbindしたままだと頂点配列を使う描画ができない
+    if (debug_info_) {
+      for (auto& widget : widgets_) {
+        if (!widget->isDisp()) continue;
         widget->drawDebugInfo();
       }
-#endif
     }
+#endif
   }
 
   
@@ -224,7 +235,7 @@ private:
       event_.signal(touching_widget_->eventMessage(), params);
 
       if (touching_widget_->isTouchSound()) {
-        requestSound(event_, touching_widget_->soundMessage());
+        requestSound(event_, touching_widget_->sound());
       }
     }
   }
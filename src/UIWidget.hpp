@@ -14,6 +14,7 @@
 #include "EasingUtil.hpp"
 #include "TweenUtil.hpp"
 #include "FontHolder.hpp"
+#include "SoundHandle.hpp"
 
 
 namespace ngs {
@@ -54,7 +55,7 @@ class UIWidget : private boost::noncopyable {
   bool touch_event_;
   std::string event_message_;
   bool touch_sound_;
-  std::string sound_message_;
+  SoundHandle sound_;
 
   
 public:
@@ -78,7 +79,8 @@ public:
     disp_(true),
     active_(false),
     touch_event_(false),
-    touch_sound_(false)
+    touch_sound_(false),
+    sound_(0)
   {
     std::fill(std::begin(rotate_), std::end(rotate_), 0.0f);
     
@@ -92,7 +94,7 @@ public:
       touch_event_   = true;
     }
     if (params.hasChild("sound_message")) {
-      sound_message_ = params["sound_message"].getValue<std::string>();
+      sound_ = getSoundHandle(params["sound_message"].getValue<std::string>());
       touch_sound_   = true;
     }
     
@@ -201,7 +203,7 @@ public:
   const std::string& eventMessage() const noexcept { return event_message_; }
 
   bool isTouchSound() const noexcept { return touch_sound_; }
-  const std::string& soundMessage() const noexcept { return sound_message_; }
+  SoundHandle sound() const noexcept { return sound_; }
 
   
   bool intersects(const ci::Ray& ray) const noexcept {
@@ -214,7 +216,7 @@ public:
 
   void draw(FontHolder& fonts, ModelHolder& models) noexcept {
     CubeTextDrawer::draw(text_, fonts.getFont(font_name_),
-                         models.get(model_),
+                         models.arena(), models.get(model_),
                          pos_() + layout_->getPos(), scale_(),
                          getTextColor(), getBaseColor(),
                          rotate_);
@@ -7,6 +7,10 @@
 #include <codecvt>
 #include <sstream>
 #include <chrono>
+#include <fstream>
+#include <iterator>
+#include <cstdint>
+#include <atomic>
 #include <sys/stat.h>
 
 
@@ -54,8 +58,9 @@ void replaceString(std::string& text, const std::string& src, const std::string&
 }
 
 // 重複しないidを生成
+// TIPS:複数のFieldを別々のスレッドで動かしても重複しない
 u_int getUniqueNumber() noexcept {
-  static u_int unique_number = 0;
+  static std::atomic<u_int> unique_number(0);
   
   return ++unique_number;
 }
@@ -118,6 +123,29 @@ bool isValidPath(const std::string& path) noexcept {
   // TODO: ディレクトリかどうかも判定
 }
 
+// ファイルのサイズ(無ければ0)
+u_int fileSize(const std::string& path) noexcept {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) return 0;
+  return u_int(info.st_size);
+}
+
+// ファイル全体を読み込む
+std::string readFile(const std::string& path) noexcept {
+  std::ifstream fstr(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(fstr),
+                     std::istreambuf_iterator<char>());
+}
+
+// 変換元の判定などに使うハッシュ値(FNV-1a)
+u_int hashBytes(const char* data, const size_t size) noexcept {
+  uint32_t value = 2166136261u;
+  for (size_t i = 0; i < size; ++i) {
+    value = (value ^ uint8_t(data[i])) * 16777619u;
+  }
+  return value;
+}
+
 std::string createUniquePath() noexcept {
   static int unique_num = 0;
     
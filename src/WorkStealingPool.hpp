@@ -0,0 +1,170 @@
+﻿#pragma once
+
+//
+// ワークスティーリングによる並列実行
+//   スレッドごとに仕事の列を持ち、自分の列は末尾から取り出す
+//   自分の列が空になったら、他のスレッドの列の先頭から盗む
+//   所要時間がばらばらな仕事を大量に流す時に、スレッド間の偏りが出にくい
+//   TIPS:submit, wait はメインスレッドから呼ぶ
+//        仕事にはスレッドの番号が渡されるので、結果はスレッドごとに集計すればロック不要
+//
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <boost/noncopyable.hpp>
+
+
+namespace ngs {
+
+class WorkStealingPool : private boost::noncopyable {
+public:
+  using Task = std::function<void (const u_int worker)>;
+
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+  std::vector<std::unique_ptr<Queue> > queues_;
+
+  std::vector<std::thread> threads_;
+
+  // 終わっていない数
+  std::atomic<u_int> pending_;
+
+  std::mutex mutex_;
+  std::condition_variable ready_cv_;
+  std::condition_variable done_cv_;
+  bool stop_;
+
+  u_int next_queue_;
+
+
+public:
+  // thread_num が0ならCPUの数に合わせる
+  explicit WorkStealingPool(u_int thread_num = 0) noexcept :
+    pending_(0),
+    stop_(false),
+    next_queue_(0)
+  {
+    if (!thread_num) {
+      thread_num = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (u_int i = 0; i < thread_num; ++i) {
+      queues_.emplace_back(new Queue);
+    }
+
+    DOUT << "WorkStealingPool threads:" << thread_num << std::endl;
+    for (u_int i = 0; i < thread_num; ++i) {
+      threads_.emplace_back([this, i]() { workerMain(i); });
+    }
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    ready_cv_.notify_all();
+
+    // TIPS:列に残っている仕事は実行しない
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+
+  u_int threadNum() const noexcept { return u_int(threads_.size()); }
+
+  // 順番に各スレッドの列へ配る
+  void submit(Task task) noexcept {
+    pending_ += 1;
+
+    auto& queue = *queues_[next_queue_];
+    next_queue_ = (next_queue_ + 1) % queues_.size();
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+    {
+      // TIPS:待つ側は mutex_ の中で列を調べるので、通知の前に一度取って起こし損ねを防ぐ
+      std::lock_guard<std::mutex> lock(mutex_);
+    }
+    ready_cv_.notify_one();
+  }
+
+  // すべて終わるまで待つ
+  void wait() noexcept {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return pending_ == 0; });
+  }
+
+  
+private:
+  void workerMain(const u_int index) noexcept {
+    while (true) {
+      Task task;
+      if (pop(index, task) || steal(index, task)) {
+        task(index);
+
+        if (--pending_ == 0) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          done_cv_.notify_all();
+        }
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_cv_.wait(lock, [this]() { return stop_ || hasTask(); });
+      if (stop_) return;
+    }
+  }
+
+  // どれかの列に仕事が残っているか(mutex_ を取ってから呼ぶ)
+  // TIPS:列の数を別に数えると、取り出しと追加の順番によって数がずれる
+  bool hasTask() noexcept {
+    for (auto& queue : queues_) {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      if (!queue->tasks.empty()) return true;
+    }
+    return false;
+  }
+
+  // 自分の列は後ろから(直前に積んだ物ほどキャッシュに残っている)
+  bool pop(const u_int index, Task& task) noexcept {
+    auto& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+  }
+
+  // 他の列は前から
+  bool steal(const u_int index, Task& task) noexcept {
+    u_int num = u_int(queues_.size());
+    for (u_int i = 1; i < num; ++i) {
+      auto& queue = *queues_[(index + i) % num];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty()) continue;
+
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      return true;
+    }
+    return false;
+  }
+  
+};
+
+}
@@ -0,0 +1,678 @@
+﻿//
+// 画面無しで、処理ごとの速さを計って結果を確かめる
+//   最適化した処理と素直な実装(全件走査など)を同じ入力で動かし、結果が一致するかを比べる
+//   一致しないものがあれば終了コード1を返す
+//   GL、サウンド、ウインドウは使わない
+//
+// ビルド例:
+//   c++ -std=c++11 -O2 -DHEADLESS -I../src -I$CINDER_PATH/include bench.cpp
+//       -L$CINDER_PATH/lib -lcinder -lboost_system -lboost_filesystem -lz -o bench
+//   -DDEBUG も付けると、ヒープを使わないはずの処理で確保の回数も調べる
+//   TIPS:確保の回数を調べるもの(param field)は、-DDEBUG が無いと失敗にする
+//
+// 使い方:
+//   bench [-a assets] [-s seed] [name...]
+//   name: occupancy event param field tween bg pick (指定が無い時はすべて)
+//
+
+#include "Defines.hpp"
+#include <string>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <boost/signals2.hpp>
+#include <cinder/Json.h>
+#include <cinder/Timeline.h>
+#include <cinder/Rand.h>
+#include <cinder/Ray.h>
+#include <cinder/AxisAlignedBox.h>
+#include "Utility.hpp"
+#include "JsonUtil.hpp"
+#include "Params.hpp"
+#include "SoundHandle.hpp"
+#include "Records.hpp"
+#include "AllocCounter.hpp"
+#include "Event.hpp"
+#include "EventParam.hpp"
+#include "Occupancy.hpp"
+#include "TweenPool.hpp"
+#include "Bg.hpp"
+#include "BoundingTree.hpp"
+#include "FieldSimulator.hpp"
+
+
+namespace ngs {
+
+// 実行時間(ミリ秒)
+template <typename F>
+double measure(F func) noexcept {
+  auto start = std::chrono::high_resolution_clock::now();
+  func();
+  return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+const char* result(const bool ok) noexcept {
+  return ok ? "ok" : "NG";
+}
+
+// ヒープ確保を数えられるか(DEBUG時のみ)
+bool canCountAlloc() noexcept {
+#ifdef DEBUG
+  return true;
+#else
+  return false;
+#endif
+}
+
+// ヒープ確保の回数
+std::string allocText(const u_int num) noexcept {
+  return canCountAlloc() ? std::to_string(num) : "- (needs -DDEBUG)";
+}
+
+
+// 500個のCubeを並べて、線形探索とBlockGridで隣接するCubeの有無を比べる
+bool benchOccupancy(ci::Rand& rand) noexcept {
+  struct Cube {
+    ci::Vec3i pos;
+    ci::Vec3i prev_pos;
+    bool moving;
+  };
+
+  enum {
+    CUBE_NUM  = 500,
+    WIDTH     = 16,
+    DEPTH     = 100,
+    LOOP_NUM  = 100,
+  };
+
+  std::vector<Cube> cubes;
+  cubes.reserve(CUBE_NUM);
+  for (int i = 0; i < CUBE_NUM; ++i) {
+    ci::Vec3i pos(rand.nextInt(WIDTH), 0, rand.nextInt(DEPTH));
+    ci::Vec3i prev_pos(pos.x, 0, std::max(pos.z - 1, 0));
+    cubes.push_back({ pos, prev_pos, (i & 3) == 0 });
+  }
+
+  BlockGrid<Cube> grid;
+  grid.setWindow(0, DEPTH - 1);
+  for (auto& cube : cubes) {
+    if (cube.moving) grid.update(cube, cube.pos, cube.prev_pos);
+    else             grid.update(cube, cube.pos);
+  }
+
+  static const ci::Vec3i offset_table[] = {
+    {  1, 0,  0 },
+    { -1, 0,  0 },
+    {  0, 0,  1 },
+    {  0, 0, -1 },
+  };
+  const size_t offset_num = sizeof(offset_table) / sizeof(offset_table[0]);
+
+  auto exists = [](const Cube& cube, const ci::Vec3i& pos) {
+    return (pos == cube.pos) || (cube.moving && (pos == cube.prev_pos));
+  };
+
+  // Cubeと方向ごとの結果
+  std::vector<u_char> scan_hit(CUBE_NUM * offset_num);
+  std::vector<u_char> grid_hit(CUBE_NUM * offset_num);
+
+  double scan_ms = measure([&]() {
+      for (int l = 0; l < LOOP_NUM; ++l) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+          for (size_t o = 0; o < offset_num; ++o) {
+            auto pos = cubes[i].pos + offset_table[o];
+            scan_hit[i * offset_num + o] = std::any_of(std::begin(cubes), std::end(cubes),
+                                                       [&exists, &pos](const Cube& other) { return exists(other, pos); });
+          }
+        }
+      }
+    });
+
+  double grid_ms = measure([&]() {
+      for (int l = 0; l < LOOP_NUM; ++l) {
+        for (size_t i = 0; i < cubes.size(); ++i) {
+          for (size_t o = 0; o < offset_num; ++o) {
+            auto pos = cubes[i].pos + offset_table[o];
+            grid_hit[i * offset_num + o] = grid.find(pos, [&exists, &pos](const Cube& other) { return exists(other, pos); }) != nullptr;
+          }
+        }
+      }
+    });
+
+  int hit = int(std::count(std::begin(scan_hit), std::end(scan_hit), 1));
+  int mismatch = 0;
+  for (size_t i = 0; i < scan_hit.size(); ++i) {
+    if (scan_hit[i] != grid_hit[i]) mismatch += 1;
+  }
+
+  printf("occupancy: cubes %d scan %.3fms grid %.3fms hit %d/%d mismatch %d %s\n",
+         int(CUBE_NUM),
+         scan_ms / LOOP_NUM, grid_ms / LOOP_NUM,
+         hit, int(scan_hit.size()), mismatch, result(!mismatch));
+
+  return !mismatch;
+}
+
+
+// 文字列をキーにしたstd::mapと、EventIdでのsignalを比べる
+// 指定したメッセージの受け手だけが、送った回数だけ呼ばれることを確かめる
+bool benchEvent() noexcept {
+  enum {
+    MESSAGE_NUM = 40,
+    TARGET      = 20,
+    LOOP_NUM    = 100000,
+  };
+
+  using SignalType = boost::signals2::signal<void(int&)>;
+  std::map<std::string, SignalType> signals;
+  Event<int> event;
+
+  std::vector<int> map_count(MESSAGE_NUM, 0);
+  std::vector<int> event_count(MESSAGE_NUM, 0);
+  for (int i = 0; i < MESSAGE_NUM; ++i) {
+    auto msg = "benchmark-" + std::to_string(i);
+    signals[msg].connect([&map_count, i](int& value) { map_count[i] += value; });
+    event.connect(msg, [&event_count, i](const Connection&, int& value) { event_count[i] += value; });
+  }
+
+  int value = 1;
+
+  double map_ms = measure([&]() {
+      for (int i = 0; i < LOOP_NUM; ++i) {
+        signals["benchmark-20"](value);
+      }
+    });
+
+  double string_ms = measure([&]() {
+      for (int i = 0; i < LOOP_NUM; ++i) {
+        event.signal("benchmark-20", value);
+      }
+    });
+
+  static const EventId id("benchmark-20");
+  double id_ms = measure([&]() {
+      for (int i = 0; i < LOOP_NUM; ++i) {
+        event.signal(id, value);
+      }
+    });
+
+  // 文字列とEventIdの両方で送ったので、EventIdの受け手は2倍呼ばれる
+  int mismatch = 0;
+  for (int i = 0; i < MESSAGE_NUM; ++i) {
+    if (map_count[i] != ((i == TARGET) ? LOOP_NUM : 0)) mismatch += 1;
+    if (event_count[i] != ((i == TARGET) ? (LOOP_NUM * 2) : 0)) mismatch += 1;
+  }
+
+  printf("event:     map %.1fns string %.1fns id %.1fns mismatch %d %s\n",
+         map_ms * 1000000.0 / LOOP_NUM,
+         string_ms * 1000000.0 / LOOP_NUM,
+         id_ms * 1000000.0 / LOOP_NUM,
+         mismatch, result(!mismatch));
+
+  return !mismatch;
+}
+
+
+// EventParamを付けたsignalが、ヒープを使わずに値を受け渡すことを確かめる
+bool benchParam() noexcept {
+  enum {
+    LOOP_NUM = 100000,
+  };
+
+  static const EventId msg("benchmark-param");
+  static const EventId active_key("active");
+  static const EventId count_key("count");
+  static const EventId pos_key("pos");
+  static const EventId name_key("name");
+
+  const ci::Vec3f pos(1.0f, 2.0f, 3.0f);
+  const std::string name("cube");
+
+  Event<EventParam> event;
+  int received = 0;
+  int mismatch = 0;
+  event.connect(msg,
+                [&](const Connection&, EventParam& param) noexcept {
+                  received += 1;
+                  if (!param.get<bool>(active_key)
+                      || (param.get<int>(count_key) != received)
+                      || (param.get<ci::Vec3f>(pos_key) != pos)
+                      || (param.get<std::string>(name_key) != name)) {
+                    mismatch += 1;
+                  }
+                });
+
+  u_int alloc_num = AllocCounter::count();
+  double ms = measure([&]() {
+      for (int i = 1; i <= LOOP_NUM; ++i) {
+        EventParam params = {
+          { active_key, true },
+          { count_key, i },
+          { pos_key, pos },
+          { name_key, name },
+        };
+        event.signal(msg, params);
+      }
+    });
+  alloc_num = AllocCounter::count() - alloc_num;
+
+  if (received != LOOP_NUM) mismatch += 1;
+  bool ok = !mismatch && canCountAlloc() && !alloc_num;
+
+  printf("param:     signal %.1fns alloc %s mismatch %d %s\n",
+         ms * 1000000.0 / LOOP_NUM,
+         allocText(alloc_num).c_str(), mismatch, result(ok));
+
+  return ok;
+}
+
+
+// FieldSimulatorを動かし続けた後、FieldEntityの更新でヒープを使わないことを確かめる
+//   PickableCubeを前に進め続けてStageの生成を始め、入力を止めてから数える
+//   TIPS:入力を止めた後もStageの生成と崩壊は進むので、その間のsignalも含まれる
+bool benchField(ci::JsonTree& params, const u_int seed) noexcept {
+  enum {
+    WARMUP_FRAME_NUM = 600,
+    MOVE_INTERVAL    = 30,
+    FRAME_NUM        = 120,
+  };
+
+  const double frame_seconds = 1.0 / 60.0;
+
+  Records records(params["version"].getValue<float>());
+  FieldSimulator simulator(params, records, seed);
+
+  while (simulator.frameNum() < WARMUP_FRAME_NUM) {
+    if (!(simulator.frameNum() % MOVE_INTERVAL)) {
+      for (size_t i = 0; i < simulator.pickableCubeNum(); ++i) {
+        simulator.movePickableCube(i, PickableCube::MOVE_UP, 1);
+      }
+    }
+    simulator.update(frame_seconds);
+  }
+  u_int play_num = simulator.playNum();
+
+  u_int alloc_num   = 0;
+  u_int alloc_max   = 0;
+  int   alloc_frame = 0;
+  double ms = measure([&]() {
+      for (int i = 0; i < FRAME_NUM; ++i) {
+        u_int num = AllocCounter::count();
+        simulator.update(frame_seconds);
+        num = AllocCounter::count() - num;
+
+        alloc_num += num;
+        alloc_max  = std::max(num, alloc_max);
+        if (num) alloc_frame += 1;
+      }
+    });
+
+  // 数えている間にゲームオーバーなどでやり直したら、定常状態ではない
+  bool steady = simulator.playNum() == play_num;
+  bool ok = steady && canCountAlloc() && !alloc_num;
+
+  printf("field:     frames %d update %.3fms alloc %s (max %u/frame, %d frames) steady %d %s\n",
+         int(FRAME_NUM), ms / FRAME_NUM,
+         allocText(alloc_num).c_str(), alloc_max, alloc_frame, int(steady), result(ok));
+
+  return ok;
+}
+
+
+// 10000個のStageCubeを想定して、ci::TimelineとTweenPoolで落下演出を繰り返す
+// 繰り返しを止めた後は、どちらもすべて終了値で止まることを確かめる
+bool benchTween(ci::Rand& rand) noexcept {
+  enum {
+    CUBE_NUM  = 10000,
+    FRAME_NUM = 300,
+  };
+
+  const float duration = 0.6f;
+  const double frame_seconds = 1.0 / 60.0;
+  // delayの分も含めて、すべて終わるまでのフレーム数
+  const int finish_frame_num = int(duration * 2.0f / frame_seconds) + 2;
+
+  std::vector<ci::Vec3f> end_values;
+  std::vector<float> delays;
+  end_values.reserve(CUBE_NUM);
+  delays.reserve(CUBE_NUM);
+  for (int i = 0; i < CUBE_NUM; ++i) {
+    end_values.push_back(ci::Vec3f(float(i % 16), 0.0f, float(i / 16)));
+    delays.push_back(rand.nextFloat(0.0f, duration));
+  }
+
+  auto countMismatch = [&end_values](const std::vector<ci::Vec3f>& values) {
+    int mismatch = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+      if ((values[i] - end_values[i]).lengthSquared() > 1e-8f) mismatch += 1;
+    }
+    return mismatch;
+  };
+
+  // ci::Timeline
+  double timeline_ms;
+  u_int timeline_alloc;
+  int timeline_mismatch;
+  {
+    auto timeline = ci::Timeline::create();
+    std::vector<ci::Anim<ci::Vec3f> > positions(CUBE_NUM);
+    u_int alloc_num = AllocCounter::count();
+    timeline_ms = measure([&]() {
+        for (int i = 0; i < CUBE_NUM; ++i) {
+          timeline->apply(&positions[i], end_values[i] + ci::Vec3f(0, 10, 0), end_values[i],
+                          duration, getEaseFunc("EaseOutBack")).delay(delays[i]);
+        }
+        for (int f = 0; f < FRAME_NUM; ++f) {
+          timeline->step(frame_seconds);
+          // 終わったものは繰り返す
+          for (int i = 0; i < CUBE_NUM; ++i) {
+            if (!positions[i].isComplete()) continue;
+            timeline->apply(&positions[i], end_values[i] + ci::Vec3f(0, 10, 0), end_values[i],
+                            duration, getEaseFunc("EaseOutBack"));
+          }
+        }
+      });
+    timeline_alloc = AllocCounter::count() - alloc_num;
+
+    for (int f = 0; f < finish_frame_num; ++f) {
+      timeline->step(frame_seconds);
+    }
+    std::vector<ci::Vec3f> values;
+    values.reserve(CUBE_NUM);
+    for (const auto& p : positions) {
+      values.push_back(p.value());
+    }
+    timeline_mismatch = countMismatch(values);
+  }
+
+  // TweenPool
+  double pool_ms;
+  u_int pool_alloc;
+  int pool_mismatch;
+  {
+    TweenPool<ci::Vec3f> pool;
+    u_int ease = pool.ease("EaseOutBack");
+    pool.reserve(CUBE_NUM);
+    std::vector<ci::Vec3f> positions(CUBE_NUM);
+    std::vector<TweenHandle> handles(CUBE_NUM);
+    u_int alloc_num = AllocCounter::count();
+    pool_ms = measure([&]() {
+        for (int i = 0; i < CUBE_NUM; ++i) {
+          handles[i] = pool.apply(&positions[i], end_values[i] + ci::Vec3f(0, 10, 0), end_values[i],
+                                  duration, ease, delays[i]);
+        }
+        for (int f = 0; f < FRAME_NUM; ++f) {
+          pool.update(frame_seconds);
+          for (int i = 0; i < CUBE_NUM; ++i) {
+            if (pool.isPlaying(handles[i])) continue;
+            handles[i] = pool.apply(&positions[i], end_values[i] + ci::Vec3f(0, 10, 0), end_values[i],
+                                    duration, ease);
+          }
+        }
+      });
+    pool_alloc = AllocCounter::count() - alloc_num;
+
+    for (int f = 0; f < finish_frame_num; ++f) {
+      pool.update(frame_seconds);
+    }
+    pool_mismatch = countMismatch(positions) + int(pool.playingNum());
+  }
+
+  // TIPS:TweenPoolは確保済みの枠だけで動く
+  bool ok = !timeline_mismatch && !pool_mismatch && !pool_alloc;
+
+  printf("tween:     cubes %d timeline %.3fms alloc %s pool %.3fms alloc %s mismatch %d/%d %s\n",
+         int(CUBE_NUM),
+         timeline_ms / FRAME_NUM, allocText(timeline_alloc).c_str(),
+         pool_ms / FRAME_NUM, allocText(pool_alloc).c_str(),
+         timeline_mismatch, pool_mismatch, result(ok));
+
+  return ok;
+}
+
+
+// 標準の10倍の密度を想定した数のCubeで、スカラー演算とSIMDの移動を比べる
+// TIPS:SIMDを使わない環境では同じ処理の比較になる
+bool benchBg(ci::Rand& rand) noexcept {
+  enum {
+    CUBE_NUM  = 8000,
+    FRAME_NUM = 1000,
+  };
+
+  ci::Vec3f bbox_min(-25, -16, -3);
+  ci::Vec3f bbox_max( 25,  -4, 34);
+
+  Bg::Cubes cubes;
+  for (int i = 0; i < CUBE_NUM; ++i) {
+    ci::Vec3f pos(rand.nextFloat(bbox_min.x, bbox_max.x),
+                  rand.nextFloat(bbox_min.y, bbox_max.y),
+                  rand.nextFloat(bbox_min.z, bbox_max.z));
+    float speed = rand.nextFloat(-1.2f, 1.2f);
+    cubes.push(pos, ci::Color::white(),
+               (i & 1) ? ci::Vec3f(speed, 0, 0) : ci::Vec3f(0, 0, speed));
+  }
+  cubes.pad();
+
+  // 毎フレームBBoxの反対側へ戻す
+  auto run = [&](Bg::Cubes& c,
+                 void (*move)(Bg::Cubes&, const float,
+                              const ci::Vec3f&, const ci::Vec3f&,
+                              std::vector<u_int>&)) {
+    std::vector<u_int> out_of_bbox;
+    out_of_bbox.reserve(c.x.size());
+    size_t out_num = 0;
+
+    double ms = measure([&]() {
+        for (int f = 0; f < FRAME_NUM; ++f) {
+          out_of_bbox.clear();
+          move(c, 1.0f / 60.0f, bbox_min, bbox_max, out_of_bbox);
+          for (auto index : out_of_bbox) {
+            c.x[index] = ci::math<float>::clamp(c.x[index], bbox_min.x, bbox_max.x);
+            c.z[index] = ci::math<float>::clamp(c.z[index], bbox_min.z, bbox_max.z);
+            c.speed_x[index] = -c.speed_x[index];
+            c.speed_z[index] = -c.speed_z[index];
+          }
+          out_num += out_of_bbox.size();
+        }
+      });
+
+    return std::make_pair(ms / FRAME_NUM, out_num);
+  };
+
+  Bg::Cubes scalar_cubes = cubes;
+  Bg::Cubes simd_cubes   = cubes;
+  auto scalar = run(scalar_cubes, &Bg::moveCubesScalar);
+  auto simd   = run(simd_cubes, &Bg::moveCubes);
+
+  // 止めたCube(埋めた分)も含めて、最後の位置を比べる
+  int mismatch = (scalar.second != simd.second) ? 1 : 0;
+  for (size_t i = 0; i < cubes.x.size(); ++i) {
+    if ((scalar_cubes.position(i) - simd_cubes.position(i)).lengthSquared() > 1e-6f) mismatch += 1;
+  }
+
+  printf("bg:        cubes %d scalar %.3fms simd %.3fms out %d/%d mismatch %d %s\n",
+         int(cubes.num),
+         scalar.first, simd.first,
+         int(scalar.second), int(simd.second), mismatch, result(!mismatch));
+
+  return !mismatch;
+}
+
+
+// 多数のCubeに対して、全件走査とBVHでRayの当たり判定を比べる
+bool benchPick(ci::Rand& rand) noexcept {
+  enum {
+    CUBE_NUM  = 500,
+    WIDTH     = 16,
+    DEPTH     = 100,
+    RAY_NUM   = 1000,
+  };
+
+  std::vector<ci::Vec3f> positions;
+  positions.reserve(CUBE_NUM);
+  for (int i = 0; i < CUBE_NUM; ++i) {
+    positions.push_back(ci::Vec3f(float(rand.nextInt(WIDTH)), 0.0f, float(rand.nextInt(DEPTH))));
+  }
+
+  std::vector<ci::Ray> rays;
+  rays.reserve(RAY_NUM);
+  for (int i = 0; i < RAY_NUM; ++i) {
+    ci::Vec3f target(rand.nextFloat(0.0f, float(WIDTH)), 0.0f, rand.nextFloat(0.0f, float(DEPTH)));
+    ci::Vec3f origin = target + ci::Vec3f(0.0f, 20.0f, -15.0f);
+    rays.push_back(ci::Ray(origin, (target - origin).normalized()));
+  }
+
+  ci::Vec3f half_size(0.6f, 0.6f, 0.6f);
+
+  BoundingTree tree;
+  tree.beginUpdate();
+  for (int i = 0; i < CUBE_NUM; ++i) {
+    tree.update(i, positions[i] - half_size, positions[i] + half_size);
+  }
+  tree.endUpdate();
+
+  // Rayの原点からidのCubeまでの距離(当たらない時は負の値)
+  auto distance = [&positions, &half_size](const ci::Ray& ray, const u_int id) {
+    ci::AxisAlignedBox3f bbox(positions[id] - half_size, positions[id] + half_size);
+    float intersections[3];
+    int num = bbox.intersect(ray, intersections);
+    if (!num) return -1.0f;
+    return (num > 1) ? std::min(intersections[0], intersections[1]) : intersections[0];
+  };
+
+  // 同じ位置に重なったCubeもあるので、idではなく距離で比べる
+  // TIPS:奇数のidを無視する場合も調べる(PickableCube同士を除外するのと同じ使い方)
+  auto no_skip  = [](const u_int) { return false; };
+  auto skip_odd = [](const u_int id) { return (id & 1) != 0; };
+
+  auto scan = [&](const ci::Ray& ray, const bool odd) {
+    float near_z = -1.0f;
+    for (u_int id = 0; id < positions.size(); ++id) {
+      if (odd && skip_odd(id)) continue;
+
+      float z = distance(ray, id);
+      if ((z < 0.0f) || ((near_z >= 0.0f) && (z > near_z))) continue;
+      near_z = z;
+    }
+    return near_z;
+  };
+
+  std::vector<float> scan_z(RAY_NUM);
+  std::vector<float> tree_z(RAY_NUM);
+
+  double scan_ms = measure([&]() {
+      for (int i = 0; i < RAY_NUM; ++i) {
+        scan_z[i] = scan(rays[i], false);
+      }
+    });
+
+  double tree_ms = measure([&]() {
+      for (int i = 0; i < RAY_NUM; ++i) {
+        auto id = tree.rayCast(rays[i], no_skip);
+        tree_z[i] = id ? distance(rays[i], *id) : -1.0f;
+      }
+    });
+
+  int hit = 0;
+  int mismatch = 0;
+  for (int i = 0; i < RAY_NUM; ++i) {
+    if (scan_z[i] >= 0.0f) hit += 1;
+    if (std::abs(scan_z[i] - tree_z[i]) > 1e-4f) mismatch += 1;
+
+    auto id = tree.rayCast(rays[i], skip_odd);
+    float z = id ? distance(rays[i], *id) : -1.0f;
+    if ((id && skip_odd(*id)) || (std::abs(scan(rays[i], true) - z) > 1e-4f)) mismatch += 1;
+  }
+
+  printf("pick:      cubes %d scan %.3fus tree %.3fus hit %d/%d mismatch %d %s\n",
+         int(CUBE_NUM),
+         scan_ms * 1000.0 / RAY_NUM, tree_ms * 1000.0 / RAY_NUM,
+         hit, int(RAY_NUM), mismatch, result(!mismatch));
+
+  return !mismatch;
+}
+
+}
+
+
+void printHelp() {
+  printf("Measure and check core routines without display\n");
+  printf("Usage:bench [-a assets] [-s seed] [name...]\n");
+  printf("  name: occupancy event param field tween bg pick\n");
+}
+
+int main(int argc, const char* argv[]) {
+  u_int seed = 1;
+  std::vector<std::string> names;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if ((arg == "-h") || (arg == "--help")) {
+      printHelp();
+      return 0;
+    }
+
+    if ((arg.size() == 2) && (arg[0] == '-') && ((i + 1) < argc)) {
+      const char* value = argv[++i];
+      switch (arg[1]) {
+      case 'a': ngs::Asset::rootPath() = std::string(value) + "/"; break;
+      case 's': seed = std::atoi(value); break;
+      default:
+        printHelp();
+        return 1;
+      }
+      continue;
+    }
+    names.push_back(arg);
+  }
+
+  // イージングと効果音の番号はparamsから作る
+  auto params = ngs::Params::load("params.json");
+  ngs::setupEaseFunc(params);
+  ngs::setupSoundHandle(params["sounds"]);
+
+  // 同じseedなら同じ入力になる
+  ci::Rand rand(seed);
+
+  struct Bench {
+    const char* name;
+    std::function<bool()> func;
+  };
+
+  std::vector<Bench> benches = {
+    { "occupancy", [&rand]() { return ngs::benchOccupancy(rand); } },
+    { "event",     []()      { return ngs::benchEvent(); } },
+    { "param",     []()      { return ngs::benchParam(); } },
+    { "field",     [&]()     { return ngs::benchField(params, seed); } },
+    { "tween",     [&rand]() { return ngs::benchTween(rand); } },
+    { "bg",        [&rand]() { return ngs::benchBg(rand); } },
+    { "pick",      [&rand]() { return ngs::benchPick(rand); } },
+  };
+
+  for (const auto& name : names) {
+    auto it = std::find_if(std::begin(benches), std::end(benches),
+                           [&name](const Bench& b) { return name == b.name; });
+    if (it == std::end(benches)) {
+      printf("unknown: %s\n", name.c_str());
+      return 1;
+    }
+  }
+
+  int failed = 0;
+  for (const auto& bench : benches) {
+    if (!names.empty() && (std::find(std::begin(names), std::end(names), bench.name) == std::end(names))) continue;
+    if (!bench.func()) failed += 1;
+  }
+
+  if (failed) {
+    printf("%d failed\n", failed);
+    return 1;
+  }
+  return 0;
+}
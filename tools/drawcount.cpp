@@ -0,0 +1,605 @@
+﻿//
+// 画面無しで、1フレームあたりのGL呼び出し回数を数える
+//   FieldSimulatorを動かし、以前のCubeごとの描画とCubeBatchでまとめた描画を同じ状態で比べる
+//   UIは、Widgetごとに頂点をbindしていた描画とGeometryArenaを一度だけbindする描画を比べる
+//   GLの関数をマクロで置き換えて数えるので、GL、サウンド、ウインドウは使わない
+//   TIPS:CubeBatchとGeometryArenaはそのまま使い、以前の描画はCinder 0.8.6の
+//        gl::draw(VboMesh)などが発行する呼び出しを並べて再現している
+//        マテリアル、フォグ、深度などの設定はどちらも同じなので数えない
+//
+// ビルド例:
+//   c++ -std=c++11 -O2 -DHEADLESS -I../src -I$CINDER_PATH/include drawcount.cpp
+//       -L$CINDER_PATH/lib -lcinder -lboost_system -lboost_filesystem -lz -o drawcount
+//
+// 使い方:
+//   drawcount [-a assets] [-s seed] [-f frames]
+//
+
+#include "Defines.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <boost/signals2.hpp>
+#include <cinder/Json.h>
+#include <cinder/Timeline.h>
+#include <cinder/TriMesh.h>
+#include <cinder/gl/gl.h>
+#include "Utility.hpp"
+#include "JsonUtil.hpp"
+#include "Params.hpp"
+#include "SoundHandle.hpp"
+#include "Records.hpp"
+#include "FieldSimulator.hpp"
+#include "FieldSnapshot.hpp"
+#include "CubeText.hpp"
+#include "Model.hpp"
+
+
+namespace ngs { namespace GlCounter {
+
+enum Kind {
+  BIND,
+  UPLOAD,
+  STATE,
+  DRAW,
+  MATRIX,
+  OTHER,
+
+  KIND_NUM
+};
+
+const char* kind_names[] = {
+  "bind", "upload", "state", "draw", "matrix", "other",
+};
+
+u_int counts[KIND_NUM];
+
+void call(const Kind kind) noexcept {
+  counts[kind] += 1;
+}
+
+void reset() noexcept {
+  std::fill(std::begin(counts), std::end(counts), 0);
+}
+
+u_int total() noexcept {
+  u_int num = 0;
+  for (auto count : counts) num += count;
+  return num;
+}
+
+} }
+
+
+// ここから後で使うGLの関数を数えるだけにする
+// TIPS:環境によってはマクロで定義されているので、先にundefしておく
+#undef glGenBuffers
+#undef glDeleteBuffers
+#undef glBindBuffer
+#undef glBindTexture
+#undef glBufferData
+#undef glBufferSubData
+#undef glEnableClientState
+#undef glDisableClientState
+#undef glClientActiveTexture
+#undef glVertexPointer
+#undef glNormalPointer
+#undef glColorPointer
+#undef glTexCoordPointer
+#undef glEnable
+#undef glDisable
+#undef glDrawElements
+#undef glDrawArrays
+#undef glMatrixMode
+#undef glPushMatrix
+#undef glPopMatrix
+#undef glLoadIdentity
+#undef glTranslatef
+#undef glScalef
+#undef glMultMatrixf
+#undef glColor4f
+
+#define glGenBuffers(...)          ngs::GlCounter::call(ngs::GlCounter::OTHER)
+#define glDeleteBuffers(...)       ngs::GlCounter::call(ngs::GlCounter::OTHER)
+#define glBindBuffer(...)          ngs::GlCounter::call(ngs::GlCounter::BIND)
+#define glBindTexture(...)         ngs::GlCounter::call(ngs::GlCounter::BIND)
+#define glBufferData(...)          ngs::GlCounter::call(ngs::GlCounter::UPLOAD)
+#define glBufferSubData(...)       ngs::GlCounter::call(ngs::GlCounter::UPLOAD)
+#define glEnableClientState(...)   ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glDisableClientState(...)  ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glClientActiveTexture(...) ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glVertexPointer(...)       ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glNormalPointer(...)       ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glColorPointer(...)        ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glTexCoordPointer(...)     ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glEnable(...)              ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glDisable(...)             ngs::GlCounter::call(ngs::GlCounter::STATE)
+#define glDrawElements(...)        ngs::GlCounter::call(ngs::GlCounter::DRAW)
+#define glDrawArrays(...)          ngs::GlCounter::call(ngs::GlCounter::DRAW)
+#define glMatrixMode(...)          ngs::GlCounter::call(ngs::GlCounter::MATRIX)
+#define glPushMatrix(...)          ngs::GlCounter::call(ngs::GlCounter::MATRIX)
+#define glPopMatrix(...)           ngs::GlCounter::call(ngs::GlCounter::MATRIX)
+#define glLoadIdentity(...)        ngs::GlCounter::call(ngs::GlCounter::MATRIX)
+#define glTranslatef(...)          ngs::GlCounter::call(ngs::GlCounter::MATRIX)
+#define glScalef(...)              ngs::GlCounter::call(ngs::GlCounter::MATRIX)
+#define glMultMatrixf(...)         ngs::GlCounter::call(ngs::GlCounter::MATRIX)
+#define glColor4f(...)             ngs::GlCounter::call(ngs::GlCounter::OTHER)
+
+#include "GeometryArena.hpp"
+#include "ModelHolder.hpp"
+#include "CubeBatch.hpp"
+
+
+namespace ngs {
+
+// フレームごとの回数の平均と最大
+struct CallStats {
+  u_int frame_num;
+  u_int sum[GlCounter::KIND_NUM + 1];
+  u_int max[GlCounter::KIND_NUM + 1];
+
+  CallStats() noexcept :
+    frame_num(0)
+  {
+    std::fill(std::begin(sum), std::end(sum), 0);
+    std::fill(std::begin(max), std::end(max), 0);
+  }
+
+  // 数え始める
+  void begin() noexcept {
+    GlCounter::reset();
+  }
+
+  void end() noexcept {
+    for (int i = 0; i < GlCounter::KIND_NUM; ++i) {
+      add(i, GlCounter::counts[i]);
+    }
+    add(GlCounter::KIND_NUM, GlCounter::total());
+    frame_num += 1;
+  }
+
+  void print(const char* name) const noexcept {
+    printf("  %-9s", name);
+    for (int i = 0; i <= GlCounter::KIND_NUM; ++i) {
+      const char* kind = (i < GlCounter::KIND_NUM) ? GlCounter::kind_names[i] : "total";
+      printf(" %s %.1f(%u)", kind, average(i), max[i]);
+    }
+    printf("\n");
+  }
+
+  double average(const int kind) const noexcept {
+    return frame_num ? double(sum[kind]) / frame_num : 0.0;
+  }
+
+
+private:
+  void add(const int kind, const u_int num) noexcept {
+    sum[kind] += num;
+    max[kind]  = std::max(max[kind], num);
+  }
+
+};
+
+
+// 以前の描画で使っていたVboMeshの属性
+struct VboLayout {
+  bool has_normals;
+  bool has_uvs;
+};
+
+// Cinder 0.8.6 の VboMesh::enableClientStates() と bindAllData()
+void bindVboMesh(const VboLayout& layout) noexcept {
+  glEnableClientState(GL_VERTEX_ARRAY);
+  if (layout.has_normals) glEnableClientState(GL_NORMAL_ARRAY);
+  if (layout.has_uvs) {
+    glClientActiveTexture(GL_TEXTURE0);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  }
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glVertexPointer(3, GL_FLOAT, 0, 0);
+  if (layout.has_normals) glNormalPointer(GL_FLOAT, 0, 0);
+  if (layout.has_uvs) {
+    glClientActiveTexture(GL_TEXTURE0);
+    glTexCoordPointer(2, GL_FLOAT, 0, 0);
+  }
+}
+
+// VboMesh::unbindBuffers() と disableClientStates()
+void unbindVboMesh(const VboLayout& layout) noexcept {
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  glDisableClientState(GL_VERTEX_ARRAY);
+  if (layout.has_normals) glDisableClientState(GL_NORMAL_ARRAY);
+  if (layout.has_uvs) {
+    glClientActiveTexture(GL_TEXTURE0);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  }
+}
+
+// gl::draw(VboMesh)
+void drawVboMesh(const VboLayout& layout) noexcept {
+  bindVboMesh(layout);
+  glDrawElements(GL_TRIANGLES, 0, GL_UNSIGNED_SHORT, 0);
+  unbindVboMesh(layout);
+}
+
+// gl::texture->enableAndBind()
+void enableAndBindTexture() noexcept {
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// gl::texture->unbind() と disable()
+void unbindAndDisableTexture() noexcept {
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glDisable(GL_TEXTURE_2D);
+}
+
+
+// 以前のFieldViewの描画(Cubeごとに色と行列を設定してgl::draw)
+// matrix_call_num: translateの後に呼ぶscaleとrotateの数
+void drawCubesPerCube(const size_t cube_num, const VboLayout& layout,
+                      const int matrix_call_num) noexcept {
+  for (size_t i = 0; i < cube_num; ++i) {
+    glColor4f(0, 0, 0, 1);
+
+    // gl::pushModelView()
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+
+    glTranslatef(0, 0, 0);
+    for (int m = 0; m < matrix_call_num; ++m) {
+      glMultMatrixf(nullptr);
+    }
+
+    drawVboMesh(layout);
+
+    // gl::popModelView()
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+  }
+}
+
+void drawFieldPerCube(const FieldSnapshot& field,
+                      const std::map<std::string, VboLayout>& layouts,
+                      const std::string& oneway_model) noexcept {
+  // stage cubeはtranslateのみ
+  drawCubesPerCube(field.stage_cubes.size(), layouts.at("stage_cube"), 0);
+  // 影はscale rotate scale
+  drawCubesPerCube(field.item_shadows.size(), layouts.at("item_shadow"), 3);
+  // 他はrotateとscale
+  drawCubesPerCube(field.pickable_cubes.size(), layouts.at("pickable_cube"), 2);
+  drawCubesPerCube(field.item_cubes.size(), layouts.at("item_cube"), 2);
+  drawCubesPerCube(field.moving_cubes.size(), layouts.at("pickable_cube"), 2);
+  drawCubesPerCube(field.falling_cubes.size(), layouts.at("pickable_cube"), 2);
+  drawCubesPerCube(field.switches.size(), layouts.at("switch"), 2);
+  drawCubesPerCube(field.oneways.size(), layouts.at(oneway_model), 2);
+  // bgはscaleのみ
+  drawCubesPerCube(field.bg_cubes.size(), layouts.at("bg_cube"), 1);
+}
+
+
+// FieldView::draw と同じ順番でCubeBatchに追加する
+// TIPS:補間とカリングは呼び出し回数に影響しないので省いている
+void drawFieldBatched(const FieldSnapshot& field, ModelHolder& models,
+                      CubeBatch& batch, const std::string& oneway_model) noexcept {
+  batch.begin(models.get("stage_cube"));
+  for (const auto& cube : field.stage_cubes) {
+    batch.add(cube.position, cube.color);
+  }
+  batch.end();
+
+  batch.begin(models.get("item_shadow"));
+  for (const auto& shadow : field.item_shadows) {
+    auto matrix = ci::Matrix44f::createTranslation(shadow.position);
+    matrix.scale(ci::Vec3f(1.0f, 0.0f, 1.0f));
+    matrix *= shadow.rotation.toMatrix44();
+    matrix.scale(shadow.size);
+    batch.add(matrix, ci::ColorA(0, 0, 0, shadow.alpha));
+  }
+  batch.end();
+
+  auto drawCubes = [&batch, &models](const std::vector<FieldSnapshot::Cube>& cubes,
+                                     const std::string& model_name) {
+    batch.begin(models.get(model_name));
+    for (const auto& cube : cubes) {
+      auto matrix = ci::Matrix44f::createTranslation(cube.position);
+      matrix *= cube.rotation.toMatrix44();
+      matrix.scale(cube.size);
+      batch.add(matrix, cube.color);
+    }
+    batch.end();
+  };
+
+  drawCubes(field.pickable_cubes, "pickable_cube");
+  drawCubes(field.item_cubes, "item_cube");
+  drawCubes(field.moving_cubes, "pickable_cube");
+  drawCubes(field.falling_cubes, "pickable_cube");
+  drawCubes(field.switches, "switch");
+  drawCubes(field.oneways, oneway_model);
+
+  batch.begin(models.get("bg_cube"));
+  for (const auto& cube : field.bg_cubes) {
+    auto matrix = ci::Matrix44f::createTranslation(cube.position);
+    matrix.scale(cube.size);
+    batch.add(matrix, cube.color);
+  }
+  batch.end();
+}
+
+
+// PickableCubeを一定間隔で上へ動かしながら、毎フレーム両方の描画を数える
+void countField(ci::JsonTree& params, const u_int seed, const int frame_num,
+                ModelHolder& models,
+                const std::map<std::string, VboLayout>& layouts) noexcept {
+  enum {
+    MOVE_INTERVAL = 30,
+  };
+
+  const double frame_seconds = 1.0 / 60.0;
+  const auto oneway_model = Json::getArray<std::string>(params["game_view.oneway.model"])[0];
+
+  Records records(params["version"].getValue<float>());
+  FieldSimulator simulator(params, records, seed);
+
+  CubeBatch batch;
+  FieldSnapshot snapshot;
+
+  CallStats per_cube;
+  CallStats batched;
+  size_t cube_num = 0;
+  size_t cube_max = 0;
+
+  while (simulator.frameNum() < u_int(frame_num)) {
+    if (!(simulator.frameNum() % MOVE_INTERVAL)) {
+      for (size_t i = 0; i < simulator.pickableCubeNum(); ++i) {
+        simulator.movePickableCube(i, PickableCube::MOVE_UP, 1);
+      }
+    }
+    simulator.update(frame_seconds);
+
+    snapshot.capture(simulator.fieldData());
+
+    size_t num = snapshot.stage_cubes.size()
+               + snapshot.item_shadows.size()
+               + snapshot.pickable_cubes.size()
+               + snapshot.item_cubes.size()
+               + snapshot.moving_cubes.size()
+               + snapshot.falling_cubes.size()
+               + snapshot.switches.size()
+               + snapshot.oneways.size()
+               + snapshot.bg_cubes.size();
+    cube_num += num;
+    cube_max  = std::max(cube_max, num);
+
+    per_cube.begin();
+    drawFieldPerCube(snapshot, layouts, oneway_model);
+    per_cube.end();
+
+    batched.begin();
+    drawFieldBatched(snapshot, models, batch, oneway_model);
+    batched.end();
+  }
+
+  printf("field: frames %d seed %u cubes %.1f(%u)\n",
+         frame_num, seed, double(cube_num) / frame_num, u_int(cube_max));
+  per_cube.print("per-cube");
+  batched.print("batched");
+}
+
+
+// 以前のCubeTextDrawer(Widgetごとにbindし、文字ごとにテクスチャを切り替える)
+void drawTextPerWidget(const size_t chara_num, const VboLayout& layout) noexcept {
+  bindVboMesh(layout);
+
+  for (size_t i = 0; i < chara_num; ++i) {
+    glColor4f(0, 0, 0, 1);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDrawElements(GL_TRIANGLES, 0, GL_UNSIGNED_SHORT, 0);
+
+    glColor4f(0, 0, 0, 1);
+    glTranslatef(0, 0, 0);
+    glScalef(1, 1, 1);
+
+    glEnable(GL_BLEND);
+    enableAndBindTexture();
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDrawElements(GL_TRIANGLES, 0, GL_UNSIGNED_SHORT, 0);
+
+    unbindAndDisableTexture();
+    glDisable(GL_BLEND);
+  }
+
+  unbindVboMesh(layout);
+}
+
+// 今のCubeTextDrawer(アトラスを文字列ごとに一度だけbind、頂点はGeometryArena)
+void drawTextArena(const size_t chara_num, GeometryArena& arena, const Model& model) noexcept {
+  enableAndBindTexture();
+
+  for (size_t i = 0; i < chara_num; ++i) {
+    glColor4f(0, 0, 0, 1);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisable(GL_TEXTURE_2D);
+    arena.drawGroup(model.arenaIndex(), 0);
+
+    glColor4f(0, 0, 0, 1);
+    glTranslatef(0, 0, 0);
+    glScalef(1, 1, 1);
+
+    glEnable(GL_BLEND);
+    glEnable(GL_TEXTURE_2D);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glMatrixMode(GL_TEXTURE);
+    glLoadIdentity();
+    glTranslatef(0, 0, 0);
+    glScalef(1, 1, 1);
+    glMatrixMode(GL_MODELVIEW);
+
+    arena.drawGroup(model.arenaIndex(), 1);
+    glDisable(GL_BLEND);
+  }
+
+  glMatrixMode(GL_TEXTURE);
+  glLoadIdentity();
+  glMatrixMode(GL_MODELVIEW);
+
+  unbindAndDisableTexture();
+}
+
+// 文字ごとの位置と回転(どちらも同じ)
+void placeChara() noexcept {
+  glMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glTranslatef(0, 0, 0);
+  glTranslatef(0, 0, 0);
+  glMultMatrixf(nullptr);
+  glTranslatef(0, 0, 0);
+  glScalef(1, 1, 1);
+}
+
+void restoreChara() noexcept {
+  glMatrixMode(GL_MODELVIEW);
+  glPopMatrix();
+}
+
+
+// 表示中のWidgetを一度描画した時の回数
+// TIPS:文字ごとの行列の呼び出しは、文字ごとの描画に含めて数える
+void countUI(const std::string& path, ModelHolder& models,
+             const std::map<std::string, VboLayout>& layouts) noexcept {
+  auto params = Params::load(path);
+
+  struct Widget {
+    std::string model;
+    size_t chara_num;
+  };
+  std::vector<Widget> widgets;
+  size_t chara_num = 0;
+  for (const auto& p : params) {
+    if (!Json::getValue(p, "disp", true)) continue;
+
+    CubeText text(p["text"].getValue<std::string>(),
+                  p["size"].getValue<float>(),
+                  p["spacing"].getValue<float>(),
+                  p["chara_split"].getValue<size_t>());
+    Widget widget = {
+      Json::getValue(p, "model", std::string("text")),
+      text.text().size(),
+    };
+    widgets.push_back(widget);
+    chara_num += widget.chara_num;
+  }
+
+  CallStats per_widget;
+  per_widget.begin();
+  for (const auto& widget : widgets) {
+    for (size_t i = 0; i < widget.chara_num; ++i) {
+      placeChara();
+      restoreChara();
+    }
+    drawTextPerWidget(widget.chara_num, layouts.at(widget.model));
+  }
+  per_widget.end();
+
+  CallStats arena;
+  arena.begin();
+  models.arena().bind();
+  for (const auto& widget : widgets) {
+    for (size_t i = 0; i < widget.chara_num; ++i) {
+      placeChara();
+      restoreChara();
+    }
+    drawTextArena(widget.chara_num, models.arena(), models.get(widget.model));
+  }
+  models.arena().unbind();
+  arena.end();
+
+  printf("%s: widgets %d charas %d\n", path.c_str(), int(widgets.size()), int(chara_num));
+  per_widget.print("per-widget");
+  arena.print("arena");
+}
+
+}
+
+
+void printHelp() {
+  printf("Count GL calls per frame without display\n");
+  printf("Usage:drawcount [-a assets] [-s seed] [-f frames]\n");
+}
+
+int main(int argc, const char* argv[]) {
+  u_int seed = 1;
+  int frame_num = 1800;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if ((arg == "-h") || (arg == "--help")) {
+      printHelp();
+      return 0;
+    }
+
+    if ((arg.size() == 2) && (arg[0] == '-') && ((i + 1) < argc)) {
+      const char* value = argv[++i];
+      switch (arg[1]) {
+      case 'a': ngs::Asset::rootPath() = std::string(value) + "/"; break;
+      case 's': seed = std::atoi(value); break;
+      case 'f': frame_num = std::max(std::atoi(value), 1); break;
+      default:
+        printHelp();
+        return 1;
+      }
+      continue;
+    }
+    printHelp();
+    return 1;
+  }
+
+  auto params = ngs::Params::load("params.json");
+  ngs::setupEaseFunc(params);
+  ngs::setupSoundHandle(params["sounds"]);
+
+  // アプリと同じModelを読み込む
+  ngs::ModelHolder models;
+  std::map<std::string, ngs::VboLayout> layouts;
+  for (const auto& p : params["app.models"]) {
+    auto name = p["name"].getValue<std::string>();
+    ngs::VboLayout layout = {
+      p["normals"].getValue<bool>(),
+      p["uvs"].getValue<bool>(),
+    };
+    models.add(name, p["path"].getValue<std::string>(),
+               layout.has_normals, layout.has_uvs, p["indices"].getValue<bool>());
+    layouts.insert({ name, layout });
+  }
+  models.build();
+
+  ngs::countField(params, seed, frame_num, models, layouts);
+
+  const char* ui_files[] = {
+    "ui_title.json",
+    "ui_intro.json",
+    "ui_progress.json",
+    "ui_gameover.json",
+    "ui_stageclear.json",
+    "ui_regularstageclear.json",
+    "ui_allstageclear.json",
+    "ui_pause.json",
+    "ui_settings.json",
+    "ui_records.json",
+    "ui_credits.json",
+  };
+  for (const auto* path : ui_files) {
+    ngs::countUI(path, models, layouts);
+  }
+
+  return 0;
+}
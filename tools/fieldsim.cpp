@@ -0,0 +1,434 @@
+﻿//
+// 画面無しでFieldを動かす
+//   固定時間でFieldEntityを更新し、スクリプトに従ってPickableCubeを動かす
+//   GL、サウンド、ウインドウは使わない
+//
+// ビルド例:
+//   c++ -std=c++11 -O2 -DHEADLESS -I../src -I$CINDER_PATH/include fieldsim.cpp
+//       -L$CINDER_PATH/lib -lcinder -lboost_system -lboost_filesystem -lz -o fieldsim
+//   -t で計測区間を書き出す場合は -DPROFILER も付ける
+//
+// スクリプト(JSON):
+//   {
+//     "repeat": 30,
+//     "moves": [
+//       { "frame": 0, "cube": -1, "direction": "up", "speed": 1 }
+//     ]
+//   }
+//   frame:     repeatで割った余りのフレームで動かす(repeatが0なら先頭からのフレーム)
+//   cube:      PickableCubeの番号(-1で全部)
+//   direction: up down left right
+//
+// 耐久テスト:
+//   -e で各ステージを指定回数繰り返した長いステージにする
+//   行や配置物は生成時に読み出すので、長さによらずメモリ使用量は一定になる
+//   -g で各ステージを、生成設定(params/stagegen.json)から自動生成したものに置き換える
+//   (seedとステージ番号から生成するので、同じseedなら同じステージになる)
+//
+// 再生:
+//   -l でゲーム中に記録した操作(replay.data)を、最速で再生する
+//   seedとRecordsは記録から復元し、スクリプトと-f -p -s -rは使わない
+//   記録と食い違うか、記録が壊れていたら、そこで止めて終了コード1を返す
+//
+// 一括実行:
+//   -n で独立したFieldを指定数だけ、seedを1ずつ変えて動かす(-j はスレッド数)
+//   ワークスティーリングで各スレッドに割り振り、Recordsの結果をまとめて表示する
+//   パラメータ(build_speedなど)の調整用
+//
+
+#include "Defines.hpp"
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#if !defined (_MSC_VER)
+#include <sys/resource.h>
+#endif
+#include <cinder/Json.h>
+#include <cinder/Timeline.h>
+#include "Utility.hpp"
+#include "JsonUtil.hpp"
+#include "Params.hpp"
+#include "Records.hpp"
+#include "FieldSimulator.hpp"
+#include "Replay.hpp"
+#include "WorkStealingPool.hpp"
+
+
+namespace ngs {
+
+struct ScriptMove {
+  u_int frame;
+  int cube;
+  int direction;
+  int speed;
+};
+
+struct Script {
+  u_int repeat;
+  std::vector<ScriptMove> moves;
+};
+
+
+// 指定が無い時はすべてのPickableCubeを前に進め続ける
+Script defaultScript() noexcept {
+  Script script = {
+    30,
+    { { 0, -1, PickableCube::MOVE_UP, 1 } },
+  };
+
+  return script;
+}
+
+Script loadScript(const std::string& path) noexcept {
+  static const std::map<std::string, int> direction = {
+    { "up",    PickableCube::MOVE_UP },
+    { "down",  PickableCube::MOVE_DOWN },
+    { "left",  PickableCube::MOVE_LEFT },
+    { "right", PickableCube::MOVE_RIGHT },
+  };
+
+  ci::JsonTree json(ci::loadFile(path));
+
+  Script script;
+  script.repeat = Json::getValue(json, "repeat", 0);
+
+  for (const auto& move : json["moves"]) {
+    ScriptMove m = {
+      move["frame"].getValue<u_int>(),
+      Json::getValue(move, "cube", -1),
+      direction.at(move["direction"].getValue<std::string>()),
+      Json::getValue(move, "speed", 1),
+    };
+    script.moves.push_back(m);
+  }
+
+  return script;
+}
+
+void applyScript(const Script& script, FieldSimulator& simulator) noexcept {
+  u_int frame = script.repeat ? (simulator.frameNum() % script.repeat)
+                              : simulator.frameNum();
+
+  for (const auto& move : script.moves) {
+    if (move.frame != frame) continue;
+
+    if (move.cube < 0) {
+      for (size_t i = 0; i < simulator.pickableCubeNum(); ++i) {
+        simulator.movePickableCube(i, move.direction, move.speed);
+      }
+    }
+    else {
+      simulator.movePickableCube(move.cube, move.direction, move.speed);
+    }
+  }
+}
+
+
+// 記録した操作を最後まで再生する
+// 記録と食い違うか、記録が壊れていたらそこで止めてfalse
+bool runReplay(Replay::Player& player, FieldSimulator& simulator) noexcept {
+  Replay::Input input;
+  while (player.next(input)) {
+    if (input.type != Replay::FRAME) {
+      if (input.frame != simulator.frameNum()) {
+        printf("replay: frame mismatch %u != %u\n", input.frame, simulator.frameNum());
+      }
+      if (!simulator.apply(input)) {
+        printf("replay: desync at frame %u (cube %u of %u)\n",
+               simulator.frameNum(), input.index, u_int(simulator.pickableCubeNum()));
+        return false;
+      }
+      continue;
+    }
+
+    for (u_int i = 0; i < input.frame_num; ++i) {
+#if defined (PROFILER)
+      ngs::Profiler::frame();
+#endif
+      simulator.update(input.dt);
+    }
+  }
+
+  if (!player.isEnd()) {
+    printf("replay: broken data at frame %u\n", simulator.frameNum());
+    return false;
+  }
+  return true;
+}
+
+
+// 一括実行の集計(スレッドごとに持ち、最後に合算する)
+struct Outcome {
+  u_int instances;
+  u_int frames;
+  u_int plays;
+  u_int cleard_stages;
+  u_int total_items;
+  long long score_total;
+  int high_score;
+
+  // ステージごとのランクの合計
+  std::vector<long long> stage_rank_total;
+
+  Outcome() noexcept :
+    instances(0),
+    frames(0),
+    plays(0),
+    cleard_stages(0),
+    total_items(0),
+    score_total(0),
+    high_score(0)
+  {}
+
+  void add(const FieldSimulator& simulator, const Records& records) noexcept {
+    instances     += 1;
+    frames        += simulator.frameNum();
+    plays         += simulator.playNum();
+    cleard_stages += simulator.cleardStageNum();
+    total_items   += records.getTotalItemNum();
+    score_total   += records.getHighScore();
+    high_score     = std::max(records.getHighScore(), high_score);
+
+    auto ranks = records.stageRanks();
+    if (stage_rank_total.size() < ranks.size()) stage_rank_total.resize(ranks.size(), 0);
+    for (size_t i = 0; i < ranks.size(); ++i) {
+      stage_rank_total[i] += ranks[i];
+    }
+  }
+
+  void add(const Outcome& rhs) noexcept {
+    instances     += rhs.instances;
+    frames        += rhs.frames;
+    plays         += rhs.plays;
+    cleard_stages += rhs.cleard_stages;
+    total_items   += rhs.total_items;
+    score_total   += rhs.score_total;
+    high_score     = std::max(rhs.high_score, high_score);
+
+    if (stage_rank_total.size() < rhs.stage_rank_total.size()) stage_rank_total.resize(rhs.stage_rank_total.size(), 0);
+    for (size_t i = 0; i < rhs.stage_rank_total.size(); ++i) {
+      stage_rank_total[i] += rhs.stage_rank_total[i];
+    }
+  }
+};
+
+// 1つのFieldを最後まで動かす
+// TIPS:複数のスレッドから呼ばれる。paramsは読むだけ
+void runInstance(ci::JsonTree& params, const Script& script, const u_int seed,
+                 const u_int frame_max, const u_int play_max, const double progressing_seconds,
+                 Outcome& outcome) noexcept {
+  Records records(params["version"].getValue<float>());
+  FieldSimulator simulator(params, records, seed);
+
+  while (simulator.frameNum() < frame_max) {
+    applyScript(script, simulator);
+    simulator.update(progressing_seconds);
+
+    if (play_max && (simulator.playNum() >= play_max)) break;
+  }
+
+  outcome.add(simulator, records);
+}
+
+void printOutcome(const Outcome& outcome) noexcept {
+  double n = std::max(outcome.instances, 1u);
+
+  printf("batch:\n");
+  printf("  instances:   %u\n", outcome.instances);
+  printf("  plays:       %u (%.2f per instance)\n", outcome.plays, outcome.plays / n);
+  printf("  cleared:     %u stages (%.2f per instance)\n", outcome.cleard_stages, outcome.cleard_stages / n);
+  printf("  high score:  %d (average %.1f)\n", outcome.high_score, outcome.score_total / n);
+  printf("  total items: %u (%.2f per instance)\n", outcome.total_items, outcome.total_items / n);
+
+  printf("  stage ranks:");
+  for (auto rank : outcome.stage_rank_total) {
+    printf(" %.2f", rank / n);
+  }
+  printf("\n");
+}
+
+
+void printRecords(const Records& records) noexcept {
+  const auto& current_game = records.currentGame();
+
+  printf("records:\n");
+  printf("  total play:  %d\n", records.getTotalPlayNum());
+  printf("  total time:  %.3f\n", records.getTotalPlayTime());
+  printf("  high score:  %d\n", records.getHighScore());
+  printf("  total items: %d\n", records.getTotalItemNum());
+  printf("  last game:   stage %d score %d\n", current_game.stage_num, current_game.score);
+
+  printf("  stage ranks:");
+  for (auto rank : records.stageRanks()) {
+    printf(" %d", rank);
+  }
+  printf("\n");
+}
+
+}
+
+
+void printHelp() {
+  printf("Run FieldEntity without display\n");
+  printf("Usage:fieldsim [-a assets] [-f frames] [-p plays] [-s seed] [-r fps] [-e repeat] [-g stagegen.json] [-t trace] [-l replay] [-n instances] [-j threads] [script]\n");
+}
+
+int main(int argc, const char* argv[]) {
+  std::string script_path;
+  u_int frame_max = 60 * 60 * 10;
+  u_int play_max  = 0;
+  u_int seed      = 0;
+  double fps      = 60.0;
+  int stage_repeat = 1;
+  std::string generator_path;
+  std::string trace_path;
+  std::string replay_path;
+  u_int instance_num = 0;
+  u_int thread_num   = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if ((arg == "-h") || (arg == "--help")) {
+      printHelp();
+      return 0;
+    }
+
+    if ((arg.size() == 2) && (arg[0] == '-') && ((i + 1) < argc)) {
+      const char* value = argv[++i];
+      switch (arg[1]) {
+      case 'a': ngs::Asset::rootPath() = std::string(value) + "/"; break;
+      case 'f': frame_max = std::atoi(value); break;
+      case 'p': play_max  = std::atoi(value); break;
+      case 's': seed      = std::atoi(value); break;
+      case 'r': fps       = std::atof(value); break;
+      case 'e': stage_repeat = std::atoi(value); break;
+      case 'g': generator_path = value; break;
+      case 't': trace_path   = value; break;
+      case 'l': replay_path  = value; break;
+      case 'n': instance_num = std::atoi(value); break;
+      case 'j': thread_num   = std::atoi(value); break;
+      default:
+        printHelp();
+        return 1;
+      }
+      continue;
+    }
+    script_path = arg;
+  }
+
+  auto script = script_path.empty() ? ngs::defaultScript()
+                                    : ngs::loadScript(script_path);
+
+  ngs::Replay::Player player;
+  if (!replay_path.empty()) {
+    if (!player.load(replay_path)) {
+      printf("can't read: %s\n", replay_path.c_str());
+      return 1;
+    }
+    seed = player.seed();
+  }
+
+  auto params = ngs::Params::load("params.json");
+  if (stage_repeat > 1) {
+    params["game"].addChild(ci::JsonTree("stage_repeat", stage_repeat));
+  }
+  if (!generator_path.empty()) {
+    auto settings = ci::JsonTree::makeObject("stage_generator");
+    for (const auto& child : ci::JsonTree(ci::loadFile(generator_path))) {
+      settings.addChild(child);
+    }
+    if (!ngs::StageGenerator::Settings(settings).isValid()) {
+      printf("invalid settings: %s\n", generator_path.c_str());
+      return 1;
+    }
+    params["game"].addChild(settings);
+  }
+  // Fieldを作る前に一度だけ(以後は各スレッドから読むだけ)
+  ngs::setupEaseFunc(params);
+  ngs::setupSoundHandle(params["sounds"]);
+  const double progressing_seconds = 1.0 / fps;
+
+  if (instance_num) {
+    ngs::WorkStealingPool pool(thread_num);
+    std::vector<ngs::Outcome> outcomes(pool.threadNum());
+
+    auto start_time = std::chrono::steady_clock::now();
+    for (u_int i = 0; i < instance_num; ++i) {
+      pool.submit([&, i](const u_int worker) {
+          ngs::runInstance(params, script, seed + i,
+                           frame_max, play_max, progressing_seconds,
+                           outcomes[worker]);
+        });
+    }
+    pool.wait();
+    auto end_time = std::chrono::steady_clock::now();
+    double wall_seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+    ngs::Outcome outcome;
+    for (const auto& o : outcomes) {
+      outcome.add(o);
+    }
+
+    printf("threads:    %u\n", pool.threadNum());
+    printf("frames:     %u\n", outcome.frames);
+    printf("wall time:  %.3f sec\n", wall_seconds);
+    printf("throughput: %.1f frames/sec\n", (wall_seconds > 0.0) ? (outcome.frames / wall_seconds) : 0.0);
+    ngs::printOutcome(outcome);
+    return 0;
+  }
+
+  ngs::Records records(params["version"].getValue<float>());
+  if (!replay_path.empty()) {
+    records.fromJson(ci::JsonTree(player.records()));
+  }
+  ngs::FieldSimulator simulator(params, records, seed, replay_path.empty());
+
+  double simulated_seconds = 0.0;
+  bool replay_ok = true;
+
+  auto start_time = std::chrono::steady_clock::now();
+  if (!replay_path.empty()) {
+    replay_ok = ngs::runReplay(player, simulator);
+    simulated_seconds = simulator.simulatedSeconds();
+  }
+  else {
+    while (simulator.frameNum() < frame_max) {
+#if defined (PROFILER)
+      ngs::Profiler::frame();
+#endif
+      ngs::applyScript(script, simulator);
+      simulator.update(progressing_seconds);
+
+      if (play_max && (simulator.playNum() >= play_max)) break;
+    }
+    simulated_seconds = simulator.simulatedSeconds();
+  }
+  auto end_time = std::chrono::steady_clock::now();
+  double wall_seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+  u_int frame_num = simulator.frameNum();
+  printf("frames:     %u (%.1f sec simulated)\n", frame_num, simulated_seconds);
+  printf("wall time:  %.3f sec\n", wall_seconds);
+  printf("throughput: %.1f frames/sec\n", (wall_seconds > 0.0) ? (frame_num / wall_seconds) : 0.0);
+  printf("plays:      %u\n", simulator.playNum());
+  printf("cleared:    %d stages\n", simulator.cleardStageNum());
+#if !defined (_MSC_VER)
+  {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("max rss:    %ld\n", usage.ru_maxrss);
+  }
+#endif
+
+  ngs::printRecords(records);
+
+  // 計測区間の記録(PROFILER定義時)
+  if (!trace_path.empty()) {
+    ngs::Profiler::writeChromeTrace(trace_path);
+  }
+
+  return replay_ok ? 0 : 1;
+}
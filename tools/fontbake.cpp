@@ -0,0 +1,168 @@
+﻿//
+// Fontをアトラス画像に変換
+//   params.jsonのapp.fontsごとに、使う文字を事前にレンダリングして
+//   アトラス画像(.png)と文字の表(.json)を書き出す
+//   起動時はこれを読み込み、無い文字だけFreeTypeで描く
+//
+//   書き出す文字:
+//     pre_render_text, bake_text の1文字ずつ
+//     UIのJSONで使われているtext(chara_splitで分割)
+//
+// ビルド例:
+//   c++ -std=c++11 -O2 -DHEADLESS -I../src -I$CINDER_PATH/include -I$FREETYPE_PATH/include fontbake.cpp
+//       -L$CINDER_PATH/lib -lcinder -lfreetype -lboost_system -lboost_filesystem -o fontbake
+//
+// 使用例:
+//   fontbake -a ../assets -o ../assets ../params/ui_*.json
+//
+
+#include "Defines.hpp"
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <cstdio>
+#include <cinder/Json.h>
+#include <cinder/ImageIo.h>
+#include "Utility.hpp"
+#include "JsonUtil.hpp"
+#include "Params.hpp"
+#include "TextureFont.hpp"
+
+
+namespace ngs {
+
+// Fontごとの書き出す文字(並び順を保つ)
+struct BakeList {
+  std::vector<std::string> keys;
+  std::set<std::string> registered;
+
+  void add(const std::string& key) noexcept {
+    if (registered.insert(key).second) keys.push_back(key);
+  }
+
+  void addSplit(const std::string& text, const size_t split) noexcept {
+    size_t text_length = strlen(text);
+    for (size_t it = 0; it < text_length; it += split) {
+      add(substr(text, it, split));
+    }
+  }
+};
+
+
+// UIのJSONからtextを集める
+void collectTexts(const ci::JsonTree& json, std::map<std::string, BakeList>& lists) noexcept {
+  if (json.hasChild("text") && json.hasChild("chara_split")) {
+    auto font  = Json::getValue(json, "font", std::string("default"));
+    auto split = json["chara_split"].getValue<size_t>();
+    lists[font].addSplit(json["text"].getValue<std::string>(), split);
+  }
+
+  for (const auto& child : json) {
+    collectTexts(child, lists);
+  }
+}
+
+
+void bake(const ci::JsonTree& params, BakeList& list,
+          FontCreator& creator, const std::string& output_path) noexcept {
+  auto name          = params["name"].getValue<std::string>();
+  int size           = params["size"].getValue<int>();
+  int atlas_size     = Json::getValue(params, "atlas_size", 1024);
+  int atlas_padding  = Json::getValue(params, "atlas_padding", 2);
+  auto table_path    = Json::getValue(params, "baked", "font_" + name + ".json");
+  auto image_path    = replaceFilenameExt(table_path, "png");
+
+  size_t cell_num = GlyphAtlas::cellNum(size, atlas_size, atlas_padding);
+  if (list.keys.size() > cell_num) {
+    printf("%s: %u glyphs exceed %u cells, truncated.\n",
+           name.c_str(), u_int(list.keys.size()), u_int(cell_num));
+    list.keys.resize(cell_num);
+  }
+
+  Font font(params["path"].getValue<std::string>(), creator);
+  font.setSize(size);
+
+  ci::Surface8u atlas(atlas_size, atlas_size, true, ci::SurfaceChannelOrder::RGBA);
+  ci::ip::fill(&atlas, ci::ColorAT<uint8_t>(255, 255, 255, 0));
+
+  // 並び順がアトラスの枠の番号
+  auto glyphs = ci::JsonTree::makeArray("glyphs");
+  for (size_t i = 0; i < list.keys.size(); ++i) {
+    const auto& key = list.keys[i];
+    auto surface = TextureFont::renderGlyph(font, size, key);
+    atlas.copyFrom(surface, surface.getBounds(),
+                   GlyphAtlas::glyphPosition(u_int(i), size, atlas_size, atlas_padding));
+
+    auto glyph = ci::JsonTree::makeObject();
+    glyph.addChild(ci::JsonTree("text", key));
+    glyphs.pushBack(glyph);
+  }
+
+  ci::writeImage(output_path + image_path, atlas);
+
+  auto table = ci::JsonTree::makeObject();
+  table.addChild(ci::JsonTree("name", name))
+    .addChild(ci::JsonTree("size", size))
+    .addChild(ci::JsonTree("atlas_size", atlas_size))
+    .addChild(ci::JsonTree("atlas_padding", atlas_padding))
+    .addChild(ci::JsonTree("image", image_path))
+    .addChild(glyphs);
+  table.write(output_path + table_path);
+
+  printf("%s: %u glyphs -> %s %s\n",
+         name.c_str(), u_int(list.keys.size()), table_path.c_str(), image_path.c_str());
+}
+
+}
+
+
+void printHelp() {
+  printf("Bake font atlases\n");
+  printf("Usage:fontbake [-a assets] [-o output] [ui.json...]\n");
+}
+
+int main(int argc, const char* argv[]) {
+  std::string output_path;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if ((arg == "-h") || (arg == "--help")) {
+      printHelp();
+      return 0;
+    }
+
+    if ((arg.size() == 2) && (arg[0] == '-') && ((i + 1) < argc)) {
+      const char* value = argv[++i];
+      switch (arg[1]) {
+      case 'a': ngs::Asset::rootPath() = std::string(value) + "/"; break;
+      case 'o': output_path = std::string(value) + "/"; break;
+      default:
+        printHelp();
+        return 1;
+      }
+      continue;
+    }
+    paths.push_back(arg);
+  }
+  if (output_path.empty()) output_path = ngs::Asset::rootPath();
+
+  auto params = ngs::Params::load("params.json");
+  const auto& fonts_params = params["app.fonts"];
+
+  std::map<std::string, ngs::BakeList> lists;
+  for (const auto& p : fonts_params) {
+    auto& list = lists[p["name"].getValue<std::string>()];
+    list.addSplit(ngs::Json::getValue(p, "pre_render_text", std::string()), 1);
+    list.addSplit(ngs::Json::getValue(p, "bake_text", std::string()), 1);
+  }
+  for (const auto& path : paths) {
+    ngs::collectTexts(ci::JsonTree(ci::loadFile(path)), lists);
+  }
+
+  ngs::FontCreator creator;
+  for (const auto& p : fonts_params) {
+    ngs::bake(p, lists[p["name"].getValue<std::string>()], creator, output_path);
+  }
+}
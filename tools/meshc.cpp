@@ -0,0 +1,151 @@
+﻿//
+// .objをバイナリ形式(.mesh)に変換
+//   params.jsonのapp.modelsごとに、path と path_low の両方を変換する
+//   起動時はこれをマップして読み込み、.objのサイズが変わっていたら.objを読み込む
+//   TIPS:起動時は中身を比べないので、ビルド時に -c で古い.meshが無いか調べる
+//
+// ビルド例:
+//   c++ -std=c++11 -O2 -DHEADLESS -I../src -I$CINDER_PATH/include meshc.cpp
+//       -L$CINDER_PATH/lib -lcinder -lboost_system -lboost_filesystem -o meshc
+//
+// 使用例:
+//   meshc -a ../assets -o ../assets
+//   meshc -a ../assets -c    古い.meshがあれば終了コード1(ビルドを止める)
+//
+
+#include "Defines.hpp"
+#include <string>
+#include <vector>
+#include <set>
+#include <fstream>
+#include <cstdio>
+#include <cinder/Json.h>
+#include "Utility.hpp"
+#include "JsonUtil.hpp"
+#include "Params.hpp"
+#include "Asset.hpp"
+#include "MeshFormat.hpp"
+
+
+namespace ngs {
+
+bool compileMesh(const std::string& path,
+                 const bool has_normals, const bool has_uvs, const bool has_indices,
+                 const std::string& output_path) noexcept {
+  auto source = readFile(Asset::fullPath(path));
+  if (source.empty()) {
+    printf("can't read: %s\n", path.c_str());
+    return false;
+  }
+
+  ci::TriMesh mesh;
+  std::vector<int> group_face;
+  MeshFormat::loadObj(Asset::load(path), has_normals, has_uvs, has_indices, mesh, group_face);
+
+  auto bytes = MeshFormat::compile(mesh, group_face, source);
+
+  // 読み戻して確認
+  CompiledMesh compiled(bytes);
+  if (!compiled.isMatch(has_normals, has_uvs, has_indices, source)) {
+    printf("compile error: %s\n", path.c_str());
+    return false;
+  }
+
+  auto mesh_path = replaceFilenameExt(path, "mesh");
+  std::ofstream fstr(output_path + mesh_path, std::ios::binary);
+  if (!fstr) {
+    printf("can't write: %s\n", mesh_path.c_str());
+    return false;
+  }
+  fstr.write(bytes.data(), bytes.size());
+
+  printf("%s -> %s (%u bytes, v:%u i:%u g:%u)\n",
+         path.c_str(), mesh_path.c_str(), u_int(bytes.size()),
+         u_int(compiled.vertexNum()), u_int(compiled.indices().size()),
+         u_int(compiled.groupFaces().size()));
+  return true;
+}
+
+// 変換済みの.meshが今の.objと一致しているか
+bool checkMesh(const std::string& path,
+               const bool has_normals, const bool has_uvs, const bool has_indices) noexcept {
+  auto source = readFile(Asset::fullPath(path));
+  auto mesh_path = replaceFilenameExt(path, "mesh");
+  auto bytes = readFile(Asset::fullPath(mesh_path));
+  if (source.empty() || bytes.empty()) {
+    printf("can't read: %s\n", (source.empty() ? path : mesh_path).c_str());
+    return false;
+  }
+
+  CompiledMesh compiled(bytes);
+  if (!compiled.isMatch(has_normals, has_uvs, has_indices, source)) {
+    printf("out of date: %s (run meshc)\n", mesh_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}
+
+
+void printHelp() {
+  printf("Model obj to binary\n");
+  printf("Usage:meshc [-a assets] [-o output] [-c]\n");
+  printf("  -c: check .mesh files are up to date (no output)\n");
+}
+
+int main(int argc, const char* argv[]) {
+  std::string output_path;
+  bool check = false;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if ((arg == "-h") || (arg == "--help")) {
+      printHelp();
+      return 0;
+    }
+    if (arg == "-c") {
+      check = true;
+      continue;
+    }
+
+    if ((arg.size() == 2) && (arg[0] == '-') && ((i + 1) < argc)) {
+      const char* value = argv[++i];
+      switch (arg[1]) {
+      case 'a': ngs::Asset::rootPath() = std::string(value) + "/"; break;
+      case 'o': output_path = std::string(value) + "/"; break;
+      default:
+        printHelp();
+        return 1;
+      }
+      continue;
+    }
+    printHelp();
+    return 1;
+  }
+  if (output_path.empty()) output_path = ngs::Asset::rootPath();
+
+  auto params = ngs::Params::load("params.json");
+
+  // 同じ.objを複数のModelで使っている場合は一度だけ変換
+  std::set<std::string> compiled;
+  int result = 0;
+  for (const auto& p : params["app.models"]) {
+    bool has_normals = p["normals"].getValue<bool>();
+    bool has_uvs     = p["uvs"].getValue<bool>();
+    bool has_indices = p["indices"].getValue<bool>();
+
+    for (const auto* key : { "path", "path_low" }) {
+      if (!p.hasChild(key)) continue;
+
+      auto path = p[key].getValue<std::string>();
+      if (!compiled.insert(path).second) continue;
+
+      bool ok = check ? ngs::checkMesh(path, has_normals, has_uvs, has_indices)
+                      : ngs::compileMesh(path, has_normals, has_uvs, has_indices, output_path);
+      if (!ok) result = 1;
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,53 @@
+﻿//
+// stageのJSONをバイナリ形式に変換
+//
+// ビルド例:
+//   c++ -std=c++11 -O2 -DHEADLESS -I../src -I$CINDER_PATH/include stagec.cpp
+//       -L$CINDER_PATH/lib -lcinder -lboost_system -lboost_filesystem -o stagec
+//
+
+#include "Defines.hpp"
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cinder/Json.h>
+#include "Utility.hpp"
+#include "JsonUtil.hpp"
+#include "StageFormat.hpp"
+
+
+void printHelp() {
+  printf("Stage json to binary\n");
+  printf("Usage:stagec input [output]\n");
+}
+
+int main(int argc, const char* argv[]) {
+  if (argc < 2) {
+    printHelp();
+    return 0;
+  }
+
+  std::string input(argv[1]);
+  std::string output = (argc > 2) ? std::string(argv[2])
+                                  : ngs::replaceFilenameExt(input, "stage");
+
+  auto bytes = ngs::StageFormat::compile(ci::JsonTree(ci::loadFile(input)));
+
+  // 読み戻して確認
+  ngs::CompiledStage stage(bytes);
+  if (!stage.isValid()) {
+    printf("compile error: %s\n", input.c_str());
+    return 1;
+  }
+
+  std::ofstream fstr(output, std::ios::binary);
+  if (!fstr) {
+    printf("can't write: %s\n", output.c_str());
+    return 1;
+  }
+  fstr.write(bytes.data(), bytes.size());
+
+  printf("%s -> %s (%u bytes, %d x %d, items %u)\n",
+         input.c_str(), output.c_str(), ngs::u_int(bytes.size()),
+         stage.width(), stage.depth(), ngs::u_int(stage.items().size()));
+}
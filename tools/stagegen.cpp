@@ -0,0 +1,208 @@
+﻿//
+// Stageの自動生成
+//   seedごとにStageを作り、通り抜けられるものだけ書き出す
+//   seedごとに独立しているので、複数のスレッドで並列に生成する
+//   ファイルを指定すると、生成せずにそのStageを調べる
+//
+// ビルド例:
+//   c++ -std=c++11 -O2 -DHEADLESS -I../src -I$CINDER_PATH/include stagegen.cpp
+//       -L$CINDER_PATH/lib -lcinder -lboost_system -lboost_filesystem -lpthread -o stagegen
+//
+// 使用例:
+//   stagegen -a ../assets -g ../params/stagegen.json -n 1000 -j 8 -o out
+//
+
+#include "Defines.hpp"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cinder/Json.h>
+#include "Utility.hpp"
+#include "JsonUtil.hpp"
+#include "Params.hpp"
+#include "StageData.hpp"
+#include "StageGenerator.hpp"
+#include "StageSolver.hpp"
+
+
+namespace ngs {
+
+struct Options {
+  std::string settings_path;
+  std::string output_path;
+  u_int first_seed;
+  u_int count;
+  u_int threads;
+  int   pickable_num;
+  bool  binary;
+};
+
+
+bool writeStage(const std::string& path, ci::JsonTree& json,
+                const std::string& bytes, const bool binary) noexcept {
+  json.write(path + ".json");
+  if (!binary) return true;
+
+  std::ofstream fstr(path + ".stage", std::ios::binary);
+  if (!fstr) return false;
+  fstr.write(bytes.data(), bytes.size());
+  return true;
+}
+
+int generate(const Options& options,
+             const StageSolver::Settings& solver_settings,
+             const CompiledStage& start_line,
+             const CompiledStage& finish_line) noexcept {
+  StageGenerator::Settings settings(ci::JsonTree(ci::loadFile(options.settings_path)));
+  if (!settings.isValid()) {
+    printf("invalid settings: %s (width must be 1 - %d)\n",
+           options.settings_path.c_str(), int(StageFormat::MAX_WIDTH));
+    return 1;
+  }
+
+  std::atomic<u_int> next(0);
+  std::atomic<u_int> solved(0);
+  std::atomic<u_int> visited(0);
+
+  auto worker = [&]() noexcept {
+    while (1) {
+      u_int i = next++;
+      if (i >= options.count) break;
+
+      u_int seed = options.first_seed + i;
+      auto json  = StageGenerator::generate(settings, seed);
+      auto bytes = StageFormat::compile(json);
+      CompiledStage stage(bytes);
+      if (!stage.isValid()) continue;
+
+      auto result = StageSolver::solve(solver_settings,
+                                       start_line, stage, finish_line,
+                                       options.pickable_num);
+      visited += result.visited;
+      if (!result.solved) continue;
+
+      solved += 1;
+      if (!options.output_path.empty()) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/gen%06u", seed);
+        writeStage(options.output_path + name, json, bytes, options.binary);
+      }
+    }
+  };
+
+  auto start_time = std::chrono::steady_clock::now();
+  {
+    std::vector<std::thread> threads;
+    for (u_int i = 0; i < options.threads; ++i) {
+      threads.emplace_back(worker);
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  auto end_time = std::chrono::steady_clock::now();
+  double wall_seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+  printf("generated:  %u (seed %u - %u)\n", options.count,
+         options.first_seed, options.first_seed + options.count - 1);
+  printf("solved:     %u\n", u_int(solved));
+  printf("rejected:   %u\n", options.count - u_int(solved));
+  printf("visited:    %u cells\n", u_int(visited));
+  printf("wall time:  %.3f sec (%u threads)\n", wall_seconds, options.threads);
+  printf("throughput: %.1f stages/sec\n", (wall_seconds > 0.0) ? (options.count / wall_seconds) : 0.0);
+
+  return 0;
+}
+
+int verify(const std::vector<std::string>& paths,
+           const Options& options,
+           const StageSolver::Settings& solver_settings,
+           const CompiledStage& start_line,
+           const CompiledStage& finish_line) noexcept {
+  int failed = 0;
+  for (const auto& path : paths) {
+    CompiledStage stage(StageFormat::compile(ci::JsonTree(ci::loadFile(path))));
+    if (!stage.isValid()) {
+      printf("%s: invalid\n", path.c_str());
+      failed += 1;
+      continue;
+    }
+
+    auto result = StageSolver::solve(solver_settings,
+                                     start_line, stage, finish_line,
+                                     options.pickable_num);
+    if (result.solved) {
+      printf("%s: ok (%.2f sec)\n", path.c_str(), result.arrival_time);
+    }
+    else {
+      printf("%s: unreachable\n", path.c_str());
+      failed += 1;
+    }
+  }
+
+  return failed ? 1 : 0;
+}
+
+}
+
+
+void printHelp() {
+  printf("Generate solvable stages\n");
+  printf("Usage:stagegen [-a assets] [-g settings] [-n count] [-s first seed] [-j threads] [-p pickable] [-o output] [-b] [stage.json...]\n");
+}
+
+int main(int argc, const char* argv[]) {
+  ngs::Options options = {
+    "stagegen.json",
+    "",
+    0,
+    100,
+    std::max(std::thread::hardware_concurrency(), 1u),
+    1,
+    false
+  };
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if ((arg == "-h") || (arg == "--help")) {
+      printHelp();
+      return 0;
+    }
+    if (arg == "-b") {
+      options.binary = true;
+      continue;
+    }
+
+    if ((arg.size() == 2) && (arg[0] == '-') && ((i + 1) < argc)) {
+      const char* value = argv[++i];
+      switch (arg[1]) {
+      case 'a': ngs::Asset::rootPath() = std::string(value) + "/"; break;
+      case 'g': options.settings_path = value; break;
+      case 'n': options.count         = std::atoi(value); break;
+      case 's': options.first_seed    = std::atoi(value); break;
+      case 'j': options.threads       = std::max(std::atoi(value), 1); break;
+      case 'p': options.pickable_num  = std::atoi(value); break;
+      case 'o': options.output_path   = value; break;
+      default:
+        printHelp();
+        return 1;
+      }
+      continue;
+    }
+    paths.push_back(arg);
+  }
+
+  auto params = ngs::Params::load("params.json");
+  ngs::StageSolver::Settings solver_settings(params);
+  auto start_line  = ngs::StageData::load("startline.json");
+  auto finish_line = ngs::StageData::load("finishline.json");
+
+  return paths.empty() ? ngs::generate(options, solver_settings, start_line, finish_line)
+                       : ngs::verify(paths, options, solver_settings, start_line, finish_line);
+}